@@ -0,0 +1,107 @@
+#ifndef ELF_ARCHIVE_H
+#define ELF_ARCHIVE_H
+
+
+#include <cstdint>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "elf_parser.hpp"
+
+namespace elf {
+
+constexpr std::size_t ar_magic_size =		8;	// "!<arch>\n"
+constexpr std::size_t ar_header_size =		60;
+
+
+// one file of an archive, the symbol index and long name table aren't members
+typedef struct archive_member {
+	std::string_view name;		// long names resolved, into the archive's buffer
+	std::uint64_t header;		// offset of the member header
+	std::uint64_t offset;		// offset of the contents
+	std::uint64_t size;
+	std::uint64_t mtime;
+	std::uint32_t uid;
+	std::uint32_t gid;
+	std::uint32_t mode;
+} archive_member;
+
+
+// A static library in the System V / GNU ar format. Members are walked once
+// at open, with names from the "//" table resolved and BSD "#1/" names
+// handled, and their contents stay views into the one buffer. The armap ("/"
+// or "/SYM64/") is read into a name to member hash on the first lookup, so
+// the member defining a symbol is found without parsing any member. Members
+// are parsed on first access, or ahead of time on a pool of threads with
+// parse_members.
+class archive_file {
+
+	// Factory
+	public:
+		// null with error filled on failure, bad_magic for files that aren't
+		// archives and bad_header for a damaged member header. Member
+		// parsers are opened with options, lazy and mapped by default.
+		static std::unique_ptr<archive_file> open(const std::string& file, parse_error& error,
+						read_options options=read_options(load_mode::map, true));
+		static std::unique_ptr<archive_file> open(std::shared_ptr<file_buffer> buffer, parse_error& error,
+						read_options options=read_options(load_mode::map, true));
+		// whether bytes start with the archive magic
+		static bool is_archive(byte_view bytes);
+
+		static constexpr std::size_t npos = ~std::size_t(0);
+
+		const std::vector<archive_member>& members(void) const { return memberList; }
+		std::size_t size(void) const { return memberList.size(); }
+		// contents of member index as a view into the archive
+		byte_view member_bytes(std::size_t index) const;
+		// first member named name, npos if none
+		std::size_t find_member(std::string_view name) const;
+
+		// whether the archive has an armap, without one find_symbol parses
+		// every member on its first call to index their symbols
+		bool has_symbol_index(void) const { return armapWidth != 0; }
+		// armap names to member index, the first member listed for a name.
+		// Safe to call from several threads.
+		const std::unordered_map<std::string_view, std::size_t>& symbol_index(void);
+		// member defining symbol, npos if none does
+		std::size_t find_symbol(std::string_view symbol);
+
+		// Parser of member index, parsed on first access and kept. Null
+		// with error filled, if given, for members that aren't ELF files.
+		// Safe to call from several threads.
+		elf_parser* member(std::size_t index, parse_error* error=nullptr);
+		// parser of the member defining symbol, null if none does
+		elf_parser* defining_member(std::string_view symbol);
+		// Parses indexes, every member if empty, on up to threads threads, 0
+		// for every hardware thread. Returns how many parsed.
+		std::size_t parse_members(const std::vector<std::size_t>& indexes=std::vector<std::size_t>(),
+						unsigned threads=0);
+
+	private:
+		std::shared_ptr<file_buffer> buffer;
+		read_options options;
+		std::vector<archive_member> memberList;
+		byte_view armapTable;
+		int armapWidth = 0;		// 4 for "/", 8 for "/SYM64/", 0 without an armap
+		std::unordered_map<std::string_view, std::size_t> symbols;
+		std::once_flag indexed;
+		std::unique_ptr<std::once_flag[]> parsed;
+		std::vector<std::unique_ptr<elf_parser>> parsers;
+		std::vector<parse_error> errors;
+
+		archive_file(std::shared_ptr<file_buffer> buffer, read_options options)
+				: buffer(std::move(buffer)), options(options) {}
+		void walk(void);
+		void read_armap(void);
+		void index_members(void);
+};
+
+
+} // end of namespace elf
+
+#endif
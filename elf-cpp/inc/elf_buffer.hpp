@@ -0,0 +1,204 @@
+#ifndef ELF_BUFFER_H
+#define ELF_BUFFER_H
+
+
+#include <cstdint>
+#include <cstddef>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace elf {
+
+class metadata_cache;
+class section_cache;
+
+// how read_file brings the file into memory
+enum class load_mode {
+	map,	// one read-only mapping, sections are views into it
+	copy,	// whole file read into a vector, sections own a copy of their bytes
+	stream	// only the ranges asked for are read, see stream_buffer
+};
+
+
+typedef struct read_options {
+	read_options(load_mode mode=load_mode::map, bool lazy=false) : mode(mode), lazy(lazy) {}
+	load_mode mode;
+	// only the header tables are read at construction, section contents
+	// are fetched on first access and kept for later reads
+	bool lazy;
+	// parsed tables are looked up here before the file is read and stored
+	// after a miss, see elf_cache.hpp
+	std::shared_ptr<metadata_cache> cache;
+	// SHF_COMPRESSED sections are decompressed through this one when set,
+	// see elf_compress.hpp
+	std::shared_ptr<section_cache> sections;
+} read_options;
+
+
+// non-owning view of a byte range, valid while the owning file_buffer lives
+class byte_view {
+
+	public:
+		byte_view() : ptr(nullptr), length(0) {}
+		byte_view(const std::uint8_t* data, std::size_t size) : ptr(data), length(size) {}
+
+		const std::uint8_t* data(void) const { return ptr; }
+		std::size_t size(void) const { return length; }
+		bool empty(void) const { return length == 0; }
+		const std::uint8_t* begin(void) const { return ptr; }
+		const std::uint8_t* end(void) const { return ptr + length; }
+		const std::uint8_t& operator[](std::size_t i) const { return ptr[i]; }
+
+		// empty view if the range isn't fully inside this one
+		byte_view subview(std::uint64_t offset, std::uint64_t size) const {
+			if (offset > length || size > length - offset) return byte_view();
+			return byte_view(ptr + offset, size);
+		}
+		std::vector<std::uint8_t> to_vector(void) const {
+			return std::vector<std::uint8_t>(begin(), end());
+		}
+
+	private:
+		const std::uint8_t* ptr;
+		std::size_t length;
+};
+
+
+// 64 bit hash of bytes, for telling damaged or changed data apart
+std::uint64_t checksum(const std::uint8_t* ptr, std::size_t size);
+
+
+class file_buffer {
+
+	// Factory
+	public:
+		static std::shared_ptr<file_buffer> map_file(const std::string& file);
+		static std::shared_ptr<file_buffer> read_file(const std::string& file);
+		static std::shared_ptr<file_buffer> from_vector(std::vector<std::uint8_t> bytes);
+		static std::shared_ptr<file_buffer> stream_file(const std::string& file);
+		// fd stays owned by the caller and must outlive the buffer
+		static std::shared_ptr<file_buffer> stream_fd(int fd);
+
+		virtual ~file_buffer() = default;
+		// bytes [offset, offset+size), empty view if out of range
+		virtual byte_view read(std::uint64_t offset, std::uint64_t size) const = 0;
+		virtual std::uint64_t size(void) const = 0;
+};
+
+
+class vector_buffer : public file_buffer {
+
+	private:
+		std::vector<std::uint8_t> bytes;
+
+	public:
+		vector_buffer(std::vector<std::uint8_t> bytes) : bytes(std::move(bytes)) {}
+		byte_view read(std::uint64_t offset, std::uint64_t size) const override;
+		std::uint64_t size(void) const override { return bytes.size(); }
+};
+
+
+class mmap_buffer : public file_buffer {
+
+	private:
+		const std::uint8_t* base = nullptr;
+		std::uint64_t length = 0;
+		void map(int fd);
+
+	public:
+		mmap_buffer(const std::string& file);
+		// maps an open descriptor, which stays owned by the caller
+		mmap_buffer(int fd);
+		~mmap_buffer();
+		mmap_buffer(const mmap_buffer&) = delete;
+		mmap_buffer& operator=(const mmap_buffer&) = delete;
+		byte_view read(std::uint64_t offset, std::uint64_t size) const override;
+		std::uint64_t size(void) const override { return length; }
+};
+
+
+// Reads only the byte ranges asked for. Files are read with pread in aligned
+// blocks, so the small reads of a parse (header, program headers, section
+// headers) cost a read each and neighbours share one. Reads spanning blocks
+// get a buffer of their own. Pipes and other inputs that can't seek are read
+// forward, keeping what was read, up to the furthest byte asked for. Nothing
+// is evicted since views handed out stay valid for the buffer's life.
+class stream_buffer : public file_buffer {
+
+	public:
+		static constexpr std::uint64_t block_size = 64 << 10;
+
+		stream_buffer(const std::string& file);
+		stream_buffer(int fd);
+		~stream_buffer();
+		stream_buffer(const stream_buffer&) = delete;
+		stream_buffer& operator=(const stream_buffer&) = delete;
+		byte_view read(std::uint64_t offset, std::uint64_t size) const override;
+		// bytes read so far for inputs that can't seek, until they end
+		std::uint64_t size(void) const override;
+		// bytes fetched from the input, including the unused rest of blocks
+		std::uint64_t bytes_read(void) const;
+
+	private:
+		int fd;
+		bool owned;
+		bool seekable;
+		mutable std::uint64_t length = 0;
+		mutable std::mutex lock;
+		mutable std::unordered_map<std::uint64_t, std::vector<std::uint8_t>> blocks;
+		mutable std::map<std::pair<std::uint64_t, std::uint64_t>, std::vector<std::uint8_t>> spans;
+		mutable std::uint64_t fetched = 0;
+		// inputs that can't seek, blocks read so far and whether the input ended
+		mutable std::uint64_t streamed = 0;
+		mutable bool ended = false;
+
+		void init(void);
+		const std::vector<std::uint8_t>* block(std::uint64_t index) const;
+		std::uint64_t fill(std::uint8_t* dst, std::uint64_t size, std::uint64_t offset) const;
+};
+
+
+// Opens the underlying buffer on the first read, for parsers whose tables came
+// from somewhere else and may never need the file contents
+class deferred_buffer : public file_buffer {
+
+	private:
+		std::function<std::shared_ptr<file_buffer>(void)> open;
+		std::uint64_t length;
+		mutable std::once_flag opened;
+		mutable std::shared_ptr<file_buffer> target;
+
+	public:
+		deferred_buffer(std::function<std::shared_ptr<file_buffer>(void)> open, std::uint64_t size)
+				: open(std::move(open)), length(size) {}
+		// empty view if the buffer can't be opened any more
+		byte_view read(std::uint64_t offset, std::uint64_t size) const override;
+		std::uint64_t size(void) const override { return length; }
+};
+
+
+// [offset, offset+size) of another buffer seen as a file of its own, such as
+// a member of an archive. Reads are views into the parent, which it keeps alive.
+class slice_buffer : public file_buffer {
+
+	private:
+		std::shared_ptr<file_buffer> parent;
+		std::uint64_t start;
+		std::uint64_t length;
+
+	public:
+		slice_buffer(std::shared_ptr<file_buffer> parent, std::uint64_t offset, std::uint64_t size)
+				: parent(std::move(parent)), start(offset), length(size) {}
+		byte_view read(std::uint64_t offset, std::uint64_t size) const override;
+		std::uint64_t size(void) const override { return length; }
+};
+
+
+} // end of namespace elf
+
+#endif
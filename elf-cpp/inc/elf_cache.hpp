@@ -0,0 +1,84 @@
+#ifndef ELF_CACHE_H
+#define ELF_CACHE_H
+
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "elf_parser.hpp"
+
+namespace elf {
+
+// identity of a file on disk, rewriting or touching it gives a new key
+typedef struct file_key {
+	std::uint64_t device = 0;
+	std::uint64_t inode = 0;
+	std::uint64_t size = 0;
+	std::uint64_t mtime = 0;	// nanoseconds
+	bool valid = false;
+	std::string name(void) const;
+} file_key;
+
+
+// Persistent cache of parsed header tables, section index and symbol tables,
+// one file per entry in a directory. Entries of files with a GNU build-id are
+// named after it and linked from each file key, so copies of a binary share
+// one entry. Entries are checksummed and anything that fails validation
+// counts as a miss and is removed. Once the directory grows past maxBytes
+// the least recently used entries are evicted.
+class metadata_cache {
+
+	public:
+		metadata_cache(std::string directory, std::uint64_t maxBytes=256 << 20);
+		metadata_cache(const metadata_cache&) = delete;
+		metadata_cache& operator=(const metadata_cache&) = delete;
+
+		// parser built from the entry of file, null on a miss. A hit costs
+		// the stat of file and one read or mapping of the entry, the file
+		// itself is opened on the first section access. key is filled from the
+		// stat so a miss can be stored without another one.
+		std::unique_ptr<elf_parser> load(const std::string& file, const read_options& options,
+							file_key& key);
+		// best effort, a failure only means the next load misses
+		void store(const file_key& key, elf_parser& parser);
+		void invalidate(const std::string& file);
+		void clear(void);
+
+		const std::string& directory(void) const { return dir; }
+		std::uint64_t hits(void) const { return hitCount; }
+		std::uint64_t misses(void) const { return missCount; }
+
+		// symbol columns of an entry, decoded by the parser on first access,
+		// nothing if they're damaged and have to come from the file
+		template <typename elf_class>
+		static std::optional<symbol_table> decode_symbols(byte_view block,
+									elf_class_parser<elf_class>& parser);
+
+	private:
+		std::string dir;
+		std::uint64_t maxBytes;
+		std::atomic<std::uint64_t> usedBytes {0};
+		std::atomic<std::uint64_t> hitCount {0};
+		std::atomic<std::uint64_t> missCount {0};
+		std::atomic<std::uint64_t> tempCount {0};
+		std::mutex evictLock;
+
+		template <typename elf_class>
+		static std::uint64_t encode(elf_class_parser<elf_class>& parser, std::vector<std::uint8_t>& out);
+		template <typename elf_class>
+		static std::unique_ptr<elf_parser> decode(byte_view payload, std::shared_ptr<file_buffer> entry,
+							std::shared_ptr<file_buffer> file, const read_options& options);
+		bool write_file(const std::string& path, const std::vector<std::uint8_t>& bytes);
+		std::string temp_path(void);
+		void evict(void);
+};
+
+
+} // end of namespace elf
+
+#endif
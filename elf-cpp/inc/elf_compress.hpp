@@ -0,0 +1,83 @@
+#ifndef ELF_COMPRESS_H
+#define ELF_COMPRESS_H
+
+
+#include <cstdint>
+#include <cstddef>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "elf_buffer.hpp"
+
+namespace elf {
+
+constexpr std::uint64_t SHF_COMPRESSED =	0x800;
+constexpr std::uint32_t ELFCOMPRESS_ZLIB =	1;
+constexpr std::uint32_t ELFCOMPRESS_ZSTD =	2;	// only built with ELF_ZSTD defined
+
+typedef std::shared_ptr<const std::vector<std::uint8_t>> section_bytes;
+
+
+// Elf32_Chdr / Elf64_Chdr at the start of an SHF_COMPRESSED section
+typedef struct compression_header {
+	std::uint32_t type = 0;
+	std::uint64_t size = 0;		// bytes once decompressed
+	std::uint64_t addralign = 0;
+	std::size_t payload = 0;	// offset of the compressed stream
+} compression_header;
+
+// false if the section is too short to hold a header
+bool read_compression_header(byte_view section, bool is64, bool bigEndian, compression_header& header);
+
+// Contents of an SHF_COMPRESSED section, decompressed straight into a buffer
+// allocated once from ch_size. zstd payloads made of several frames have
+// their frames decoded in parallel, a zlib stream can only be inflated from
+// its start. Null for unknown formats and streams that don't decompress to
+// exactly ch_size bytes.
+section_bytes decompress_section(byte_view section, bool is64, bool bigEndian, unsigned threads=0);
+
+
+// Decompressed sections shared between parsers, least recently used first
+// out once the held bytes pass maxBytes. Entries are keyed by a checksum of
+// the compressed bytes, so reopening a file, or another copy of it, finds
+// the sections decompressed before. Parsers keep their own reference to what
+// they were handed, evicting only drops the cache's one.
+class section_cache {
+
+	public:
+		section_cache(std::size_t maxBytes=256 << 20) : maxBytes(maxBytes) {}
+		section_cache(const section_cache&) = delete;
+		section_cache& operator=(const section_cache&) = delete;
+
+		// decompressed contents of section, through the cache
+		section_bytes decompress(byte_view section, bool is64, bool bigEndian);
+		void clear(void);
+
+		std::size_t size(void) const;		// bytes held
+		std::size_t capacity(void) const { return maxBytes; }
+		std::uint64_t hits(void) const;
+		std::uint64_t misses(void) const;
+
+	private:
+		typedef struct entry_t {
+			std::uint64_t key;
+			std::size_t compressedSize;
+			section_bytes bytes;
+		} entry_t;
+
+		std::size_t maxBytes;
+		std::size_t usedBytes = 0;
+		std::uint64_t hitCount = 0;
+		std::uint64_t missCount = 0;
+		mutable std::mutex lock;
+		std::list<entry_t> order;	// most recently used first
+		std::unordered_map<std::uint64_t, std::list<entry_t>::iterator> entries;
+};
+
+
+} // end of namespace elf
+
+#endif
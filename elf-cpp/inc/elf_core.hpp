@@ -0,0 +1,130 @@
+#ifndef ELF_CORE_H
+#define ELF_CORE_H
+
+
+#include <cstdint>
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "elf_notes.hpp"
+
+namespace elf {
+
+constexpr std::uint16_t ET_CORE =		4;
+
+// notes of owner "CORE"
+constexpr std::uint32_t NT_PRSTATUS =		1;
+constexpr std::uint32_t NT_PRFPREG =		2;
+constexpr std::uint32_t NT_PRPSINFO =		3;
+constexpr std::uint32_t NT_AUXV =		6;
+constexpr std::uint32_t NT_SIGINFO =		0x53494749;
+constexpr std::uint32_t NT_FILE =		0x46494c45;
+
+
+// one NT_PRSTATUS, the first is the thread that got the signal
+typedef struct core_thread {
+	std::uint32_t pid = 0;
+	std::uint32_t ppid = 0;
+	std::uint32_t pgrp = 0;
+	std::uint32_t sid = 0;
+	std::uint16_t signal = 0;		// pr_cursig
+	std::vector<std::uint64_t> registers;	// pr_reg words, in the machine's elf_gregset_t order
+	// taken from registers on x86-64, i386, AArch64, ARM and RISC-V, 0 elsewhere
+	std::uint64_t pc = 0;
+	std::uint64_t sp = 0;
+	std::uint64_t fp = 0;
+} core_thread;
+
+// NT_PRPSINFO
+typedef struct core_process {
+	bool present = false;
+	char state = 0;			// pr_sname, 'R', 'S', 'D', 'T', 'Z'
+	std::uint32_t uid = 0;
+	std::uint32_t gid = 0;
+	std::uint32_t pid = 0;
+	std::uint32_t ppid = 0;
+	std::uint32_t pgrp = 0;
+	std::uint32_t sid = 0;
+	std::string name;		// pr_fname, at most 16 characters
+	std::string args;		// pr_psargs, the command line cut at 80
+} core_process;
+
+// one entry of NT_FILE, a file mapped at [start, end) from offset
+typedef struct core_mapping {
+	std::uint64_t start;
+	std::uint64_t end;
+	std::uint64_t offset;
+	std::string path;
+} core_mapping;
+
+// PT_LOAD of a core, bytes past filesz weren't dumped
+typedef load_segment core_segment;
+
+
+// An ET_CORE file: its notes decoded into threads, process, auxiliary
+// vector and mapped files, and its PT_LOAD segments sorted by address so
+// memory of the crashed process is found with a binary search. Memory is
+// served as views into the mapped core, opening a dump of tens of GB reads
+// the headers and notes only and touches the pages asked for later.
+class core_file {
+
+	// Factory
+	public:
+		// null with error filled on failure, bad_header for ELF files that
+		// aren't ET_CORE
+		static std::unique_ptr<core_file> open(const std::string& file, parse_error& error);
+		static std::unique_ptr<core_file> open(std::shared_ptr<file_buffer> buffer, parse_error& error);
+
+		bool is64(void) const { return wide; }
+		bool big_endian(void) const { return bigEndian; }
+		std::uint16_t machine(void) const { return eMachine; }
+
+		const std::vector<core_thread>& threads(void) const { return threadList; }
+		const core_process& process(void) const { return processInfo; }
+		// NT_AUXV pairs up to AT_NULL
+		const std::vector<std::pair<std::uint64_t, std::uint64_t>>& auxv(void) const { return auxvList; }
+		std::uint64_t auxv_value(std::uint64_t type, std::uint64_t fallback=0) const;
+		const std::vector<core_mapping>& mappings(void) const { return mappingList; }
+		// every note in file order, the ones above included
+		const std::vector<elf_note>& notes(void) const { return noteList; }
+
+		// PT_LOAD sorted by vaddr
+		const std::vector<core_segment>& segments(void) const { return memory.segments(); }
+		const segment_index& memory_index(void) const { return memory; }
+		// segment whose memory holds vaddr, null if none
+		const core_segment* find_segment(std::uint64_t vaddr) const { return memory.find(vaddr); }
+		// [vaddr, vaddr+size) as a view into the core, empty unless it lies in
+		// the dumped bytes of one segment. Valid while the core_file lives.
+		byte_view read_memory(std::uint64_t vaddr, std::uint64_t size) const;
+		// same across neighbouring segments into dst, stops at the first
+		// byte that wasn't dumped, returns the bytes copied
+		std::uint64_t copy_memory(std::uint64_t vaddr, void* dst, std::uint64_t size) const;
+		// word of the core's class and byte order at vaddr, false if not dumped
+		bool read_pointer(std::uint64_t vaddr, std::uint64_t& value) const;
+
+	private:
+		std::shared_ptr<file_buffer> buffer;
+		bool wide = false;
+		bool bigEndian = false;
+		std::uint16_t eMachine = 0;
+		std::vector<core_thread> threadList;
+		core_process processInfo;
+		std::vector<std::pair<std::uint64_t, std::uint64_t>> auxvList;
+		std::vector<core_mapping> mappingList;
+		std::vector<elf_note> noteList;
+		segment_index memory;
+
+		core_file(std::shared_ptr<file_buffer> buffer) : buffer(std::move(buffer)) {}
+		template <typename elf_class, bool swap>
+		void parse(void);
+		template <typename elf_class, bool swap>
+		void decode_core_notes(void);
+};
+
+
+} // end of namespace elf
+
+#endif
@@ -0,0 +1,154 @@
+#ifndef ELF_DIFF_H
+#define ELF_DIFF_H
+
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "elf_parser.hpp"
+
+namespace elf {
+
+// how a section differs from the one it was matched with, or-ed together
+enum section_change : unsigned {
+	section_added =		1,
+	section_removed =	2,
+	section_moved =		4,	// sh_offset
+	section_resized =	8,	// sh_size
+	section_content =	16,	// file bytes
+	section_header =	32	// type, flags, address, link, info or index
+};
+
+// one section of a parsed file, hash is the fingerprint of its file bytes
+typedef struct section_state {
+	std::string name;
+	std::uint32_t type;
+	std::uint64_t flags;
+	std::uint64_t addr;
+	std::uint64_t offset;
+	std::uint64_t size;
+	std::uint32_t link;
+	std::uint32_t info;
+	std::uint64_t hash;	// 0 for SHT_NOBITS
+} section_state;
+
+typedef struct section_diff {
+	std::string name;
+	std::uint32_t type;
+	unsigned changes;		// section_change flags
+	std::size_t oldIndex;		// npos for added sections
+	std::size_t newIndex;		// npos for removed sections
+	// [offset, size) of the bytes that differ, see diff_options::ranges
+	std::vector<std::pair<std::uint64_t, std::uint64_t>> ranges;
+	static constexpr std::size_t npos = ~std::size_t(0);
+} section_diff;
+
+
+// 64 bit hash of bytes for telling contents apart, not for security. Eight
+// lanes of multiply-accumulate over 64 byte stripes, with AVX2 or NEON where
+// the CPU has it. Every path gives the same value on every host.
+std::uint64_t fingerprint(const std::uint8_t* ptr, std::size_t size);
+
+// Fingerprint of section contents. Up to fingerprint_chunk bytes it is
+// fingerprint, longer contents fold the fingerprints of their chunks so a
+// single large section is spread over threads too.
+constexpr std::size_t fingerprint_chunk = 1 << 20;
+std::uint64_t section_fingerprint(byte_view bytes);
+
+// section_fingerprint of each view on up to threads threads, 0 for every
+// hardware thread
+std::vector<std::uint64_t> fingerprint_views(const std::vector<byte_view>& views, unsigned threads=0);
+
+// Headers and file byte fingerprints of the sections of parser, hashed in
+// parallel. hashed, if given, gets the bytes read added.
+std::vector<section_state> fingerprint_sections(elf_parser& parser, unsigned threads=0,
+							std::uint64_t* hashed=nullptr);
+
+// Matches the sections of after with those of before by name, type and how
+// many came before with both. Returns the changed ones in after's order and
+// the removed ones last. unchanged[i], if given, is set where section i of
+// after has the same header and contents as its match, wherever it sits.
+std::vector<section_diff> diff_sections(const std::vector<section_state>& before,
+					const std::vector<section_state>& after,
+					std::vector<bool>* unchanged=nullptr);
+
+
+typedef struct field_diff {
+	const char* field;
+	std::uint64_t before;
+	std::uint64_t after;
+} field_diff;
+
+// program headers are matched by type and how many came before with it
+typedef struct segment_diff {
+	std::uint32_t type;
+	std::size_t oldIndex;		// npos for added segments
+	std::size_t newIndex;		// npos for removed segments
+	std::vector<field_diff> fields;	// empty for added and removed segments
+	static constexpr std::size_t npos = ~std::size_t(0);
+} segment_diff;
+
+enum symbol_change : unsigned {
+	symbol_added =		1,
+	symbol_removed =	2,
+	symbol_value =		4,
+	symbol_size =		8,
+	symbol_kind =		16,	// type, binding or visibility
+	symbol_section =	32	// defined in a section of another name, or undefined
+};
+
+// symbols are matched by name and how many came before with it
+typedef struct symbol_diff {
+	std::string name;
+	bool dynamic;			// .dynsym rather than .symtab
+	unsigned changes;		// symbol_change flags
+	std::uint64_t oldValue = 0;
+	std::uint64_t newValue = 0;
+	std::uint64_t oldSize = 0;
+	std::uint64_t newSize = 0;
+} symbol_diff;
+
+typedef struct diff_options {
+	unsigned threads = 0;		// 0 uses every hardware thread
+	bool symbols = true;		// compare .symtab and .dynsym
+	// fill section_diff::ranges for sections whose contents differ, at most
+	// max_ranges each, the last one reaching to the end of the longer one
+	bool ranges = false;
+	std::size_t max_ranges = 64;
+	// compare sections with equal fingerprints byte by byte as well
+	bool verify = false;
+} diff_options;
+
+typedef struct binary_diff {
+	std::vector<field_diff> header;
+	std::vector<segment_diff> segments;
+	std::vector<section_diff> sections;
+	std::vector<symbol_diff> symbols;
+	std::size_t unchanged = 0;		// sections found identical
+	std::size_t skippedTables = 0;		// symbol tables not decoded as their sections are identical
+	std::uint64_t hashed = 0;		// bytes fingerprinted, both files
+	std::uint64_t compared = 0;		// bytes compared byte by byte
+	bool identical(void) const {
+		return header.empty() && segments.empty() && sections.empty() && symbols.empty();
+	}
+} binary_diff;
+
+
+// Structured differences between two parsed files: the file header fields,
+// the program headers, the sections and the symbols. Sections whose
+// fingerprints and headers agree count as identical without being
+// compared, and symbol tables whose sections are identical aren't decoded.
+binary_diff diff_elf(elf_parser& before, elf_parser& after, diff_options options=diff_options());
+
+// diff_elf of two files, mapped and parsed lazily. false with error filled
+// if either can't be parsed.
+bool diff_files(const std::string& before, const std::string& after, binary_diff& diff,
+		parse_error& error, diff_options options=diff_options());
+
+
+} // end of namespace elf
+
+#endif
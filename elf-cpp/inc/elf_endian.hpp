@@ -0,0 +1,53 @@
+#ifndef ELF_ENDIAN_H
+#define ELF_ENDIAN_H
+
+
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+
+namespace elf {
+
+constexpr bool host_big_endian = __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__;
+
+template <int size> struct uint_of_size;
+template <> struct uint_of_size<1> { typedef std::uint8_t type; };
+template <> struct uint_of_size<2> { typedef std::uint16_t type; };
+template <> struct uint_of_size<4> { typedef std::uint32_t type; };
+template <> struct uint_of_size<8> { typedef std::uint64_t type; };
+
+inline std::uint8_t byte_swap(std::uint8_t value) { return value; }
+inline std::uint16_t byte_swap(std::uint16_t value) { return __builtin_bswap16(value); }
+inline std::uint32_t byte_swap(std::uint32_t value) { return __builtin_bswap32(value); }
+inline std::uint64_t byte_swap(std::uint64_t value) { return __builtin_bswap64(value); }
+
+
+// Fixed width field load, swap is true when the file endianness differs
+// from the host so the choice is made once per table rather than per byte
+template <int size, bool swap>
+inline typename uint_of_size<size>::type load(const std::uint8_t* ptr) {
+
+	typename uint_of_size<size>::type value;
+	std::memcpy(&value, ptr, size);
+	return swap ? byte_swap(value) : value;
+}
+
+template <int size, bool swap>
+inline void store(std::uint8_t* ptr, std::uint64_t value) {
+
+	typename uint_of_size<size>::type field = value;
+	if (swap) field = byte_swap(field);
+	std::memcpy(ptr, &field, size);
+}
+
+
+// Byte swap a table of fixed layout entries from src into dst. layout holds
+// the width of each field of one entry, fields must be naturally aligned so
+// none crosses a 16 byte boundary. Uses byte shuffles where available.
+void swap_table(const std::uint8_t* src, std::uint8_t* dst, std::size_t size,
+		const std::uint8_t* layout, std::size_t fields);
+
+
+} // end of namespace elf
+
+#endif
@@ -0,0 +1,87 @@
+#ifndef ELF_LINES_H
+#define ELF_LINES_H
+
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "elf_buffer.hpp"
+
+namespace elf {
+
+typedef struct line_options {
+	unsigned threads = 0;		// units decoded in parallel, 0 uses every hardware thread
+} line_options;
+
+
+// Address to source position index over the .debug_line programs of a
+// linked binary, DWARF 2 to 5. Each unit's program is run once, units are
+// decoded in parallel and the rows of all sequences are merged into one
+// table sorted by address. Rows that can never be returned by a lookup are
+// dropped (all but the last row at an address, and rows repeating the
+// position of the row before them), gaps between sequences are kept as end
+// rows. Addresses are kept as 32 bit offsets from the start of blocks of up
+// to 64 rows, a lookup searches the small array of block starts and then
+// one block. File names are stored once for the whole table.
+class line_table {
+
+	public:
+		static constexpr std::uint32_t npos = 0xFFFFFFFF;
+
+		line_table() = default;
+		// lineStr and str back DW_FORM_line_strp and DW_FORM_strp names in
+		// DWARF 5 headers, units with a bad header are skipped
+		line_table(byte_view debugLine, byte_view debugLineStr, byte_view debugStr,
+				bool bigEndian, line_options options=line_options());
+
+		// row of the position of address, npos if no sequence covers it
+		std::uint32_t lookup(std::uint64_t address) const;
+		// same for many addresses, merged against the table when there are
+		// enough of them, results are in input order
+		void lookup(const std::uint64_t* addresses, std::size_t count, std::uint32_t* rows) const;
+		std::vector<std::uint32_t> lookup(const std::vector<std::uint64_t>& addresses) const;
+
+		std::size_t size(void) const { return rowDelta.size(); }
+		bool empty(void) const { return rowDelta.empty(); }
+		std::uint64_t address(std::uint32_t row) const;
+		const std::string& file(std::uint32_t row) const { return files[rowFile[row]]; }
+		std::uint32_t line(std::uint32_t row) const { return rowLine[row]; }
+		std::uint32_t column(std::uint32_t row) const { return rowColumn[row]; }
+
+		std::size_t units(void) const { return unitCount; }
+		std::size_t file_count(void) const { return files.size(); }
+		// bytes held by the index, rows and file names
+		std::size_t memory_usage(void) const;
+
+	private:
+		typedef struct unit_t {
+			std::size_t offset;
+			std::size_t size;	// including the length field
+		} unit_t;
+		struct unit_rows;
+
+		static constexpr std::size_t block_rows = 64;
+
+		// a block also ends early when an offset wouldn't fit
+		std::vector<std::uint64_t> blockStart;
+		std::vector<std::uint32_t> blockFirst;	// first row, one more entry for the end
+		std::vector<std::uint32_t> rowDelta;	// address - its block start
+		std::vector<std::uint32_t> rowFile;	// npos for the end of a sequence
+		std::vector<std::uint32_t> rowLine;
+		std::vector<std::uint16_t> rowColumn;	// saturates at 0xFFFF
+		std::vector<std::string> files;
+		std::size_t unitCount = 0;
+
+		template <bool swap>
+		static void decode_unit(byte_view unit, byte_view lineStr, byte_view str, unit_rows& out);
+		void merge(std::vector<unit_rows>& decoded);
+		void push_row(std::uint64_t address, std::uint32_t file, std::uint32_t line, std::uint16_t column);
+};
+
+
+} // end of namespace elf
+
+#endif
@@ -0,0 +1,61 @@
+#ifndef ELF_NOTES_H
+#define ELF_NOTES_H
+
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "elf_parser.hpp"
+
+namespace elf {
+
+constexpr std::uint32_t NT_GNU_ABI_TAG =		1;
+constexpr std::uint32_t NT_GNU_BUILD_ID =		3;
+constexpr std::uint32_t NT_GNU_PROPERTY_TYPE_0 =	5;
+
+
+typedef struct elf_note {
+	std::string name;		// owner, "GNU" for the notes below
+	std::uint32_t type = 0;
+	std::vector<std::uint8_t> desc;
+} elf_note;
+
+typedef struct abi_tag {
+	bool present = false;
+	std::uint32_t os = 0;		// 0 Linux, 1 GNU, 2 Solaris, 3 FreeBSD
+	std::uint32_t major = 0;	// earliest kernel the file runs on
+	std::uint32_t minor = 0;
+	std::uint32_t patch = 0;
+} abi_tag;
+
+typedef struct gnu_property {
+	std::uint32_t type = 0;		// GNU_PROPERTY_*, e.g. 0xc0000002 x86 features
+	std::vector<std::uint8_t> data;
+} gnu_property;
+
+typedef struct note_info {
+	std::vector<elf_note> notes;		// every note in file order
+	std::string build_id;			// NT_GNU_BUILD_ID in hex, empty if none
+	abi_tag abi;				// NT_GNU_ABI_TAG
+	std::vector<gnu_property> properties;	// entries of NT_GNU_PROPERTY_TYPE_0
+	unsigned reads = 0;			// reads the file took
+} note_info;
+
+
+// Adds the notes of one PT_NOTE segment or SHT_NOTE section to info, align
+// is the segment's or section's alignment (notes are padded to 4 or 8)
+void decode_notes(byte_view notes, bool is64, bool bigEndian, std::uint64_t align, note_info& info);
+
+// Notes of file without parsing or mapping the rest of it. The first page
+// is read once, the program headers come from it and so do the PT_NOTE
+// segments of most linked files. Anything outside costs one more read. Files
+// without PT_NOTE (relocatable objects) fall back to their SHT_NOTE sections.
+// false with error filled when the file isn't a readable ELF file.
+bool read_notes(const std::string& file, note_info& info, parse_error& error);
+
+
+} // end of namespace elf
+
+#endif
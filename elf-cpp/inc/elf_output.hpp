@@ -0,0 +1,98 @@
+#ifndef ELF_OUTPUT_H
+#define ELF_OUTPUT_H
+
+
+#include <cstdint>
+#include <cstddef>
+#include <ostream>
+#include <string>
+#include <string_view>
+
+namespace elf {
+
+enum class output_format {
+	text,	// the print_* layout
+	json,	// one object per file
+	ndjson	// one object per header, section, segment and symbol, each on its own line
+};
+
+// what elf_parser::write emits, or-ed together
+enum output_part : unsigned {
+	output_header =		1,
+	output_sections =	2,
+	output_segments =	4,
+	output_symbols =	8,
+	output_all =		15
+};
+
+
+// where an output_buffer's chunks go
+class output_sink {
+
+	public:
+		virtual ~output_sink() = default;
+		virtual void write(const char* data, std::size_t size) = 0;
+};
+
+// write(2) to a descriptor the caller keeps open, short writes are retried
+class fd_sink : public output_sink {
+
+	public:
+		fd_sink(int fd) : fd(fd) {}
+		void write(const char* data, std::size_t size) override;
+
+	private:
+		int fd;
+};
+
+class stream_sink : public output_sink {
+
+	public:
+		stream_sink(std::ostream& stream) : stream(stream) {}
+		void write(const char* data, std::size_t size) override { stream.write(data, size); }
+
+	private:
+		std::ostream& stream;
+};
+
+
+// Formats into one reusable buffer and hands it to the sink in chunks once
+// it holds chunkSize bytes, and on flush and destruction. Numbers are
+// formatted with std::to_chars, nothing allocates once the buffer reached
+// its size. Keep one for a whole batch of files.
+class output_buffer {
+
+	public:
+		output_buffer(output_sink& sink, std::size_t chunkSize=1 << 16);
+		~output_buffer() { flush(); }
+		output_buffer(const output_buffer&) = delete;
+		output_buffer& operator=(const output_buffer&) = delete;
+
+		output_buffer& put(std::string_view text);
+		output_buffer& put(char c);
+		// text padded with spaces to width, after it if left
+		output_buffer& pad(std::string_view text, std::size_t width, bool left=true);
+		// right aligned in width
+		output_buffer& dec(std::uint64_t value, std::size_t width=0, char fill=' ');
+		output_buffer& hex(std::uint64_t value, std::size_t width=0, char fill='0');
+		// quoted JSON string
+		output_buffer& json(std::string_view text);
+		void flush(void);
+
+		std::size_t size(void) const { return used; }
+
+	private:
+		output_sink& sink;
+		std::string bytes;
+		std::size_t used = 0;
+		std::size_t chunkSize;
+
+		char* reserve(std::size_t size);
+		void commit(std::size_t size) { used += size; if (used >= chunkSize) flush(); }
+		output_buffer& number(const char* digits, std::size_t count, std::size_t width, char fill);
+};
+
+
+} // end of namespace elf
+
+#endif
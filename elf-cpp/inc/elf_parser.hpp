@@ -11,7 +11,20 @@
 #include <iostream>
 #include <algorithm>
 #include <map>
+#include <unordered_map>
+#include <string_view>
 #include <cmath>
+#include <memory>
+#include <optional>
+
+#include "elf_buffer.hpp"
+#include "elf_endian.hpp"
+#include "elf_symbols.hpp"
+#include "elf_relocs.hpp"
+#include "elf_lines.hpp"
+#include "elf_compress.hpp"
+#include "elf_segments.hpp"
+#include "elf_output.hpp"
 
 namespace elf {
 
@@ -138,6 +151,38 @@ constexpr int sh_addralign_64_size =	8;
 constexpr int sh_entsize_32_size =	4;
 constexpr int sh_entsize_64_size =	8;
 
+// Symbol Table
+constexpr int st_name_offset =		0x00;
+constexpr int st_value_32_offset =	0x04;
+constexpr int st_value_64_offset =	0x08;
+constexpr int st_size_32_offset =	0x08;
+constexpr int st_size_64_offset =	0x10;
+constexpr int st_info_32_offset =	0x0C;
+constexpr int st_info_64_offset =	0x04;
+constexpr int st_other_32_offset =	0x0D;
+constexpr int st_other_64_offset =	0x05;
+constexpr int st_shndx_32_offset =	0x0E;
+constexpr int st_shndx_64_offset =	0x06;
+
+constexpr int st_name_size =		4;
+constexpr int st_value_32_size =	4;
+constexpr int st_value_64_size =	8;
+constexpr int st_size_32_size =		4;
+constexpr int st_size_64_size =		8;
+constexpr int st_info_size =		1;
+constexpr int st_other_size =		1;
+constexpr int st_shndx_size =		2;
+
+// Relocation Entries
+constexpr int r_offset_offset =		0x00;
+constexpr int r_info_32_offset =	0x04;
+constexpr int r_info_64_offset =	0x08;
+constexpr int r_addend_32_offset =	0x08;
+constexpr int r_addend_64_offset =	0x10;
+
+constexpr int r_addr_32_size =		4;	// r_offset, r_info and r_addend
+constexpr int r_addr_64_size =		8;
+
 typedef std::uint32_t Elf32_Addr;
 typedef std::uint16_t Elf32_Half;
 typedef std::uint32_t Elf32_Off;
@@ -249,46 +294,253 @@ typedef struct sectionHeader64_t {
 
 typedef struct section32_t : sectionHeader32_t {
 	std::string name;
-	std::vector<std::uint8_t> bytes;
+	byte_view data;				// view into the parser's file_buffer
+	std::vector<std::uint8_t> bytes;	// owning copy, load_mode::copy only
+	section_bytes inflated;			// SHF_COMPRESSED contents, data views these
+	bool loaded = false;			// data/bytes filled, see read_options::lazy
 } section32_t;
 
 typedef struct section64_t : sectionHeader64_t {
 	std::string name;
+	byte_view data;
 	std::vector<std::uint8_t> bytes;
+	section_bytes inflated;
+	bool loaded = false;
 } section64_t;
 
 
-bool compare_section_32(const section32_t& a, const section32_t& b);
-bool compare_segments_32(const segment32_t& a, const segment32_t& b);
+// Per-class field layout, selects the struct types and the _32/_64 offsets
+typedef struct elf32_traits {
+	typedef elf32Header_t header_t;
+	typedef segment32_t segment_t;
+	typedef section32_t section_t;
+	typedef Elf32_Addr addr_t;
+	static constexpr std::uint8_t elf_class =	1;
+	static constexpr const char* name =		"ELF32";
+	static constexpr int addr_width =		8;	// hex digits when printing
+
+	static constexpr int e_entry_size =		e_entry_32_size;
+	static constexpr int e_phoff_offset =		e_phoff_32_offset;
+	static constexpr int e_phoff_size =		e_phoff_32_size;
+	static constexpr int e_shoff_offset =		e_shoff_32_offset;
+	static constexpr int e_shoff_size =		e_shoff_32_size;
+	static constexpr int e_flags_offset =		e_flags_32_offset;
+	static constexpr int e_ehsize_offset =		e_ehsize_32_offset;
+	static constexpr int e_phentsize_offset =	e_phentsize_32_offset;
+	static constexpr int e_phnum_offset =		e_phnum_32_offset;
+	static constexpr int e_shentsize_offset =	e_shentsize_32_offset;
+	static constexpr int e_shnum_offset =		e_shnum_32_offset;
+	static constexpr int e_shstrndx_offset =	e_shstrndx_32_offset;
+
+	static constexpr int p_flags_offset =		p_flags_32_offset;
+	static constexpr int p_offset_offset =		p_offset_32_offset;
+	static constexpr int p_offset_size =		p_offset_32_size;
+	static constexpr int p_vaddr_offset =		p_vaddr_32_offset;
+	static constexpr int p_vaddr_size =		p_vaddr_32_size;
+	static constexpr int p_paddr_offset =		p_paddr_32_offset;
+	static constexpr int p_paddr_size =		p_paddr_32_size;
+	static constexpr int p_filesz_offset =		p_filesz_32_offset;
+	static constexpr int p_filesz_size =		p_filesz_32_size;
+	static constexpr int p_memsz_offset =		p_memsz_32_offset;
+	static constexpr int p_memsz_size =		p_memsz_32_size;
+	static constexpr int p_align_offset =		p_align_32_offset;
+	static constexpr int p_align_size =		p_align_32_size;
+
+	static constexpr int sh_flags_size =		sh_flags_32_size;
+	static constexpr int sh_addr_offset =		sh_addr_32_offset;
+	static constexpr int sh_addr_size =		sh_addr_32_size;
+	static constexpr int sh_offset_offset =		sh_offset_32_offset;
+	static constexpr int sh_offset_size =		sh_offset_32_size;
+	static constexpr int sh_size_offset =		sh_size_32_offset;
+	static constexpr int sh_size_size =		sh_size_32_size;
+	static constexpr int sh_link_offset =		sh_link_32_offset;
+	static constexpr int sh_info_offset =		sh_info_32_offset;
+	static constexpr int sh_addralign_offset =	sh_addralign_32_offset;
+	static constexpr int sh_addralign_size =	sh_addralign_32_size;
+	static constexpr int sh_entsize_offset =	sh_entsize_32_offset;
+	static constexpr int sh_entsize_size =		sh_entsize_32_size;
+
+	// entry sizes and field widths for bulk swapping whole tables
+	static constexpr int phdr_size =		0x20;
+	static constexpr int shdr_size =		0x28;
+	static constexpr std::uint8_t ph_layout[] =	{4, 4, 4, 4, 4, 4, 4, 4};
+	static constexpr std::uint8_t sh_layout[] =	{4, 4, 4, 4, 4, 4, 4, 4, 4, 4};
+
+	static constexpr int st_value_offset =		st_value_32_offset;
+	static constexpr int st_value_size =		st_value_32_size;
+	static constexpr int st_size_offset =		st_size_32_offset;
+	static constexpr int st_size_size =		st_size_32_size;
+	static constexpr int st_info_offset =		st_info_32_offset;
+	static constexpr int st_other_offset =		st_other_32_offset;
+	static constexpr int st_shndx_offset =		st_shndx_32_offset;
+	static constexpr int sym_size =			0x10;
+	static constexpr std::uint8_t sym_layout[] =	{4, 4, 4, 1, 1, 2};
+
+	static constexpr int r_info_offset =		r_info_32_offset;
+	static constexpr int r_addend_offset =		r_addend_32_offset;
+	static constexpr int r_addr_size =		r_addr_32_size;
+	static constexpr int r_sym_shift =		8;	// ELF32_R_SYM
+	static constexpr std::uint64_t r_type_mask =	0xFF;
+	static constexpr int rel_size =			0x08;
+	static constexpr int rela_size =		0x0C;
+} elf32_traits;
+
+typedef struct elf64_traits {
+	typedef elf64Header_t header_t;
+	typedef segment64_t segment_t;
+	typedef section64_t section_t;
+	typedef Elf64_Addr addr_t;
+	static constexpr std::uint8_t elf_class =	2;
+	static constexpr const char* name =		"ELF64";
+	static constexpr int addr_width =		16;
+
+	static constexpr int e_entry_size =		e_entry_64_size;
+	static constexpr int e_phoff_offset =		e_phoff_64_offset;
+	static constexpr int e_phoff_size =		e_phoff_64_size;
+	static constexpr int e_shoff_offset =		e_shoff_64_offset;
+	static constexpr int e_shoff_size =		e_shoff_64_size;
+	static constexpr int e_flags_offset =		e_flags_64_offset;
+	static constexpr int e_ehsize_offset =		e_ehsize_64_offset;
+	static constexpr int e_phentsize_offset =	e_phentsize_64_offset;
+	static constexpr int e_phnum_offset =		e_phnum_64_offset;
+	static constexpr int e_shentsize_offset =	e_shentsize_64_offset;
+	static constexpr int e_shnum_offset =		e_shnum_64_offset;
+	static constexpr int e_shstrndx_offset =	e_shstrndx_64_offset;
+
+	static constexpr int p_flags_offset =		p_flags_64_offset;
+	static constexpr int p_offset_offset =		p_offset_64_offset;
+	static constexpr int p_offset_size =		p_offset_64_size;
+	static constexpr int p_vaddr_offset =		p_vaddr_64_offset;
+	static constexpr int p_vaddr_size =		p_vaddr_64_size;
+	static constexpr int p_paddr_offset =		p_paddr_64_offset;
+	static constexpr int p_paddr_size =		p_paddr_64_size;
+	static constexpr int p_filesz_offset =		p_filesz_64_offset;
+	static constexpr int p_filesz_size =		p_filesz_64_size;
+	static constexpr int p_memsz_offset =		p_memsz_64_offset;
+	static constexpr int p_memsz_size =		p_memsz_64_size;
+	static constexpr int p_align_offset =		p_align_64_offset;
+	static constexpr int p_align_size =		p_align_64_size;
+
+	static constexpr int sh_flags_size =		sh_flags_64_size;
+	static constexpr int sh_addr_offset =		sh_addr_64_offset;
+	static constexpr int sh_addr_size =		sh_addr_64_size;
+	static constexpr int sh_offset_offset =		sh_offset_64_offset;
+	static constexpr int sh_offset_size =		sh_offset_64_size;
+	static constexpr int sh_size_offset =		sh_size_64_offset;
+	static constexpr int sh_size_size =		sh_size_64_size;
+	static constexpr int sh_link_offset =		sh_link_64_offset;
+	static constexpr int sh_info_offset =		sh_info_64_offset;
+	static constexpr int sh_addralign_offset =	sh_addralign_64_offset;
+	static constexpr int sh_addralign_size =	sh_addralign_64_size;
+	static constexpr int sh_entsize_offset =	sh_entsize_64_offset;
+	static constexpr int sh_entsize_size =		sh_entsize_64_size;
+
+	static constexpr int phdr_size =		0x38;
+	static constexpr int shdr_size =		0x40;
+	static constexpr std::uint8_t ph_layout[] =	{4, 4, 8, 8, 8, 8, 8, 8};
+	static constexpr std::uint8_t sh_layout[] =	{4, 4, 8, 8, 8, 8, 4, 4, 8, 8};
+
+	static constexpr int st_value_offset =		st_value_64_offset;
+	static constexpr int st_value_size =		st_value_64_size;
+	static constexpr int st_size_offset =		st_size_64_offset;
+	static constexpr int st_size_size =		st_size_64_size;
+	static constexpr int st_info_offset =		st_info_64_offset;
+	static constexpr int st_other_offset =		st_other_64_offset;
+	static constexpr int st_shndx_offset =		st_shndx_64_offset;
+	static constexpr int sym_size =			0x18;
+	static constexpr std::uint8_t sym_layout[] =	{4, 1, 1, 2, 8, 8};
+
+	static constexpr int r_info_offset =		r_info_64_offset;
+	static constexpr int r_addend_offset =		r_addend_64_offset;
+	static constexpr int r_addr_size =		r_addr_64_size;
+	static constexpr int r_sym_shift =		32;
+	static constexpr std::uint64_t r_type_mask =	0xFFFFFFFF;
+	static constexpr int rel_size =			0x10;
+	static constexpr int rela_size =		0x18;
+} elf64_traits;
+
+
+template <typename section_t>
+bool compare_sections(const section_t& a, const section_t& b);
+
+
+// Why a file couldn't be parsed, the values match the codes thrown internally
+enum class parse_errc {
+	none = -1,
+	file_not_found = 0,
+	bad_magic = 1,
+	bad_header = 2,
+	out_of_bounds = 3,	// a table or section lies outside of the file
+	io_error = 4,		// the file exists but couldn't be opened, mapped or read
+	bad_edit = 5		// an elf_edit that can't be applied, see write_elf
+};
+
+typedef struct parse_error {
+	parse_errc code = parse_errc::none;
+	std::string message;
+	explicit operator bool(void) const { return code != parse_errc::none; }
+} parse_error;
+
+std::string parse_error_message(parse_errc code);
 
 
 class elf_parser {
 
 	// Factory
 	public:
-		static elf_parser* read_file(std::string file);
+		static elf_parser* read_file(std::string file, read_options options=read_options());
+		// same without console output, null with error filled on failure
+		static std::unique_ptr<elf_parser> open(const std::string& file, parse_error& error,
+								read_options options=read_options());
+		// parses a buffer already open, such as an archive member,
+		// options.cache is left out as there is no file to key it by
+		static std::unique_ptr<elf_parser> open(std::shared_ptr<file_buffer> buffer, parse_error& error,
+								read_options options=read_options());
+		virtual ~elf_parser() = default;
 		virtual std::vector<std::uint8_t> read_section(std::string name) = 0;
+		virtual byte_view section_view(std::string name) = 0;
 		virtual void print_elf_header(void) = 0;
 		virtual void print_sections(void) = 0;
 		virtual void print_segments(void) = 0;
 		virtual void print_symbol_table(void) = 0;
+		// the tables above into out, as text in the print_* layout or as
+		// JSON records carrying file
+		virtual void write(output_buffer& out, output_format format, unsigned parts=output_all,
+					std::string_view file=std::string_view()) = 0;
+		// decoded .symtab and .dynsym, empty if the file has none
+		virtual const symbol_table& symbols(void) = 0;
+		virtual const symbol_table& dynamic_symbols(void) = 0;
+		// name lookup over dynamic_symbols, through .gnu.hash or .hash if present
+		virtual const name_index& dynamic_names(void) = 0;
+		// every REL, RELA and RELR section decoded in section order
+		virtual const relocation_table& relocations(void) = 0;
+		// .debug_line indexed by address, built on first use
+		virtual const line_table& lines(void) = 0;
+		// PT_LOAD segments indexed by address, built on first use
+		virtual const segment_index& vaddr_index(void) = 0;
+		// [vaddr, vaddr+size) of the loaded image as a view into the file,
+		// empty unless all of it is file bytes of one segment, bss isn't
+		virtual byte_view read_at_vaddr(std::uint64_t vaddr, std::uint64_t size) = 0;
+		// bytes of section index as stored in the file, compressed sections
+		// aren't inflated, empty for SHT_NOBITS or a section outside the file
+		virtual byte_view file_bytes(std::size_t index) = 0;
 
 	protected:
-		unsigned int join_bytes(std::vector<std::uint8_t>::iterator ptr, int numOfBytes, bool bigEndian);
-		virtual std::vector<int> map_sections_to_segments(std::uint32_t offset,
-                        std::uint32_t size, std::vector<int> result=std::vector<int>(), int index=0) = 0;
-		std::map<std::uint8_t, std::string> EI_OSABI {
+		std::shared_ptr<file_buffer> buffer;
+		read_options options;
+		std::uint64_t join_bytes(const std::uint8_t* ptr, int numOfBytes, bool bigEndian);
+		static inline const std::map<std::uint8_t, std::string> EI_OSABI {
 			{0x00, "System V"}, {0x01, "HP-UX"}, {0x02, "NetBSD"}, {0x03, "Linux"}, {0x04, "GNU Hurd"},
 			{0x06, "Solaris"}, {0x07, "AIX (Monterey)"}, {0x08, "IRIX"}, {0x09, "FreeBSD"},
 			{0x0A, "Tru64"}, {0x0B, "Novell Modesto"}, {0x0C, "OpenBSD"}, {0x0D, "OpenVMS"},
 			{0x0E, "NonStop Kernel"}, {0x0F, "AROS"}, {0x10, "FenixOS"}, {0x11, "Nuxi CloudABI"},
 			{0x12, "Stratus Technologies OpenVOS"}
 		};
-		std::map<std::uint16_t, std::string> e_type {
+		static inline const std::map<std::uint16_t, std::string> e_type {
 			{0x00, "NONE"}, {0x01, "REL"}, {0x02, "EXEC"}, {0x03, "DYN"}, {0x04, "CORE"},
 			{0xFE00, "LOOS"}, {0xFEFF, "HIOS"}, {0xFF00, "LOPROC"}, {0xFFFF, "HIPROC"}
 		};
-		std::map<std::uint16_t, std::string> e_machine {
+		static inline const std::map<std::uint16_t, std::string> e_machine {
 			{0x00, "No specific instruction set"}, {0x01, "AT&T WE 32100"}, {0x02, "SPARC"},
 			{0x03, "x86"}, {0x04, "Motorola 68000 (M68k)"}, {0x05, "Motorola 88000 (M88k)"},
 			{0x06, "Intel MCU"}, {0x07, "Intel 80860"}, {0x08, "MIPS"}, {0x09, "IBM System/370"},
@@ -320,83 +572,163 @@ class elf_parser {
 			{0xB7, "Arm 64-bits (Armv8/AArch64)"}, {0xDC, "Zilog Z80"}, {0xF3, "RISC-V"},
 			{0xF7, "Berkeley Packet Filter"}, {0x101, "WDC 65C816"}
 		};
-		std::map<std::uint32_t, std::string> programType {
+		static inline const std::map<std::uint32_t, std::string> programType {
 			{0x00, "NULL"}, {0x01, "LOAD"}, {0x02, "DYNAMIC"}, {0x03, "INTERP"},
 			{0x04, "NOTE"}, {0x05, "SHLIB"}, {0x06, "PHDR"}, {0x07, "TLS"},
 			{0x60000000, "LOOS"}, {0x6FFFFFFF, "HIOS"}, {0x70000000, "LOPROC"},
 			{0x7FFFFFFF, "HIPROC"},
 		};
-		 std::map<std::uint32_t, std::vector<std::string>> programFlags {
+		 static inline const std::map<std::uint32_t, std::vector<std::string>> programFlags {
 			 {0x1, {"Executable", "E"}}, {0x2, {"Writable", "W"}}, {0x4, {"Readable", "R"}}
 		};
-		std::map<std::uint32_t, std::string> sectionType {
+		static inline const std::map<std::uint32_t, std::string> sectionType {
 			{0x00,  "NULL"}, {0x01,  "PROGBITS"}, {0x02,  "SYMTAB"}, {0x03,  "STRTAB"},
 			{0x04,  "RELA"}, {0x05,  "HASH"}, {0x06,  "DYNAMIC"}, {0x07,  "NOTE"}, {0x08,  "NOBITS"},
 			{0x09,  "REL"}, {0x0A,  "SHLIB"}, {0x0B,  "DYNSYM"}, {0x0E,  "INIT_ARRAY"},
 			{0x0F,  "FINI_ARRAY"}, {0x10,  "PREINIT_ARRAY"}, {0x11,  "GROUP"},
-			{0x12,  "SYMTAB_SHNDX"}, {0x13,  "NUM"}, {0x60000000, "LOOS"}
+			{0x12,  "SYMTAB_SHNDX"}, {0x13,  "RELR"}, {0x60000000, "LOOS"},
+			{0x6FFFFFF6, "GNU_HASH"}
                 };
-		std::map<std::uint32_t, std::vector<std::string>> sectionFlags {
+		static inline const std::map<std::uint32_t, std::vector<std::string>> sectionFlags {
 			{0x01, {"SHF_WRITE", "W"}}, {0x02, {"SHF_ALLOC", "A"}}, {0x04, {"SHF_EXECINSTR", "X"}},
 			{0x10, {"SHF_MERGE", "M"}}, {0x20, {"SHF_STRINGS", "S"}}, {0x40, {"SHF_INFO_LINK", "I"}},
 			{0x80, {"SHF_LINK_ORDER", "L"}}, {0x100, {"SHF_OS_NONCONFORMING", "O"}},
-			{0x200, {"SHF_GROUP", "G"}}, {0x400, {"SHF_TLS", "T"}}, {0x0FF00000, {"SHF_MASKOS", "o"}},
+			{0x200, {"SHF_GROUP", "G"}}, {0x400, {"SHF_TLS", "T"}}, {0x800, {"SHF_COMPRESSED", "C"}},
+			{0x0FF00000, {"SHF_MASKOS", "o"}},
 			{0xF0000000, {"SHF_MASKPROC", "p"}}, {0x4000000, {"SHF_ORDERED", ""}},
 			{0x8000000, {"SHF_EXCLUDE", ""}}
 		};
+		static inline const std::map<std::uint8_t, std::string> symbolType {
+			{0x00, "NOTYPE"}, {0x01, "OBJECT"}, {0x02, "FUNC"}, {0x03, "SECTION"},
+			{0x04, "FILE"}, {0x05, "COMMON"}, {0x06, "TLS"}, {0x0A, "IFUNC"}
+		};
+		static inline const std::map<std::uint8_t, std::string> symbolBind {
+			{0x00, "LOCAL"}, {0x01, "GLOBAL"}, {0x02, "WEAK"}, {0x0A, "UNIQUE"}
+		};
+		static inline const std::map<std::uint8_t, std::string> symbolVisibility {
+			{0x00, "DEFAULT"}, {0x01, "INTERNAL"}, {0x02, "HIDDEN"}, {0x03, "PROTECTED"}
+		};
+};
+
+
+// tables elf_class_parser::adopt took over, or-ed together
+enum adopted_table : unsigned {
+	adopted_symbols =		1,
+	adopted_dynamic_symbols =	2,
+	adopted_relocations =		4,
+	adopted_lines =			8,
+	adopted_segments =		16
 };
 
 
-class elf_32_parser : public elf_parser {
+// One implementation for both classes, elf_class is elf32_traits or elf64_traits
+template <typename elf_class>
+class elf_class_parser : public elf_parser {
+
+	public:
+		typedef typename elf_class::header_t header_t;
+		typedef typename elf_class::segment_t segment_t;
+		typedef typename elf_class::section_t section_t;
 
 	private:
-                elf32Header_t elfHeader;
-		std::vector<segment32_t> programHeaderTable;
-                std::vector<section32_t> sectionHeaderTable;
-		std::vector<int> map_sections_to_segments(std::uint32_t offset,
-                        std::uint32_t size, std::vector<int> result=std::vector<int>({}), int index=0) override;
+                header_t elfHeader;
+		std::vector<segment_t> programHeaderTable;
+                std::vector<section_t> sectionHeaderTable;
+		// section name -> index, keys point into .shstrtab
+		std::unordered_map<std::string_view, std::size_t> sectionIndex;
+		// decoded on first access
+		std::optional<symbol_table> symbolTable;
+		std::optional<symbol_table> dynamicSymbolTable;
+		std::optional<name_index> dynamicNames;
+		std::optional<relocation_table> relocationTable;
+		std::optional<line_table> lineTable;
+		std::optional<segment_index> segmentIndex;
+		// set when the tables came from a metadata_cache entry, whose buffer
+		// backs the section index keys and the cached symbol columns
+		std::shared_ptr<file_buffer> cacheEntry;
+		byte_view cachedSymbols;
+		byte_view cachedDynamicSymbols;
+		friend class metadata_cache;
+		elf_class_parser() = default;
+		void map_sections_to_segments(void);
+		const symbol_table& load_symbols(std::optional<symbol_table>& table, std::uint32_t type);
+		section_t& load_section(section_t& section);
+		void load_sections(const std::vector<section_t*>& sections);
+		template <bool swap> void decode_elf_header(byte_view bytes);
+		template <bool swap> void decode_section_table(byte_view table, std::size_t count);
+		template <bool swap> void decode_program_table(byte_view table, std::size_t count);
+		void write_text(output_buffer& out, unsigned parts);
+		void write_json(output_buffer& out, output_format format, unsigned parts, std::string_view file);
+		void header_fields(output_buffer& out);
+		void section_fields(output_buffer& out, std::size_t index);
+		void segment_fields(output_buffer& out, std::size_t index);
+		void symbol_fields(output_buffer& out, std::string_view table, const symbol_table::symbol& symbol);
 
 	public:
-		elf_32_parser(std::vector<std::uint8_t> bytes);
+		elf_class_parser(std::vector<std::uint8_t> bytes);
+		elf_class_parser(std::shared_ptr<file_buffer> buffer, read_options options=read_options());
 		std::vector<std::uint8_t> read_section(std::string name) override;
+		byte_view section_view(std::string name) override;
 		void print_elf_header(void) override;
 		void print_sections(void) override;
 		void print_segments(void) override;
 		void print_symbol_table(void) override;
+		void write(output_buffer& out, output_format format, unsigned parts=output_all,
+				std::string_view file=std::string_view()) override;
+		const symbol_table& symbols(void) override { return load_symbols(symbolTable, 0x02); }
+		const symbol_table& dynamic_symbols(void) override { return load_symbols(dynamicSymbolTable, 0x0B); }
+		const name_index& dynamic_names(void) override;
+		const relocation_table& relocations(void) override;
+		const line_table& lines(void) override;
+		const segment_index& vaddr_index(void) override;
+		byte_view read_at_vaddr(std::uint64_t vaddr, std::uint64_t size) override;
+		byte_view file_bytes(std::size_t index) override;
+
+		// Accessors, sections returned from these have their contents loaded
+		const header_t& elf_header(void) const { return elfHeader; }
+		const std::vector<segment_t>& segments(void) const { return programHeaderTable; }
+		const std::vector<section_t>& sections(void) const { return sectionHeaderTable; }
+		section_t* find_section(std::string_view name);
+		section_t& section_at(std::size_t index);
+		std::vector<section_t*> sections_of_type(std::uint32_t type);
+
+		// Takes over the tables previous, an earlier parse of the same file,
+		// decoded from sections that are still the same. unchanged[i] is set
+		// where section i has the same header and contents in both. Returns
+		// the adopted_table flags of what was taken.
+		unsigned adopt(elf_class_parser& previous, const std::vector<bool>& unchanged);
 };
 
-
-class elf_64_parser : public elf_parser {
-
-	private:
-                elf64Header_t elfHeader;
-		std::vector<programHeader64_t> programHeaders;
-                std::vector<sectionHeader64_t> sectionHeaderTable;
-		std::vector<int> map_sections_to_segments(std::uint32_t offset,
-                        std::uint32_t size, std::vector<int> result=std::vector<int>(), int index=0) override {return std::vector<int>();}
-
-	public:
-		elf_64_parser(std::vector<std::uint8_t> bytes);
-		std::vector<std::uint8_t> read_section(std::string name) override {return std::vector<std::uint8_t>();}
-		void print_elf_header(void) override {}
-		void print_sections(void) override {}
-		void print_segments(void) override {}
-		void print_symbol_table(void) override {}
-};
+typedef elf_class_parser<elf32_traits> elf_32_parser;
+typedef elf_class_parser<elf64_traits> elf_64_parser;
 
 
 class elf_error : public elf_parser {
 	// Factory error class (default return value if exception thrown)
-	private:
-		std::vector<int> map_sections_to_segments(uint32_t offset,
-                        uint32_t size, std::vector<int> result=std::vector<int>(), int index=0) override {return std::vector<int>();}
-	
 	public:
 		std::vector<std::uint8_t> read_section(std::string name) override {return std::vector<std::uint8_t>();}
+		byte_view section_view(std::string name) override {return byte_view();}
                 void print_elf_header(void) override {}
                 void print_sections(void) override {}
 		void print_segments(void) override {}
                 void print_symbol_table(void) override {}
+		void write(output_buffer& out, output_format format, unsigned parts=output_all,
+				std::string_view file=std::string_view()) override {}
+		const symbol_table& symbols(void) override { return noSymbols; }
+		const symbol_table& dynamic_symbols(void) override { return noSymbols; }
+		const name_index& dynamic_names(void) override { return noNames; }
+		const relocation_table& relocations(void) override { return noRelocations; }
+		const line_table& lines(void) override { return noLines; }
+		const segment_index& vaddr_index(void) override { return noSegments; }
+		byte_view read_at_vaddr(std::uint64_t vaddr, std::uint64_t size) override { return byte_view(); }
+		byte_view file_bytes(std::size_t index) override { return byte_view(); }
+
+	private:
+		symbol_table noSymbols;
+		name_index noNames;
+		relocation_table noRelocations;
+		line_table noLines;
+		segment_index noSegments;
 };
 
 
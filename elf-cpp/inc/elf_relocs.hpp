@@ -0,0 +1,86 @@
+#ifndef ELF_RELOCS_H
+#define ELF_RELOCS_H
+
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+#include "elf_buffer.hpp"
+
+namespace elf {
+
+constexpr std::uint32_t SHT_RELA =	0x04;
+constexpr std::uint32_t SHT_REL =	0x09;
+constexpr std::uint32_t SHT_RELR =	0x13;
+
+
+// Decoded relocations of any number of REL, RELA and RELR sections, stored
+// column by column and section after section. RELR sections are expanded to
+// one row per relocated address with the machine's relative type. Rows of
+// REL and RELR sections have no explicit addend, their addend column is 0.
+class relocation_table {
+
+	public:
+		// the rows decoded from one section
+		typedef struct run_t {
+			std::uint32_t section = 0;	// the relocation section
+			std::uint32_t target = 0;	// section patched (sh_info), 0 for dynamic relocations
+			std::uint32_t symbols = 0;	// symbol table of the symbol column (sh_link)
+			std::uint32_t type = 0;		// SHT_REL, SHT_RELA or SHT_RELR
+			std::size_t first = 0;
+			std::size_t count = 0;
+		} run_t;
+
+		// rows bucketed by a key, keys ascend and the rows of group i are
+		// rows[starts[i]] up to rows[starts[i+1]] in table order
+		typedef struct grouping {
+			std::vector<std::uint32_t> keys;
+			std::vector<std::size_t> starts;
+			std::vector<std::uint32_t> rows;
+			std::size_t size(void) const { return keys.size(); }
+			std::size_t count(std::size_t group) const { return starts[group+1] - starts[group]; }
+			const std::uint32_t* group(std::size_t group) const { return rows.data() + starts[group]; }
+		} grouping;
+
+		// decodes the contents of the section described by run and appends
+		// it as one run, elf_class is elf32_traits or elf64_traits.
+		// relativeType is the row type of RELR entries, see relative_type
+		template <typename elf_class>
+		void append(byte_view table, run_t run, std::size_t entsize, bool bigEndian,
+				std::uint32_t relativeType=0);
+		// room for rows, so appending many sections doesn't copy the columns
+		void reserve(std::size_t rows);
+		// R_*_RELATIVE of e_machine, 0 when unknown
+		static std::uint32_t relative_type(std::uint16_t machine);
+
+		std::size_t size(void) const { return relOffset.size(); }
+		bool empty(void) const { return relOffset.empty(); }
+		const std::vector<run_t>& runs(void) const { return relRuns; }
+
+		grouping by_type(void) const;
+		grouping by_target(void) const;
+
+		// columns
+		const std::vector<std::uint64_t>& offsets(void) const { return relOffset; }
+		const std::vector<std::uint32_t>& types(void) const { return relType; }
+		const std::vector<std::uint32_t>& symbol_indexes(void) const { return relSymbol; }
+		const std::vector<std::int64_t>& addends(void) const { return relAddend; }
+
+	private:
+		std::vector<std::uint64_t> relOffset;
+		std::vector<std::uint32_t> relType;
+		std::vector<std::uint32_t> relSymbol;
+		std::vector<std::int64_t> relAddend;
+		std::vector<run_t> relRuns;
+
+		template <typename elf_class, bool swap, bool rela>
+		void decode_rows(const std::uint8_t* table, std::size_t count, std::size_t entsize, std::size_t first);
+		template <typename elf_class, bool swap>
+		std::size_t decode_relr(const std::uint8_t* table, std::size_t words, std::uint32_t relativeType);
+};
+
+
+} // end of namespace elf
+
+#endif
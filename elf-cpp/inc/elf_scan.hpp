@@ -0,0 +1,98 @@
+#ifndef ELF_SCAN_H
+#define ELF_SCAN_H
+
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "elf_parser.hpp"
+#include "elf_notes.hpp"
+
+namespace elf {
+
+typedef struct scan_options {
+	unsigned threads = 0;		// 0 uses every hardware thread
+	// files parsed or being parsed that the consumer hasn't taken yet,
+	// workers wait once this many are out, 0 means 4 per thread
+	std::size_t max_pending = 0;
+	// headers only by default, section contents are mapped on first access
+	read_options read = read_options(load_mode::map, true);
+	bool skip_non_elf = false;	// drop files without the ELF magic instead of reporting them
+	// only the notes are read with read_notes, results have no parser
+	bool notes_only = false;
+} scan_options;
+
+
+typedef struct scan_result {
+	std::size_t index = 0;		// position in the input list
+	std::string path;
+	std::unique_ptr<elf_parser> parser;	// null if error is set
+	note_info notes;			// scan_options::notes_only
+	parse_error error;
+} scan_result;
+
+
+// Parses a list of files on a pool of worker threads and hands the results
+// out in completion order. Each worker starts with a contiguous run of the
+// list and steals half of another worker's remaining run when it's done.
+class scan_channel {
+
+	public:
+		scan_channel(std::vector<std::string> paths, scan_options options=scan_options());
+		// stops the workers, results not taken yet are dropped
+		~scan_channel();
+		scan_channel(const scan_channel&) = delete;
+		scan_channel& operator=(const scan_channel&) = delete;
+
+		// waits for the next parsed file, false once every file was handed out
+		bool next(scan_result& result);
+		// workers finish the file they're on and stop, next returns false
+		void cancel(void);
+		std::size_t size(void) const { return paths.size(); }
+
+	private:
+		typedef struct worker_queue {
+			std::mutex lock;
+			std::deque<std::size_t> tasks;
+		} worker_queue;
+
+		std::vector<std::string> paths;
+		scan_options options;
+		std::vector<std::unique_ptr<worker_queue>> queues;
+		std::vector<std::thread> workers;
+
+		// guards everything below
+		std::mutex lock;
+		std::condition_variable resultReady;
+		std::condition_variable slotFree;
+		std::deque<scan_result> results;
+		std::size_t inFlight = 0;	// parsing or waiting in results
+		std::size_t remaining;		// files not finished yet
+		bool stopped = false;
+
+		void work(std::size_t self);
+		bool take_task(std::size_t self, std::size_t& index);
+};
+
+
+// regular files below root, symlinks are not followed
+std::vector<std::string> list_files(const std::string& root);
+
+// Convenience wrappers around scan_channel, callback runs on the calling
+// thread once per file in completion order
+void scan_files(std::vector<std::string> paths, const std::function<void(scan_result&)>& callback,
+			scan_options options=scan_options());
+void scan_directory(const std::string& root, const std::function<void(scan_result&)>& callback,
+			scan_options options=scan_options());
+
+
+} // end of namespace elf
+
+#endif
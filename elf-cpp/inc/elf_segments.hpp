@@ -0,0 +1,62 @@
+#ifndef ELF_SEGMENTS_H
+#define ELF_SEGMENTS_H
+
+
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+namespace elf {
+
+// one PT_LOAD, memory [vaddr, vaddr+memsz) of which the first filesz bytes
+// are at offset in the file, the rest is bss (or wasn't dumped in a core)
+typedef struct load_segment {
+	std::uint64_t vaddr;
+	std::uint64_t memsz;
+	std::uint64_t offset;
+	std::uint64_t filesz;
+	std::uint32_t flags;	// PF_R 4, PF_W 2, PF_X 1
+} load_segment;
+
+
+// Virtual address to file offset translation over the PT_LOAD segments of
+// a file. Segments are sorted by address and clipped where they overlap,
+// lookups are a binary search behind a check of the segment the previous
+// lookup found, which is where runs of nearby addresses land. Safe to share
+// between threads.
+class segment_index {
+
+	public:
+		static constexpr std::uint64_t npos = ~0ull;
+
+		segment_index() = default;
+		// segments with no memory are dropped
+		segment_index(std::vector<load_segment> segments);
+		segment_index(const segment_index& other);
+		segment_index& operator=(const segment_index& other);
+
+		// segment whose memory holds vaddr, null if none
+		const load_segment* find(std::uint64_t vaddr) const;
+		// npos if vaddr isn't mapped or lies in bss
+		std::uint64_t vaddr_to_offset(std::uint64_t vaddr) const;
+		// address offset is loaded at, npos if no segment's file bytes hold it
+		std::uint64_t offset_to_vaddr(std::uint64_t offset) const;
+		// offset of [vaddr, vaddr+size) if all of it is file bytes of one
+		// segment, npos otherwise
+		std::uint64_t range_to_offset(std::uint64_t vaddr, std::uint64_t size) const;
+
+		const std::vector<load_segment>& segments(void) const { return bySegment; }
+		std::size_t size(void) const { return bySegment.size(); }
+		bool empty(void) const { return bySegment.empty(); }
+
+	private:
+		std::vector<load_segment> bySegment;		// sorted by vaddr
+		std::vector<std::uint32_t> byOffset;		// indexes sorted by offset, file bytes only
+		mutable std::atomic<std::uint32_t> last {0};
+};
+
+
+} // end of namespace elf
+
+#endif
@@ -0,0 +1,132 @@
+#ifndef ELF_STATS_H
+#define ELF_STATS_H
+
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+
+#include "elf_output.hpp"
+
+namespace elf {
+
+// Instrumentation is built with ELF_STATS defined (make STATS=1). Without it
+// timers and counters are empty inline functions the compiler drops, and
+// collect_stats returns zeros.
+#ifdef ELF_STATS
+constexpr bool stats_enabled = true;
+#else
+constexpr bool stats_enabled = false;
+#endif
+
+
+// where parse time goes, each timed exclusive of the phases nested in it
+enum class stat_phase : unsigned {
+	io,			// opening, mapping and reading files
+	header,			// file header decode
+	section_table,		// section header decode
+	section_names,		// .shstrtab walk and the name index
+	program_table,		// program header decode
+	segment_mapping,	// map_sections_to_segments
+	section_load,		// section contents fetched, copied in copy mode
+	decompress,		// SHF_COMPRESSED sections inflated
+	symbols,		// .symtab and .dynsym decode
+	relocations,
+	lines,			// .debug_line decode
+	output			// elf_parser::write and the print_* calls
+};
+constexpr std::size_t stat_phase_count = 12;
+
+enum class stat_counter : unsigned {
+	files_parsed,		// parsers constructed, metadata_cache hits included
+	bytes_read,		// read into memory by read_file and stream_buffer
+	bytes_mapped,		// mapped by mmap_buffer
+	allocations,		// buffers for file contents: whole files, stream blocks, section copies, inflated sections
+	sections_decoded,
+	segments_decoded,
+	sections_loaded,
+	section_bytes,		// bytes of the sections loaded, inflated size for compressed ones
+	symbols_decoded,
+	relocations_decoded,
+	cache_hits,		// metadata_cache and section_cache
+	cache_misses
+};
+constexpr std::size_t stat_counter_count = 12;
+
+const char* stat_name(stat_phase phase);
+const char* stat_name(stat_counter counter);
+
+
+// totals of every thread, see collect_stats
+typedef struct parse_stats {
+	std::array<std::uint64_t, stat_phase_count> nanoseconds {};
+	std::array<std::uint64_t, stat_phase_count> calls {};
+	std::array<std::uint64_t, stat_counter_count> counters {};
+
+	std::uint64_t time(stat_phase phase) const { return nanoseconds[static_cast<unsigned>(phase)]; }
+	std::uint64_t count(stat_counter counter) const { return counters[static_cast<unsigned>(counter)]; }
+	// one object: "enabled", then "phases" of {"ns", "calls"} and "counters"
+	void write_json(output_buffer& out) const;
+} parse_stats;
+
+// Sums every thread's stats since the last reset, threads that exited
+// included. Threads still parsing are read mid-way, relaxed.
+parse_stats collect_stats(void);
+// zeroes every thread's stats, updates racing with it may survive
+void reset_stats(void);
+
+
+#ifdef ELF_STATS
+
+// one per thread, written only by its thread
+typedef struct stat_block {
+	std::array<std::atomic<std::uint64_t>, stat_phase_count> nanoseconds {};
+	std::array<std::atomic<std::uint64_t>, stat_phase_count> calls {};
+	std::array<std::atomic<std::uint64_t>, stat_counter_count> counters {};
+} stat_block;
+
+stat_block& thread_stats(void);
+
+// single writer, a plain load and store rather than a locked add
+inline void stat_add(stat_counter counter, std::uint64_t value=1) {
+
+	std::atomic<std::uint64_t> &slot = thread_stats().counters[static_cast<unsigned>(counter)];
+	slot.store(slot.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+}
+
+// Charges the time until it goes out of scope to phase, less the time of
+// timers started inside it on the same thread
+class stat_timer {
+
+	public:
+		explicit stat_timer(stat_phase phase);
+		~stat_timer();
+		stat_timer(const stat_timer&) = delete;
+		stat_timer& operator=(const stat_timer&) = delete;
+
+	private:
+		stat_phase phase;
+		std::uint64_t start;
+		std::uint64_t nested = 0;
+		stat_timer* parent;
+};
+
+#else
+
+inline void stat_add(stat_counter, std::uint64_t=1) {}
+
+class stat_timer {
+
+	public:
+		explicit stat_timer(stat_phase) {}
+		stat_timer(const stat_timer&) = delete;
+		stat_timer& operator=(const stat_timer&) = delete;
+};
+
+#endif
+
+
+} // end of namespace elf
+
+#endif
@@ -0,0 +1,223 @@
+#ifndef ELF_SYMBOLS_H
+#define ELF_SYMBOLS_H
+
+
+#include <cstdint>
+#include <cstddef>
+#include <iterator>
+#include <string_view>
+#include <vector>
+
+#include "elf_buffer.hpp"
+
+namespace elf {
+
+constexpr std::uint8_t STT_NOTYPE =	0;
+constexpr std::uint8_t STT_OBJECT =	1;
+constexpr std::uint8_t STT_FUNC =	2;
+constexpr std::uint8_t STT_SECTION =	3;
+constexpr std::uint8_t STT_FILE =	4;
+constexpr std::uint8_t STT_COMMON =	5;
+constexpr std::uint8_t STT_TLS =	6;
+constexpr std::uint8_t STT_GNU_IFUNC =	10;
+
+constexpr std::uint8_t STB_LOCAL =	0;
+constexpr std::uint8_t STB_GLOBAL =	1;
+constexpr std::uint8_t STB_WEAK =	2;
+constexpr std::uint8_t STB_GNU_UNIQUE =	10;
+
+constexpr std::uint32_t SHN_UNDEF =	0x0000;
+constexpr std::uint32_t SHN_ABS =	0xfff1;
+constexpr std::uint32_t SHN_COMMON =	0xfff2;
+constexpr std::uint32_t SHN_XINDEX =	0xffff;
+
+
+// Decoded .symtab or .dynsym stored column by column. Each field is its own
+// array so scans over one field touch only that field, and names are views
+// into the string table so no per symbol strings are allocated.
+class symbol_table {
+
+	public:
+		// lightweight handle to one row
+		class symbol {
+
+			public:
+				symbol(const symbol_table* table, std::size_t index) : table(table), row(index) {}
+				std::size_t index(void) const { return row; }
+				std::string_view name(void) const { return table->name(row); }
+				std::uint64_t value(void) const { return table->symValue[row]; }
+				std::uint64_t size(void) const { return table->symSize[row]; }
+				std::uint8_t info(void) const { return table->symInfo[row]; }
+				std::uint8_t type(void) const { return table->symInfo[row] & 0x0F; }
+				std::uint8_t bind(void) const { return table->symInfo[row] >> 4; }
+				std::uint8_t visibility(void) const { return table->symOther[row] & 0x03; }
+				std::uint32_t shndx(void) const { return table->symShndx[row]; }
+
+			private:
+				const symbol_table* table;
+				std::size_t row;
+		};
+
+		class iterator {
+
+			public:
+				typedef std::random_access_iterator_tag iterator_category;
+				typedef symbol value_type;
+				typedef std::ptrdiff_t difference_type;
+				typedef symbol pointer;
+				typedef symbol reference;
+
+				iterator(const symbol_table* table, std::size_t index) : table(table), row(index) {}
+				symbol operator*(void) const { return symbol(table, row); }
+				symbol operator[](difference_type n) const { return symbol(table, row+n); }
+				iterator& operator++(void) { row++; return *this; }
+				iterator operator++(int) { iterator it = *this; row++; return it; }
+				iterator& operator--(void) { row--; return *this; }
+				iterator& operator+=(difference_type n) { row += n; return *this; }
+				iterator operator+(difference_type n) const { return iterator(table, row+n); }
+				difference_type operator-(const iterator& it) const { return row - it.row; }
+				bool operator==(const iterator& it) const { return row == it.row; }
+				bool operator!=(const iterator& it) const { return row != it.row; }
+				bool operator<(const iterator& it) const { return row < it.row; }
+
+			private:
+				const symbol_table* table;
+				std::size_t row;
+		};
+
+		// elf_class is elf32_traits or elf64_traits
+		template <typename elf_class>
+		static symbol_table decode(byte_view table, std::size_t entsize, byte_view strtab,
+						bool bigEndian, byte_view xindex=byte_view());
+
+		std::size_t size(void) const { return symValue.size(); }
+		bool empty(void) const { return symValue.empty(); }
+		symbol operator[](std::size_t index) const { return symbol(this, index); }
+		iterator begin(void) const { return iterator(this, 0); }
+		iterator end(void) const { return iterator(this, size()); }
+		std::string_view name(std::size_t index) const;
+		// name(index) == name without measuring the whole name first
+		bool name_equals(std::size_t index, std::string_view name) const;
+
+		// rows whose type and binding match, 0xFF matches any
+		std::vector<std::uint32_t> filter(std::uint8_t type, std::uint8_t bind=0xFF) const;
+
+		// columns
+		const std::vector<std::uint64_t>& values(void) const { return symValue; }
+		const std::vector<std::uint64_t>& sizes(void) const { return symSize; }
+		const std::vector<std::uint8_t>& infos(void) const { return symInfo; }
+		const std::vector<std::uint8_t>& others(void) const { return symOther; }
+		const std::vector<std::uint32_t>& section_indexes(void) const { return symShndx; }
+		const std::vector<std::uint32_t>& name_offsets(void) const { return symName; }
+
+	private:
+		std::vector<std::uint64_t> symValue;
+		std::vector<std::uint64_t> symSize;
+		std::vector<std::uint8_t> symInfo;
+		std::vector<std::uint8_t> symOther;
+		std::vector<std::uint32_t> symShndx;
+		std::vector<std::uint32_t> symName;
+		byte_view strtab;
+		friend class metadata_cache;
+		template <typename elf_class> friend class elf_class_parser;
+
+		template <typename elf_class, bool swap>
+		void decode_rows(const std::uint8_t* table, std::size_t count, std::size_t entsize);
+};
+
+
+// Function symbols of one symbol_table sorted by address for symbolizing.
+// Start addresses are stored in Eytzinger (breadth first) order so a search
+// walks down cache friendly levels without branches.
+class address_index {
+
+	public:
+		static constexpr std::uint32_t npos = 0xFFFFFFFF;
+
+		address_index() = default;
+		address_index(const symbol_table& symbols);
+
+		// row in the symbol table of the function containing address, npos if none
+		std::uint32_t lookup(std::uint64_t address) const;
+		// same for many addresses, sorted and merged against the table when
+		// there are enough of them, results are in input order
+		void lookup(const std::uint64_t* addresses, std::size_t count, std::uint32_t* rows) const;
+		std::vector<std::uint32_t> lookup(const std::vector<std::uint64_t>& addresses) const;
+		std::size_t size(void) const { return starts.size(); }
+
+	private:
+		typedef struct slot_t {
+			std::uint64_t end;
+			std::uint32_t row;
+		} slot_t;
+
+		// sorted by start address, used for merging batches
+		std::vector<std::uint64_t> starts;
+		std::vector<slot_t> sorted;
+		// 1-based Eytzinger layout of starts, with the end and row of each slot
+		std::vector<std::uint64_t> tree;
+		std::vector<slot_t> slots;
+};
+
+
+// Name to row lookup over the defined, non-local symbols of a symbol_table.
+// Uses the object's own .gnu.hash table, bloom filter first, or its SysV
+// .hash table when that's all there is. Tables that fail validation are
+// ignored and an open addressing index over the names is built instead, as
+// for objects without either. Where a name is defined more than once (symbol
+// versions) one of the definitions is returned.
+class name_index {
+
+	public:
+		static constexpr std::uint32_t npos = 0xFFFFFFFF;
+		enum class source { none, gnu_hash, sysv_hash, built };
+
+		name_index() = default;
+		name_index(const symbol_table& symbols);
+		// gnuHash and sysvHash are section contents, either may be empty,
+		// wordSize is 4 or 8 as the bloom filter words follow the class
+		name_index(const symbol_table& symbols, byte_view gnuHash, byte_view sysvHash,
+				bool bigEndian, std::size_t wordSize);
+
+		// row of the definition of name, npos if there is none
+		std::uint32_t lookup(std::string_view name) const;
+		source kind(void) const { return tableKind; }
+
+		static std::uint32_t gnu_hash(std::string_view name);
+		static std::uint32_t sysv_hash(std::string_view name);
+
+	private:
+		typedef struct slot_t {
+			std::uint32_t hash;
+			std::uint32_t row;	// npos for an empty slot
+		} slot_t;
+
+		const symbol_table* symbols = nullptr;
+		source tableKind = source::none;
+		bool swap = false;
+		// .gnu.hash, words point into the section
+		std::uint32_t bucketCount = 0;
+		std::uint32_t symbolOffset = 0;
+		std::uint32_t bloomMask = 0;
+		std::uint32_t bloomShift = 0;
+		std::size_t wordBits = 0;
+		const std::uint8_t* bloom = nullptr;
+		const std::uint8_t* buckets = nullptr;
+		const std::uint8_t* chains = nullptr;
+		std::uint32_t chainCount = 0;	// also .hash
+		std::vector<slot_t> built;	// power of two size, linear probing
+
+		bool use_gnu_hash(byte_view table, std::size_t wordSize);
+		bool use_sysv_hash(byte_view table);
+		void build(void);
+		std::uint32_t word(const std::uint8_t* ptr) const;
+		bool defines(std::uint32_t row, std::string_view name) const;
+		std::uint32_t lookup_gnu(std::string_view name) const;
+		std::uint32_t lookup_sysv(std::string_view name) const;
+		std::uint32_t lookup_built(std::string_view name) const;
+};
+
+
+} // end of namespace elf
+
+#endif
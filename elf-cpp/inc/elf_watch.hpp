@@ -0,0 +1,112 @@
+#ifndef ELF_WATCH_H
+#define ELF_WATCH_H
+
+
+#include <cstdint>
+#include <cstddef>
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "elf_diff.hpp"
+#include "elf_parser.hpp"
+
+namespace elf {
+
+// what a change of one watched file did to it
+typedef struct elf_change {
+	std::string path;
+	bool removed = false;			// the path is gone, its last state is kept
+	parse_error error;			// the new file doesn't parse, its last state is kept
+	bool header = false;			// class, byte order, type, machine, entry or flags differ
+	bool segments = false;			// program headers differ
+	std::vector<section_diff> sections;	// changed sections in new file order, removed ones last
+	std::size_t unchanged = 0;		// sections found identical
+	unsigned adopted = 0;			// adopted_table flags of the decoded tables kept
+	std::uint64_t hashed = 0;		// bytes read to find the changed sections
+	elf_parser* parser = nullptr;		// the state after the change, null if removed
+} elf_change;
+
+
+typedef struct watch_options {
+	// how watched files are read, the cache is not used. A mapping is
+	// only safe for files that are replaced (unlinked or renamed over) as
+	// linkers do, files truncated and rewritten in place need load_mode::copy.
+	read_options read = read_options(load_mode::map, true);
+	unsigned threads = 0;	// threads hashing sections, 0 for every hardware thread
+} watch_options;
+
+
+// Keeps a set of ELF files parsed and re-parses them when inotify reports
+// them rewritten. Parent directories are watched, so files replaced by
+// rename or deleted and created again (ld, gold, lld, mold) are followed. On
+// a change the header and the section and program header tables are read
+// again, sections are matched by name and type, and their file bytes are
+// fingerprinted in parallel to find the ones that changed. Tables already
+// decoded from sections that didn't change are carried over to the new
+// parse, everything else is decoded again on first access. Subscribers get an elf_change per
+// changed file from poll, on the thread calling it.
+class elf_watcher {
+
+	public:
+		typedef std::function<void(const elf_change&)> subscriber;
+
+		elf_watcher(watch_options options=watch_options());
+		~elf_watcher();
+		elf_watcher(const elf_watcher&) = delete;
+		elf_watcher& operator=(const elf_watcher&) = delete;
+
+		// parses file and starts watching it, false with error filled if it
+		// can't be parsed or watched
+		bool add(const std::string& file, parse_error& error);
+		void remove(const std::string& file);
+		// null if file isn't watched or is gone
+		elf_parser* parser(const std::string& file);
+		std::size_t size(void) const { return files.size(); }
+
+		// returns an id for unsubscribe
+		std::size_t subscribe(subscriber callback);
+		void unsubscribe(std::size_t id);
+
+		// Waits up to timeoutMs (-1 for ever, 0 not at all) for events, then
+		// handles everything queued. Returns the changes delivered.
+		std::size_t poll(int timeoutMs=0);
+		// re-reads file now as if an event came for it
+		bool refresh(const std::string& file);
+		// inotify descriptor for an event loop, readable when poll has work
+		int fd(void) const { return notifyFd; }
+
+	private:
+		typedef struct watched_t {
+			std::string path;
+			std::unique_ptr<elf_parser> parser;
+			// what a change is compared against, class neutral
+			std::uint64_t header[6] = {};	// class, byte order, type, machine, entry, flags
+			std::vector<std::vector<std::uint64_t>> segments;
+			std::vector<section_state> sections;
+			// stat of the file parsed, an event that leaves it alone is ignored
+			std::uint64_t device = 0, inode = 0, size = 0, mtime = 0;
+			bool gone = false;
+		} watched_t;
+
+		watch_options options;
+		int notifyFd = -1;
+		std::map<std::string, watched_t> files;
+		// watch descriptor -> directory, directory -> watch descriptor and
+		// the watched names in it
+		std::unordered_map<int, std::string> directories;
+		std::map<std::string, std::pair<int, std::vector<std::string>>> watches;
+		std::map<std::size_t, subscriber> subscribers;
+		std::size_t nextId = 1;
+
+		bool load(watched_t& file, elf_change& change);
+		void notify(const elf_change& change);
+};
+
+
+} // end of namespace elf
+
+#endif
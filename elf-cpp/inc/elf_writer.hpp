@@ -0,0 +1,77 @@
+#ifndef ELF_WRITER_H
+#define ELF_WRITER_H
+
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "elf_parser.hpp"
+
+namespace elf {
+
+constexpr std::uint32_t SHT_NOTE =		0x07;
+constexpr std::uint32_t SHT_NOBITS =		0x08;
+constexpr std::uint32_t SHT_GROUP =		0x11;
+constexpr std::uint32_t SHT_SYMTAB_SHNDX =	0x12;
+constexpr std::uint64_t SHF_ALLOC =		0x02;
+constexpr std::uint64_t SHF_INFO_LINK =		0x40;
+
+
+enum class edit_kind {
+	add_section,
+	remove_section,
+	replace_section,
+	set_flags,
+	update_note
+};
+
+// One change to a file, made with the helpers below. Sections are named, for
+// remove and set_flags a trailing '*' matches every name with that prefix.
+typedef struct elf_edit {
+	edit_kind kind;
+	std::string section;
+	std::vector<std::uint8_t> data;		// contents of an added or replaced section, desc of a note
+	std::uint32_t type = 0x01;		// sh_type of an added section
+	std::uint64_t flags = 0;		// sh_flags of an added section or the new ones
+	std::uint64_t align = 1;		// sh_addralign of an added section
+	std::string owner;			// name and type of the note to update
+	std::uint32_t noteType = 0;
+
+	static elf_edit add(std::string section, std::vector<std::uint8_t> data, std::uint32_t type=0x01,
+				std::uint64_t flags=0, std::uint64_t align=1);
+	static elf_edit remove(std::string section);
+	static elf_edit replace(std::string section, std::vector<std::uint8_t> data);
+	static elf_edit set_flags(std::string section, std::uint64_t flags);
+	// the first note of owner and type in section gets desc, one is
+	// appended if there is none
+	static elf_edit update_note(std::string section, std::string owner, std::uint32_t type,
+					std::vector<std::uint8_t> desc);
+} elf_edit;
+
+typedef struct write_stats {
+	std::uint64_t size = 0;		// bytes of the new file
+	std::uint64_t copied = 0;	// bytes copied from the source in the kernel
+	std::uint64_t written = 0;	// bytes written from memory: tables and edited sections
+	std::size_t copies = 0;		// source ranges copied
+	std::size_t sections = 0;	// section headers written
+} write_stats;
+
+
+// Writes source, which parser was read from, to output with edits applied in
+// order. Sections inside segments keep their offsets so the program headers
+// stay valid, edits to them have to keep their size. Every other section is
+// laid out again after the segments, the section header table goes last.
+// Unchanged ranges are copied with copy_file_range (sendfile where that
+// fails), only headers and edited sections pass through memory. output is
+// replaced by rename, it may be source. false with error filled on failure,
+// parse_errc::bad_edit for edits that don't fit the file, such as removing a
+// section another one, a symbol or a group still refers to.
+bool write_elf(elf_parser& parser, const std::string& source, const std::vector<elf_edit>& edits,
+		const std::string& output, parse_error& error, write_stats* stats=nullptr);
+
+
+} // end of namespace elf
+
+#endif
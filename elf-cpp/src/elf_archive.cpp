@@ -0,0 +1,300 @@
+#include "../inc/elf_archive.hpp"
+#include "../inc/elf_endian.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <filesystem>
+#include <thread>
+
+namespace elf {
+
+static constexpr char ar_magic[] = "!<arch>\n";
+
+
+// decimal or octal field of a member header, blank fields are 0
+static std::uint64_t header_number(byte_view header, std::size_t offset, std::size_t width, unsigned base) {
+
+	std::uint64_t value = 0;
+	std::size_t i = offset;
+	for (; i < offset + width && header[i] != ' '; i++) {
+		unsigned digit = header[i] - '0';
+		if (digit >= base) throw 2;
+		value = value * base + digit;
+	}
+	for (; i < offset + width; i++) {
+		if (header[i] != ' ') throw 2;
+	}
+	return value;
+}
+
+
+static std::string_view trim_name(std::string_view name) {
+
+	while (!name.empty() && (name.back() == ' ' || name.back() == '\0')) name.remove_suffix(1);
+	return name;
+}
+
+
+std::unique_ptr<archive_file> archive_file::open(const std::string& file, parse_error& error,
+						read_options options) {
+
+	error = parse_error();
+	try {
+		if (!std::filesystem::exists(file)) throw 0;
+		std::shared_ptr<file_buffer> buffer;
+		if (options.mode == load_mode::stream) {
+			buffer = file_buffer::stream_file(file);
+		} else if (options.mode == load_mode::map || options.lazy) {
+			buffer = file_buffer::map_file(file);
+		} else {
+			buffer = file_buffer::read_file(file);
+		}
+		return open(std::move(buffer), error, options);
+	}
+	catch (int e) {
+		error.code = static_cast<parse_errc>(e);
+	}
+	catch (const std::exception&) {
+		error.code = parse_errc::io_error;
+	}
+	error.message = parse_error_message(error.code);
+	return nullptr;
+}
+
+
+std::unique_ptr<archive_file> archive_file::open(std::shared_ptr<file_buffer> buffer, parse_error& error,
+						read_options options) {
+
+	error = parse_error();
+	try {
+		if (!is_archive(buffer->read(0, ar_magic_size))) throw 1;
+		std::unique_ptr<archive_file> archive(new archive_file(std::move(buffer), options));
+		archive->walk();
+		std::size_t count = archive->memberList.size();
+		archive->parsed = std::make_unique<std::once_flag[]>(count);
+		archive->parsers.resize(count);
+		archive->errors.resize(count);
+		return archive;
+	}
+	catch (int e) {
+		error.code = static_cast<parse_errc>(e);
+	}
+	catch (const std::exception&) {
+		// tables sized from a corrupt header
+		error.code = parse_errc::io_error;
+	}
+	error.message = parse_error_message(error.code);
+	return nullptr;
+}
+
+
+bool archive_file::is_archive(byte_view bytes) {
+
+	return bytes.size() >= ar_magic_size && std::memcmp(bytes.data(), ar_magic, ar_magic_size) == 0;
+}
+
+
+void archive_file::walk(void) {
+
+	const std::uint64_t end = buffer->size();
+	byte_view longNames;
+	byte_view table;
+	int width = 0;
+	for (std::uint64_t pos = ar_magic_size; pos < end; ) {
+		byte_view header = buffer->read(pos, ar_header_size);
+		if (header.empty()) throw 3;
+		if (header[58] != '`' || header[59] != '\n') throw 2;
+		std::uint64_t offset = pos + ar_header_size;
+		std::uint64_t size = header_number(header, 48, 10, 10);
+		if (size > end - offset) throw 3;
+		std::uint64_t next = offset + size + (size & 1);
+		std::string_view name = trim_name(std::string_view(reinterpret_cast<const char*>(header.data()), 16));
+
+		if (name == "/" || name == "/SYM64/") {
+			// a later one replaces an earlier, as ar -s would write it
+			table = buffer->read(offset, size);
+			width = name == "/" ? 4 : 8;
+		} else if (name == "//") {
+			longNames = buffer->read(offset, size);
+		} else {
+			archive_member member;
+			member.header = pos;
+			if (name.size() > 1 && name[0] == '/' && name[1] >= '0' && name[1] <= '9') {
+				// GNU long name, entries of "//" end with "/\n"
+				std::uint64_t at = header_number(header, 1, 15, 10);
+				if (at >= longNames.size()) throw 2;
+				const char* first = reinterpret_cast<const char*>(longNames.data()) + at;
+				const char* last = static_cast<const char*>(std::memchr(first, '\n', longNames.size() - at));
+				name = std::string_view(first, last ? last - first : longNames.size() - at);
+				if (!name.empty() && name.back() == '/') name.remove_suffix(1);
+			} else if (name.substr(0, 3) == "#1/") {
+				// BSD long name, stored at the start of the contents
+				std::uint64_t length = header_number(header, 3, 13, 10);
+				if (length > size) throw 2;
+				byte_view stored = buffer->read(offset, length);
+				name = trim_name(std::string_view(reinterpret_cast<const char*>(stored.data()), length));
+				offset += length;
+				size -= length;
+			} else if (!name.empty() && name.back() == '/') {
+				name.remove_suffix(1);
+			}
+			member.name = name;
+			member.offset = offset;
+			member.size = size;
+			member.mtime = header_number(header, 16, 12, 10);
+			member.uid = header_number(header, 28, 6, 10);
+			member.gid = header_number(header, 34, 6, 10);
+			member.mode = header_number(header, 40, 8, 8);
+			// the BSD ranlib index is in the byte order of whoever wrote it,
+			// the symbols of the members are indexed instead
+			if (name != "__.SYMDEF" && name != "__.SYMDEF SORTED") memberList.push_back(member);
+		}
+		pos = next;
+		// ar pads the last member to an even size, some writers don't
+		if (end - pos == 1) break;
+	}
+	if (width) {
+		if (table.size() < (std::size_t) width) throw 2;
+		std::uint64_t count = width == 4 ? load<4, !host_big_endian>(table.data())
+						: load<8, !host_big_endian>(table.data());
+		if (count > table.size() / width - 1) throw 3;
+		armapTable = table;
+		armapWidth = width;
+	}
+}
+
+
+// count, then as many member header offsets, then as many names, all big
+// endian. walk checked the offsets fit, names cut off by the end are dropped.
+void archive_file::read_armap(void) {
+
+	constexpr bool swap = !host_big_endian;
+	const int width = armapWidth;
+	auto word = [&](const std::uint8_t* ptr) -> std::uint64_t {
+		return width == 4 ? load<4, swap>(ptr) : load<8, swap>(ptr);
+	};
+	std::uint64_t count = word(armapTable.data());
+	const std::uint8_t* offsets = armapTable.data() + width;
+	const char* names = reinterpret_cast<const char*>(offsets + count * width);
+	const char* namesEnd = reinterpret_cast<const char*>(armapTable.end());
+
+	symbols.reserve(count);
+	std::size_t member = 0;
+	for (std::uint64_t i=0; i<count; i++) {
+		const char* end = static_cast<const char*>(std::memchr(names, '\0', namesEnd - names));
+		if (!end) break;
+		std::string_view name(names, end - names);
+		names = end + 1;
+		// entries come grouped by member in archive order, check the last
+		// one and the next before searching
+		std::uint64_t header = word(offsets + i * width);
+		if (member + 1 < memberList.size() && memberList[member + 1].header == header) {
+			member++;
+		} else if (member >= memberList.size() || memberList[member].header != header) {
+			auto it = std::lower_bound(memberList.begin(), memberList.end(), header,
+				[](const archive_member& m, std::uint64_t h) { return m.header < h; });
+			if (it == memberList.end() || it->header != header) continue;
+			member = it - memberList.begin();
+		}
+		symbols.try_emplace(name, member);
+	}
+}
+
+
+byte_view archive_file::member_bytes(std::size_t index) const {
+
+	if (index >= memberList.size()) return byte_view();
+	return buffer->read(memberList[index].offset, memberList[index].size);
+}
+
+
+std::size_t archive_file::find_member(std::string_view name) const {
+
+	for (std::size_t i=0; i<memberList.size(); i++) {
+		if (memberList[i].name == name) return i;
+	}
+	return npos;
+}
+
+
+// without an armap the index comes from the defined global symbols of every
+// member, as ar -s would have written it
+void archive_file::index_members(void) {
+
+	parse_members();
+	for (std::size_t i=0; i<parsers.size(); i++) {
+		if (!parsers[i]) continue;
+		const symbol_table &table = parsers[i]->symbols();
+		for (std::size_t row=1; row<table.size(); row++) {
+			symbol_table::symbol symbol = table[row];
+			if (symbol.shndx() == SHN_UNDEF || symbol.bind() == 0 || symbol.name().empty()) continue;
+			symbols.try_emplace(symbol.name(), i);
+		}
+	}
+}
+
+
+const std::unordered_map<std::string_view, std::size_t>& archive_file::symbol_index(void) {
+
+	std::call_once(indexed, [this] { armapWidth ? read_armap() : index_members(); });
+	return symbols;
+}
+
+
+std::size_t archive_file::find_symbol(std::string_view symbol) {
+
+	const std::unordered_map<std::string_view, std::size_t> &index = symbol_index();
+	auto it = index.find(symbol);
+	return it == index.end() ? npos : it->second;
+}
+
+
+elf_parser* archive_file::member(std::size_t index, parse_error* error) {
+
+	if (index >= memberList.size()) {
+		if (error) {
+			error->code = parse_errc::file_not_found;
+			error->message = parse_error_message(error->code);
+		}
+		return nullptr;
+	}
+	std::call_once(parsed[index], [&] {
+		const archive_member &m = memberList[index];
+		parsers[index] = elf_parser::open(std::make_shared<slice_buffer>(buffer, m.offset, m.size),
+							errors[index], options);
+	});
+	if (error) *error = errors[index];
+	return parsers[index].get();
+}
+
+
+elf_parser* archive_file::defining_member(std::string_view symbol) {
+
+	std::size_t index = find_symbol(symbol);
+	return index == npos ? nullptr : member(index);
+}
+
+
+std::size_t archive_file::parse_members(const std::vector<std::size_t>& indexes, unsigned threads) {
+
+	std::size_t count = indexes.empty() ? memberList.size() : indexes.size();
+	auto at = [&](std::size_t k) { return indexes.empty() ? k : indexes[k]; };
+	std::atomic<std::size_t> next(0);
+	std::atomic<std::size_t> done(0);
+	auto work = [&]() {
+		for (std::size_t k; (k = next.fetch_add(1, std::memory_order_relaxed)) < count; ) {
+			if (member(at(k))) done.fetch_add(1, std::memory_order_relaxed);
+		}
+	};
+	if (threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
+	threads = std::min<std::size_t>(threads, count);
+	std::vector<std::thread> workers;
+	for (unsigned t=1; t<threads; t++) workers.emplace_back(work);
+	work();
+	for (std::thread &worker : workers) worker.join();
+	return done;
+}
+
+
+} // end of namespace elf
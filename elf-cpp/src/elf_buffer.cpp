@@ -0,0 +1,298 @@
+#include "../inc/elf_buffer.hpp"
+#include "../inc/elf_stats.hpp"
+
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+
+namespace elf {
+
+
+// multiply and fold over four independent lanes of words so the multiplies
+// overlap
+std::uint64_t checksum(const std::uint8_t* ptr, std::size_t size) {
+
+	constexpr std::uint64_t prime = 0xFF51AFD7ED558CCDull;
+	std::uint64_t lanes[4] = {0x9E3779B97F4A7C15ull ^ size, 1, 2, 3};
+	std::size_t i = 0;
+	for (; i+32<=size; i+=32) {
+		for (int j=0; j<4; j++) {
+			std::uint64_t word;
+			std::memcpy(&word, ptr+i+8*j, 8);
+			lanes[j] = (lanes[j] ^ word) * prime;
+			lanes[j] ^= lanes[j] >> 32;
+		}
+	}
+	std::uint64_t hash = lanes[0];
+	for (int j=1; j<4; j++) hash = (hash ^ lanes[j]) * prime;
+	for (; i<size; i++) hash = (hash ^ ptr[i]) * 0x100000001B3ull;
+	return hash ^ (hash >> 29);
+}
+
+
+std::shared_ptr<file_buffer> file_buffer::map_file(const std::string& file) {
+
+	return std::make_shared<mmap_buffer>(file);
+}
+
+
+std::shared_ptr<file_buffer> file_buffer::read_file(const std::string& file) {
+
+	stat_timer timer(stat_phase::io);
+	std::ifstream fileIt(file, std::ios::binary | std::ios::ate);
+	if (!fileIt) {
+		throw 4;
+	}
+	std::vector<std::uint8_t> bytes(static_cast<std::size_t>(fileIt.tellg()));
+	fileIt.seekg(0);
+	fileIt.read(reinterpret_cast<char*>(bytes.data()), bytes.size());
+	fileIt.close();
+	stat_add(stat_counter::bytes_read, bytes.size());
+	stat_add(stat_counter::allocations);
+	return from_vector(std::move(bytes));
+}
+
+
+std::shared_ptr<file_buffer> file_buffer::from_vector(std::vector<std::uint8_t> bytes) {
+
+	return std::make_shared<vector_buffer>(std::move(bytes));
+}
+
+
+std::shared_ptr<file_buffer> file_buffer::stream_file(const std::string& file) {
+
+	return std::make_shared<stream_buffer>(file);
+}
+
+
+std::shared_ptr<file_buffer> file_buffer::stream_fd(int fd) {
+
+	return std::make_shared<stream_buffer>(fd);
+}
+
+
+byte_view vector_buffer::read(std::uint64_t offset, std::uint64_t size) const {
+
+	return byte_view(bytes.data(), bytes.size()).subview(offset, size);
+}
+
+
+mmap_buffer::mmap_buffer(const std::string& file) {
+
+	int fd = open(file.c_str(), O_RDONLY | O_CLOEXEC);
+	if (fd < 0) {
+		throw 4;
+	}
+	try {
+		map(fd);
+	}
+	catch (int) {
+		close(fd);
+		throw;
+	}
+	// the mapping keeps the file referenced
+	close(fd);
+}
+
+
+mmap_buffer::mmap_buffer(int fd) {
+
+	map(fd);
+}
+
+
+void mmap_buffer::map(int fd) {
+
+	stat_timer timer(stat_phase::io);
+	struct stat st;
+	if (fstat(fd, &st) != 0) {
+		throw 4;
+	}
+	length = st.st_size;
+	// zero length mappings are invalid, an empty file is just an empty view
+	if (length > 0) {
+		void* addr = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (addr == MAP_FAILED) {
+			throw 4;
+		}
+		base = static_cast<const std::uint8_t*>(addr);
+		stat_add(stat_counter::bytes_mapped, length);
+	}
+}
+
+
+mmap_buffer::~mmap_buffer() {
+
+	if (base) munmap(const_cast<std::uint8_t*>(base), length);
+}
+
+
+byte_view mmap_buffer::read(std::uint64_t offset, std::uint64_t size) const {
+
+	return byte_view(base, length).subview(offset, size);
+}
+
+
+stream_buffer::stream_buffer(const std::string& file) : owned(true) {
+
+	fd = open(file.c_str(), O_RDONLY | O_CLOEXEC);
+	if (fd < 0) {
+		throw 4;
+	}
+	init();
+}
+
+
+stream_buffer::stream_buffer(int fd) : fd(fd), owned(false) {
+
+	init();
+}
+
+
+void stream_buffer::init(void) {
+
+	struct stat st;
+	if (fstat(fd, &st) != 0) {
+		if (owned) close(fd);
+		throw 4;
+	}
+	seekable = S_ISREG(st.st_mode) || S_ISBLK(st.st_mode);
+	if (seekable) {
+		off_t end = lseek(fd, 0, SEEK_END);
+		seekable = end >= 0;
+		length = seekable ? end : 0;
+	}
+}
+
+
+stream_buffer::~stream_buffer() {
+
+	if (owned) close(fd);
+}
+
+
+std::uint64_t stream_buffer::size(void) const {
+
+	std::lock_guard<std::mutex> guard(lock);
+	return length;
+}
+
+
+std::uint64_t stream_buffer::bytes_read(void) const {
+
+	std::lock_guard<std::mutex> guard(lock);
+	return fetched;
+}
+
+
+// reads until size bytes are in or the input ends, returns the count read
+std::uint64_t stream_buffer::fill(std::uint8_t* dst, std::uint64_t size, std::uint64_t offset) const {
+
+	stat_timer timer(stat_phase::io);
+	// every fill goes into a block or span of its own
+	stat_add(stat_counter::allocations);
+	std::uint64_t done = 0;
+	while (done < size) {
+		ssize_t count = seekable ? pread(fd, dst + done, size - done, offset + done)
+						: ::read(fd, dst + done, size - done);
+		if (count < 0 && errno == EINTR) continue;
+		if (count <= 0) break;
+		done += count;
+	}
+	fetched += done;
+	stat_add(stat_counter::bytes_read, done);
+	return done;
+}
+
+
+const std::vector<std::uint8_t>* stream_buffer::block(std::uint64_t index) const {
+
+	auto it = blocks.find(index);
+	if (it != blocks.end()) {
+		return &it->second;
+	}
+	if (seekable) {
+		if (index * block_size >= length) return nullptr;
+		std::vector<std::uint8_t> bytes(std::min(block_size, length - index * block_size));
+		bytes.resize(fill(bytes.data(), bytes.size(), index * block_size));
+		return &blocks.emplace(index, std::move(bytes)).first->second;
+	}
+	// forward only, every block before this one is read and kept on the way
+	while (streamed <= index && !ended) {
+		std::vector<std::uint8_t> bytes(block_size);
+		bytes.resize(fill(bytes.data(), bytes.size(), 0));
+		ended = bytes.size() < block_size;
+		length += bytes.size();
+		blocks.emplace(streamed++, std::move(bytes));
+	}
+	it = blocks.find(index);
+	return it != blocks.end() ? &it->second : nullptr;
+}
+
+
+byte_view stream_buffer::read(std::uint64_t offset, std::uint64_t size) const {
+
+	if (size == 0 || offset + size < offset) return byte_view();
+	std::lock_guard<std::mutex> guard(lock);
+	std::uint64_t first = offset / block_size;
+	std::uint64_t last = (offset + size - 1) / block_size;
+	if (first == last) {
+		const std::vector<std::uint8_t>* bytes = block(first);
+		if (!bytes) return byte_view();
+		return byte_view(bytes->data(), bytes->size()).subview(offset - first * block_size, size);
+	}
+
+	auto it = spans.find({offset, size});
+	if (it != spans.end()) {
+		return byte_view(it->second.data(), it->second.size());
+	}
+	std::vector<std::uint8_t> bytes;
+	if (seekable) {
+		if (offset > length || size > length - offset) return byte_view();
+		bytes.resize(size);
+		if (fill(bytes.data(), size, offset) < size) return byte_view();
+	} else {
+		// the blocks are kept anyway, copy them out into one range
+		if (!block(last) || blocks[last].size() < offset + size - last * block_size) {
+			return byte_view();
+		}
+		stat_add(stat_counter::allocations);
+		bytes.reserve(size);
+		for (std::uint64_t i=first; i<=last; i++) {
+			byte_view part = byte_view(blocks[i].data(), blocks[i].size());
+			std::uint64_t from = i == first ? offset - first * block_size : 0;
+			std::uint64_t to = i == last ? offset + size - last * block_size : part.size();
+			bytes.insert(bytes.end(), part.begin() + from, part.begin() + to);
+		}
+	}
+	it = spans.emplace(std::make_pair(offset, size), std::move(bytes)).first;
+	return byte_view(it->second.data(), it->second.size());
+}
+
+
+byte_view deferred_buffer::read(std::uint64_t offset, std::uint64_t size) const {
+
+	std::call_once(opened, [this] {
+		try {
+			target = open();
+		}
+		catch (...) {
+			target = from_vector(std::vector<std::uint8_t>());
+		}
+	});
+	return target->read(offset, size);
+}
+
+
+byte_view slice_buffer::read(std::uint64_t offset, std::uint64_t size) const {
+
+	if (offset > length || size > length - offset) return byte_view();
+	return parent->read(start + offset, size);
+}
+
+} // end of namespace elf
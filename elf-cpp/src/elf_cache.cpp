@@ -0,0 +1,627 @@
+#include "../inc/elf_cache.hpp"
+#include "../inc/elf_notes.hpp"
+#include "../inc/elf_stats.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+
+namespace elf {
+
+// Entry layout, every value in the byte order of the host that wrote it and
+// every part starting 8 byte aligned:
+//   entry_header_t
+//   e_ident padded to 16 bytes, the other 13 header fields as u64
+//   u64 section count, segment count, map length, names length
+//   section_record_t and segment_record_t arrays
+//   section to segment map as u32, section names
+//   u64 length and symbol block for .symtab, then the same for .dynsym, a
+//   length of 0 means the table isn't cached
+// The header checksum covers everything before the symbol blocks, so a hit
+// that only needs the tables doesn't read the symbols. A symbol block has its
+// own checksum, then u64 count and string table index, then the value, size,
+// section index, name offset, info and other columns.
+
+constexpr char entry_magic[8] = {'E', 'L', 'F', 'M', 'E', 'T', 'A', 0};
+constexpr std::uint32_t entry_version = 1;
+constexpr std::size_t symbol_row_size = 8 + 8 + 4 + 4 + 1 + 1;
+// entries up to this size are read rather than mapped
+constexpr std::size_t small_entry = 64 << 10;
+// hits on entries older than this refresh their mtime for eviction, more
+// recent ones are left alone so a hit stays read-only
+constexpr std::time_t touch_interval = 3600;
+
+typedef struct entry_header_t {
+	char magic[8];
+	std::uint32_t version;
+	std::uint8_t elf_class;
+	std::uint8_t big_endian;
+	std::uint16_t reserved;
+	std::uint64_t file_size;
+	std::uint64_t payload_size;
+	std::uint64_t tables_size;	// payload before the symbol blocks
+	std::uint64_t checksum;		// of those tables
+} entry_header_t;
+
+typedef struct section_record_t {
+	std::uint64_t fields[10];	// sh_name to sh_entsize
+	std::uint32_t name_offset;
+	std::uint32_t name_length;
+	std::uint32_t indexed;
+	std::uint32_t reserved;
+} section_record_t;
+
+typedef struct segment_record_t {
+	std::uint64_t fields[8];	// p_type to p_align in 32-bit order
+	std::uint32_t first;
+	std::uint32_t count;
+} segment_record_t;
+
+
+static std::string hex(std::uint64_t value) {
+
+	char text[17];
+	std::snprintf(text, sizeof(text), "%llx", (unsigned long long) value);
+	return text;
+}
+
+
+std::string file_key::name(void) const {
+
+	return "s-" + hex(device) + "-" + hex(inode) + "-" + hex(size) + "-" + hex(mtime);
+}
+
+
+class entry_writer {
+
+	public:
+		entry_writer(std::vector<std::uint8_t>& out) : out(out) {}
+		template <typename T> void put(T value) { put_bytes(&value, sizeof(T)); }
+		void put_bytes(const void* data, std::size_t size) {
+			const std::uint8_t* ptr = static_cast<const std::uint8_t*>(data);
+			out.insert(out.end(), ptr, ptr + size);
+		}
+		void align(void) { out.resize((out.size() + 7) & ~(std::size_t) 7); }
+
+	private:
+		std::vector<std::uint8_t>& out;
+};
+
+
+// bounds checked cursor, any read past the end clears good()
+class entry_reader {
+
+	public:
+		entry_reader(byte_view bytes) : bytes(bytes) {}
+		template <typename T> T get(void) {
+			T value {};
+			byte_view field = get_bytes(sizeof(T));
+			if (ok) std::memcpy(&value, field.data(), sizeof(T));
+			return value;
+		}
+		byte_view get_bytes(std::uint64_t size) {
+			if (size > bytes.size() - pos) {
+				ok = false;
+				pos = bytes.size();
+				return byte_view();
+			}
+			byte_view field(bytes.data() + pos, size);
+			pos += size;
+			return field;
+		}
+		// checked before sizing anything from a count
+		bool fits(std::uint64_t count, std::uint64_t size) {
+			if (count > (bytes.size() - pos) / size) ok = false;
+			return ok;
+		}
+		void align(void) { pos = std::min<std::uint64_t>(bytes.size(), (pos + 7) & ~(std::uint64_t) 7); }
+		bool good(void) const { return ok; }
+
+	private:
+		byte_view bytes;
+		std::uint64_t pos = 0;
+		bool ok = true;
+};
+
+
+template <typename elf_class>
+static std::string build_id(elf_class_parser<elf_class>& parser) {
+
+	note_info info;
+	bool bigEndian = parser.elf_header().e_ident[EI_DATA_offset] == 2;
+	for (auto* section : parser.sections_of_type(0x07)) {
+		decode_notes(section->data, elf_class::elf_class == 2, bigEndian, section->sh_addralign, info);
+		if (!info.build_id.empty()) break;
+	}
+	return info.build_id;
+}
+
+
+metadata_cache::metadata_cache(std::string directory, std::uint64_t maxBytes)
+		: dir(std::move(directory)), maxBytes(maxBytes) {
+
+	std::error_code error;
+	std::filesystem::create_directories(dir, error);
+	std::uint64_t used = 0;
+	for (const auto& entry : std::filesystem::directory_iterator(dir, error)) {
+		std::error_code status;
+		if (entry.is_regular_file(status)) used += entry.file_size(status);
+	}
+	usedBytes = used;
+}
+
+
+std::unique_ptr<elf_parser> metadata_cache::load(const std::string& file, const read_options& options,
+							file_key& key) {
+
+	key = file_key();
+	struct stat st;
+	if (stat(file.c_str(), &st) != 0 || !S_ISREG(st.st_mode)) {
+		return nullptr;
+	}
+	key.device = st.st_dev;
+	key.inode = st.st_ino;
+	key.size = st.st_size;
+	key.mtime = (std::uint64_t) st.st_mtim.tv_sec * 1000000000 + st.st_mtim.tv_nsec;
+	key.valid = true;
+
+	std::string path = dir + "/" + key.name();
+	int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+	if (fd < 0) {
+		missCount++;
+		stat_add(stat_counter::cache_misses);
+		return nullptr;
+	}
+	std::shared_ptr<file_buffer> entry;
+	struct stat entrySt;
+	if (fstat(fd, &entrySt) == 0) {
+		if (entrySt.st_size <= (off_t) small_entry) {
+			// setting up and tearing down a mapping costs more than copying this much
+			std::vector<std::uint8_t> bytes(entrySt.st_size);
+			if (pread(fd, bytes.data(), bytes.size(), 0) == (ssize_t) bytes.size()) {
+				entry = file_buffer::from_vector(std::move(bytes));
+			}
+		} else {
+			try {
+				entry = std::make_shared<mmap_buffer>(fd);
+			}
+			catch (int) {}
+		}
+		if (std::time(nullptr) - entrySt.st_mtime > touch_interval) futimens(fd, nullptr);
+	}
+	close(fd);
+
+	std::unique_ptr<elf_parser> parser;
+	byte_view bytes = entry ? entry->read(0, entry->size()) : byte_view();
+	entry_header_t header;
+	if (bytes.size() >= sizeof(header)) {
+		std::memcpy(&header, bytes.data(), sizeof(header));
+		byte_view payload = bytes.subview(sizeof(header), bytes.size() - sizeof(header));
+		if (std::memcmp(header.magic, entry_magic, sizeof(entry_magic)) == 0
+				&& header.version == entry_version
+				&& header.big_endian == host_big_endian
+				&& header.file_size == key.size
+				&& header.payload_size == payload.size()
+				&& header.tables_size <= payload.size()
+				&& header.checksum == checksum(payload.data(), header.tables_size)) {
+			// the file is only opened once something needs its contents
+			load_mode mode = options.mode;
+			bool lazy = options.lazy;
+			auto buffer = std::make_shared<deferred_buffer>([file, mode, lazy] {
+				if (mode == load_mode::stream) return file_buffer::stream_file(file);
+				return mode == load_mode::map || lazy ?
+						file_buffer::map_file(file) : file_buffer::read_file(file);
+			}, key.size);
+			if (header.elf_class == elf32_traits::elf_class) {
+				parser = decode<elf32_traits>(payload, entry, buffer, options);
+			} else if (header.elf_class == elf64_traits::elf_class) {
+				parser = decode<elf64_traits>(payload, entry, buffer, options);
+			}
+		}
+	}
+	if (!parser) {
+		// damaged or from another version, drop it along with a linked entry
+		std::error_code error;
+		if (std::filesystem::is_symlink(path, error)) {
+			std::filesystem::remove(dir + "/" + std::filesystem::read_symlink(path, error).string(), error);
+		}
+		std::filesystem::remove(path, error);
+		missCount++;
+		stat_add(stat_counter::cache_misses);
+		return nullptr;
+	}
+	hitCount++;
+	stat_add(stat_counter::cache_hits);
+	stat_add(stat_counter::files_parsed);
+	return parser;
+}
+
+
+void metadata_cache::store(const file_key& key, elf_parser& parser) {
+
+	if (!key.valid) {
+		return;
+	}
+	std::vector<std::uint8_t> bytes(sizeof(entry_header_t));
+	entry_header_t header {};
+	std::string buildId;
+	if (auto parser32 = dynamic_cast<elf_32_parser*>(&parser)) {
+		header.tables_size = encode(*parser32, bytes);
+		buildId = build_id(*parser32);
+		header.elf_class = elf32_traits::elf_class;
+	} else if (auto parser64 = dynamic_cast<elf_64_parser*>(&parser)) {
+		header.tables_size = encode(*parser64, bytes);
+		buildId = build_id(*parser64);
+		header.elf_class = elf64_traits::elf_class;
+	} else {
+		return;
+	}
+	std::memcpy(header.magic, entry_magic, sizeof(entry_magic));
+	header.version = entry_version;
+	header.big_endian = host_big_endian;
+	header.file_size = key.size;
+	header.payload_size = bytes.size() - sizeof(header);
+	header.checksum = checksum(bytes.data() + sizeof(header), header.tables_size);
+	std::memcpy(bytes.data(), &header, sizeof(header));
+
+	std::string link = dir + "/" + key.name();
+	if (buildId.empty()) {
+		if (!write_file(link, bytes)) return;
+	} else {
+		// copies packaged or stripped differently keep the build-id, so
+		// only files whose tables came out identical share an entry
+		std::string target = "b-" + buildId + "-" + hex(key.size) + "-"
+					+ hex(checksum(bytes.data() + sizeof(header), header.payload_size));
+		std::error_code error;
+		if (!std::filesystem::exists(dir + "/" + target, error)) {
+			if (!write_file(dir + "/" + target, bytes)) return;
+		}
+		std::string temp = temp_path();
+		std::filesystem::create_symlink(target, temp, error);
+		if (error || std::rename(temp.c_str(), link.c_str()) != 0) {
+			std::filesystem::remove(temp, error);
+			return;
+		}
+	}
+	usedBytes += bytes.size();
+	if (usedBytes > maxBytes) evict();
+}
+
+
+void metadata_cache::invalidate(const std::string& file) {
+
+	struct stat st;
+	if (stat(file.c_str(), &st) != 0) {
+		return;
+	}
+	file_key key;
+	key.device = st.st_dev;
+	key.inode = st.st_ino;
+	key.size = st.st_size;
+	key.mtime = (std::uint64_t) st.st_mtim.tv_sec * 1000000000 + st.st_mtim.tv_nsec;
+	std::error_code error;
+	std::filesystem::remove(dir + "/" + key.name(), error);
+}
+
+
+void metadata_cache::clear(void) {
+
+	std::lock_guard<std::mutex> guard(evictLock);
+	std::error_code error;
+	std::vector<std::filesystem::path> paths;
+	for (const auto& entry : std::filesystem::directory_iterator(dir, error)) {
+		std::string name = entry.path().filename().string();
+		if (name.rfind("s-", 0) == 0 || name.rfind("b-", 0) == 0 || name.rfind("tmp-", 0) == 0) {
+			paths.push_back(entry.path());
+		}
+	}
+	for (const auto& path : paths) std::filesystem::remove(path, error);
+	usedBytes = 0;
+}
+
+
+bool metadata_cache::write_file(const std::string& path, const std::vector<std::uint8_t>& bytes) {
+
+	// written aside and renamed so readers never see a partial entry
+	std::string temp = temp_path();
+	std::ofstream out(temp, std::ios::binary | std::ios::trunc);
+	out.write(reinterpret_cast<const char*>(bytes.data()), bytes.size());
+	out.close();
+	if (!out || std::rename(temp.c_str(), path.c_str()) != 0) {
+		std::remove(temp.c_str());
+		return false;
+	}
+	return true;
+}
+
+
+std::string metadata_cache::temp_path(void) {
+
+	return dir + "/tmp-" + std::to_string(getpid()) + "-" + std::to_string(tempCount++);
+}
+
+
+void metadata_cache::evict(void) {
+
+	// one thread evicting is enough, the others carry on
+	std::unique_lock<std::mutex> guard(evictLock, std::try_to_lock);
+	if (!guard.owns_lock()) {
+		return;
+	}
+	typedef struct entry_t {
+		std::filesystem::file_time_type mtime;
+		std::uint64_t size;
+		std::filesystem::path path;
+	} entry_t;
+	std::vector<entry_t> entries;
+	std::vector<std::filesystem::path> links;
+	std::uint64_t used = 0;
+	auto now = std::filesystem::file_time_type::clock::now();
+	std::error_code error;
+	for (const auto& entry : std::filesystem::directory_iterator(dir, error)) {
+		std::error_code status;
+		std::string name = entry.path().filename().string();
+		if (entry.is_symlink(status)) {
+			links.push_back(entry.path());
+		} else if (entry.is_regular_file(status)) {
+			entry_t item {entry.last_write_time(status), entry.file_size(status), entry.path()};
+			// temporaries left behind by a process that died mid write
+			if (name.rfind("tmp-", 0) == 0) {
+				if (now - item.mtime > std::chrono::seconds(touch_interval)) {
+					std::filesystem::remove(item.path, status);
+				}
+				continue;
+			}
+			used += item.size;
+			entries.push_back(item);
+		}
+	}
+
+	// oldest first down to 3/4 of the limit, so eviction doesn't run on
+	// every store once the cache is full
+	std::sort(entries.begin(), entries.end(), [](const entry_t& a, const entry_t& b) {
+		return a.mtime < b.mtime;
+	});
+	for (const entry_t& entry : entries) {
+		if (used <= maxBytes / 4 * 3) break;
+		if (std::filesystem::remove(entry.path, error)) used -= entry.size;
+	}
+	for (const auto& link : links) {
+		if (!std::filesystem::exists(link, error)) std::filesystem::remove(link, error);
+	}
+	usedBytes = used;
+}
+
+
+template <typename elf_class>
+std::uint64_t metadata_cache::encode(elf_class_parser<elf_class>& parser, std::vector<std::uint8_t>& out) {
+
+	entry_writer writer(out);
+	const auto& header = parser.elfHeader;
+	std::uint8_t ident[16] = {};
+	std::copy(header.e_ident.begin(), header.e_ident.end(), ident);
+	writer.put_bytes(ident, sizeof(ident));
+	std::uint64_t fields[] = {header.e_type, header.e_machine, header.e_version, header.e_entry,
+				header.e_phoff, header.e_shoff, header.e_flags, header.e_ehsize,
+				header.e_phentsize, header.e_phnum, header.e_shentsize,
+				header.e_shnum, header.e_shstrndx};
+	for (std::uint64_t field : fields) writer.put(field);
+
+	std::string names;
+	std::uint64_t mapLength = 0;
+	for (const auto& segment : parser.programHeaderTable) mapLength += segment.sectionMapIndexes.size();
+	for (const auto& section : parser.sectionHeaderTable) names += section.name;
+	writer.put<std::uint64_t>(parser.sectionHeaderTable.size());
+	writer.put<std::uint64_t>(parser.programHeaderTable.size());
+	writer.put<std::uint64_t>(mapLength);
+	writer.put<std::uint64_t>(names.size());
+
+	std::uint32_t nameOffset = 0;
+	for (std::size_t i=0; i<parser.sectionHeaderTable.size(); i++) {
+		const auto& section = parser.sectionHeaderTable[i];
+		// repeated names stay with the first section, as in the parser
+		auto it = parser.sectionIndex.find(section.name);
+		section_record_t record = {{section.sh_name, section.sh_type, section.sh_flags,
+					section.sh_addr, section.sh_offset, section.sh_size,
+					section.sh_link, section.sh_info, section.sh_addralign,
+					section.sh_entsize},
+					nameOffset, (std::uint32_t) section.name.size(),
+					it != parser.sectionIndex.end() && it->second == i, 0};
+		writer.put(record);
+		nameOffset += section.name.size();
+	}
+	std::uint32_t first = 0;
+	for (const auto& segment : parser.programHeaderTable) {
+		segment_record_t record = {{segment.p_type, segment.p_offset, segment.p_vaddr,
+					segment.p_paddr, segment.p_filesz, segment.p_memsz,
+					segment.p_flags, segment.p_align},
+					first, (std::uint32_t) segment.sectionMapIndexes.size()};
+		writer.put(record);
+		first += segment.sectionMapIndexes.size();
+	}
+	for (const auto& segment : parser.programHeaderTable) {
+		for (int index : segment.sectionMapIndexes) writer.put<std::uint32_t>(index);
+	}
+	writer.align();
+	writer.put_bytes(names.data(), names.size());
+	writer.align();
+	std::uint64_t tablesSize = out.size() - sizeof(entry_header_t);
+
+	for (std::uint32_t type : {0x02u, 0x0Bu}) {
+		std::vector<typename elf_class::section_t*> tables = parser.sections_of_type(type);
+		if (tables.empty()) {
+			writer.put<std::uint64_t>(0);
+			continue;
+		}
+		const symbol_table& table = type == 0x02 ? parser.symbols() : parser.dynamic_symbols();
+		std::size_t count = table.size();
+		std::uint64_t length = 24 + count * symbol_row_size;
+		writer.put<std::uint64_t>((length + 7) & ~(std::uint64_t) 7);
+		std::size_t start = out.size();
+		writer.put<std::uint64_t>(0);
+		writer.put<std::uint64_t>(count);
+		writer.put<std::uint64_t>(tables[0]->sh_link);
+		writer.put_bytes(table.symValue.data(), count * 8);
+		writer.put_bytes(table.symSize.data(), count * 8);
+		writer.put_bytes(table.symShndx.data(), count * 4);
+		writer.put_bytes(table.symName.data(), count * 4);
+		writer.put_bytes(table.symInfo.data(), count);
+		writer.put_bytes(table.symOther.data(), count);
+		std::uint64_t sum = checksum(out.data() + start + 8, length - 8);
+		std::memcpy(out.data() + start, &sum, 8);
+		writer.align();
+	}
+	return tablesSize;
+}
+
+
+template <typename elf_class>
+std::unique_ptr<elf_parser> metadata_cache::decode(byte_view payload, std::shared_ptr<file_buffer> entry,
+							std::shared_ptr<file_buffer> file, const read_options& options) {
+
+	typedef typename elf_class::section_t section_t;
+	entry_reader reader(payload);
+	std::unique_ptr<elf_class_parser<elf_class>> parser(new elf_class_parser<elf_class>());
+	parser->buffer = file;
+	parser->options = options;
+	parser->cacheEntry = entry;
+
+	auto& header = parser->elfHeader;
+	byte_view ident = reader.get_bytes(16);
+	if (!reader.good()) return nullptr;
+	header.e_ident.assign(ident.begin(), ident.begin() + 10);
+	header.e_type = reader.get<std::uint64_t>();
+	header.e_machine = reader.get<std::uint64_t>();
+	header.e_version = reader.get<std::uint64_t>();
+	header.e_entry = reader.get<std::uint64_t>();
+	header.e_phoff = reader.get<std::uint64_t>();
+	header.e_shoff = reader.get<std::uint64_t>();
+	header.e_flags = reader.get<std::uint64_t>();
+	header.e_ehsize = reader.get<std::uint64_t>();
+	header.e_phentsize = reader.get<std::uint64_t>();
+	header.e_phnum = reader.get<std::uint64_t>();
+	header.e_shentsize = reader.get<std::uint64_t>();
+	header.e_shnum = reader.get<std::uint64_t>();
+	header.e_shstrndx = reader.get<std::uint64_t>();
+	std::uint64_t shnum = reader.get<std::uint64_t>();
+	std::uint64_t phnum = reader.get<std::uint64_t>();
+	std::uint64_t mapLength = reader.get<std::uint64_t>();
+	std::uint64_t namesLength = reader.get<std::uint64_t>();
+
+	if (!reader.fits(shnum, sizeof(section_record_t))) return nullptr;
+	byte_view sections = reader.get_bytes(shnum * sizeof(section_record_t));
+	if (!reader.fits(phnum, sizeof(segment_record_t))) return nullptr;
+	byte_view segments = reader.get_bytes(phnum * sizeof(segment_record_t));
+	if (!reader.fits(mapLength, 4)) return nullptr;
+	byte_view map = reader.get_bytes(mapLength * 4);
+	reader.align();
+	byte_view names = reader.get_bytes(namesLength);
+	reader.align();
+	if (!reader.good()) return nullptr;
+
+	// keys point into the entry buffer, which the parser keeps alive
+	parser->sectionHeaderTable.resize(shnum);
+	parser->sectionIndex.reserve(shnum);
+	for (std::size_t i=0; i<shnum; i++) {
+		section_record_t record;
+		std::memcpy(&record, sections.data() + i * sizeof(record), sizeof(record));
+		section_t& section = parser->sectionHeaderTable[i];
+		section.sh_name = record.fields[0];
+		section.sh_type = record.fields[1];
+		section.sh_flags = record.fields[2];
+		section.sh_addr = record.fields[3];
+		section.sh_offset = record.fields[4];
+		section.sh_size = record.fields[5];
+		section.sh_link = record.fields[6];
+		section.sh_info = record.fields[7];
+		section.sh_addralign = record.fields[8];
+		section.sh_entsize = record.fields[9];
+		if ((std::uint64_t) record.name_offset + record.name_length > names.size()) return nullptr;
+		std::string_view name(reinterpret_cast<const char*>(names.data()) + record.name_offset,
+					record.name_length);
+		section.name = std::string(name);
+		if (record.indexed) parser->sectionIndex.emplace(name, i);
+	}
+	parser->programHeaderTable.resize(phnum);
+	for (std::size_t i=0; i<phnum; i++) {
+		segment_record_t record;
+		std::memcpy(&record, segments.data() + i * sizeof(record), sizeof(record));
+		auto& segment = parser->programHeaderTable[i];
+		segment.p_type = record.fields[0];
+		segment.p_offset = record.fields[1];
+		segment.p_vaddr = record.fields[2];
+		segment.p_paddr = record.fields[3];
+		segment.p_filesz = record.fields[4];
+		segment.p_memsz = record.fields[5];
+		segment.p_flags = record.fields[6];
+		segment.p_align = record.fields[7];
+		if ((std::uint64_t) record.first + record.count > mapLength) return nullptr;
+		segment.sectionMapIndexes.resize(record.count);
+		for (std::size_t j=0; j<record.count; j++) {
+			std::uint32_t index;
+			std::memcpy(&index, map.data() + 4 * (record.first + j), 4);
+			if (index >= shnum) return nullptr;
+			segment.sectionMapIndexes[j] = index;
+		}
+	}
+
+	for (byte_view* cached : {&parser->cachedSymbols, &parser->cachedDynamicSymbols}) {
+		std::uint64_t length = reader.get<std::uint64_t>();
+		byte_view block = reader.get_bytes(length);
+		if (!reader.good()) return nullptr;
+		if (length == 0) continue;
+		entry_reader symbols(block);
+		symbols.get<std::uint64_t>();
+		std::uint64_t count = symbols.get<std::uint64_t>();
+		symbols.get<std::uint64_t>();
+		if (!symbols.fits(count, symbol_row_size)) return nullptr;
+		*cached = block;
+	}
+
+	if (!options.lazy) {
+		for (section_t& section : parser->sectionHeaderTable) parser->load_section(section);
+	}
+	return parser;
+}
+
+
+template <typename elf_class>
+std::optional<symbol_table> metadata_cache::decode_symbols(byte_view block, elf_class_parser<elf_class>& parser) {
+
+	// sizes were checked when the entry was loaded, the contents are checked here
+	entry_reader reader(block);
+	std::uint64_t sum = reader.get<std::uint64_t>();
+	std::uint64_t count = reader.get<std::uint64_t>();
+	if (sum != checksum(block.data() + 8, 16 + count * symbol_row_size)) {
+		return std::nullopt;
+	}
+	std::uint64_t link = reader.get<std::uint64_t>();
+	symbol_table table;
+	auto column = [&reader, count](auto& values) {
+		byte_view bytes = reader.get_bytes(count * sizeof(values[0]));
+		values.resize(count);
+		if (count) std::memcpy(values.data(), bytes.data(), bytes.size());
+	};
+	column(table.symValue);
+	column(table.symSize);
+	column(table.symShndx);
+	column(table.symName);
+	column(table.symInfo);
+	column(table.symOther);
+	table.strtab = link < parser.sectionHeaderTable.size() ? parser.section_at(link).data : byte_view();
+	return table;
+}
+
+
+template std::optional<symbol_table> metadata_cache::decode_symbols<elf32_traits>(byte_view,
+								elf_class_parser<elf32_traits>&);
+template std::optional<symbol_table> metadata_cache::decode_symbols<elf64_traits>(byte_view,
+								elf_class_parser<elf64_traits>&);
+
+} // end of namespace elf
@@ -0,0 +1,229 @@
+#include "../inc/elf_compress.hpp"
+#include "../inc/elf_endian.hpp"
+#include "../inc/elf_stats.hpp"
+
+#include <atomic>
+#include <limits>
+#include <thread>
+#include <zlib.h>
+#ifdef ELF_ZSTD
+#include <zstd.h>
+#endif
+
+
+namespace elf {
+
+
+template <bool swap>
+static void decode_header(const std::uint8_t* ptr, bool is64, compression_header& header) {
+
+	header.type = load<4, swap>(ptr);
+	if (is64) {
+		// ch_reserved follows ch_type
+		header.size =		load<8, swap>(ptr + 8);
+		header.addralign =	load<8, swap>(ptr + 16);
+		header.payload = 24;
+	} else {
+		header.size =		load<4, swap>(ptr + 4);
+		header.addralign =	load<4, swap>(ptr + 8);
+		header.payload = 12;
+	}
+}
+
+
+bool read_compression_header(byte_view section, bool is64, bool bigEndian, compression_header& header) {
+
+	if (section.size() < (is64 ? 24u : 12u)) return false;
+	bigEndian != host_big_endian ? decode_header<true>(section.data(), is64, header)
+				: decode_header<false>(section.data(), is64, header);
+	return true;
+}
+
+
+static bool inflate_zlib(byte_view stream, std::vector<std::uint8_t>& out) {
+
+	// the output size is known, so one call inflates the whole stream
+	z_stream z = {};
+	if (inflateInit(&z) != Z_OK) return false;
+	z.next_in = const_cast<Bytef*>(stream.data());
+	z.avail_in = stream.size();
+	z.next_out = out.data();
+	z.avail_out = out.size();
+	int status = inflate(&z, Z_FINISH);
+	std::size_t written = z.total_out;
+	inflateEnd(&z);
+	return status == Z_STREAM_END && written == out.size();
+}
+
+
+#ifdef ELF_ZSTD
+// the most the frames of stream can hold: the sizes they give, or for a
+// frame without one a full 128 KiB for every 3 byte block header. 0 when
+// the frames don't parse.
+static std::uint64_t zstd_content_bound(byte_view stream) {
+
+	constexpr std::uint64_t block_max = 128 << 10;
+	std::uint64_t bound = 0;
+	for (std::size_t in = 0; in < stream.size(); ) {
+		std::size_t inSize = ZSTD_findFrameCompressedSize(stream.data() + in, stream.size() - in);
+		if (ZSTD_isError(inSize)) return 0;
+		unsigned long long outSize = ZSTD_getFrameContentSize(stream.data() + in, inSize);
+		if (outSize == ZSTD_CONTENTSIZE_ERROR) return 0;
+		if (outSize == ZSTD_CONTENTSIZE_UNKNOWN) outSize = (inSize / 3 + 1) * block_max;
+		if (outSize > std::numeric_limits<std::uint64_t>::max() - bound) {
+			return std::numeric_limits<std::uint64_t>::max();
+		}
+		bound += outSize;
+		in += inSize;
+	}
+	return bound;
+}
+
+
+static bool decompress_zstd(byte_view stream, std::vector<std::uint8_t>& out, unsigned threads) {
+
+	// frames are independent, when every one gives its size up front each
+	// one knows where its output goes and they can be decoded at once
+	typedef struct frame_t {
+		std::size_t in, inSize, out, outSize;
+	} frame_t;
+	std::vector<frame_t> frames;
+	std::size_t in = 0, total = 0;
+	bool sized = true;
+	while (in < stream.size() && sized) {
+		std::size_t inSize = ZSTD_findFrameCompressedSize(stream.data() + in, stream.size() - in);
+		if (ZSTD_isError(inSize)) return false;
+		unsigned long long outSize = ZSTD_getFrameContentSize(stream.data() + in, inSize);
+		sized = outSize != ZSTD_CONTENTSIZE_UNKNOWN && outSize != ZSTD_CONTENTSIZE_ERROR
+				&& outSize <= out.size() - total;
+		frames.push_back({in, inSize, total, (std::size_t) outSize});
+		in += inSize;
+		total += outSize;
+	}
+
+	constexpr std::size_t parallel_bytes = 1 << 20;
+	if (threads == 0) threads = std::thread::hardware_concurrency();
+	if (!sized || frames.size() < 2 || threads < 2 || out.size() < parallel_bytes) {
+		std::size_t written = ZSTD_decompress(out.data(), out.size(), stream.data(), stream.size());
+		return !ZSTD_isError(written) && written == out.size();
+	}
+	if (total != out.size()) return false;
+
+	std::atomic<std::size_t> next {0};
+	std::atomic<bool> failed {false};
+	auto work = [&]() {
+		ZSTD_DCtx* context = ZSTD_createDCtx();
+		for (std::size_t i = next++; i < frames.size() && context; i = next++) {
+			const frame_t &frame = frames[i];
+			std::size_t written = ZSTD_decompressDCtx(context, out.data() + frame.out, frame.outSize,
+							stream.data() + frame.in, frame.inSize);
+			if (ZSTD_isError(written) || written != frame.outSize) failed = true;
+		}
+		if (!context) failed = true;
+		ZSTD_freeDCtx(context);
+	};
+	std::vector<std::thread> workers;
+	for (unsigned t=1; t<threads && t<frames.size(); t++) workers.emplace_back(work);
+	work();
+	for (std::thread &worker : workers) worker.join();
+	return !failed;
+}
+#endif
+
+
+section_bytes decompress_section(byte_view section, bool is64, bool bigEndian, unsigned threads) {
+
+	compression_header header;
+	if (!read_compression_header(section, is64, bigEndian, header)) return nullptr;
+	byte_view stream = section.subview(header.payload, section.size() - header.payload);
+	// refuse sizes no stream of this length could produce rather than
+	// allocate them, deflate expands 1032 times at most
+	if (header.type == ELFCOMPRESS_ZLIB) {
+		if (header.size / 1032 > stream.size() + 1) return nullptr;
+#ifdef ELF_ZSTD
+	} else if (header.type == ELFCOMPRESS_ZSTD) {
+		if (header.size > zstd_content_bound(stream)) return nullptr;
+#endif
+	} else {
+		return nullptr;
+	}
+
+	auto out = std::make_shared<std::vector<std::uint8_t>>(header.size);
+	stat_add(stat_counter::allocations);
+#ifdef ELF_ZSTD
+	bool ok = header.type == ELFCOMPRESS_ZLIB ? inflate_zlib(stream, *out) : decompress_zstd(stream, *out, threads);
+#else
+	(void) threads;
+	bool ok = inflate_zlib(stream, *out);
+#endif
+	if (!ok) return nullptr;
+	return out;
+}
+
+
+section_bytes section_cache::decompress(byte_view section, bool is64, bool bigEndian) {
+
+	std::uint64_t key = checksum(section.data(), section.size());
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		auto it = entries.find(key);
+		if (it != entries.end() && it->second->compressedSize == section.size()) {
+			order.splice(order.begin(), order, it->second);
+			hitCount++;
+			stat_add(stat_counter::cache_hits);
+			return it->second->bytes;
+		}
+		missCount++;
+		stat_add(stat_counter::cache_misses);
+	}
+
+	// decompressed unlocked, two parsers missing the same section at once
+	// both do the work and only the first copy is kept
+	section_bytes bytes = decompress_section(section, is64, bigEndian);
+	if (!bytes || bytes->size() > maxBytes) return bytes;
+
+	std::lock_guard<std::mutex> guard(lock);
+	if (entries.count(key)) return bytes;
+	order.push_front({key, section.size(), bytes});
+	entries[key] = order.begin();
+	usedBytes += bytes->size();
+	while (usedBytes > maxBytes) {
+		usedBytes -= order.back().bytes->size();
+		entries.erase(order.back().key);
+		order.pop_back();
+	}
+	return bytes;
+}
+
+
+void section_cache::clear(void) {
+
+	std::lock_guard<std::mutex> guard(lock);
+	order.clear();
+	entries.clear();
+	usedBytes = 0;
+}
+
+
+std::size_t section_cache::size(void) const {
+
+	std::lock_guard<std::mutex> guard(lock);
+	return usedBytes;
+}
+
+
+std::uint64_t section_cache::hits(void) const {
+
+	std::lock_guard<std::mutex> guard(lock);
+	return hitCount;
+}
+
+
+std::uint64_t section_cache::misses(void) const {
+
+	std::lock_guard<std::mutex> guard(lock);
+	return missCount;
+}
+
+
+} // end of namespace elf
@@ -0,0 +1,261 @@
+#include "../inc/elf_core.hpp"
+
+#include <cstring>
+
+
+namespace elf {
+
+
+std::unique_ptr<core_file> core_file::open(const std::string& file, parse_error& error) {
+
+	error = parse_error();
+	try {
+		if (!std::filesystem::exists(file)) throw 0;
+		return open(file_buffer::map_file(file), error);
+	}
+	catch (int e) {
+		error.code = static_cast<parse_errc>(e);
+	}
+	catch (const std::exception&) {
+		error.code = parse_errc::io_error;
+	}
+	error.message = parse_error_message(error.code);
+	return nullptr;
+}
+
+
+std::unique_ptr<core_file> core_file::open(std::shared_ptr<file_buffer> buffer, parse_error& error) {
+
+	error = parse_error();
+	try {
+		byte_view ident = buffer->read(0, EI_PAD_offset);
+		if (ident.empty() || ident[0] != 0x7F || ident[1] != 0x45
+				|| ident[2] != 0x4c || ident[3] != 0x46) {
+			throw 1;
+		}
+		std::unique_ptr<core_file> core(new core_file(std::move(buffer)));
+		core->bigEndian = ident[EI_DATA_offset] == 2;
+		bool swap = core->bigEndian != host_big_endian;
+		if (ident[EI_CLASS_offset] == 1) {
+			swap ? core->parse<elf32_traits, true>() : core->parse<elf32_traits, false>();
+		} else if (ident[EI_CLASS_offset] == 2) {
+			swap ? core->parse<elf64_traits, true>() : core->parse<elf64_traits, false>();
+		} else {
+			throw 2;
+		}
+		return core;
+	}
+	catch (int e) {
+		error.code = static_cast<parse_errc>(e);
+	}
+	catch (const std::exception&) {
+		// tables sized from a corrupt header
+		error.code = parse_errc::io_error;
+	}
+	error.message = parse_error_message(error.code);
+	return nullptr;
+}
+
+
+template <typename elf_class, bool swap>
+void core_file::parse(void) {
+
+	byte_view header = buffer->read(0, elf_class::e_shstrndx_offset + e_shstrndx_size);
+	if (header.empty()) throw 2;
+	const std::uint8_t* ptr = header.data();
+	if (load<2, swap>(ptr + e_type_offset) != ET_CORE) throw 2;
+	wide = elf_class::elf_class == 2;
+	eMachine = load<2, swap>(ptr + e_machine_offset);
+	std::uint64_t phoff =	load<elf_class::e_phoff_size, swap>(ptr + elf_class::e_phoff_offset);
+	std::uint64_t shoff =	load<elf_class::e_shoff_size, swap>(ptr + elf_class::e_shoff_offset);
+	std::size_t phentsize =	load<2, swap>(ptr + elf_class::e_phentsize_offset);
+	std::size_t phnum =	load<2, swap>(ptr + elf_class::e_phnum_offset);
+	std::size_t shentsize =	load<2, swap>(ptr + elf_class::e_shentsize_offset);
+
+	// dumps with more than 65534 mappings keep the count in section 0
+	if (phnum == 0xffff && shoff) {
+		if (shentsize < elf_class::shdr_size) throw 2;
+		byte_view first = buffer->read(shoff, elf_class::shdr_size);
+		if (first.empty()) throw 3;
+		phnum = load<4, swap>(first.data() + elf_class::sh_info_offset);
+	}
+	if (phnum && phentsize < elf_class::phdr_size) throw 2;
+	byte_view table = buffer->read(phoff, (std::uint64_t) phentsize * phnum);
+	if (table.empty() && phnum) throw 3;
+
+	std::vector<core_segment> loads;
+	loads.reserve(phnum);
+	for (std::size_t i=0; i<phnum; i++) {
+		const std::uint8_t* entry = table.data() + phentsize * i;
+		std::uint32_t type = load<4, swap>(entry + p_type_offset);
+		std::uint64_t offset = load<elf_class::p_offset_size, swap>(entry + elf_class::p_offset_offset);
+		std::uint64_t filesz = load<elf_class::p_filesz_size, swap>(entry + elf_class::p_filesz_offset);
+		if (type == 0x04) {
+			byte_view notes = buffer->read(offset, filesz);
+			if (notes.empty() && filesz) throw 3;
+			note_info info;
+			decode_notes(notes, wide, bigEndian,
+					load<elf_class::p_align_size, swap>(entry + elf_class::p_align_offset), info);
+			std::move(info.notes.begin(), info.notes.end(), std::back_inserter(noteList));
+		} else if (type == 0x01) {
+			// a segment claiming bytes past the end of a truncated dump
+			// keeps what is there
+			std::uint64_t size = buffer->size();
+			core_segment segment;
+			segment.vaddr = load<elf_class::p_vaddr_size, swap>(entry + elf_class::p_vaddr_offset);
+			segment.memsz = load<elf_class::p_memsz_size, swap>(entry + elf_class::p_memsz_offset);
+			segment.offset = offset;
+			segment.filesz = offset >= size ? 0 : std::min(filesz, size - offset);
+			segment.filesz = std::min(segment.filesz, segment.memsz);
+			segment.flags = load<4, swap>(entry + elf_class::p_flags_offset);
+			loads.push_back(segment);
+		}
+	}
+	memory = segment_index(std::move(loads));
+	decode_core_notes<elf_class, swap>();
+}
+
+
+template <typename elf_class, bool swap>
+void core_file::decode_core_notes(void) {
+
+	constexpr std::uint64_t word = elf_class::p_vaddr_size;
+	// pr_reg follows the signal info, the pending and held masks, four
+	// pids and four timevals, pr_fpvalid follows it
+	constexpr std::uint64_t reg_offset = 16 + 2*word + 16 + 8*word;
+	auto load_word = [](const std::uint8_t* ptr) { return load<word, swap>(ptr); };
+
+	for (const elf_note &note : noteList) {
+		if (note.name != "CORE") continue;
+		const std::uint8_t* desc = note.desc.data();
+		std::uint64_t size = note.desc.size();
+
+		if (note.type == NT_PRSTATUS && size >= reg_offset + 4) {
+			core_thread thread;
+			thread.signal =	load<2, swap>(desc + 12);
+			thread.pid =	load<4, swap>(desc + 16 + 2*word);
+			thread.ppid =	load<4, swap>(desc + 20 + 2*word);
+			thread.pgrp =	load<4, swap>(desc + 24 + 2*word);
+			thread.sid =	load<4, swap>(desc + 28 + 2*word);
+			std::uint64_t count = (size - reg_offset - 4) / word;
+			thread.registers.resize(count);
+			for (std::uint64_t i=0; i<count; i++) thread.registers[i] = load_word(desc + reg_offset + i*word);
+
+			// indexes into user_regs_struct / user_pt_regs
+			int pc = -1, sp = -1, fp = -1;
+			switch (eMachine) {
+				case 62:  pc = 16; sp = 19; fp = 4;  break;	// x86-64 rip, rsp, rbp
+				case 3:   pc = 12; sp = 15; fp = 5;  break;	// i386 eip, esp, ebp
+				case 183: pc = 32; sp = 31; fp = 29; break;	// AArch64 pc, sp, x29
+				case 40:  pc = 15; sp = 13; fp = 11; break;	// ARM r15, r13, r11
+				case 243: pc = 0;  sp = 2;  fp = 8;  break;	// RISC-V pc, sp, s0
+			}
+			if (pc >= 0 && (std::uint64_t) std::max({pc, sp, fp}) < count) {
+				thread.pc = thread.registers[pc];
+				thread.sp = thread.registers[sp];
+				thread.fp = thread.registers[fp];
+			}
+			threadList.push_back(std::move(thread));
+
+		} else if (note.type == NT_PRPSINFO && size >= 2*word + 16 + 96) {
+			// pr_fname[16] and pr_psargs[80] close the struct, the four pids
+			// come right before and uid and gid before them, 16 bit on
+			// i386 and 32 bit elsewhere
+			std::uint64_t fname = size - 96;
+			std::uint64_t pids = fname - 16;
+			std::uint64_t idSize = (pids - 2*word) / 2;
+			processInfo.present = true;
+			processInfo.state = desc[1];
+			processInfo.uid = idSize == 2 ? load<2, swap>(desc + 2*word) : load<4, swap>(desc + 2*word);
+			processInfo.gid = idSize == 2 ? load<2, swap>(desc + 2*word + 2)
+							: load<4, swap>(desc + 2*word + 4);
+			processInfo.pid =	load<4, swap>(desc + pids);
+			processInfo.ppid =	load<4, swap>(desc + pids + 4);
+			processInfo.pgrp =	load<4, swap>(desc + pids + 8);
+			processInfo.sid =	load<4, swap>(desc + pids + 12);
+			const char* text = reinterpret_cast<const char*>(desc + fname);
+			processInfo.name.assign(text, strnlen(text, 16));
+			processInfo.args.assign(text + 16, strnlen(text + 16, 80));
+			while (!processInfo.args.empty() && processInfo.args.back() == ' ') processInfo.args.pop_back();
+
+		} else if (note.type == NT_AUXV) {
+			for (std::uint64_t at=0; at+2*word<=size; at+=2*word) {
+				std::uint64_t type = load_word(desc + at);
+				if (type == 0) break;
+				auxvList.emplace_back(type, load_word(desc + at + word));
+			}
+
+		} else if (note.type == NT_FILE && size >= 2*word) {
+			// count and page size, count (start, end, page offset) triples,
+			// then count file names
+			std::uint64_t count = load_word(desc);
+			std::uint64_t pageSize = load_word(desc + word);
+			if (count > (size - 2*word) / (3*word)) continue;
+			std::uint64_t names = 2*word + 3*word*count;
+			mappingList.reserve(count);
+			for (std::uint64_t i=0; i<count; i++) {
+				const std::uint8_t* entry = desc + 2*word + 3*word*i;
+				core_mapping mapping;
+				mapping.start = load_word(entry);
+				mapping.end = load_word(entry + word);
+				mapping.offset = load_word(entry + 2*word) * pageSize;
+				if (names < size) {
+					const char* text = reinterpret_cast<const char*>(desc + names);
+					mapping.path.assign(text, strnlen(text, size - names));
+					names += mapping.path.size() + 1;
+				}
+				mappingList.push_back(std::move(mapping));
+			}
+		}
+	}
+}
+
+
+std::uint64_t core_file::auxv_value(std::uint64_t type, std::uint64_t fallback) const {
+
+	for (const auto &[key, value] : auxvList) {
+		if (key == type) return value;
+	}
+	return fallback;
+}
+
+
+byte_view core_file::read_memory(std::uint64_t vaddr, std::uint64_t size) const {
+
+	std::uint64_t offset = memory.range_to_offset(vaddr, size);
+	if (offset == segment_index::npos) return byte_view();
+	return buffer->read(offset, size);
+}
+
+
+std::uint64_t core_file::copy_memory(std::uint64_t vaddr, void* dst, std::uint64_t size) const {
+
+	std::uint8_t* out = static_cast<std::uint8_t*>(dst);
+	std::uint64_t done = 0;
+	while (done < size) {
+		const core_segment* segment = find_segment(vaddr + done);
+		if (!segment) break;
+		std::uint64_t at = vaddr + done - segment->vaddr;
+		if (at >= segment->filesz) break;
+		std::uint64_t count = std::min(size - done, segment->filesz - at);
+		byte_view bytes = buffer->read(segment->offset + at, count);
+		if (bytes.empty()) break;
+		std::memcpy(out + done, bytes.data(), count);
+		done += count;
+	}
+	return done;
+}
+
+
+bool core_file::read_pointer(std::uint64_t vaddr, std::uint64_t& value) const {
+
+	byte_view bytes = read_memory(vaddr, wide ? 8 : 4);
+	if (bytes.empty()) return false;
+	bool swap = bigEndian != host_big_endian;
+	if (wide) value = swap ? load<8, true>(bytes.data()) : load<8, false>(bytes.data());
+	else value = swap ? load<4, true>(bytes.data()) : load<4, false>(bytes.data());
+	return true;
+}
+
+
+} // end of namespace elf
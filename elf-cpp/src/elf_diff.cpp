@@ -0,0 +1,698 @@
+#include "../inc/elf_diff.hpp"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstring>
+#include <map>
+#include <thread>
+#include <tuple>
+#include <unordered_map>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define ELF_HASH_AVX2
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#define ELF_HASH_NEON
+#endif
+
+
+namespace elf {
+
+// 16 stripes of 64 bytes make a block, the lanes are scrambled after each
+constexpr std::size_t stripe_size = 64;
+constexpr std::size_t block_stripes = 16;
+constexpr std::size_t block_size = stripe_size * block_stripes;
+constexpr std::uint64_t prime32 = 0x9E3779B1u;
+constexpr std::uint64_t prime64_1 = 0x9E3779B185EBCA87ull;
+constexpr std::uint64_t prime64_2 = 0xC2B2AE3D27D4EB4Full;
+constexpr std::uint64_t prime64_3 = 0x165667B19E3779F9ull;
+constexpr std::uint64_t prime64_4 = 0x85EBCA77C2B2AE63ull;
+
+// a key per lane and stripe of a block, then one per lane for scrambling
+typedef struct hash_keys {
+	std::uint64_t stripe[block_stripes * 8];
+	std::uint64_t scramble[8];
+} hash_keys;
+
+static constexpr hash_keys make_keys(void) {
+
+	hash_keys keys = {};
+	std::uint64_t state = 0x243F6A8885A308D3ull;
+	auto next = [&state]() {
+		// splitmix64
+		std::uint64_t z = (state += 0x9E3779B97F4A7C15ull);
+		z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+		z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+		return z ^ (z >> 31);
+	};
+	for (std::uint64_t &key : keys.stripe) key = next();
+	for (std::uint64_t &key : keys.scramble) key = next();
+	return keys;
+}
+
+static constexpr hash_keys keys = make_keys();
+
+
+static inline std::uint64_t load_le64(const std::uint8_t* ptr) {
+
+	return host_big_endian ? load<8, true>(ptr) : load<8, false>(ptr);
+}
+
+static inline std::uint64_t rotl(std::uint64_t value, int bits) {
+
+	return (value << bits) | (value >> (64 - bits));
+}
+
+
+// stripes of ptr into acc, the first uses the keys of stripe first
+static void accumulate_scalar(std::uint64_t acc[8], const std::uint8_t* ptr, std::size_t stripes,
+				std::size_t first) {
+
+	for (std::size_t s=0; s<stripes; s++) {
+		const std::uint64_t* key = keys.stripe + 8 * (first + s);
+		for (int j=0; j<8; j++) {
+			std::uint64_t data = load_le64(ptr + stripe_size * s + 8 * j);
+			std::uint64_t mixed = data ^ key[j];
+			acc[j ^ 1] += data;
+			acc[j] += (mixed & 0xFFFFFFFF) * (mixed >> 32);
+		}
+	}
+}
+
+static void scramble_scalar(std::uint64_t acc[8]) {
+
+	for (int j=0; j<8; j++) {
+		acc[j] ^= acc[j] >> 47;
+		acc[j] ^= keys.scramble[j];
+		acc[j] *= prime32;
+	}
+}
+
+static void blocks_scalar(std::uint64_t acc[8], const std::uint8_t* ptr, std::size_t blocks) {
+
+	for (std::size_t b=0; b<blocks; b++) {
+		accumulate_scalar(acc, ptr + block_size * b, block_stripes, 0);
+		scramble_scalar(acc);
+	}
+}
+
+
+#ifdef ELF_HASH_AVX2
+// the same steps as the scalar code four lanes at a time, the swap of
+// neighbouring lanes stays within each 128 bit half
+__attribute__((target("avx2")))
+static void blocks_avx2(std::uint64_t acc[8], const std::uint8_t* ptr, std::size_t blocks) {
+
+	__m256i lanes[2] = {_mm256_loadu_si256((const __m256i*) acc), _mm256_loadu_si256((const __m256i*) (acc+4))};
+	const __m256i prime = _mm256_set1_epi64x(prime32);
+	for (std::size_t b=0; b<blocks; b++) {
+		for (std::size_t s=0; s<block_stripes; s++) {
+			for (int h=0; h<2; h++) {
+				__m256i data = _mm256_loadu_si256((const __m256i*) (ptr + block_size * b + stripe_size * s + 32 * h));
+				__m256i key = _mm256_loadu_si256((const __m256i*) (keys.stripe + 8 * s + 4 * h));
+				__m256i mixed = _mm256_xor_si256(data, key);
+				__m256i product = _mm256_mul_epu32(mixed, _mm256_srli_epi64(mixed, 32));
+				__m256i swapped = _mm256_shuffle_epi32(data, _MM_SHUFFLE(1, 0, 3, 2));
+				lanes[h] = _mm256_add_epi64(lanes[h], _mm256_add_epi64(product, swapped));
+			}
+		}
+		for (int h=0; h<2; h++) {
+			__m256i value = _mm256_xor_si256(lanes[h], _mm256_srli_epi64(lanes[h], 47));
+			value = _mm256_xor_si256(value, _mm256_loadu_si256((const __m256i*) (keys.scramble + 4 * h)));
+			__m256i low = _mm256_mul_epu32(value, prime);
+			__m256i high = _mm256_mul_epu32(_mm256_srli_epi64(value, 32), prime);
+			lanes[h] = _mm256_add_epi64(low, _mm256_slli_epi64(high, 32));
+		}
+	}
+	_mm256_storeu_si256((__m256i*) acc, lanes[0]);
+	_mm256_storeu_si256((__m256i*) (acc+4), lanes[1]);
+}
+#endif
+
+#if defined(ELF_HASH_AVX2) && defined(__x86_64__)
+// SSE2 is part of x86-64, two lanes at a time
+static void blocks_sse2(std::uint64_t acc[8], const std::uint8_t* ptr, std::size_t blocks) {
+
+	__m128i lanes[4];
+	for (int q=0; q<4; q++) lanes[q] = _mm_loadu_si128((const __m128i*) (acc + 2 * q));
+	const __m128i prime = _mm_set1_epi64x(prime32);
+	for (std::size_t b=0; b<blocks; b++) {
+		for (std::size_t s=0; s<block_stripes; s++) {
+			for (int q=0; q<4; q++) {
+				__m128i data = _mm_loadu_si128((const __m128i*) (ptr + block_size * b + stripe_size * s + 16 * q));
+				__m128i key = _mm_loadu_si128((const __m128i*) (keys.stripe + 8 * s + 2 * q));
+				__m128i mixed = _mm_xor_si128(data, key);
+				__m128i product = _mm_mul_epu32(mixed, _mm_srli_epi64(mixed, 32));
+				__m128i swapped = _mm_shuffle_epi32(data, _MM_SHUFFLE(1, 0, 3, 2));
+				lanes[q] = _mm_add_epi64(lanes[q], _mm_add_epi64(product, swapped));
+			}
+		}
+		for (int q=0; q<4; q++) {
+			__m128i value = _mm_xor_si128(lanes[q], _mm_srli_epi64(lanes[q], 47));
+			value = _mm_xor_si128(value, _mm_loadu_si128((const __m128i*) (keys.scramble + 2 * q)));
+			__m128i low = _mm_mul_epu32(value, prime);
+			__m128i high = _mm_mul_epu32(_mm_srli_epi64(value, 32), prime);
+			lanes[q] = _mm_add_epi64(low, _mm_slli_epi64(high, 32));
+		}
+	}
+	for (int q=0; q<4; q++) _mm_storeu_si128((__m128i*) (acc + 2 * q), lanes[q]);
+}
+#endif
+
+#ifdef ELF_HASH_NEON
+static void blocks_neon(std::uint64_t acc[8], const std::uint8_t* ptr, std::size_t blocks) {
+
+	uint64x2_t lanes[4];
+	for (int q=0; q<4; q++) lanes[q] = vld1q_u64(acc + 2 * q);
+	const uint32x2_t prime = vdup_n_u32(prime32);
+	for (std::size_t b=0; b<blocks; b++) {
+		for (std::size_t s=0; s<block_stripes; s++) {
+			for (int q=0; q<4; q++) {
+				uint64x2_t data = vreinterpretq_u64_u8(vld1q_u8(ptr + block_size * b + stripe_size * s + 16 * q));
+				uint64x2_t mixed = veorq_u64(data, vld1q_u64(keys.stripe + 8 * s + 2 * q));
+				uint64x2_t product = vmull_u32(vmovn_u64(mixed), vshrn_n_u64(mixed, 32));
+				uint64x2_t swapped = vextq_u64(data, data, 1);
+				lanes[q] = vaddq_u64(lanes[q], vaddq_u64(product, swapped));
+			}
+		}
+		for (int q=0; q<4; q++) {
+			uint64x2_t value = veorq_u64(lanes[q], vshrq_n_u64(lanes[q], 47));
+			value = veorq_u64(value, vld1q_u64(keys.scramble + 2 * q));
+			uint64x2_t low = vmull_u32(vmovn_u64(value), prime);
+			uint64x2_t high = vmull_u32(vshrn_n_u64(value, 32), prime);
+			lanes[q] = vaddq_u64(low, vshlq_n_u64(high, 32));
+		}
+	}
+	for (int q=0; q<4; q++) vst1q_u64(acc + 2 * q, lanes[q]);
+}
+#endif
+
+
+static void hash_blocks(std::uint64_t acc[8], const std::uint8_t* ptr, std::size_t blocks) {
+
+	// the vector paths read words in little endian order
+	if (!host_big_endian) {
+#if defined(ELF_HASH_AVX2)
+		if (__builtin_cpu_supports("avx2")) return blocks_avx2(acc, ptr, blocks);
+#if defined(__x86_64__)
+		return blocks_sse2(acc, ptr, blocks);
+#endif
+#elif defined(ELF_HASH_NEON)
+		return blocks_neon(acc, ptr, blocks);
+#endif
+	}
+	blocks_scalar(acc, ptr, blocks);
+}
+
+
+static std::uint64_t avalanche(std::uint64_t hash) {
+
+	hash ^= hash >> 33;
+	hash *= prime64_2;
+	hash ^= hash >> 29;
+	hash *= prime64_3;
+	return hash ^ (hash >> 32);
+}
+
+
+std::uint64_t fingerprint(const std::uint8_t* ptr, std::size_t size) {
+
+	std::uint64_t acc[8] = {prime32, prime64_1, prime64_2, prime64_3, prime64_4, 0x85EBCA6Bu, 0xC2B2AE35u,
+				0x27D4EB2Fu};
+	std::size_t blocks = size / block_size;
+	if (blocks) hash_blocks(acc, ptr, blocks);
+
+	// whole stripes of the last block, then the rest padded with zeros
+	std::size_t done = blocks * block_size;
+	std::size_t stripes = (size - done) / stripe_size;
+	accumulate_scalar(acc, ptr + done, stripes, 0);
+	done += stripes * stripe_size;
+	if (done < size) {
+		std::uint8_t last[stripe_size] = {};
+		std::memcpy(last, ptr + done, size - done);
+		accumulate_scalar(acc, last, 1, stripes);
+	}
+
+	std::uint64_t hash = size * prime64_1;
+	for (int j=0; j<8; j++) {
+		hash ^= rotl(acc[j] * prime64_2, 31) * prime64_1;
+		hash = rotl(hash, 27) * prime64_1 + prime64_4;
+	}
+	return avalanche(hash);
+}
+
+
+// the fingerprint of contents longer than fingerprint_chunk
+static std::uint64_t fold_chunks(std::uint64_t size, const std::vector<std::uint64_t>& chunks) {
+
+	std::uint64_t hash = size * prime64_3;
+	for (std::uint64_t chunk : chunks) hash = rotl(hash ^ (chunk * prime64_2), 31) * prime64_1;
+	return avalanche(hash);
+}
+
+
+std::uint64_t section_fingerprint(byte_view bytes) {
+
+	if (bytes.size() <= fingerprint_chunk) return fingerprint(bytes.data(), bytes.size());
+	std::vector<std::uint64_t> chunks;
+	for (std::uint64_t at=0; at<bytes.size(); at+=fingerprint_chunk) {
+		chunks.push_back(fingerprint(bytes.data() + at, std::min<std::uint64_t>(fingerprint_chunk, bytes.size() - at)));
+	}
+	return fold_chunks(bytes.size(), chunks);
+}
+
+
+std::vector<std::uint64_t> fingerprint_views(const std::vector<byte_view>& views, unsigned threads) {
+
+	// a task is one chunk of a large view or a run of small views adding up
+	// to about a chunk, count is 0 for a chunk
+	typedef struct task_t {
+		std::size_t view;
+		std::size_t count;
+		std::size_t chunk;
+	} task_t;
+	std::vector<std::uint64_t> hashes(views.size());
+	std::vector<std::vector<std::uint64_t>> chunks(views.size());
+	std::vector<task_t> tasks;
+	std::uint64_t total = 0;
+	for (std::size_t i=0; i<views.size(); ) {
+		if (views[i].size() > fingerprint_chunk) {
+			chunks[i].resize((views[i].size() + fingerprint_chunk - 1) / fingerprint_chunk);
+			for (std::size_t c=0; c<chunks[i].size(); c++) tasks.push_back({i, 0, c});
+			total += views[i++].size();
+			continue;
+		}
+		std::size_t first = i;
+		std::uint64_t bytes = 0;
+		while (i < views.size() && views[i].size() <= fingerprint_chunk && bytes < fingerprint_chunk) {
+			bytes += views[i++].size();
+		}
+		tasks.push_back({first, i - first, 0});
+		total += bytes;
+	}
+
+	auto run = [&](const task_t& task) {
+		if (task.count == 0) {
+			byte_view view = views[task.view];
+			std::uint64_t at = task.chunk * fingerprint_chunk;
+			chunks[task.view][task.chunk] = fingerprint(view.data() + at,
+								std::min<std::uint64_t>(fingerprint_chunk, view.size() - at));
+			return;
+		}
+		for (std::size_t i=task.view; i<task.view+task.count; i++) {
+			hashes[i] = fingerprint(views[i].data(), views[i].size());
+		}
+	};
+	if (threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
+	// starting threads costs more than hashing a few chunks
+	if (total < 4 * fingerprint_chunk) threads = 1;
+	threads = std::min<std::size_t>(threads, tasks.size());
+	if (threads <= 1) {
+		for (const task_t &task : tasks) run(task);
+	} else {
+		std::atomic<std::size_t> next(0);
+		std::vector<std::thread> workers;
+		for (unsigned t=0; t<threads; t++) {
+			workers.emplace_back([&]() {
+				for (std::size_t k; (k = next.fetch_add(1, std::memory_order_relaxed)) < tasks.size(); ) {
+					run(tasks[k]);
+				}
+			});
+		}
+		for (std::thread &worker : workers) worker.join();
+	}
+	for (std::size_t i=0; i<views.size(); i++) {
+		if (!chunks[i].empty()) hashes[i] = fold_chunks(views[i].size(), chunks[i]);
+	}
+	return hashes;
+}
+
+
+// what diff_elf compares of one file, class neutral
+typedef struct file_snapshot {
+	std::vector<std::pair<const char*, std::uint64_t>> header;
+	std::vector<std::array<std::uint64_t, 8>> segments;	// type, flags, offset, vaddr, paddr, filesz, memsz, align
+	std::vector<section_state> sections;
+	std::vector<byte_view> views;				// empty where nothing is hashed
+} file_snapshot;
+
+static const char* const segment_fields[] = {"type", "flags", "offset", "vaddr", "paddr", "filesz", "memsz", "align"};
+
+
+template <typename elf_class>
+static void snapshot(elf_class_parser<elf_class>& parser, file_snapshot& file) {
+
+	const typename elf_class::header_t &h = parser.elf_header();
+	file.header = {
+		{"class", elf_class::elf_class}, {"data", h.e_ident[EI_DATA_offset]},
+		{"osabi", h.e_ident[EI_OSABI_offset]}, {"abiversion", h.e_ident[EI_ABIVERSION_offset]},
+		{"type", h.e_type}, {"machine", h.e_machine}, {"version", h.e_version}, {"entry", h.e_entry},
+		{"flags", h.e_flags}, {"phoff", h.e_phoff}, {"shoff", h.e_shoff}, {"ehsize", h.e_ehsize},
+		{"phentsize", h.e_phentsize}, {"phnum", h.e_phnum}, {"shentsize", h.e_shentsize},
+		{"shnum", h.e_shnum}, {"shstrndx", h.e_shstrndx}
+	};
+	for (const auto &s : parser.segments()) {
+		file.segments.push_back({s.p_type, s.p_flags, s.p_offset, s.p_vaddr, s.p_paddr, s.p_filesz,
+						s.p_memsz, s.p_align});
+	}
+	file.sections.reserve(parser.sections().size());
+	file.views.reserve(parser.sections().size());
+	for (std::size_t i=0; i<parser.sections().size(); i++) {
+		const auto &s = parser.sections()[i];
+		file.sections.push_back({s.name, s.sh_type, s.sh_flags, s.sh_addr, s.sh_offset, s.sh_size,
+						s.sh_link, s.sh_info, 0});
+		file.views.push_back(s.sh_type != 0x08 && s.sh_size ? parser.file_bytes(i) : byte_view());
+	}
+}
+
+
+static void snapshot(elf_parser& parser, file_snapshot& file) {
+
+	if (elf_32_parser* typed = dynamic_cast<elf_32_parser*>(&parser)) snapshot(*typed, file);
+	else if (elf_64_parser* typed = dynamic_cast<elf_64_parser*>(&parser)) snapshot(*typed, file);
+}
+
+
+// fingerprints of the sections of every file in one pool of tasks
+static std::uint64_t hash_snapshots(const std::vector<file_snapshot*>& files, unsigned threads) {
+
+	std::vector<byte_view> views;
+	std::uint64_t hashed = 0;
+	for (const file_snapshot* file : files) {
+		for (byte_view view : file->views) {
+			views.push_back(view);
+			hashed += view.size();
+		}
+	}
+	std::vector<std::uint64_t> hashes = fingerprint_views(views, threads);
+	std::size_t next = 0;
+	for (file_snapshot* file : files) {
+		for (std::size_t i=0; i<file->sections.size(); i++, next++) {
+			const section_state &s = file->sections[i];
+			// an empty section of a type with contents hashes like one read empty
+			file->sections[i].hash = s.type == 0x08 || s.size == 0 ? 0 : hashes[next];
+		}
+	}
+	return hashed;
+}
+
+
+std::vector<section_state> fingerprint_sections(elf_parser& parser, unsigned threads, std::uint64_t* hashed) {
+
+	file_snapshot file;
+	snapshot(parser, file);
+	std::uint64_t bytes = hash_snapshots({&file}, threads);
+	if (hashed) *hashed += bytes;
+	return std::move(file.sections);
+}
+
+
+// index in before of the match of each section of after, npos if none
+static std::vector<std::size_t> match_sections(const std::vector<section_state>& before,
+						const std::vector<section_state>& after) {
+
+	std::map<std::tuple<std::string, std::uint32_t, std::size_t>, std::size_t> previous;
+	std::map<std::pair<std::string, std::uint32_t>, std::size_t> seen;
+	for (std::size_t i=0; i<before.size(); i++) {
+		const section_state &s = before[i];
+		previous.emplace(std::make_tuple(s.name, s.type, seen[{s.name, s.type}]++), i);
+	}
+	seen.clear();
+	std::vector<std::size_t> match(after.size(), section_diff::npos);
+	for (std::size_t i=0; i<after.size(); i++) {
+		const section_state &s = after[i];
+		auto it = previous.find(std::make_tuple(s.name, s.type, seen[{s.name, s.type}]++));
+		if (it != previous.end()) match[i] = it->second;
+	}
+	return match;
+}
+
+
+std::vector<section_diff> diff_sections(const std::vector<section_state>& before,
+					const std::vector<section_state>& after,
+					std::vector<bool>* unchanged) {
+
+	std::vector<section_diff> diffs;
+	std::vector<std::size_t> match = match_sections(before, after);
+	std::vector<bool> matched(before.size());
+	if (unchanged) unchanged->assign(after.size(), false);
+	for (std::size_t i=0; i<after.size(); i++) {
+		const section_state &s = after[i];
+		std::size_t old = match[i];
+		if (old == section_diff::npos) {
+			diffs.push_back({s.name, s.type, section_added, section_diff::npos, i, {}});
+			continue;
+		}
+		const section_state &o = before[old];
+		matched[old] = true;
+		unsigned changes = 0;
+		if (s.offset != o.offset) changes |= section_moved;
+		if (s.size != o.size) changes |= section_resized;
+		if (s.hash != o.hash) changes |= section_content;
+		if (s.flags != o.flags || s.addr != o.addr || s.link != o.link || s.info != o.info || old != i) {
+			changes |= section_header;
+		}
+		// where it sits in the file doesn't matter to what was decoded from it
+		if (unchanged) (*unchanged)[i] = (changes & ~section_moved) == 0;
+		if (changes) diffs.push_back({s.name, s.type, changes, old, i, {}});
+	}
+	for (std::size_t i=0; i<before.size(); i++) {
+		if (matched[i]) continue;
+		diffs.push_back({before[i].name, before[i].type, section_removed, i, section_diff::npos, {}});
+	}
+	return diffs;
+}
+
+
+// runs of differing bytes, equal stretches shorter than 16 bytes don't split one
+static void differing_ranges(byte_view a, byte_view b, std::size_t limit, section_diff& diff,
+				std::uint64_t& compared) {
+
+	constexpr std::size_t block = 4096;
+	constexpr std::size_t gap = 16;
+	std::uint64_t common = std::min(a.size(), b.size());
+	std::uint64_t at = 0;
+	while (at < common && diff.ranges.size() < limit) {
+		std::uint64_t step = std::min<std::uint64_t>(block, common - at);
+		if (std::memcmp(a.data() + at, b.data() + at, step) == 0) {
+			at += step;
+			continue;
+		}
+		while (a[at] == b[at]) at++;
+		std::uint64_t start = at, equal = 0;
+		for (; at < common && equal < gap; at++) equal = a[at] == b[at] ? equal + 1 : 0;
+		diff.ranges.emplace_back(start, at - equal - start);
+	}
+	compared += 2 * at;
+	if (a.size() != b.size() && diff.ranges.size() < limit) {
+		std::uint64_t longer = std::max(a.size(), b.size());
+		if (!diff.ranges.empty() && diff.ranges.back().first + diff.ranges.back().second == common) {
+			diff.ranges.back().second = longer - diff.ranges.back().first;
+		} else {
+			diff.ranges.emplace_back(common, longer - common);
+		}
+	}
+}
+
+
+static void diff_symbols(const symbol_table& before, const symbol_table& after, bool dynamic,
+				const file_snapshot& a, const file_snapshot& b, std::vector<symbol_diff>& diffs) {
+
+	constexpr std::uint32_t npos = 0xFFFFFFFF;
+	// the section a symbol is defined in is compared by name, the indexes
+	// move when sections are added or removed
+	auto where = [](const file_snapshot& file, std::uint32_t shndx) -> std::string_view {
+		if (shndx == SHN_UNDEF || shndx >= 0xff00 || shndx >= file.sections.size()) return std::string_view();
+		return file.sections[shndx].name;
+	};
+	auto special = [](std::uint32_t shndx) { return shndx == SHN_UNDEF || shndx >= 0xff00; };
+
+	auto compare = [&](symbol_table::symbol o, symbol_table::symbol s) {
+		unsigned changes = 0;
+		if (s.value() != o.value()) changes |= symbol_value;
+		if (s.size() != o.size()) changes |= symbol_size;
+		if (s.info() != o.info() || s.visibility() != o.visibility()) changes |= symbol_kind;
+		if (special(s.shndx()) || special(o.shndx()) ? s.shndx() != o.shndx()
+				: where(b, s.shndx()) != where(a, o.shndx())) {
+			changes |= symbol_section;
+		}
+		if (changes) diffs.push_back({std::string(s.name()), dynamic, changes, o.value(), s.value(), o.size(), s.size()});
+	};
+
+	// rows with the same names at the same places from either end match
+	// without hashing a name, usually that is all of them
+	// a missing table counts as its null row alone, every row of the other
+	// one is then added or removed
+	std::uint32_t first = 1;
+	std::uint32_t lastBefore = std::max<std::size_t>(before.size(), 1);
+	std::uint32_t lastAfter = std::max<std::size_t>(after.size(), 1);
+	while (first < lastBefore && first < lastAfter && before.name(first) == after.name(first)) {
+		compare(before[first], after[first]);
+		first++;
+	}
+	while (lastBefore > first && lastAfter > first && before.name(lastBefore - 1) == after.name(lastAfter - 1)) {
+		lastBefore--;
+		lastAfter--;
+	}
+
+	// rows of before in between by name, each name's rows in order
+	std::vector<std::uint32_t> next(lastBefore - first, npos);
+	std::unordered_map<std::string_view, std::pair<std::uint32_t, std::uint32_t>> rows;
+	rows.reserve(lastBefore - first);
+	for (std::uint32_t i=first; i<lastBefore; i++) {
+		auto [it, added] = rows.try_emplace(before.name(i), i, i);
+		if (!added) {
+			next[it->second.second - first] = i;
+			it->second.second = i;
+		}
+	}
+	std::vector<bool> matched(lastBefore - first);
+	for (std::uint32_t i=first; i<lastAfter; i++) {
+		symbol_table::symbol s = after[i];
+		auto it = rows.find(s.name());
+		if (it == rows.end() || it->second.first == npos) {
+			diffs.push_back({std::string(s.name()), dynamic, symbol_added, 0, s.value(), 0, s.size()});
+			continue;
+		}
+		std::uint32_t row = it->second.first;
+		it->second.first = next[row - first];
+		matched[row - first] = true;
+		compare(before[row], s);
+	}
+	for (std::uint32_t i=lastAfter; i<after.size(); i++) compare(before[lastBefore + i - lastAfter], after[i]);
+	for (std::uint32_t i=first; i<lastBefore; i++) {
+		if (matched[i - first]) continue;
+		symbol_table::symbol o = before[i];
+		diffs.push_back({std::string(o.name()), dynamic, symbol_removed, o.value(), 0, o.size(), 0});
+	}
+}
+
+
+binary_diff diff_elf(elf_parser& before, elf_parser& after, diff_options options) {
+
+	binary_diff diff;
+	file_snapshot a, b;
+	snapshot(before, a);
+	snapshot(after, b);
+	diff.hashed = hash_snapshots({&a, &b}, options.threads);
+
+	for (std::size_t i=0; i<std::min(a.header.size(), b.header.size()); i++) {
+		if (a.header[i].second != b.header[i].second) {
+			diff.header.push_back({a.header[i].first, a.header[i].second, b.header[i].second});
+		}
+	}
+
+	std::map<std::pair<std::uint64_t, std::size_t>, std::size_t> previous;
+	std::map<std::uint64_t, std::size_t> seen;
+	for (std::size_t i=0; i<a.segments.size(); i++) previous.emplace(std::make_pair(a.segments[i][0], seen[a.segments[i][0]]++), i);
+	seen.clear();
+	std::vector<bool> matched(a.segments.size());
+	for (std::size_t i=0; i<b.segments.size(); i++) {
+		const std::array<std::uint64_t, 8> &s = b.segments[i];
+		auto it = previous.find(std::make_pair(s[0], seen[s[0]]++));
+		if (it == previous.end()) {
+			diff.segments.push_back({(std::uint32_t) s[0], segment_diff::npos, i, {}});
+			continue;
+		}
+		matched[it->second] = true;
+		segment_diff change = {(std::uint32_t) s[0], it->second, i, {}};
+		for (int f=1; f<8; f++) {
+			std::uint64_t old = a.segments[it->second][f];
+			if (old != s[f]) change.fields.push_back({segment_fields[f], old, s[f]});
+		}
+		if (!change.fields.empty()) diff.segments.push_back(std::move(change));
+	}
+	for (std::size_t i=0; i<a.segments.size(); i++) {
+		if (!matched[i]) diff.segments.push_back({(std::uint32_t) a.segments[i][0], i, segment_diff::npos, {}});
+	}
+
+	std::vector<bool> unchanged;
+	diff.sections = diff_sections(a.sections, b.sections, &unchanged);
+	if (options.verify) {
+		// equal fingerprints of different bytes
+		std::vector<std::size_t> match = match_sections(a.sections, b.sections);
+		for (std::size_t i=0; i<b.sections.size(); i++) {
+			std::size_t old = match[i];
+			if (old == section_diff::npos || a.sections[old].hash != b.sections[i].hash) continue;
+			byte_view x = a.views[old], y = b.views[i];
+			if (x.size() != y.size() || x.empty()) continue;
+			diff.compared += 2 * x.size();
+			if (std::memcmp(x.data(), y.data(), x.size()) == 0) continue;
+			unchanged[i] = false;
+			auto it = std::find_if(diff.sections.begin(), diff.sections.end(),
+						[i](const section_diff& d) { return d.newIndex == i; });
+			if (it != diff.sections.end()) it->changes |= section_content;
+			else diff.sections.push_back({b.sections[i].name, b.sections[i].type, section_content, old, i, {}});
+		}
+		std::stable_sort(diff.sections.begin(), diff.sections.end(), [](const section_diff& x, const section_diff& y) {
+			return x.newIndex < y.newIndex;
+		});
+	}
+	for (section_diff &section : diff.sections) {
+		if (options.ranges && (section.changes & section_content) && section.oldIndex != section_diff::npos
+				&& section.newIndex != section_diff::npos) {
+			differing_ranges(a.views[section.oldIndex], b.views[section.newIndex], options.max_ranges,
+						section, diff.compared);
+		}
+	}
+	diff.unchanged = b.sections.size();
+	for (const section_diff &section : diff.sections) {
+		if (section.newIndex != section_diff::npos) diff.unchanged--;
+	}
+
+	if (options.symbols) {
+		// names in index order, symbols keep their sections if these agree
+		bool sameLayout = a.sections.size() == b.sections.size();
+		for (std::size_t i=0; sameLayout && i<a.sections.size(); i++) {
+			sameLayout = a.sections[i].name == b.sections[i].name;
+		}
+		auto first_of_type = [](const file_snapshot& file, std::uint32_t type) {
+			for (std::size_t i=0; i<file.sections.size(); i++) {
+				if (file.sections[i].type == type) return i;
+			}
+			return section_diff::npos;
+		};
+		std::vector<std::size_t> match = match_sections(a.sections, b.sections);
+		for (std::uint32_t type : {0x02u, 0x0Bu}) {
+			std::size_t x = first_of_type(a, type), y = first_of_type(b, type);
+			if (x == section_diff::npos && y == section_diff::npos) continue;
+			if (x != section_diff::npos && y != section_diff::npos && sameLayout && unchanged[y] && match[y] == x) {
+				std::size_t strings = b.sections[y].link;
+				if (strings < b.sections.size() && unchanged[strings] && match[strings] == a.sections[x].link) {
+					diff.skippedTables++;
+					continue;
+				}
+			}
+			bool dynamic = type == 0x0B;
+			diff_symbols(dynamic ? before.dynamic_symbols() : before.symbols(),
+					dynamic ? after.dynamic_symbols() : after.symbols(), dynamic, a, b, diff.symbols);
+		}
+	}
+	return diff;
+}
+
+
+bool diff_files(const std::string& before, const std::string& after, binary_diff& diff,
+		parse_error& error, diff_options options) {
+
+	read_options read(load_mode::map, true);
+	std::unique_ptr<elf_parser> first = elf_parser::open(before, error, read);
+	if (!first) return false;
+	std::unique_ptr<elf_parser> second = elf_parser::open(after, error, read);
+	if (!second) return false;
+	try {
+		diff = diff_elf(*first, *second, options);
+		return true;
+	}
+	catch (const std::exception&) {
+		// section contents the mapping can't read, or memory
+		error.code = parse_errc::io_error;
+	}
+	error.message = parse_error_message(error.code);
+	return false;
+}
+
+
+} // end of namespace elf
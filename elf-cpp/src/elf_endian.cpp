@@ -0,0 +1,84 @@
+#include "../inc/elf_endian.hpp"
+
+#include <numeric>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define ELF_SWAP_SSSE3
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#define ELF_SWAP_NEON
+#endif
+
+
+namespace elf {
+
+
+// shuffle mask for one repeat of the layout, padded to a multiple of 16 bytes
+static std::vector<std::uint8_t> swap_mask(const std::uint8_t* layout, std::size_t fields) {
+
+	std::size_t entry = 0;
+	for (std::size_t i=0; i<fields; i++) entry += layout[i];
+	std::size_t period = std::lcm(entry, (std::size_t) 16);
+	std::vector<std::uint8_t> mask(period);
+	std::size_t pos = 0;
+	while (pos < period) {
+		for (std::size_t i=0; i<fields; i++) {
+			for (std::size_t j=0; j<layout[i]; j++) {
+				// index relative to the start of the 16 byte lane
+				mask[pos+j] = (pos % 16) + layout[i]-1-j;
+			}
+			pos += layout[i];
+		}
+	}
+	return mask;
+}
+
+
+#ifdef ELF_SWAP_SSSE3
+__attribute__((target("ssse3")))
+static std::size_t swap_lanes(const std::uint8_t* src, std::uint8_t* dst, std::size_t size,
+					const std::vector<std::uint8_t>& mask) {
+
+	std::size_t i = 0;
+	for (; i+16<=size; i+=16) {
+		__m128i shuffle = _mm_loadu_si128((const __m128i*) (mask.data() + i % mask.size()));
+		__m128i lane = _mm_loadu_si128((const __m128i*) (src+i));
+		_mm_storeu_si128((__m128i*) (dst+i), _mm_shuffle_epi8(lane, shuffle));
+	}
+	return i;
+}
+#elif defined(ELF_SWAP_NEON)
+static std::size_t swap_lanes(const std::uint8_t* src, std::uint8_t* dst, std::size_t size,
+					const std::vector<std::uint8_t>& mask) {
+
+	std::size_t i = 0;
+	for (; i+16<=size; i+=16) {
+		uint8x16_t shuffle = vld1q_u8(mask.data() + i % mask.size());
+		vst1q_u8(dst+i, vqtbl1q_u8(vld1q_u8(src+i), shuffle));
+	}
+	return i;
+}
+#endif
+
+
+void swap_table(const std::uint8_t* src, std::uint8_t* dst, std::size_t size,
+		const std::uint8_t* layout, std::size_t fields) {
+
+	std::vector<std::uint8_t> mask = swap_mask(layout, fields);
+	std::size_t done = 0;
+#if defined(ELF_SWAP_SSSE3)
+	if (__builtin_cpu_supports("ssse3")) done = swap_lanes(src, dst, size, mask);
+#elif defined(ELF_SWAP_NEON)
+	done = swap_lanes(src, dst, size, mask);
+#endif
+	// scalar tail, or the whole table without vector support
+	for (std::size_t i=done; i<size; i++) {
+		std::size_t lane = i - i % 16;
+		std::size_t from = lane + mask[i % mask.size()];
+		dst[i] = from < size ? src[from] : 0;
+	}
+}
+
+} // end of namespace elf
@@ -0,0 +1,532 @@
+#include "../inc/elf_lines.hpp"
+#include "../inc/elf_endian.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <deque>
+#include <thread>
+#include <unordered_map>
+
+
+namespace elf {
+
+// standard and extended opcodes of the line number program
+constexpr std::uint8_t DW_LNS_copy =			0x01;
+constexpr std::uint8_t DW_LNS_advance_pc =		0x02;
+constexpr std::uint8_t DW_LNS_advance_line =		0x03;
+constexpr std::uint8_t DW_LNS_set_file =		0x04;
+constexpr std::uint8_t DW_LNS_set_column =		0x05;
+constexpr std::uint8_t DW_LNS_const_add_pc =		0x08;
+constexpr std::uint8_t DW_LNS_fixed_advance_pc =	0x09;
+constexpr std::uint8_t DW_LNE_end_sequence =		0x01;
+constexpr std::uint8_t DW_LNE_set_address =		0x02;
+constexpr std::uint8_t DW_LNE_define_file =		0x03;
+
+// DWARF 5 directory and file entry formats
+constexpr std::uint64_t DW_LNCT_path =			0x1;
+constexpr std::uint64_t DW_LNCT_directory_index =	0x2;
+constexpr std::uint64_t DW_FORM_block =			0x09;
+constexpr std::uint64_t DW_FORM_data1 =			0x0b;
+constexpr std::uint64_t DW_FORM_data2 =			0x05;
+constexpr std::uint64_t DW_FORM_data4 =			0x06;
+constexpr std::uint64_t DW_FORM_data8 =			0x07;
+constexpr std::uint64_t DW_FORM_data16 =		0x1e;
+constexpr std::uint64_t DW_FORM_string =		0x08;
+constexpr std::uint64_t DW_FORM_strp =			0x0e;
+constexpr std::uint64_t DW_FORM_udata =			0x0f;
+constexpr std::uint64_t DW_FORM_line_strp =		0x1f;
+
+
+// rows of one unit, file indexes are into the unit's own names
+struct line_table::unit_rows {
+	std::vector<std::uint64_t> address;
+	std::vector<std::uint32_t> file;
+	std::vector<std::uint32_t> line;
+	std::vector<std::uint16_t> column;
+	std::vector<std::size_t> sequences;	// first row of each sequence
+	std::vector<std::string> files;
+};
+
+
+// bounds checked cursor over DWARF data, a read past the end clears good()
+template <bool swap>
+class dwarf_reader {
+
+	public:
+		dwarf_reader(const std::uint8_t* ptr, const std::uint8_t* end) : ptr(ptr), end(end) {}
+		template <int size> std::uint64_t get(void) {
+			if (end - ptr < size) return fail();
+			std::uint64_t value = load<size, swap>(ptr);
+			ptr += size;
+			return value;
+		}
+		// unsigned of 1 to 8 bytes in file order
+		std::uint64_t get_sized(std::size_t size) {
+			if (size == 0 || size > 8 || (std::size_t) (end - ptr) < size) return fail();
+			std::uint64_t value = 0;
+			for (std::size_t i=0; i<size; i++) {
+				value |= (std::uint64_t) ptr[i] << (swap != host_big_endian ? 8*(size-1-i) : 8*i);
+			}
+			ptr += size;
+			return value;
+		}
+		std::uint64_t uleb(void) {
+			std::uint64_t value = 0;
+			for (int shift=0; ptr < end; shift += 7) {
+				std::uint8_t byte = *ptr++;
+				if (shift < 64) value |= (std::uint64_t) (byte & 0x7F) << shift;
+				if (!(byte & 0x80)) return value;
+			}
+			return fail();
+		}
+		std::int64_t sleb(void) {
+			std::uint64_t value = 0;
+			int shift = 0;
+			while (ptr < end) {
+				std::uint8_t byte = *ptr++;
+				if (shift < 64) value |= (std::uint64_t) (byte & 0x7F) << shift;
+				shift += 7;
+				if (!(byte & 0x80)) {
+					if (shift < 64 && (byte & 0x40)) value |= ~(std::uint64_t) 0 << shift;
+					return value;
+				}
+			}
+			return fail();
+		}
+		std::string_view cstr(void) {
+			const void* nul = std::memchr(ptr, 0, end - ptr);
+			if (!nul) {
+				fail();
+				return std::string_view();
+			}
+			std::string_view value(reinterpret_cast<const char*>(ptr), static_cast<const std::uint8_t*>(nul) - ptr);
+			ptr += value.size() + 1;
+			return value;
+		}
+		void skip(std::uint64_t size) {
+			if (size > (std::uint64_t) (end - ptr)) fail();
+			else ptr += size;
+		}
+		bool good(void) const { return ok; }
+		bool at_end(void) const { return ptr >= end; }
+		const std::uint8_t* position(void) const { return ptr; }
+		void seek(const std::uint8_t* to) { ptr = to; }
+
+	private:
+		const std::uint8_t* ptr;
+		const std::uint8_t* end;
+		bool ok = true;
+
+		std::uint64_t fail(void) {
+			ok = false;
+			ptr = end;
+			return 0;
+		}
+};
+
+
+// string at offset of a string section, empty if it's out of range
+static std::string_view string_at(byte_view strings, std::uint64_t offset) {
+
+	if (offset >= strings.size()) return std::string_view();
+	const char* str = reinterpret_cast<const char*>(strings.data()) + offset;
+	return std::string_view(str, strnlen(str, strings.size() - offset));
+}
+
+
+static std::string join_path(std::string_view dir, std::string_view name) {
+
+	if (dir.empty() || (!name.empty() && name[0] == '/')) return std::string(name);
+	std::string path(dir);
+	if (path.back() != '/') path += '/';
+	return path.append(name);
+}
+
+
+template <bool swap>
+void line_table::decode_unit(byte_view unit, byte_view lineStr, byte_view str, unit_rows& out) {
+
+	dwarf_reader<swap> reader(unit.data(), unit.data() + unit.size());
+	bool dwarf64 = reader.template get<4>() == 0xFFFFFFFF;
+	if (dwarf64) reader.template get<8>();
+	std::uint64_t version = reader.template get<2>();
+	if (version < 2 || version > 5) return;
+	if (version >= 5) reader.skip(2);	// address and segment selector size
+	std::uint64_t headerLength = dwarf64 ? reader.template get<8>() : reader.template get<4>();
+	const std::uint8_t* program = reader.position();
+	if (headerLength > (std::uint64_t) (unit.data() + unit.size() - program)) return;
+	program += headerLength;
+	std::uint8_t minLength = reader.template get<1>();
+	if (version >= 4) reader.skip(1);	// maximum operations per instruction, VLIW only
+	reader.skip(1);				// default_is_stmt
+	std::int8_t lineBase = reader.template get<1>();
+	std::uint8_t lineRange = reader.template get<1>();
+	std::uint8_t opcodeBase = reader.template get<1>();
+	if (!reader.good() || lineRange == 0) return;
+	std::uint8_t argCount[256] = {};
+	for (int i=1; i<opcodeBase; i++) argCount[i] = reader.template get<1>();
+
+	// directory 0 is the compilation directory, DWARF 5 names it in the
+	// table and numbers files from 0, earlier versions leave it to
+	// .debug_info and number files from 1
+	std::vector<std::string_view> dirs;
+	std::deque<std::string> joined;		// backs the dirs that had to be joined
+	std::uint32_t fileBase = version >= 5 ? 0 : 1;
+	if (version < 5) {
+		dirs.push_back(std::string_view());
+		for (std::string_view dir = reader.cstr(); reader.good() && !dir.empty(); dir = reader.cstr()) {
+			dirs.push_back(dir);
+		}
+		for (std::string_view name = reader.cstr(); reader.good() && !name.empty(); name = reader.cstr()) {
+			std::uint64_t dir = reader.uleb();
+			reader.uleb();	// modification time
+			reader.uleb();	// length
+			out.files.push_back(join_path(dir < dirs.size() ? dirs[dir] : std::string_view(), name));
+		}
+	} else {
+		for (int table=0; table<2 && reader.good(); table++) {
+			std::vector<std::pair<std::uint64_t, std::uint64_t>> format(reader.template get<1>());
+			for (auto& [type, form] : format) {
+				type = reader.uleb();
+				form = reader.uleb();
+			}
+			std::uint64_t count = reader.uleb();
+			for (std::uint64_t i=0; i<count && reader.good(); i++) {
+				std::string_view path;
+				std::uint64_t dir = 0;
+				for (auto [type, form] : format) {
+					std::string_view text;
+					std::uint64_t value = 0;
+					switch (form) {
+						case DW_FORM_string: text = reader.cstr(); break;
+						case DW_FORM_line_strp:
+						case DW_FORM_strp:
+							value = dwarf64 ? reader.template get<8>() : reader.template get<4>();
+							text = string_at(form == DW_FORM_strp ? str : lineStr, value);
+							break;
+						case DW_FORM_udata: value = reader.uleb(); break;
+						case DW_FORM_data1: value = reader.template get<1>(); break;
+						case DW_FORM_data2: value = reader.template get<2>(); break;
+						case DW_FORM_data4: value = reader.template get<4>(); break;
+						case DW_FORM_data8: value = reader.template get<8>(); break;
+						case DW_FORM_data16: reader.skip(16); break;
+						case DW_FORM_block: reader.skip(reader.uleb()); break;
+						// anything else can't be sized, the header is unusable
+						default: return;
+					}
+					if (type == DW_LNCT_path) path = text;
+					if (type == DW_LNCT_directory_index) dir = value;
+				}
+				if (table == 0) {
+					// relative include directories are below the compilation directory
+					dirs.push_back(dirs.empty() || path.empty() || path[0] == '/' ? path
+							: std::string_view(joined.emplace_back(join_path(dirs[0], path))));
+				} else {
+					out.files.push_back(join_path(dir < dirs.size() ? dirs[dir] : std::string_view(), path));
+				}
+			}
+		}
+	}
+	if (!reader.good()) return;
+	std::uint32_t unknownFile = npos;
+
+	// the state machine, one row per copy, special opcode or end of sequence
+	reader.seek(program);
+	std::uint64_t address = 0;
+	std::uint32_t file = 1, line = 1, column = 0;
+	std::size_t sequenceStart = out.address.size();
+	auto emit = [&](bool end) {
+		std::uint32_t index = npos;
+		if (!end) {
+			index = file - fileBase;
+			if (file < fileBase || index >= out.files.size()) {
+				if (unknownFile == npos) {
+					unknownFile = out.files.size();
+					out.files.push_back("??");
+				}
+				index = unknownFile;
+			}
+		}
+		out.address.push_back(address);
+		out.file.push_back(index);
+		out.line.push_back(line);
+		out.column.push_back(std::min<std::uint32_t>(column, 0xFFFF));
+	};
+	while (!reader.at_end()) {
+		std::uint8_t opcode = reader.template get<1>();
+		if (opcode >= opcodeBase) {
+			std::uint8_t adjusted = opcode - opcodeBase;
+			address += (adjusted / lineRange) * minLength;
+			line += lineBase + adjusted % lineRange;
+			emit(false);
+			continue;
+		}
+		switch (opcode) {
+			case 0: {
+				std::uint64_t size = reader.uleb();
+				if (size == 0 || size > (std::uint64_t) (unit.data() + unit.size() - reader.position())) {
+					reader.skip(size);
+					break;
+				}
+				// in bounds now that size is checked
+				const std::uint8_t* next = reader.position() + size;
+				std::uint8_t extended = reader.template get<1>();
+				if (extended == DW_LNE_end_sequence) {
+					emit(true);
+					out.sequences.push_back(sequenceStart);
+					sequenceStart = out.address.size();
+					address = 0;
+					file = 1;
+					line = 1;
+					column = 0;
+				} else if (extended == DW_LNE_set_address) {
+					address = reader.get_sized(size - 1);
+				} else if (extended == DW_LNE_define_file && version < 5) {
+					std::string_view name = reader.cstr();
+					std::uint64_t dir = reader.uleb();
+					out.files.push_back(join_path(dir < dirs.size() ? dirs[dir] : std::string_view(), name));
+				}
+				reader.seek(next);
+				break;
+			}
+			case DW_LNS_copy: emit(false); break;
+			case DW_LNS_advance_pc: address += reader.uleb() * minLength; break;
+			case DW_LNS_advance_line: line += reader.sleb(); break;
+			case DW_LNS_set_file: file = reader.uleb(); break;
+			case DW_LNS_set_column: column = reader.uleb(); break;
+			case DW_LNS_const_add_pc: address += ((255 - opcodeBase) / lineRange) * minLength; break;
+			case DW_LNS_fixed_advance_pc: address += reader.template get<2>(); break;
+			default:
+				for (int i=0; i<argCount[opcode]; i++) reader.uleb();
+		}
+	}
+	// rows after the last end of sequence belong to no sequence
+	out.address.resize(sequenceStart);
+	out.file.resize(sequenceStart);
+	out.line.resize(sequenceStart);
+	out.column.resize(sequenceStart);
+}
+
+
+line_table::line_table(byte_view debugLine, byte_view debugLineStr, byte_view debugStr,
+			bool bigEndian, line_options options) {
+
+	// unit boundaries come from the length fields alone, so finding them
+	// is a quick walk and the programs can then be run independently
+	std::vector<unit_t> list;
+	bool swap = bigEndian != host_big_endian;
+	std::size_t offset = 0;
+	while (debugLine.size() - offset >= 4) {
+		std::uint64_t length = swap ? load<4, true>(debugLine.data() + offset)
+						: load<4, false>(debugLine.data() + offset);
+		std::size_t field = 4;
+		if (length == 0xFFFFFFFF) {
+			if (debugLine.size() - offset < 12) break;
+			length = swap ? load<8, true>(debugLine.data() + offset + 4)
+					: load<8, false>(debugLine.data() + offset + 4);
+			field = 12;
+		}
+		if (length > debugLine.size() - offset - field) break;
+		list.push_back({offset, field + length});
+		offset += field + length;
+	}
+	unitCount = list.size();
+
+	std::vector<unit_rows> decoded(list.size());
+	auto decode = [&](std::size_t i) {
+		byte_view unit(debugLine.data() + list[i].offset, list[i].size);
+		if (swap) {
+			decode_unit<true>(unit, debugLineStr, debugStr, decoded[i]);
+		} else {
+			decode_unit<false>(unit, debugLineStr, debugStr, decoded[i]);
+		}
+	};
+	std::size_t threads = options.threads ? options.threads : std::thread::hardware_concurrency();
+	threads = std::max<std::size_t>(1, std::min(threads, list.size()));
+	if (threads == 1) {
+		for (std::size_t i=0; i<list.size(); i++) decode(i);
+	} else {
+		// units vary a lot in size, hand them out one at a time
+		std::atomic<std::size_t> next {0};
+		std::vector<std::thread> workers;
+		for (std::size_t t=0; t<threads; t++) {
+			workers.emplace_back([&]() {
+				for (std::size_t i = next++; i < list.size(); i = next++) decode(i);
+			});
+		}
+		for (std::thread& worker : workers) worker.join();
+	}
+	merge(decoded);
+}
+
+
+void line_table::merge(std::vector<unit_rows>& decoded) {
+
+	// one name per distinct path across all units, the keys view the kept
+	// names, which don't move as files is reserved up front
+	std::size_t names = 0, rows = 0;
+	for (const unit_rows& unit : decoded) {
+		names += unit.files.size();
+		rows += unit.address.size();
+	}
+	files.reserve(names);
+	std::unordered_map<std::string_view, std::uint32_t> fileIds;
+	std::vector<std::vector<std::uint32_t>> fileMaps(decoded.size());
+	for (std::size_t u=0; u<decoded.size(); u++) {
+		for (std::string& name : decoded[u].files) {
+			auto it = fileIds.find(name);
+			if (it == fileIds.end()) {
+				files.push_back(std::move(name));
+				it = fileIds.emplace(files.back(), files.size() - 1).first;
+			}
+			fileMaps[u].push_back(it->second);
+		}
+	}
+
+	typedef struct sequence_t {
+		std::uint64_t start;
+		std::uint32_t unit;
+		std::size_t first;
+		std::size_t last;	// the end row
+	} sequence_t;
+	std::vector<sequence_t> sequences;
+	for (std::uint32_t u=0; u<decoded.size(); u++) {
+		const unit_rows &unit = decoded[u];
+		for (std::size_t i=0; i<unit.sequences.size(); i++) {
+			std::size_t first = unit.sequences[i];
+			std::size_t last = i+1 < unit.sequences.size() ? unit.sequences[i+1] - 1 : unit.address.size() - 1;
+			sequences.push_back({unit.address[first], u, first, last});
+		}
+	}
+	std::stable_sort(sequences.begin(), sequences.end(), [](const sequence_t& a, const sequence_t& b) {
+		return a.start < b.start;
+	});
+
+	rowDelta.reserve(rows);
+	rowFile.reserve(rows);
+	rowLine.reserve(rows);
+	rowColumn.reserve(rows);
+	std::uint64_t covered = 0, last = 0;
+	for (const sequence_t& sequence : sequences) {
+		const unit_rows &unit = decoded[sequence.unit];
+		// overlapping sequences are left over from discarded code, usually
+		// at address 0, the first one at an address wins
+		if (sequence.start < covered || unit.address[sequence.last] < sequence.start) continue;
+		covered = unit.address[sequence.last];
+		for (std::size_t i=sequence.first; i<=sequence.last; i++) {
+			std::uint32_t file = unit.file[i] == npos ? npos : fileMaps[sequence.unit][unit.file[i]];
+			if (!empty() && last == unit.address[i]) {
+				// only the last row at an address can be found
+				rowFile.back() = file;
+				rowLine.back() = unit.line[i];
+				rowColumn.back() = unit.column[i];
+				continue;
+			}
+			if (!empty() && file != npos && rowFile.back() == file
+					&& rowLine.back() == unit.line[i] && rowColumn.back() == unit.column[i]) {
+				continue;
+			}
+			push_row(unit.address[i], file, unit.line[i], unit.column[i]);
+			last = unit.address[i];
+		}
+	}
+	blockFirst.push_back(size());
+	files.shrink_to_fit();
+	blockStart.shrink_to_fit();
+	blockFirst.shrink_to_fit();
+	rowDelta.shrink_to_fit();
+	rowFile.shrink_to_fit();
+	rowLine.shrink_to_fit();
+	rowColumn.shrink_to_fit();
+}
+
+
+void line_table::push_row(std::uint64_t address, std::uint32_t file, std::uint32_t line, std::uint16_t column) {
+
+	if (blockStart.empty() || size() - blockFirst.back() == block_rows
+			|| address - blockStart.back() > 0xFFFFFFFF) {
+		blockStart.push_back(address);
+		blockFirst.push_back(size());
+	}
+	rowDelta.push_back(address - blockStart.back());
+	rowFile.push_back(file);
+	rowLine.push_back(line);
+	rowColumn.push_back(column);
+}
+
+
+std::uint64_t line_table::address(std::uint32_t row) const {
+
+	std::size_t block = std::upper_bound(blockFirst.begin(), blockFirst.end() - 1, row) - blockFirst.begin() - 1;
+	return blockStart[block] + rowDelta[row];
+}
+
+
+std::uint32_t line_table::lookup(std::uint64_t address) const {
+
+	auto block = std::upper_bound(blockStart.begin(), blockStart.end(), address);
+	if (block == blockStart.begin()) return npos;
+	std::size_t index = block - blockStart.begin() - 1;
+	std::uint64_t delta = address - blockStart[index];
+	const std::uint32_t* first = rowDelta.data() + blockFirst[index];
+	const std::uint32_t* last = rowDelta.data() + blockFirst[index+1];
+	// the first offset is 0, so the row found is in this block
+	std::uint32_t row = delta > 0xFFFFFFFF ? last - rowDelta.data() - 1
+				: std::upper_bound(first, last, (std::uint32_t) delta) - rowDelta.data() - 1;
+	return rowFile[row] == npos ? npos : row;
+}
+
+
+void line_table::lookup(const std::uint64_t* addresses, std::size_t count, std::uint32_t* result) const {
+
+	// a merge pays off once the queries are dense relative to the table
+	std::size_t depth = 64 - __builtin_clzll(size() | 1);
+	if (count * depth < size() || count < 64) {
+		for (std::size_t i=0; i<count; i++) result[i] = lookup(addresses[i]);
+		return;
+	}
+	std::vector<std::uint32_t> queries(count);
+	for (std::size_t i=0; i<count; i++) queries[i] = i;
+	std::sort(queries.begin(), queries.end(), [addresses](std::uint32_t a, std::uint32_t b) {
+		return addresses[a] < addresses[b];
+	});
+	// upper is the first row past the address, in block
+	std::size_t upper = 0, block = 0;
+	for (std::uint32_t query : queries) {
+		std::uint64_t address = addresses[query];
+		while (upper < size()) {
+			if (upper == blockFirst[block+1]) block++;
+			if (blockStart[block] + rowDelta[upper] > address) break;
+			upper++;
+		}
+		result[query] = upper && rowFile[upper-1] != npos ? upper-1 : npos;
+	}
+}
+
+
+std::vector<std::uint32_t> line_table::lookup(const std::vector<std::uint64_t>& addresses) const {
+
+	std::vector<std::uint32_t> result(addresses.size());
+	lookup(addresses.data(), addresses.size(), result.data());
+	return result;
+}
+
+
+std::size_t line_table::memory_usage(void) const {
+
+	std::size_t bytes = blockStart.capacity() * sizeof(std::uint64_t)
+				+ blockFirst.capacity() * sizeof(std::uint32_t)
+				+ rowDelta.capacity() * sizeof(std::uint32_t)
+				+ rowFile.capacity() * sizeof(std::uint32_t)
+				+ rowLine.capacity() * sizeof(std::uint32_t)
+				+ rowColumn.capacity() * sizeof(std::uint16_t)
+				+ files.capacity() * sizeof(std::string);
+	// short names live inside the string object
+	for (const std::string& name : files) {
+		if (name.capacity() > sizeof(std::string) - 1) bytes += name.capacity() + 1;
+	}
+	return bytes;
+}
+
+} // end of namespace elf
@@ -0,0 +1,234 @@
+#include "../inc/elf_notes.hpp"
+
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+
+
+namespace elf {
+
+
+template <bool swap>
+static void decode_note_entries(byte_view notes, bool is64, std::uint64_t align, note_info& info) {
+
+	// each entry is namesz, descsz, type, then the name and the desc both
+	// padded to the alignment
+	auto pad = [align](std::uint64_t value) { return (value + align - 1) & ~(align - 1); };
+	std::uint64_t pos = 0;
+	while (pos + 12 <= notes.size()) {
+		std::uint64_t namesz = load<4, swap>(notes.data()+pos);
+		std::uint64_t descsz = load<4, swap>(notes.data()+pos+4);
+		std::uint32_t type = load<4, swap>(notes.data()+pos+8);
+		std::uint64_t name = pos + 12;
+		std::uint64_t desc = pad(name + namesz);
+		if (desc > notes.size() || descsz > notes.size() - desc) break;
+
+		elf_note note;
+		note.type = type;
+		const char* text = reinterpret_cast<const char*>(notes.data()+name);
+		note.name.assign(text, strnlen(text, namesz));
+		note.desc.assign(notes.data()+desc, notes.data()+desc+descsz);
+		pos = pad(desc + descsz);
+
+		if (note.name != "GNU") {
+			info.notes.push_back(std::move(note));
+			continue;
+		}
+		const std::uint8_t* ptr = notes.data()+desc;
+		if (type == NT_GNU_BUILD_ID && info.build_id.empty()) {
+			static const char digits[] = "0123456789abcdef";
+			info.build_id.resize(2*descsz);
+			for (std::uint64_t i=0; i<descsz; i++) {
+				info.build_id[2*i] = digits[ptr[i] >> 4];
+				info.build_id[2*i+1] = digits[ptr[i] & 0xF];
+			}
+		} else if (type == NT_GNU_ABI_TAG && descsz >= 16) {
+			info.abi.present = true;
+			info.abi.os =		load<4, swap>(ptr);
+			info.abi.major =	load<4, swap>(ptr+4);
+			info.abi.minor =	load<4, swap>(ptr+8);
+			info.abi.patch =	load<4, swap>(ptr+12);
+		} else if (type == NT_GNU_PROPERTY_TYPE_0) {
+			// pr_type, pr_datasz and the data padded to the word size
+			std::uint64_t word = is64 ? 8 : 4;
+			std::uint64_t at = 0;
+			while (at + 8 <= descsz) {
+				gnu_property property;
+				property.type = load<4, swap>(ptr+at);
+				std::uint64_t size = load<4, swap>(ptr+at+4);
+				if (size > descsz - at - 8) break;
+				property.data.assign(ptr+at+8, ptr+at+8+size);
+				info.properties.push_back(std::move(property));
+				at = (at + 8 + size + word - 1) & ~(word - 1);
+			}
+		}
+		info.notes.push_back(std::move(note));
+	}
+}
+
+
+void decode_notes(byte_view notes, bool is64, bool bigEndian, std::uint64_t align, note_info& info) {
+
+	// 0 and 1 mean no constraint, anything but 8 is laid out as 4
+	align = align == 8 ? 8 : 4;
+	bigEndian != host_big_endian ? decode_note_entries<true>(notes, is64, align, info)
+				: decode_note_entries<false>(notes, is64, align, info);
+}
+
+
+// Keeps the first page of a file, reads outside of it go to a scratch
+// buffer that is reused by the next one
+class head_reader {
+
+	public:
+		static constexpr std::size_t head_size = 4096;
+
+		head_reader(int fd, note_info& info) : fd(fd), info(info) {
+			head.resize(head_size);
+			ssize_t got = fill(head.data(), head_size, 0);
+			head.resize(got < 0 ? 0 : got);
+		}
+		const std::vector<std::uint8_t>& first_page(void) const { return head; }
+		// empty view if the range isn't fully in the file
+		byte_view read(std::uint64_t offset, std::uint64_t size) {
+			byte_view inHead = byte_view(head.data(), head.size()).subview(offset, size);
+			if (!inHead.empty() || size == 0) return inHead;
+			// the first page came back short, so the file ends in it
+			if (head.size() < head_size) return byte_view();
+			scratch.resize(size);
+			if (fill(scratch.data(), size, offset) != (ssize_t) size) return byte_view();
+			return byte_view(scratch.data(), size);
+		}
+
+	private:
+		int fd;
+		note_info& info;
+		std::vector<std::uint8_t> head;
+		std::vector<std::uint8_t> scratch;
+
+		ssize_t fill(std::uint8_t* dst, std::size_t size, std::uint64_t offset) {
+			std::size_t done = 0;
+			while (done < size) {
+				info.reads++;
+				ssize_t got = pread(fd, dst + done, size - done, offset + done);
+				if (got < 0 && errno == EINTR) continue;
+				if (got < 0) return -1;
+				if (got == 0) break;
+				done += got;
+			}
+			return done;
+		}
+};
+
+
+typedef struct note_range {
+	std::uint64_t offset;
+	std::uint64_t size;
+	std::uint64_t align;
+} note_range;
+
+
+template <typename elf_class, bool swap>
+static void read_class_notes(head_reader& reader, note_info& info) {
+
+	const std::vector<std::uint8_t>& head = reader.first_page();
+	if (head.size() < (std::size_t) elf_class::e_shstrndx_offset + e_shstrndx_size) throw 2;
+	const std::uint8_t* ptr = head.data();
+	std::uint64_t phoff =	load<elf_class::e_phoff_size, swap>(ptr + elf_class::e_phoff_offset);
+	std::uint64_t shoff =	load<elf_class::e_shoff_size, swap>(ptr + elf_class::e_shoff_offset);
+	std::size_t phentsize =	load<2, swap>(ptr + elf_class::e_phentsize_offset);
+	std::size_t phnum =	load<2, swap>(ptr + elf_class::e_phnum_offset);
+	std::size_t shentsize =	load<2, swap>(ptr + elf_class::e_shentsize_offset);
+	std::size_t shnum =	load<2, swap>(ptr + elf_class::e_shnum_offset);
+	bool bigEndian = head[EI_DATA_offset] == 2;
+	bool is64 = elf_class::elf_class == 2;
+
+	// ranges are collected before reading any, the scratch buffer holding
+	// a table is reused by the next read
+	std::vector<note_range> ranges;
+	if ((phnum == 0xffff || shnum == 0) && shoff) {
+		// extended counts are kept in section 0
+		if (shentsize < elf_class::shdr_size) throw 2;
+		byte_view first = reader.read(shoff, shentsize);
+		if (first.empty()) throw 3;
+		if (phnum == 0xffff) phnum = load<4, swap>(first.data() + elf_class::sh_info_offset);
+		if (shnum == 0) shnum = load<elf_class::sh_size_size, swap>(first.data() + elf_class::sh_size_offset);
+	}
+	if (phnum) {
+		if (phentsize < elf_class::phdr_size) throw 2;
+		byte_view table = reader.read(phoff, (std::uint64_t) phentsize * phnum);
+		if (table.empty()) throw 3;
+		for (std::size_t i=0; i<phnum; i++) {
+			const std::uint8_t* entry = table.data() + phentsize * i;
+			if (load<4, swap>(entry + p_type_offset) != 0x04) continue;
+			ranges.push_back({
+				load<elf_class::p_offset_size, swap>(entry + elf_class::p_offset_offset),
+				load<elf_class::p_filesz_size, swap>(entry + elf_class::p_filesz_offset),
+				load<elf_class::p_align_size, swap>(entry + elf_class::p_align_offset)});
+		}
+	}
+	if (ranges.empty() && shnum && shoff) {
+		if (shentsize < elf_class::shdr_size) throw 2;
+		byte_view table = reader.read(shoff, (std::uint64_t) shentsize * shnum);
+		if (table.empty()) throw 3;
+		for (std::size_t i=0; i<shnum; i++) {
+			const std::uint8_t* entry = table.data() + shentsize * i;
+			if (load<4, swap>(entry + sh_type_offset) != 0x07) continue;
+			ranges.push_back({
+				load<elf_class::sh_offset_size, swap>(entry + elf_class::sh_offset_offset),
+				load<elf_class::sh_size_size, swap>(entry + elf_class::sh_size_offset),
+				load<elf_class::sh_addralign_size, swap>(entry + elf_class::sh_addralign_offset)});
+		}
+	}
+
+	for (const note_range &range : ranges) {
+		byte_view notes = reader.read(range.offset, range.size);
+		if (notes.empty() && range.size) throw 3;
+		decode_notes(notes, is64, bigEndian, range.align, info);
+	}
+}
+
+
+bool read_notes(const std::string& file, note_info& info, parse_error& error) {
+
+	info = note_info();
+	error = parse_error();
+	int fd = ::open(file.c_str(), O_RDONLY | O_CLOEXEC);
+	if (fd < 0) {
+		error.code = errno == ENOENT ? parse_errc::file_not_found : parse_errc::io_error;
+		error.message = parse_error_message(error.code);
+		return false;
+	}
+	try {
+		head_reader reader(fd, info);
+		const std::vector<std::uint8_t>& head = reader.first_page();
+		if (head.size() < EI_PAD_offset || head[0] != 0x7F || head[1] != 0x45
+				|| head[2] != 0x4c || head[3] != 0x46) {
+			throw 1;
+		}
+		bool swap = (head[EI_DATA_offset] == 2) != host_big_endian;
+		if (head[EI_CLASS_offset] == 1) {
+			swap ? read_class_notes<elf32_traits, true>(reader, info)
+				: read_class_notes<elf32_traits, false>(reader, info);
+		} else if (head[EI_CLASS_offset] == 2) {
+			swap ? read_class_notes<elf64_traits, true>(reader, info)
+				: read_class_notes<elf64_traits, false>(reader, info);
+		} else {
+			throw 2;
+		}
+	}
+	catch (int e) {
+		error.code = static_cast<parse_errc>(e);
+	}
+	catch (const std::exception&) {
+		// tables sized from a corrupt header
+		error.code = parse_errc::io_error;
+	}
+	::close(fd);
+	error.message = parse_error_message(error.code);
+	return !error;
+}
+
+
+} // end of namespace elf
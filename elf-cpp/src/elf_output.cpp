@@ -0,0 +1,128 @@
+#include "../inc/elf_output.hpp"
+
+#include <cerrno>
+#include <charconv>
+#include <cstring>
+#include <unistd.h>
+
+
+namespace elf {
+
+
+void fd_sink::write(const char* data, std::size_t size) {
+
+	while (size) {
+		ssize_t done = ::write(fd, data, size);
+		if (done < 0 && errno == EINTR) continue;
+		// nowhere to report it, the rest is dropped like a closed stream would
+		if (done <= 0) return;
+		data += done;
+		size -= done;
+	}
+}
+
+
+output_buffer::output_buffer(output_sink& sink, std::size_t chunkSize)
+		: sink(sink), chunkSize(chunkSize ? chunkSize : 1) {
+
+	// room for a chunk and the longest single append past it
+	bytes.resize(this->chunkSize + 256);
+}
+
+
+char* output_buffer::reserve(std::size_t size) {
+
+	if (used + size > bytes.size()) bytes.resize(used + size);
+	return &bytes[used];
+}
+
+
+void output_buffer::flush(void) {
+
+	if (used) sink.write(bytes.data(), used);
+	used = 0;
+}
+
+
+output_buffer& output_buffer::put(std::string_view text) {
+
+	std::memcpy(reserve(text.size()), text.data(), text.size());
+	commit(text.size());
+	return *this;
+}
+
+
+output_buffer& output_buffer::put(char c) {
+
+	*reserve(1) = c;
+	commit(1);
+	return *this;
+}
+
+
+output_buffer& output_buffer::pad(std::string_view text, std::size_t width, bool left) {
+
+	std::size_t fill = width > text.size() ? width - text.size() : 0;
+	char* out = reserve(text.size() + fill);
+	if (!left) out = (char*) std::memset(out, ' ', fill) + fill;
+	std::memcpy(out, text.data(), text.size());
+	if (left) std::memset(out + text.size(), ' ', fill);
+	commit(text.size() + fill);
+	return *this;
+}
+
+
+output_buffer& output_buffer::number(const char* digits, std::size_t count, std::size_t width, char fill) {
+
+	std::size_t spaces = width > count ? width - count : 0;
+	char* out = reserve(spaces + count);
+	std::memset(out, fill, spaces);
+	std::memcpy(out + spaces, digits, count);
+	commit(spaces + count);
+	return *this;
+}
+
+
+output_buffer& output_buffer::dec(std::uint64_t value, std::size_t width, char fill) {
+
+	char digits[20];
+	std::size_t count = std::to_chars(digits, digits + sizeof(digits), value).ptr - digits;
+	return number(digits, count, width, fill);
+}
+
+
+output_buffer& output_buffer::hex(std::uint64_t value, std::size_t width, char fill) {
+
+	char digits[16];
+	std::size_t count = std::to_chars(digits, digits + sizeof(digits), value, 16).ptr - digits;
+	return number(digits, count, width, fill);
+}
+
+
+output_buffer& output_buffer::json(std::string_view text) {
+
+	// names are plain ASCII almost always, runs without escapes are copied whole
+	static const char digits[] = "0123456789abcdef";
+	put('"');
+	std::size_t start = 0;
+	for (std::size_t i=0; i<text.size(); i++) {
+		unsigned char c = text[i];
+		if (c >= 0x20 && c != '"' && c != '\\') continue;
+		put(text.substr(start, i - start));
+		if (c == '"' || c == '\\') {
+			put('\\').put((char) c);
+		} else if (c == '\n') {
+			put("\\n");
+		} else if (c == '\t') {
+			put("\\t");
+		} else {
+			put("\\u00").put(digits[c >> 4]).put(digits[c & 0xF]);
+		}
+		start = i + 1;
+	}
+	put(text.substr(start));
+	return put('"');
+}
+
+
+} // end of namespace elf
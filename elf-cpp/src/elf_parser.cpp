@@ -1,10 +1,18 @@
 #include "../inc/elf_parser.hpp"
+#include "../inc/elf_cache.hpp"
+#include "../inc/elf_stats.hpp"
+
+#include <atomic>
+#include <cstring>
+#include <new>
+#include <thread>
 
 
 namespace elf {
 
 
-bool compare_sections_32(const section32_t& a, const section32_t& b) {
+template <typename section_t>
+bool compare_sections(const section_t& a, const section_t& b) {
 
         return a.sh_offset < b.sh_offset ?
 				true : (a.sh_offset == b.sh_offset ?
@@ -18,65 +26,122 @@ bool compare_sections_32(const section32_t& a, const section32_t& b) {
 //}
 
 
-elf_parser* elf_parser::read_file(std::string file) {
+elf_parser* elf_parser::read_file(std::string file, read_options options) {
+
+	parse_error error;
+	std::unique_ptr<elf_parser> parser = open(file, error, options);
+	if (parser) return parser.release();
+	std::cout << "Exception: " << error.message << std::endl;
+	return new elf_error();
+}
+
+
+std::string parse_error_message(parse_errc code) {
+
+	switch (code) {
+		case parse_errc::none:
+			return "";
+		case parse_errc::file_not_found:
+			return "File doesn't exist";
+		case parse_errc::bad_magic:
+			return "Incorrect magic number for ELF format";
+		case parse_errc::bad_header:
+			return "Unexpected value in ELF header";
+		case parse_errc::out_of_bounds:
+			return "ELF table or section outside of file";
+		case parse_errc::io_error:
+			return "File couldn't be read";
+		case parse_errc::bad_edit:
+			return "Edit can't be applied to the file";
+	}
+	return "";
+}
+
 
+std::unique_ptr<elf_parser> elf_parser::open(const std::string& file, parse_error& error,
+						read_options options) {
+
+	error = parse_error();
 	try {
-		std::vector<std::uint8_t> bytes;
+		file_key key;
+		if (options.cache) {
+			std::unique_ptr<elf_parser> cached = options.cache->load(file, options, key);
+			if (cached) return cached;
+		}
+
+		std::shared_ptr<file_buffer> buffer;
 		if (std::filesystem::exists(file)) {
-			std::ifstream fileIt(file, std::ios::binary);
-        		bytes = std::vector<std::uint8_t>(
-					(std::istreambuf_iterator<char>(fileIt)),
-					(std::istreambuf_iterator<char>()));
-        		fileIt.close();
+			// lazy copies are taken from the mapping on first access
+			if (options.mode == load_mode::stream) {
+				buffer = file_buffer::stream_file(file);
+			} else if (options.mode == load_mode::map || options.lazy) {
+				buffer = file_buffer::map_file(file);
+			} else {
+				buffer = file_buffer::read_file(file);
+			}
 		} else {
 			throw 0;
 		}
 
-		if (bytes[0] != 0x7F || bytes[1] != 0x45
-				|| bytes[2] != 0x4c || bytes[3] != 0x46) {
+		std::unique_ptr<elf_parser> parser = open(buffer, error, options);
+		if (parser && options.cache) options.cache->store(key, *parser);
+		return parser;
+	}
+	catch (int e) {
+		error.code = static_cast<parse_errc>(e);
+	}
+	catch (const std::exception&) {
+		// filesystem errors and allocations sized from a corrupt header
+		error.code = parse_errc::io_error;
+	}
+	error.message = parse_error_message(error.code);
+	return nullptr;
+}
+
+
+std::unique_ptr<elf_parser> elf_parser::open(std::shared_ptr<file_buffer> buffer, parse_error& error,
+						read_options options) {
+
+	error = parse_error();
+	try {
+		byte_view ident = buffer->read(0, EI_PAD_offset);
+		if (ident.empty() || ident[0] != 0x7F || ident[1] != 0x45
+				|| ident[2] != 0x4c || ident[3] != 0x46) {
 			throw 1;
 		}
 
-		if (bytes[EI_CLASS_offset] == 1) {
+		options.cache = nullptr;
+		if (ident[EI_CLASS_offset] == 1) {
                 	// 32-bit format
-                	return new elf_32_parser(bytes);
-        	} else if (bytes[EI_CLASS_offset] == 2) {
+                	return std::make_unique<elf_32_parser>(buffer, options);
+        	} else if (ident[EI_CLASS_offset] == 2) {
                 	// 64-bit format
-                	return new elf_64_parser(bytes);
-        	} else {
-			throw 2;
-		}
-	}
- 	catch (int e) {
-		switch(e) {
-			case 0:
-				std::cout << "Exception: File doesn't exist"
-						<< std::endl;
-				break;
-			case 1:
-				std::cout << "Exception: Incorrect magic number"
-						" for ELF format" << std::endl;
-				break;
-			case 2:
-				std::cout << "Exception: Unexpected value in ELF"
-						" header" << std::endl;
-				break;
-		}
-	return new elf_error();
+                	return std::make_unique<elf_64_parser>(buffer, options);
+        	}
+		throw 2;
+	}
+	catch (int e) {
+		error.code = static_cast<parse_errc>(e);
 	}
+	catch (const std::exception&) {
+		// allocations sized from a corrupt header
+		error.code = parse_errc::io_error;
+	}
+	error.message = parse_error_message(error.code);
+	return nullptr;
 }
 
 
-unsigned int elf_parser::join_bytes(std::vector<std::uint8_t>::iterator ptr,
+std::uint64_t elf_parser::join_bytes(const std::uint8_t* ptr,
 					int numOfBytes, bool bigEndian) {
 
-	unsigned int result = 0;
+	std::uint64_t result = 0;
 	for (int i=0; i<numOfBytes; i++) {
 		if (bigEndian) {
 			result = result << 8;
 			result += (std::uint8_t) *ptr;
 		} else {
-			result += ((std::uint8_t) *ptr) << (8*i);
+			result += ((std::uint64_t) *ptr) << (8*i);
         	}
         	ptr++;
 	}
@@ -84,353 +149,985 @@ unsigned int elf_parser::join_bytes(std::vector<std::uint8_t>::iterator ptr,
 }
 
 
-elf_32_parser::elf_32_parser(std::vector<std::uint8_t> bytes) {
+template <typename elf_class>
+elf_class_parser<elf_class>::elf_class_parser(std::vector<std::uint8_t> bytes)
+		: elf_class_parser(file_buffer::from_vector(std::move(bytes)), load_mode::copy) {}
+
+
+template <typename elf_class>
+elf_class_parser<elf_class>::elf_class_parser(std::shared_ptr<file_buffer> buffer, read_options options) {
+
+	this->buffer = buffer;
+	this->options = options;
+	stat_add(stat_counter::files_parsed);
 
 	// parse file header
+	byte_view bytes = buffer->read(0, elf_class::e_shstrndx_offset+e_shstrndx_size);
+	if (bytes.empty()) throw 3;
 	for (int i=0; i<10; i++) elfHeader.e_ident.push_back(bytes[i]);
-	bool bigEndian = bytes[EI_DATA_offset] == 2;
-	elfHeader.e_type = 	join_bytes(bytes.begin()+e_type_offset,
-						e_type_size, bigEndian);
-	elfHeader.e_machine = 	join_bytes(bytes.begin()+e_machine_offset,
-						e_machine_size, bigEndian);
-	elfHeader.e_version = 	join_bytes(bytes.begin()+e_version_offset,
-						e_version_size, bigEndian);
-	elfHeader.e_entry = 	join_bytes(bytes.begin()+e_entry_offset,
-						e_entry_32_size, bigEndian);
-	elfHeader.e_phoff = 	join_bytes(bytes.begin()+e_phoff_32_offset, 
-						e_phoff_32_size, bigEndian);
-	elfHeader.e_shoff = 	join_bytes(bytes.begin()+e_shoff_32_offset,
-						e_shoff_32_size, bigEndian);
-	elfHeader.e_flags = 	join_bytes(bytes.begin()+e_flags_32_offset,
-						e_flags_size, bigEndian);
-	elfHeader.e_ehsize = 	join_bytes(bytes.begin()+e_ehsize_32_offset,
-						e_ehsize_size, bigEndian);
-	elfHeader.e_phentsize = join_bytes(bytes.begin()+e_phentsize_32_offset,
-						e_phentsize_size, bigEndian);
-	elfHeader.e_phnum = 	join_bytes(bytes.begin()+e_phnum_32_offset,
-						e_phnum_size, bigEndian);
-	elfHeader.e_shentsize = join_bytes(bytes.begin()+e_shentsize_32_offset,
-						e_shentsize_size, bigEndian);
-	elfHeader.e_shnum = 	join_bytes(bytes.begin()+e_shnum_32_offset,
-						e_shnum_size, bigEndian);
-	elfHeader.e_shstrndx = 	join_bytes(bytes.begin()+e_shstrndx_32_offset,
-						e_shstrndx_size, bigEndian);
+	bool swap = (bytes[EI_DATA_offset] == 2) != host_big_endian;
+	swap ? decode_elf_header<true>(bytes) : decode_elf_header<false>(bytes);
 
 	// parse section header
-	for (int i=0; i<elfHeader.e_shnum; i++) {
-		int offset = elfHeader.e_shoff + elfHeader.e_shentsize * i;
-		section32_t header;
-		header.sh_name = 	join_bytes(bytes.begin()+offset+sh_name_offset,
-							sh_name_size, bigEndian);
-		header.sh_type = 	join_bytes(bytes.begin()+offset+sh_type_offset,
-							sh_type_size, bigEndian);
-		header.sh_flags = 	join_bytes(bytes.begin()+offset+sh_flags_offset,
-							sh_flags_32_size, bigEndian);
-		header.sh_addr = 	join_bytes(bytes.begin()+offset+sh_addr_32_offset,
-							sh_addr_32_size, bigEndian);
-		header.sh_offset = 	join_bytes(bytes.begin()+offset+sh_offset_32_offset,
-							sh_offset_32_size, bigEndian);
-		header.sh_size = 	join_bytes(bytes.begin()+offset+sh_size_32_offset,
-							sh_size_32_size, bigEndian);
-		header.sh_link = 	join_bytes(bytes.begin()+offset+sh_link_32_offset,
-							sh_link_size, bigEndian);
-		header.sh_info = 	join_bytes(bytes.begin()+offset+sh_info_32_offset,
-							sh_info_size, bigEndian);
-		header.sh_addralign = 	join_bytes(bytes.begin()+offset+sh_addralign_32_offset,
-							sh_addralign_32_size, bigEndian);
-		header.sh_entsize = 	join_bytes(bytes.begin()+offset+sh_entsize_32_offset,
-							sh_entsize_32_size, bigEndian);
-		for (int i=header.sh_offset; i-header.sh_offset<header.sh_size; i++) {
-			header.bytes.push_back(bytes[i]);
-		}
-		sectionHeaderTable.push_back(header);
+	std::size_t shnum = elfHeader.e_shnum;
+	std::size_t shstrndx = elfHeader.e_shstrndx;
+	std::size_t phnum = elfHeader.e_phnum;
+	byte_view table;
+	if (elfHeader.e_shoff) {
+		// 0xff00 or more sections, the real counts are kept in section 0
+		if (elfHeader.e_shentsize < elf_class::shdr_size) throw 2;
+		table = buffer->read(elfHeader.e_shoff, elfHeader.e_shentsize);
+		if (table.empty()) throw 3;
+		swap ? decode_section_table<true>(table, 1) : decode_section_table<false>(table, 1);
+		if (shnum == 0) shnum = sectionHeaderTable[0].sh_size;
+		if (shstrndx == 0xffff) shstrndx = sectionHeaderTable[0].sh_link;
+		if (phnum == 0xffff) phnum = sectionHeaderTable[0].sh_info;
+	}
+	if (shnum && elfHeader.e_shentsize < elf_class::shdr_size) throw 2;
+	table = buffer->read(elfHeader.e_shoff, (std::uint64_t) elfHeader.e_shentsize * shnum);
+	if (shnum && table.empty()) throw 3;
+	swap ? decode_section_table<true>(table, shnum) : decode_section_table<false>(table, shnum);
+	stat_add(stat_counter::sections_decoded, shnum);
+	if (!options.lazy) {
+		std::vector<section_t*> all;
+		for (section_t &section : sectionHeaderTable) all.push_back(&section);
+		load_sections(all);
 	}
 
 	// parser string table
-	sectionHeader32_t stringTableHeader = sectionHeaderTable[elfHeader.e_shstrndx];
-	for (section32_t &section : sectionHeaderTable) {
-		if (section.sh_type == 0x00) {
-			continue;
-		}
-		int offset = stringTableHeader.sh_offset + section.sh_name;
-		std::string sectionName = "";
-		while (bytes[offset] != '\0') {
-			sectionName += bytes[offset];
-			offset++;
+	byte_view stringTable;
+	sectionIndex.reserve(sectionHeaderTable.size());
+	if (shstrndx < sectionHeaderTable.size()) {
+		stringTable = load_section(sectionHeaderTable[shstrndx]).data;
+	}
+	{
+		stat_timer timer(stat_phase::section_names);
+		for (section_t &section : sectionHeaderTable) {
+			if (section.sh_type == 0x00 || section.sh_name >= stringTable.size()) {
+				continue;
+			}
+			const char* name = reinterpret_cast<const char*>(stringTable.data()) + section.sh_name;
+			std::string_view key(name, strnlen(name, stringTable.size()-section.sh_name));
+			section.name = std::string(key);
+			// first section wins if a name repeats
+			sectionIndex.emplace(key, &section - sectionHeaderTable.data());
 		}
-		section.name = sectionName;
 	}
 
 	// parse program headers
-	for (int i=0; i<elfHeader.e_phnum; i++) {
-		int offset = elfHeader.e_phoff + elfHeader.e_phentsize * i;
-		segment32_t header;
-		header.p_type =		join_bytes(bytes.begin()+offset+p_type_offset,
-							p_type_size, bigEndian);
-		header.p_offset = 	join_bytes(bytes.begin()+offset+p_offset_32_offset,
-							p_offset_32_size, bigEndian);
-		header.p_vaddr = 	join_bytes(bytes.begin()+offset+p_vaddr_32_offset,
-							p_vaddr_32_size, bigEndian);
-		header.p_paddr = 	join_bytes(bytes.begin()+offset+p_paddr_32_offset,
-							p_paddr_32_size, bigEndian);
-		header.p_filesz = 	join_bytes(bytes.begin()+offset+p_filesz_32_offset,
-							p_filesz_32_size, bigEndian);
-		header.p_memsz = 	join_bytes(bytes.begin()+offset+p_memsz_32_offset,
-							p_memsz_32_size, bigEndian);
-		header.p_flags = 	join_bytes(bytes.begin()+offset+p_flags_32_offset,
-							p_flags_size, bigEndian);
-		header.p_align = 	join_bytes(bytes.begin()+offset+p_align_32_offset,
-							p_align_32_size, bigEndian);
-		header.sectionMapIndexes = map_sections_to_segments(header.p_offset,
-									header.p_filesz);
-		programHeaderTable.push_back(header);
-	}
-}
-
-
-std::vector<int> elf_32_parser::map_sections_to_segments(std::uint32_t offset,
-			std::uint32_t size, std::vector<int> result, int index) {
-
-	std::cout << "rec: " << size << '\t' << offset << std::endl;
-	// recursive
-	if (size == 0) {
-		std::cout << " correct " << std::endl;
-		return result;
-	}
-	int closestIndex = sectionHeaderTable.size()-1;
-	for (int i=index; i<sectionHeaderTable.size(); i++) {
-		if (sectionHeaderTable[i].sh_offset == offset) {
-			std::cout << "sec: " << sectionHeaderTable[i].sh_size;
-			std::cout << '\t' << sectionHeaderTable[i].sh_offset << std::endl;
-			std::cout << sectionHeaderTable[i].name << std::endl;
-			result.push_back(i);
-			if (sectionHeaderTable[i].sh_size == 0) {
-				std::cout << "zero" << std::endl;
-				continue;
-			}
-			return result = map_sections_to_segments(
-				offset+sectionHeaderTable[i].sh_size,
-				size-sectionHeaderTable[i].sh_size, result, i+1);
-		} else if (sectionHeaderTable[i].sh_offset > offset
-				&& sectionHeaderTable[i].sh_offset
-				< sectionHeaderTable[closestIndex].sh_offset) {
-			closestIndex = i;
-		}
-	}
-	//No contiguous match, check closest
-	if (sectionHeaderTable[closestIndex].sh_offset < offset+size) {
-		std::cout << "dec: " << sectionHeaderTable[closestIndex].name << std::endl;
-		result.push_back(closestIndex);
-		return result = map_sections_to_segments(
-				sectionHeaderTable[closestIndex].sh_offset+sectionHeaderTable[closestIndex].sh_size,
-				size-sectionHeaderTable[closestIndex].sh_size
-					-(sectionHeaderTable[closestIndex].sh_offset-offset)
-						, result, closestIndex+1);
-	}
-       	// EOF
-	std::cout << " incorrect " << std::endl;
-	return result;
+	if (phnum && elfHeader.e_phentsize < elf_class::phdr_size) throw 2;
+	table = buffer->read(elfHeader.e_phoff,
+			(std::uint64_t) elfHeader.e_phentsize * phnum);
+	if (phnum && table.empty()) throw 3;
+	swap ? decode_program_table<true>(table, phnum) : decode_program_table<false>(table, phnum);
+	stat_add(stat_counter::segments_decoded, phnum);
+	map_sections_to_segments();
+}
+
+
+template <typename elf_class>
+template <bool swap>
+void elf_class_parser<elf_class>::decode_elf_header(byte_view bytes) {
+
+	stat_timer timer(stat_phase::header);
+	const std::uint8_t* ptr = bytes.data();
+	elfHeader.e_type = 	load<e_type_size, swap>(ptr+e_type_offset);
+	elfHeader.e_machine = 	load<e_machine_size, swap>(ptr+e_machine_offset);
+	elfHeader.e_version = 	load<e_version_size, swap>(ptr+e_version_offset);
+	elfHeader.e_entry = 	load<elf_class::e_entry_size, swap>(ptr+e_entry_offset);
+	elfHeader.e_phoff = 	load<elf_class::e_phoff_size, swap>(ptr+elf_class::e_phoff_offset);
+	elfHeader.e_shoff = 	load<elf_class::e_shoff_size, swap>(ptr+elf_class::e_shoff_offset);
+	elfHeader.e_flags = 	load<e_flags_size, swap>(ptr+elf_class::e_flags_offset);
+	elfHeader.e_ehsize = 	load<e_ehsize_size, swap>(ptr+elf_class::e_ehsize_offset);
+	elfHeader.e_phentsize = load<e_phentsize_size, swap>(ptr+elf_class::e_phentsize_offset);
+	elfHeader.e_phnum = 	load<e_phnum_size, swap>(ptr+elf_class::e_phnum_offset);
+	elfHeader.e_shentsize = load<e_shentsize_size, swap>(ptr+elf_class::e_shentsize_offset);
+	elfHeader.e_shnum = 	load<e_shnum_size, swap>(ptr+elf_class::e_shnum_offset);
+	elfHeader.e_shstrndx = 	load<e_shstrndx_size, swap>(ptr+elf_class::e_shstrndx_offset);
 }
 
 
-std::vector<std::uint8_t> elf_32_parser::read_section(std::string name) {
+template <typename elf_class>
+template <bool swap>
+void elf_class_parser<elf_class>::decode_section_table(byte_view table, std::size_t count) {
 
-	section32_t section;
-	for (section32_t sectionHeader : sectionHeaderTable) {
-		if (sectionHeader.name == name) {
-			section = sectionHeader;
+	stat_timer timer(stat_phase::section_table);
+	if constexpr (swap) {
+		// swap the whole table in one pass, then decode it as host order
+		if (elfHeader.e_shentsize == elf_class::shdr_size) {
+			std::vector<std::uint8_t> native(table.size());
+			swap_table(table.data(), native.data(), native.size(),
+					elf_class::sh_layout, sizeof(elf_class::sh_layout));
+			decode_section_table<false>(byte_view(native.data(), native.size()), count);
+			return;
 		}
 	}
+	sectionHeaderTable.resize(count);
+	for (std::size_t i=0; i<count; i++) {
+		const std::uint8_t* entry = table.data() + elfHeader.e_shentsize * i;
+		section_t &header = sectionHeaderTable[i];
+		header.sh_name = 	load<sh_name_size, swap>(entry+sh_name_offset);
+		header.sh_type = 	load<sh_type_size, swap>(entry+sh_type_offset);
+		header.sh_flags = 	load<elf_class::sh_flags_size, swap>(entry+sh_flags_offset);
+		header.sh_addr = 	load<elf_class::sh_addr_size, swap>(entry+elf_class::sh_addr_offset);
+		header.sh_offset = 	load<elf_class::sh_offset_size, swap>(entry+elf_class::sh_offset_offset);
+		header.sh_size = 	load<elf_class::sh_size_size, swap>(entry+elf_class::sh_size_offset);
+		header.sh_link = 	load<sh_link_size, swap>(entry+elf_class::sh_link_offset);
+		header.sh_info = 	load<sh_info_size, swap>(entry+elf_class::sh_info_offset);
+		header.sh_addralign = 	load<elf_class::sh_addralign_size, swap>(entry+elf_class::sh_addralign_offset);
+		header.sh_entsize = 	load<elf_class::sh_entsize_size, swap>(entry+elf_class::sh_entsize_offset);
+	}
+}
 
-	return section.bytes;
+
+template <typename elf_class>
+template <bool swap>
+void elf_class_parser<elf_class>::decode_program_table(byte_view table, std::size_t count) {
+
+	stat_timer timer(stat_phase::program_table);
+	if constexpr (swap) {
+		if (elfHeader.e_phentsize == elf_class::phdr_size) {
+			std::vector<std::uint8_t> native(table.size());
+			swap_table(table.data(), native.data(), native.size(),
+					elf_class::ph_layout, sizeof(elf_class::ph_layout));
+			decode_program_table<false>(byte_view(native.data(), native.size()), count);
+			return;
+		}
+	}
+	programHeaderTable.resize(count);
+	for (std::size_t i=0; i<count; i++) {
+		const std::uint8_t* entry = table.data() + elfHeader.e_phentsize * i;
+		segment_t &header = programHeaderTable[i];
+		header.p_type =		load<p_type_size, swap>(entry+p_type_offset);
+		header.p_offset = 	load<elf_class::p_offset_size, swap>(entry+elf_class::p_offset_offset);
+		header.p_vaddr = 	load<elf_class::p_vaddr_size, swap>(entry+elf_class::p_vaddr_offset);
+		header.p_paddr = 	load<elf_class::p_paddr_size, swap>(entry+elf_class::p_paddr_offset);
+		header.p_filesz = 	load<elf_class::p_filesz_size, swap>(entry+elf_class::p_filesz_offset);
+		header.p_memsz = 	load<elf_class::p_memsz_size, swap>(entry+elf_class::p_memsz_offset);
+		header.p_flags = 	load<p_flags_size, swap>(entry+elf_class::p_flags_offset);
+		header.p_align = 	load<elf_class::p_align_size, swap>(entry+elf_class::p_align_offset);
+	}
 }
 
-void elf_32_parser::print_elf_header(void) {
 
-	std::cout << std::left << "Magic Number: " << std::setfill('0')
-								<< std::right;
-	for (int i=0; i<10; i++) std::cout << std::setw(2) << std::hex
-					<< (unsigned int) elfHeader.e_ident[i]
-					<< " ";
-	std::cout << std::endl << std::left << std::setfill(' ');
-	std::cout << std::setw(36) << "Class:" << "ELF32" << std::endl;
-	std::cout << std::setw(36) << "Data:";
-	if (elfHeader.e_ident[EI_DATA_offset] - 1) {
-		std::cout << "Big Endian";
+// Same rules as binutils ELF_SECTION_IN_SEGMENT_STRICT, which readelf uses
+// for its section to segment listing
+template <typename section_t, typename segment_t>
+static bool section_in_segment(const section_t& section, const segment_t& segment) {
+
+	constexpr std::uint32_t SHT_NOBITS = 0x08, SHF_ALLOC = 0x02, SHF_TLS = 0x400;
+	constexpr std::uint32_t PT_LOAD = 0x01, PT_DYNAMIC = 0x02, PT_NOTE = 0x04,
+			PT_PHDR = 0x06, PT_TLS = 0x07, PT_GNU_EH_FRAME = 0x6474e550,
+			PT_GNU_STACK = 0x6474e551, PT_GNU_RELRO = 0x6474e552;
+	bool tls = section.sh_flags & SHF_TLS;
+	bool alloc = section.sh_flags & SHF_ALLOC;
+	bool nobits = section.sh_type == SHT_NOBITS;
+	std::uint32_t type = segment.p_type;
+
+	// .tbss only takes space in PT_TLS
+	if (tls && nobits && type != PT_TLS) return false;
+	// TLS sections only in PT_TLS, PT_GNU_RELRO and PT_LOAD, nothing else in PT_TLS or PT_PHDR
+	if (tls ? (type != PT_TLS && type != PT_GNU_RELRO && type != PT_LOAD)
+			: (type == PT_TLS || type == PT_PHDR)) return false;
+	// loadable segments only hold SHF_ALLOC sections
+	if (!alloc && (type == PT_LOAD || type == PT_DYNAMIC || type == PT_GNU_EH_FRAME
+			|| type == PT_GNU_STACK || type == PT_GNU_RELRO)) return false;
+
+	std::uint64_t size = (!tls || !nobits || type == PT_TLS) ? section.sh_size : 0;
+	if (!nobits && (section.sh_offset < segment.p_offset
+			|| section.sh_offset - segment.p_offset > segment.p_filesz - 1
+			|| section.sh_offset - segment.p_offset + size > segment.p_filesz)) return false;
+	if (alloc && (section.sh_addr < segment.p_vaddr
+			|| section.sh_addr - segment.p_vaddr > segment.p_memsz - 1
+			|| section.sh_addr - segment.p_vaddr + size > segment.p_memsz)) return false;
+
+	// no empty sections at the edges of PT_DYNAMIC or PT_NOTE
+	if ((type == PT_DYNAMIC || type == PT_NOTE) && section.sh_size == 0 && segment.p_memsz != 0) {
+		return (nobits || (section.sh_offset > segment.p_offset
+				&& section.sh_offset - segment.p_offset < segment.p_filesz))
+			&& (!alloc || (section.sh_addr > segment.p_vaddr
+				&& section.sh_addr - segment.p_vaddr < segment.p_memsz));
+	}
+	return true;
+}
+
+
+// Sort the sections once by file offset (and NOBITS sections by address),
+// then each segment only visits the sections that start inside its range
+template <typename elf_class>
+void elf_class_parser<elf_class>::map_sections_to_segments(void) {
+
+	stat_timer timer(stat_phase::segment_mapping);
+	std::vector<std::size_t> byOffset, byAddr, other;
+	for (std::size_t i=1; i<sectionHeaderTable.size(); i++) {
+		const section_t &section = sectionHeaderTable[i];
+		if (section.sh_type != 0x08) {
+			byOffset.push_back(i);
+		} else if (section.sh_flags & 0x02) {
+			byAddr.push_back(i);
+		} else {
+			other.push_back(i);
+		}
+	}
+	std::sort(byOffset.begin(), byOffset.end(), [this](std::size_t a, std::size_t b) {
+		return sectionHeaderTable[a].sh_offset < sectionHeaderTable[b].sh_offset;
+	});
+	std::sort(byAddr.begin(), byAddr.end(), [this](std::size_t a, std::size_t b) {
+		return sectionHeaderTable[a].sh_addr < sectionHeaderTable[b].sh_addr;
+	});
+
+	for (segment_t &segment : programHeaderTable) {
+		std::vector<int> &result = segment.sectionMapIndexes;
+		result.clear();
+		auto it = std::lower_bound(byOffset.begin(), byOffset.end(), segment.p_offset,
+				[this](std::size_t i, std::uint64_t offset) {
+			return sectionHeaderTable[i].sh_offset < offset;
+		});
+		for (; it != byOffset.end() && sectionHeaderTable[*it].sh_offset
+				<= segment.p_offset + segment.p_filesz; it++) {
+			if (section_in_segment(sectionHeaderTable[*it], segment)) result.push_back(*it);
+		}
+		it = std::lower_bound(byAddr.begin(), byAddr.end(), segment.p_vaddr,
+				[this](std::size_t i, std::uint64_t addr) {
+			return sectionHeaderTable[i].sh_addr < addr;
+		});
+		for (; it != byAddr.end() && sectionHeaderTable[*it].sh_addr
+				<= segment.p_vaddr + segment.p_memsz; it++) {
+			if (section_in_segment(sectionHeaderTable[*it], segment)) result.push_back(*it);
+		}
+		for (std::size_t i : other) {
+			if (section_in_segment(sectionHeaderTable[i], segment)) result.push_back(i);
+		}
+		// listed in section header order, like readelf
+		std::sort(result.begin(), result.end());
+	}
+}
+
+
+template <typename elf_class>
+typename elf_class_parser<elf_class>::section_t& elf_class_parser<elf_class>::load_section(section_t& section) {
+
+	if (section.loaded) {
+		return section;
+	}
+	stat_timer timer(stat_phase::section_load);
+	// NOBITS sections occupy no file space
+	if (section.sh_type != 0x08) {
+		section.data = buffer->read(section.sh_offset, section.sh_size);
+	}
+	if (section.sh_flags & SHF_COMPRESSED && !section.data.empty()) {
+		// streams that don't decompress are left as they are in the file
+		stat_timer inflating(stat_phase::decompress);
+		bool is64 = elf_class::elf_class == 2;
+		bool bigEndian = elfHeader.e_ident[EI_DATA_offset] == 2;
+		try {
+			section.inflated = options.sections ? options.sections->decompress(section.data, is64, bigEndian)
+					: decompress_section(section.data, is64, bigEndian);
+		}
+		catch (const std::bad_alloc&) {
+			// a size the stream could produce but memory can't hold
+		}
+		if (section.inflated) section.data = byte_view(section.inflated->data(), section.inflated->size());
+	}
+	if (options.mode == load_mode::copy && !section.inflated) {
+		section.bytes = section.data.to_vector();
+		stat_add(stat_counter::allocations);
+	}
+	stat_add(stat_counter::sections_loaded);
+	stat_add(stat_counter::section_bytes, section.data.size());
+	section.loaded = true;
+	return section;
+}
+
+
+template <typename elf_class>
+void elf_class_parser<elf_class>::load_sections(const std::vector<section_t*>& sections) {
+
+	// compressed sections are separate streams, so they are decompressed
+	// at once, one section per thread
+	std::vector<section_t*> compressed;
+	for (section_t* section : sections) {
+		if (section->loaded) continue;
+		if (section->sh_flags & SHF_COMPRESSED) compressed.push_back(section);
+		else load_section(*section);
+	}
+	std::atomic<std::size_t> next {0};
+	auto work = [&]() {
+		for (std::size_t i = next++; i < compressed.size(); i = next++) load_section(*compressed[i]);
+	};
+	std::vector<std::thread> workers;
+	std::size_t threads = std::min<std::size_t>(compressed.size(), std::thread::hardware_concurrency());
+	for (std::size_t t=1; t<threads; t++) workers.emplace_back(work);
+	work();
+	for (std::thread &worker : workers) worker.join();
+}
+
+
+template <typename elf_class>
+std::vector<std::uint8_t> elf_class_parser<elf_class>::read_section(std::string name) {
+
+	section_t* section = find_section(name);
+	if (!section) {
+		return std::vector<std::uint8_t>();
+	}
+	return options.mode == load_mode::copy && !section->inflated ?
+			section->bytes : section->data.to_vector();
+}
+
+
+template <typename elf_class>
+byte_view elf_class_parser<elf_class>::section_view(std::string name) {
+
+	section_t* section = find_section(name);
+	return section ? section->data : byte_view();
+}
+
+
+template <typename elf_class>
+typename elf_class_parser<elf_class>::section_t* elf_class_parser<elf_class>::find_section(std::string_view name) {
+
+	auto it = sectionIndex.find(name);
+	if (it == sectionIndex.end()) {
+		return nullptr;
+	}
+	return &load_section(sectionHeaderTable[it->second]);
+}
+
+
+template <typename elf_class>
+typename elf_class_parser<elf_class>::section_t& elf_class_parser<elf_class>::section_at(std::size_t index) {
+
+	return load_section(sectionHeaderTable.at(index));
+}
+
+
+template <typename elf_class>
+std::vector<typename elf_class_parser<elf_class>::section_t*> elf_class_parser<elf_class>::sections_of_type(std::uint32_t type) {
+
+	std::vector<section_t*> result;
+	for (section_t &section : sectionHeaderTable) {
+		if (section.sh_type == type) {
+			result.push_back(&load_section(section));
+		}
+	}
+	return result;
+}
+
+// name of key in names, empty if it has none
+template <typename map_t, typename key_t>
+static std::string_view name_of(const map_t& names, key_t key) {
+
+	auto it = names.find(key);
+	return it == names.end() ? std::string_view() : std::string_view(it->second);
+}
+
+
+// the name as a JSON string, or the value if it has none
+template <typename map_t, typename key_t>
+static void json_name(output_buffer& out, const map_t& names, key_t key) {
+
+	auto it = names.find(key);
+	if (it == names.end()) {
+		out.dec(key);
 	} else {
-		std::cout << "Little Endian";
+		out.json(it->second);
 	}
-	std::cout << std::endl << std::setw(36) << "Version:";
-	if (elfHeader.e_ident[EI_VERSION_offset] == 1) {
-		std::cout << "1 (current)";
+}
+
+
+template <typename elf_class>
+void elf_class_parser<elf_class>::print_elf_header(void) {
+
+	stat_timer timer(stat_phase::output);
+	stream_sink sink(std::cout);
+	output_buffer out(sink);
+	write_text(out, output_header);
+}
+
+
+template <typename elf_class>
+void elf_class_parser<elf_class>::print_sections(void) {
+
+	stat_timer timer(stat_phase::output);
+	stream_sink sink(std::cout);
+	output_buffer out(sink);
+	write_text(out, output_sections);
+}
+
+
+template <typename elf_class>
+void elf_class_parser<elf_class>::print_segments(void) {
+
+	stat_timer timer(stat_phase::output);
+	stream_sink sink(std::cout);
+	output_buffer out(sink);
+	write_text(out, output_segments);
+}
+
+
+template <typename elf_class>
+void elf_class_parser<elf_class>::print_symbol_table(void) {
+
+	stat_timer timer(stat_phase::output);
+	stream_sink sink(std::cout);
+	output_buffer out(sink);
+	write_text(out, output_symbols);
+}
+
+
+template <typename elf_class>
+void elf_class_parser<elf_class>::write(output_buffer& out, output_format format, unsigned parts,
+					std::string_view file) {
+
+	stat_timer timer(stat_phase::output);
+	if (format == output_format::text) {
+		write_text(out, parts);
 	} else {
-		std::cout << elfHeader.e_ident[EI_VERSION_offset];
-	}
-	std::cout << std::endl << std::setw(36) << "OS/ABI:";
-	std::cout << EI_OSABI[elfHeader.e_ident[EI_OSABI_offset]] << std::endl;
-	std::cout << std::setw(36) << "ABI Version";
-	std::cout << (int) elfHeader.e_ident[EI_ABIVERSION_offset];
-	std::cout << std::endl << std::setw(36) << "Type:";
-	std::cout << e_type[elfHeader.e_type] << std::endl;
-	std::cout << std::setw(36) << "Machine:";
-	std::cout << e_machine[elfHeader.e_machine] << std::endl;
-	std::cout << std::setw(36) << "Version:" << "0x" << std::hex;
-	std::cout << (int) elfHeader.e_ident[EI_VERSION_offset];
-	std::cout << std::endl << std::setw(36) << "Entry point address:";
-	std::cout << "0x" << std::hex << elfHeader.e_entry;
-	std::cout << std::endl << std::setw(36) << "Start of program headers:";
-	std::cout << std::dec << (int) elfHeader.e_phoff;
-	std::cout << std::endl << std::setw(36) << "Start of section headers:";
-	std::cout << (int) elfHeader.e_shoff << std::endl;
-	std::cout << std::setw(36) << "Flags:" << "0x" << std::hex;
-	std::cout << (int) elfHeader.e_flags << std::endl;
-	std::cout << std::setw(36) << "Size of this header:" << std::dec;
-	std::cout << (int) elfHeader.e_ehsize << std::endl;
-	std::cout << std::setw(36) << "Size of program headers:";
-	std::cout << (int) elfHeader.e_phentsize << std::endl;
-	std::cout << std::setw(36) << "Number of program headers:";
-	std::cout << (int) elfHeader.e_phnum << std::endl;
-	std::cout << std::setw(36) << "Size of section headers:";
-	std::cout << (int) elfHeader.e_shentsize << std::endl;
-	std::cout << std::setw(36) << "Number of section headers:";
-	std::cout << (int) elfHeader.e_shnum << std::endl;
-	std::cout << std::setw(36) << "Section header string table index:";
-	std::cout << (int) elfHeader.e_shstrndx << std::endl;
-}
-
-void elf_32_parser::print_sections(void) {
-
-	std::cout << std::left << std::setfill(' ') << std::setw(18) << "Name";
-	std::cout << std::setw(15) << "Type";
-	std::cout << std::setw(9) << "Addr";
-	std::cout << std::setw(7) << "Off";
-	std::cout << std::setw(7) << "Size";
-	std::cout << "ES Flg Lk Inf Al";
-	std::cout << std::endl;
-	std::vector<section32_t> sections = sectionHeaderTable;
-	std::sort(sections.begin(), sections.end(), compare_sections_32);
-	for (section32_t section : sections) {
-		std::cout << std::left << std::setfill(' ') << std::setw(18);
-		std::cout << section.name << std::setw(15);
-		std::cout << sectionType[section.sh_type] << std::right;
-		std::cout << std::setfill('0') << std::setw(8) << std::hex;
-		std::cout << section.sh_addr << ' ' << std::setw(6);
-		std::cout << section.sh_offset << ' ' << std::setw(6);
-		std::cout << section.sh_size << ' ' << std::setw(2) << std::hex;
-		std::cout << section.sh_entsize << ' ';
-		std::string flags = "";
-		for (const auto &pair : sectionFlags) {
-			if (!!(section.sh_flags & pair.first)) {
-				flags += sectionFlags[pair.first][1];
+		write_json(out, format, parts, file);
+	}
+}
+
+
+template <typename elf_class>
+void elf_class_parser<elf_class>::write_text(output_buffer& out, unsigned parts) {
+
+	const int width = elf_class::addr_width;
+	const std::vector<std::uint8_t> &ident = elfHeader.e_ident;
+	if (parts & output_header) {
+		out.put("Magic Number: ");
+		for (int i=0; i<10; i++) out.hex(ident[i], 2).put(' ');
+		out.put('\n').pad("Class:", 36).put(elf_class::name).put('\n');
+		out.pad("Data:", 36).put(ident[EI_DATA_offset] != 1 ? "Big Endian" : "Little Endian").put('\n');
+		out.pad("Version:", 36);
+		if (ident[EI_VERSION_offset] == 1) {
+			out.put("1 (current)");
+		} else {
+			out.put((char) ident[EI_VERSION_offset]);
+		}
+		out.put('\n').pad("OS/ABI:", 36).put(name_of(EI_OSABI, ident[EI_OSABI_offset])).put('\n');
+		out.pad("ABI Version", 36).hex(ident[EI_ABIVERSION_offset]).put('\n');
+		out.pad("Type:", 36).put(name_of(e_type, elfHeader.e_type)).put('\n');
+		out.pad("Machine:", 36).put(name_of(e_machine, elfHeader.e_machine)).put('\n');
+		out.pad("Version:", 36).put("0x").hex(ident[EI_VERSION_offset]).put('\n');
+		out.pad("Entry point address:", 36).put("0x").hex(elfHeader.e_entry).put('\n');
+		out.pad("Start of program headers:", 36).dec(elfHeader.e_phoff).put('\n');
+		out.pad("Start of section headers:", 36).dec(elfHeader.e_shoff).put('\n');
+		out.pad("Flags:", 36).put("0x").hex(elfHeader.e_flags).put('\n');
+		out.pad("Size of this header:", 36).dec(elfHeader.e_ehsize).put('\n');
+		out.pad("Size of program headers:", 36).dec(elfHeader.e_phentsize).put('\n');
+		out.pad("Number of program headers:", 36).dec(elfHeader.e_phnum).put('\n');
+		out.pad("Size of section headers:", 36).dec(elfHeader.e_shentsize).put('\n');
+		out.pad("Number of section headers:", 36).dec(elfHeader.e_shnum).put('\n');
+		out.pad("Section header string table index:", 36).dec(elfHeader.e_shstrndx).put('\n');
+	}
+
+	if (parts & output_sections) {
+		out.pad("Name", 18).pad("Type", 15).pad("Addr", width+1).pad("Off", 7).pad("Size", 7);
+		out.put("ES Flg Lk Inf Al\n");
+		// file order, the headers themselves stay in place
+		std::vector<std::uint32_t> order(sectionHeaderTable.size());
+		for (std::size_t i=0; i<order.size(); i++) order[i] = i;
+		std::stable_sort(order.begin(), order.end(), [this](std::uint32_t a, std::uint32_t b) {
+			return compare_sections(sectionHeaderTable[a], sectionHeaderTable[b]);
+		});
+		for (std::uint32_t i : order) {
+			const section_t &section = sectionHeaderTable[i];
+			out.pad(section.name, 18).pad(name_of(sectionType, section.sh_type), 15);
+			out.hex(section.sh_addr, width).put(' ').hex(section.sh_offset, 6).put(' ');
+			out.hex(section.sh_size, 6).put(' ').hex(section.sh_entsize, 2).put(' ');
+			char flags[16];
+			std::size_t count = 0;
+			for (const auto &pair : sectionFlags) {
+				if (section.sh_flags & pair.first && !pair.second[1].empty() && count < sizeof(flags)) {
+					flags[count++] = pair.second[1][0];
+				}
+			}
+			out.pad(std::string_view(flags, count), 3, false).put(' ');
+			out.dec(section.sh_link, 2).put(' ').dec(section.sh_info, 3).put(' ');
+			out.dec(section.sh_addralign, 2).put('\n');
+		}
+	}
+
+	if (parts & output_segments) {
+		out.pad("Type", 15).pad("Offset", 8).pad("VirtAddr", width+3).pad("PhysAddr", width+3);
+		out.pad("FileSiz", 9).pad("MemSiz", 8).put("Flg Align\n");
+		for (const segment_t &segment : programHeaderTable) {
+			out.pad(name_of(programType, segment.p_type), 15);
+			out.put("0x").hex(segment.p_offset, 5).put(" 0x").hex(segment.p_vaddr, width);
+			out.put(" 0x").hex(segment.p_paddr, width).put(" 0x").hex(segment.p_filesz, 6);
+			out.put(" 0x").hex(segment.p_memsz, 5).put(' ');
+			for (const auto &pair : programFlags) {
+				out.put(segment.p_flags & pair.first ? pair.second[1][0] : ' ');
 			}
+			out.put(" 0x").hex(segment.p_align).put('\n');
 		}
-		std::cout << std::setfill(' ') << std::setw(3) << flags << ' ';
-		std::cout << std::setw(2) << std::dec << section.sh_link << ' ';
-		std::cout << std::setw(3) << section.sh_info << ' ';
-		std::cout << std::setw(2) << section.sh_addralign << std::endl;
-	}
-}
-
-
-void elf_32_parser::print_segments(void) {
-
-	//std::vector<segment32_t> segments = programHeaderTable;
-        //std::sort(segments.begin(), segments.end(), compare_segments_32);
-
-	// program headers
-	std::cout << std::left << std::setfill(' ') << std::setw(15) << "Type";
-	std::cout << std::setw(8) << "Offset" << std::setw(11) << "VirtAddr";
-	std::cout << std::setw(11) << "PhysAddr" << std::setw(9) << "FileSiz";
-	std::cout << std::setw(8) << "MemSiz" << std::setw(4) << "Flg Align";
-	std::cout << std::endl;
-	for (segment32_t segment : programHeaderTable) {
-		std::cout << std::setfill(' ') << std::left << std::setw(15);
-		std::cout << programType[segment.p_type] << std::setfill('0');
-		std::cout << "0x" << std::setw(5) << std::right << std::hex;
-		std::cout << segment.p_offset << " 0x" << std::setw(8);
-		std::cout << segment.p_vaddr << " 0x" << std::setw(8);
-		std::cout << segment.p_paddr << " 0x" << std::setw(6);
-		std::cout << segment.p_filesz << " 0x" << std::setw(5);
-		std::cout << segment.p_memsz << " ";
-		std::string flag = "";
-		for (const auto &pair : programFlags) {
-                        if (!!(segment.p_flags & pair.first)) {
-                                flag += programFlags[pair.first][1];
-                        } else {
-				flag += ' ';
+		// segment section map
+		out.put('\n');
+		std::size_t digits = programHeaderTable.empty() ? 0 : std::ceil(std::log10(programHeaderTable.size()));
+		for (std::size_t i=0; i<programHeaderTable.size(); i++) {
+			out.dec(i, digits, '0');
+			for (int index : programHeaderTable[i].sectionMapIndexes) {
+				out.put(' ').put(sectionHeaderTable[index].name);
 			}
-                }
-		std::cout << flag << " 0x";
-		std::cout << std::left << segment.p_align << std::endl;
+			out.put('\n');
+		}
 	}
 
-	// segment section map
-	std::cout << std::endl;
-	for (int i=0; i<programHeaderTable.size(); i++) {
-		std::cout << std::dec << std::right
-		<< std::setw(std::ceil(std::log10(programHeaderTable.size())));
-		std::cout << i;
-		for (int secHedIndex : programHeaderTable[i].sectionMapIndexes) {
-			std::cout << ' ' << sectionHeaderTable[secHedIndex].name;
+	if (parts & output_symbols) {
+		for (std::uint32_t type : {0x0B, 0x02}) {
+			std::vector<section_t*> tables = sections_of_type(type);
+			if (tables.empty()) {
+				continue;
+			}
+			const symbol_table &table = type == 0x02 ? symbols() : dynamic_symbols();
+			out.put("Symbol table '").put(tables[0]->name).put("' contains ").dec(table.size());
+			out.put(" entries:\n   Num:    ").pad("Value", width-1);
+			out.put("Size Type    Bind   Vis      Ndx Name\n");
+			for (symbol_table::symbol symbol : table) {
+				out.dec(symbol.index(), 6).put(": ").hex(symbol.value(), width).put(' ');
+				out.dec(symbol.size(), 5).put(' ');
+				out.pad(name_of(symbolType, symbol.type()), 7).put(' ');
+				out.pad(name_of(symbolBind, symbol.bind()), 6).put(' ');
+				out.pad(name_of(symbolVisibility, symbol.visibility()), 8);
+				if (symbol.shndx() == SHN_UNDEF) {
+					out.put(" UND");
+				} else if (symbol.shndx() == SHN_ABS) {
+					out.put(" ABS");
+				} else if (symbol.shndx() == SHN_COMMON) {
+					out.put(" COM");
+				} else {
+					out.dec(symbol.shndx(), 4);
+				}
+				out.put(' ');
+				// section symbols are named after their section
+				if (symbol.type() == STT_SECTION && symbol.name().empty()
+						&& symbol.shndx() < sectionHeaderTable.size()) {
+					out.put(sectionHeaderTable[symbol.shndx()].name).put('\n');
+				} else {
+					out.put(symbol.name()).put('\n');
+				}
+			}
+			out.put('\n');
 		}
-		std::cout << std::endl;
 	}
 }
 
 
-void elf_32_parser::print_symbol_table(void) {
+template <typename elf_class>
+void elf_class_parser<elf_class>::header_fields(output_buffer& out) {
+
+	const std::vector<std::uint8_t> &ident = elfHeader.e_ident;
+	out.put("\"class\":").dec((elf_class::elf_class == 2 ? 64 : 32));
+	out.put(",\"big_endian\":").put(ident[EI_DATA_offset] == 2 ? "true" : "false");
+	out.put(",\"version\":").dec(ident[EI_VERSION_offset]);
+	out.put(",\"os_abi\":");
+	json_name(out, EI_OSABI, ident[EI_OSABI_offset]);
+	out.put(",\"abi_version\":").dec(ident[EI_ABIVERSION_offset]);
+	out.put(",\"type\":");
+	json_name(out, e_type, elfHeader.e_type);
+	out.put(",\"machine\":");
+	json_name(out, e_machine, elfHeader.e_machine);
+	out.put(",\"entry\":").dec(elfHeader.e_entry);
+	out.put(",\"phoff\":").dec(elfHeader.e_phoff);
+	out.put(",\"shoff\":").dec(elfHeader.e_shoff);
+	out.put(",\"flags\":").dec(elfHeader.e_flags);
+	out.put(",\"ehsize\":").dec(elfHeader.e_ehsize);
+	out.put(",\"phentsize\":").dec(elfHeader.e_phentsize);
+	out.put(",\"phnum\":").dec(elfHeader.e_phnum);
+	out.put(",\"shentsize\":").dec(elfHeader.e_shentsize);
+	out.put(",\"shnum\":").dec(elfHeader.e_shnum);
+	out.put(",\"shstrndx\":").dec(elfHeader.e_shstrndx);
+}
+
+
+template <typename elf_class>
+void elf_class_parser<elf_class>::section_fields(output_buffer& out, std::size_t index) {
 
-	std::vector<std::uint8_t> bytes = read_section(".symtab");
-	for (int i=1; i<bytes.size()+1; i++) {
-		std::cout << std::right << std::setfill('0');
-		std::cout << std::setw(2) << std::hex
-				<< (unsigned int) bytes[i-1];
-		if (i % 4 == 0) std::cout << " ";
-		if (i % 16 == 0) std::cout << std::endl;
+	const section_t &section = sectionHeaderTable[index];
+	out.put("\"index\":").dec(index).put(",\"name\":").json(section.name);
+	out.put(",\"type\":");
+	json_name(out, sectionType, section.sh_type);
+	out.put(",\"flags\":\"");
+	for (const auto &pair : sectionFlags) {
+		if (section.sh_flags & pair.first && !pair.second[1].empty()) out.put(pair.second[1][0]);
 	}
-	std::cout << std::endl;
+	out.put("\",\"addr\":").dec(section.sh_addr);
+	out.put(",\"offset\":").dec(section.sh_offset);
+	out.put(",\"size\":").dec(section.sh_size);
+	out.put(",\"entsize\":").dec(section.sh_entsize);
+	out.put(",\"link\":").dec(section.sh_link);
+	out.put(",\"info\":").dec(section.sh_info);
+	out.put(",\"align\":").dec(section.sh_addralign);
 }
 
-elf_64_parser::elf_64_parser(std::vector<std::uint8_t> bytes) {
 
-	std::cout<<"64"<<std::endl;
-	
-	// parse file header
-        for (int i=0; i<10; i++) elfHeader.e_ident.push_back(bytes[i]);
-	bool bigEndian = bytes[5] == 2;
-        elfHeader.e_type = 	join_bytes(bytes.begin()+e_type_offset,
-						e_type_size, bigEndian);
-        elfHeader.e_machine = 	join_bytes(bytes.begin()+e_machine_offset,
-						e_machine_size, bigEndian);
-        elfHeader.e_version = 	join_bytes(bytes.begin()+e_version_offset,
-						e_version_size, bigEndian);
-        elfHeader.e_entry = 	join_bytes(bytes.begin()+e_entry_offset,
-						e_entry_64_size, bigEndian);
-        elfHeader.e_phoff = 	join_bytes(bytes.begin()+e_phoff_64_offset,
-						e_phoff_64_size, bigEndian);
-        elfHeader.e_shoff = 	join_bytes(bytes.begin()+e_shoff_64_offset,
-						e_shoff_64_size, bigEndian);
-        elfHeader.e_flags = 	join_bytes(bytes.begin()+e_flags_64_offset,
-						e_flags_size, bigEndian);
-        elfHeader.e_ehsize = 	join_bytes(bytes.begin()+e_ehsize_64_offset,
-						e_ehsize_size, bigEndian);
-        elfHeader.e_phentsize = join_bytes(bytes.begin()+e_phentsize_64_offset,
-						e_phentsize_size, bigEndian);
-        elfHeader.e_phnum = 	join_bytes(bytes.begin()+e_phnum_64_offset,
-						e_phnum_size, bigEndian);
-        elfHeader.e_shentsize = join_bytes(bytes.begin()+e_shentsize_64_offset,
-						e_shentsize_size, bigEndian);
-        elfHeader.e_shnum = 	join_bytes(bytes.begin()+e_shnum_64_offset,
-						e_shnum_size, bigEndian);
-        elfHeader.e_shstrndx = 	join_bytes(bytes.begin()+e_shstrndx_64_offset,
-						e_shstrndx_size, bigEndian);
+template <typename elf_class>
+void elf_class_parser<elf_class>::segment_fields(output_buffer& out, std::size_t index) {
 
-	// parse program headers
-        for (int i=0; i<elfHeader.e_phnum; i++) {
-                int offset = elfHeader.e_phoff + elfHeader.e_phentsize*i;
-                std::cout << i << "\t" << offset << std::endl;
-        }
-        std::cout<<elfHeader.e_phnum<<std::endl;
+	const segment_t &segment = programHeaderTable[index];
+	out.put("\"index\":").dec(index).put(",\"type\":");
+	json_name(out, programType, segment.p_type);
+	out.put(",\"flags\":\"");
+	for (auto it = programFlags.rbegin(); it != programFlags.rend(); it++) {
+		if (segment.p_flags & it->first) out.put(it->second[1][0]);
+	}
+	out.put("\",\"offset\":").dec(segment.p_offset);
+	out.put(",\"vaddr\":").dec(segment.p_vaddr);
+	out.put(",\"paddr\":").dec(segment.p_paddr);
+	out.put(",\"filesz\":").dec(segment.p_filesz);
+	out.put(",\"memsz\":").dec(segment.p_memsz);
+	out.put(",\"align\":").dec(segment.p_align);
+	out.put(",\"sections\":[");
+	const char* separator = "";
+	for (int section : segment.sectionMapIndexes) {
+		out.put(separator).json(sectionHeaderTable[section].name);
+		separator = ",";
+	}
+	out.put(']');
+}
+
+
+template <typename elf_class>
+void elf_class_parser<elf_class>::symbol_fields(output_buffer& out, std::string_view table,
+						const symbol_table::symbol& symbol) {
+
+	out.put("\"table\":").json(table).put(",\"index\":").dec(symbol.index());
+	out.put(",\"value\":").dec(symbol.value());
+	out.put(",\"size\":").dec(symbol.size());
+	out.put(",\"type\":");
+	json_name(out, symbolType, symbol.type());
+	out.put(",\"bind\":");
+	json_name(out, symbolBind, symbol.bind());
+	out.put(",\"visibility\":");
+	json_name(out, symbolVisibility, symbol.visibility());
+	out.put(",\"shndx\":");
+	if (symbol.shndx() == SHN_UNDEF) {
+		out.put("\"UND\"");
+	} else if (symbol.shndx() == SHN_ABS) {
+		out.put("\"ABS\"");
+	} else if (symbol.shndx() == SHN_COMMON) {
+		out.put("\"COM\"");
+	} else {
+		out.dec(symbol.shndx());
+	}
+	out.put(",\"name\":");
+	if (symbol.type() == STT_SECTION && symbol.name().empty() && symbol.shndx() < sectionHeaderTable.size()) {
+		out.json(sectionHeaderTable[symbol.shndx()].name);
+	} else {
+		out.json(symbol.name());
+	}
 }
 
+
+template <typename elf_class>
+void elf_class_parser<elf_class>::write_json(output_buffer& out, output_format format, unsigned parts,
+						std::string_view file) {
+
+	// json nests every record in one object per file, ndjson writes each
+	// one on its own line tagged with its kind
+	bool nested = format == output_format::json;
+	const char* separator = "";
+	auto list = [&](const char* name) {
+		if (nested) out.put(separator).put(name);
+		separator = ",";
+	};
+	auto record = [&](const char* kind, bool first) {
+		if (nested) {
+			out.put(first ? "{" : ",{");
+			return;
+		}
+		out.put('{');
+		if (!file.empty()) out.put("\"file\":").json(file).put(',');
+		out.put("\"kind\":\"").put(kind).put("\",");
+	};
+	auto end = [&]() { out.put(nested ? "}" : "}\n"); };
+
+	if (nested) {
+		out.put('{');
+		if (!file.empty()) list("\"file\":"), out.json(file);
+	}
+	if (parts & output_header) {
+		list("\"header\":");
+		record("header", true);
+		header_fields(out);
+		end();
+	}
+	if (parts & output_sections) {
+		list("\"sections\":[");
+		for (std::size_t i=0; i<sectionHeaderTable.size(); i++) {
+			record("section", i == 0);
+			section_fields(out, i);
+			end();
+		}
+		if (nested) out.put(']');
+	}
+	if (parts & output_segments) {
+		list("\"segments\":[");
+		for (std::size_t i=0; i<programHeaderTable.size(); i++) {
+			record("segment", i == 0);
+			segment_fields(out, i);
+			end();
+		}
+		if (nested) out.put(']');
+	}
+	if (parts & output_symbols) {
+		list("\"symbols\":[");
+		bool first = true;
+		for (std::uint32_t type : {0x0B, 0x02}) {
+			std::vector<section_t*> tables = sections_of_type(type);
+			if (tables.empty()) {
+				continue;
+			}
+			const symbol_table &table = type == 0x02 ? symbols() : dynamic_symbols();
+			for (symbol_table::symbol symbol : table) {
+				record("symbol", first);
+				symbol_fields(out, tables[0]->name, symbol);
+				end();
+				first = false;
+			}
+		}
+		if (nested) out.put(']');
+	}
+	if (nested) out.put("}\n");
+}
+
+
+template <typename elf_class>
+const symbol_table& elf_class_parser<elf_class>::load_symbols(std::optional<symbol_table>& table, std::uint32_t type) {
+
+	if (table) {
+		return *table;
+	}
+	stat_timer timer(stat_phase::symbols);
+	byte_view cached = type == 0x02 ? cachedSymbols : cachedDynamicSymbols;
+	if (!cached.empty()) {
+		table = metadata_cache::decode_symbols(cached, *this);
+		if (table) {
+			stat_add(stat_counter::symbols_decoded, table->size());
+			return *table;
+		}
+	}
+	std::vector<section_t*> tables = sections_of_type(type);
+	if (tables.empty()) {
+		table.emplace();
+		return *table;
+	}
+	section_t &section = *tables[0];
+	std::size_t index = &section - sectionHeaderTable.data();
+	byte_view strtab = section.sh_link < sectionHeaderTable.size() ?
+				section_at(section.sh_link).data : byte_view();
+	byte_view xindex;
+	for (section_t* shndx : sections_of_type(0x12)) {
+		if (shndx->sh_link == index) xindex = shndx->data;
+	}
+	table = symbol_table::decode<elf_class>(section.data, section.sh_entsize, strtab,
+				elfHeader.e_ident[EI_DATA_offset] == 2, xindex);
+	stat_add(stat_counter::symbols_decoded, table->size());
+	return *table;
+}
+
+
+template <typename elf_class>
+const name_index& elf_class_parser<elf_class>::dynamic_names(void) {
+
+	if (dynamicNames) {
+		return *dynamicNames;
+	}
+	const symbol_table &symbols = dynamic_symbols();
+	// hash tables linked to the symbol table that was decoded
+	std::vector<section_t*> tables = sections_of_type(0x0B);
+	std::size_t index = tables.empty() ? 0 : tables[0] - sectionHeaderTable.data();
+	byte_view gnuHash, sysvHash;
+	for (section_t* section : sections_of_type(0x6FFFFFF6)) {
+		if (section->sh_link == index) gnuHash = section->data;
+	}
+	for (section_t* section : sections_of_type(0x05)) {
+		if (section->sh_link == index) sysvHash = section->data;
+	}
+	dynamicNames.emplace(symbols, gnuHash, sysvHash, elfHeader.e_ident[EI_DATA_offset] == 2,
+				elf_class::elf_class == 2 ? 8 : 4);
+	return *dynamicNames;
+}
+
+
+template <typename elf_class>
+const relocation_table& elf_class_parser<elf_class>::relocations(void) {
+
+	if (relocationTable) {
+		return *relocationTable;
+	}
+	stat_timer timer(stat_phase::relocations);
+	relocationTable.emplace();
+	bool bigEndian = elfHeader.e_ident[EI_DATA_offset] == 2;
+	std::uint32_t relative = relocation_table::relative_type(elfHeader.e_machine);
+	std::vector<std::size_t> tables;
+	std::size_t rows = 0;
+	for (std::size_t i=0; i<sectionHeaderTable.size(); i++) {
+		const section_t &section = sectionHeaderTable[i];
+		if (section.sh_type != SHT_REL && section.sh_type != SHT_RELA && section.sh_type != SHT_RELR) continue;
+		tables.push_back(i);
+		// RELR sections expand to a count only known once decoded
+		std::uint64_t entsize = section.sh_type == SHT_RELA ? elf_class::rela_size : elf_class::rel_size;
+		if (section.sh_type != SHT_RELR) rows += section.sh_size / std::max<std::uint64_t>(section.sh_entsize, entsize);
+	}
+	relocationTable->reserve(rows);
+	for (std::size_t i : tables) {
+		section_t &section = section_at(i);
+		std::uint32_t type = section.sh_type;
+		relocation_table::run_t run;
+		run.section = i;
+		run.target = section.sh_info;
+		run.symbols = section.sh_link;
+		run.type = type;
+		relocationTable->append<elf_class>(section.data, run, section.sh_entsize, bigEndian, relative);
+	}
+	stat_add(stat_counter::relocations_decoded, relocationTable->size());
+	return *relocationTable;
+}
+
+
+template <typename elf_class>
+const line_table& elf_class_parser<elf_class>::lines(void) {
+
+	if (!lineTable) {
+		stat_timer timer(stat_phase::lines);
+		std::vector<section_t*> sections;
+		for (const char* name : {".debug_line", ".debug_line_str", ".debug_str"}) {
+			auto it = sectionIndex.find(name);
+			if (it != sectionIndex.end()) sections.push_back(&sectionHeaderTable[it->second]);
+		}
+		load_sections(sections);
+		lineTable.emplace(section_view(".debug_line"), section_view(".debug_line_str"),
+				section_view(".debug_str"), elfHeader.e_ident[EI_DATA_offset] == 2);
+	}
+	return *lineTable;
+}
+
+
+template <typename elf_class>
+const segment_index& elf_class_parser<elf_class>::vaddr_index(void) {
+
+	if (!segmentIndex) {
+		std::vector<load_segment> loads;
+		for (const segment_t &segment : programHeaderTable) {
+			if (segment.p_type != 0x01) continue;
+			loads.push_back({segment.p_vaddr, segment.p_memsz, segment.p_offset,
+					std::min<std::uint64_t>(segment.p_filesz, segment.p_memsz), segment.p_flags});
+		}
+		segmentIndex.emplace(std::move(loads));
+	}
+	return *segmentIndex;
+}
+
+
+template <typename elf_class>
+byte_view elf_class_parser<elf_class>::read_at_vaddr(std::uint64_t vaddr, std::uint64_t size) {
+
+	std::uint64_t offset = vaddr_index().range_to_offset(vaddr, size);
+	if (offset == segment_index::npos) return byte_view();
+	return buffer->read(offset, size);
+}
+
+
+template <typename elf_class>
+byte_view elf_class_parser<elf_class>::file_bytes(std::size_t index) {
+
+	if (index >= sectionHeaderTable.size() || sectionHeaderTable[index].sh_type == 0x08) return byte_view();
+	return buffer->read(sectionHeaderTable[index].sh_offset, sectionHeaderTable[index].sh_size);
+}
+
+
+template <typename elf_class>
+unsigned elf_class_parser<elf_class>::adopt(elf_class_parser& previous, const std::vector<bool>& unchanged) {
+
+	auto same = [&](std::size_t index) { return index < unchanged.size() && unchanged[index]; };
+	auto first_of_type = [this](std::uint32_t type) {
+		for (std::size_t i=0; i<sectionHeaderTable.size(); i++) {
+			if (sectionHeaderTable[i].sh_type == type) return i;
+		}
+		return sectionHeaderTable.size();
+	};
+	unsigned adopted = 0;
+
+	// a symbol table, its string table and its extended section indexes;
+	// names are views, so they are pointed at this file's string table
+	for (auto [type, flag] : {std::make_pair(0x02u, adopted_symbols), std::make_pair(0x0Bu, adopted_dynamic_symbols)}) {
+		std::optional<symbol_table> &table = type == 0x02 ? symbolTable : dynamicSymbolTable;
+		std::optional<symbol_table> &old = type == 0x02 ? previous.symbolTable : previous.dynamicSymbolTable;
+		std::size_t index = first_of_type(type);
+		if (table || !old || index == sectionHeaderTable.size() || !same(index)) continue;
+		std::uint32_t link = sectionHeaderTable[index].sh_link;
+		if (!same(link)) continue;
+		bool inputs = true;
+		for (std::size_t i=0; i<sectionHeaderTable.size(); i++) {
+			if (sectionHeaderTable[i].sh_type == 0x12 && sectionHeaderTable[i].sh_link == index) inputs &= same(i);
+		}
+		if (!inputs) continue;
+		table = std::move(old);
+		old.reset();
+		table->strtab = section_at(link).data;
+		adopted |= flag;
+	}
+
+	// runs refer to sections by index, so every relocation section has to
+	// be where it was
+	if (!relocationTable && previous.relocationTable) {
+		std::size_t count = 0, previousCount = 0;
+		bool inputs = true;
+		for (std::size_t i=0; i<sectionHeaderTable.size(); i++) {
+			std::uint32_t type = sectionHeaderTable[i].sh_type;
+			if (type != SHT_REL && type != SHT_RELA && type != SHT_RELR) continue;
+			count++;
+			inputs &= same(i);
+		}
+		for (const section_t &section : previous.sectionHeaderTable) {
+			std::uint32_t type = section.sh_type;
+			if (type == SHT_REL || type == SHT_RELA || type == SHT_RELR) previousCount++;
+		}
+		if (inputs && count == previousCount) {
+			relocationTable = std::move(previous.relocationTable);
+			previous.relocationTable.reset();
+			adopted |= adopted_relocations;
+		}
+	}
+
+	if (!lineTable && previous.lineTable) {
+		bool inputs = true;
+		for (const char* name : {".debug_line", ".debug_line_str", ".debug_str"}) {
+			auto it = sectionIndex.find(name);
+			auto old = previous.sectionIndex.find(name);
+			if (it == sectionIndex.end() || old == previous.sectionIndex.end()) {
+				inputs &= it == sectionIndex.end() && old == previous.sectionIndex.end();
+			} else {
+				inputs &= it->second == old->second && same(it->second);
+			}
+		}
+		if (inputs) {
+			lineTable = std::move(previous.lineTable);
+			previous.lineTable.reset();
+			adopted |= adopted_lines;
+		}
+	}
+
+	if (!segmentIndex && previous.segmentIndex
+			&& programHeaderTable.size() == previous.programHeaderTable.size()) {
+		bool equal = true;
+		for (std::size_t i=0; i<programHeaderTable.size() && equal; i++) {
+			const segment_t &a = programHeaderTable[i], &b = previous.programHeaderTable[i];
+			equal = a.p_type == b.p_type && a.p_offset == b.p_offset && a.p_vaddr == b.p_vaddr
+				&& a.p_filesz == b.p_filesz && a.p_memsz == b.p_memsz && a.p_flags == b.p_flags;
+		}
+		if (equal) {
+			segmentIndex = std::move(previous.segmentIndex);
+			previous.segmentIndex.reset();
+			adopted |= adopted_segments;
+		}
+	}
+	return adopted;
+}
+
+
+template class elf_class_parser<elf32_traits>;
+template class elf_class_parser<elf64_traits>;
+
 } // end of namespace elf
@@ -0,0 +1,210 @@
+#include "../inc/elf_relocs.hpp"
+#include "../inc/elf_parser.hpp"
+
+#include <algorithm>
+#include <numeric>
+#include <type_traits>
+
+
+namespace elf {
+
+
+template <typename elf_class>
+void relocation_table::append(byte_view table, run_t run, std::size_t entsize, bool bigEndian,
+				std::uint32_t relativeType) {
+
+	run.first = size();
+	run.count = 0;
+	bool swap = bigEndian != host_big_endian;
+
+	if (run.type == SHT_RELR) {
+		std::size_t words = table.size() / elf_class::r_addr_size;
+		run.count = swap ? decode_relr<elf_class, true>(table.data(), words, relativeType)
+				: decode_relr<elf_class, false>(table.data(), words, relativeType);
+		relRuns.push_back(run);
+		return;
+	}
+
+	bool rela = run.type == SHT_RELA;
+	std::size_t fixed = rela ? elf_class::rela_size : elf_class::rel_size;
+	if (entsize < fixed) entsize = fixed;
+	std::size_t count = table.size() / entsize;
+	relOffset.resize(run.first + count);
+	relType.resize(run.first + count);
+	relSymbol.resize(run.first + count);
+	relAddend.resize(run.first + count);
+	run.count = count;
+	relRuns.push_back(run);
+
+	// fields are loaded and swapped in registers, a bulk swap_table pass
+	// first costs a copy of the section and measured slower
+	const std::uint8_t* rows = table.data();
+	if (rela) {
+		swap ? decode_rows<elf_class, true, true>(rows, count, entsize, run.first)
+			: decode_rows<elf_class, false, true>(rows, count, entsize, run.first);
+	} else {
+		swap ? decode_rows<elf_class, true, false>(rows, count, entsize, run.first)
+			: decode_rows<elf_class, false, false>(rows, count, entsize, run.first);
+	}
+}
+
+
+template <typename elf_class, bool swap, bool rela>
+void relocation_table::decode_rows(const std::uint8_t* table, std::size_t count, std::size_t entsize,
+					std::size_t first) {
+
+	// plain loads into four columns, no branches in the loop
+	typedef typename uint_of_size<elf_class::r_addr_size>::type word_t;
+	typedef typename std::make_signed<word_t>::type sword_t;
+	std::uint64_t* offsets = relOffset.data() + first;
+	std::uint32_t* types = relType.data() + first;
+	std::uint32_t* symbols = relSymbol.data() + first;
+	std::int64_t* addends = relAddend.data() + first;
+	for (std::size_t i=0; i<count; i++) {
+		const std::uint8_t* entry = table + entsize * i;
+		std::uint64_t info = load<elf_class::r_addr_size, swap>(entry + elf_class::r_info_offset);
+		offsets[i] =	load<elf_class::r_addr_size, swap>(entry + r_offset_offset);
+		types[i] =	info & elf_class::r_type_mask;
+		symbols[i] =	info >> elf_class::r_sym_shift;
+		addends[i] =	rela ? (sword_t) load<elf_class::r_addr_size, swap>(entry + elf_class::r_addend_offset) : 0;
+	}
+}
+
+
+template <typename elf_class, bool swap>
+std::size_t relocation_table::decode_relr(const std::uint8_t* table, std::size_t words,
+						std::uint32_t relativeType) {
+
+	// an even word is an address to relocate, an odd one a bitmap of the
+	// next word sized slots after the last address, bit 1 for the first
+	constexpr std::size_t word = elf_class::r_addr_size;
+	constexpr std::size_t bits = 8 * word - 1;
+	std::size_t count = 0;
+	for (std::size_t i=0; i<words; i++) {
+		std::uint64_t entry = load<word, swap>(table + i*word);
+		count += entry & 1 ? __builtin_popcountll(entry >> 1) : 1;
+	}
+
+	std::size_t first = size();
+	relOffset.resize(first + count);
+	relType.resize(first + count, relativeType);
+	relSymbol.resize(first + count, 0);
+	relAddend.resize(first + count, 0);
+	std::uint64_t* offsets = relOffset.data() + first;
+	std::uint64_t next = 0;
+	std::size_t row = 0;
+	for (std::size_t i=0; i<words; i++) {
+		std::uint64_t entry = load<word, swap>(table + i*word);
+		if (!(entry & 1)) {
+			offsets[row++] = entry;
+			next = entry + word;
+			continue;
+		}
+		for (std::uint64_t bitmap = entry >> 1; bitmap; bitmap &= bitmap - 1) {
+			offsets[row++] = next + __builtin_ctzll(bitmap) * word;
+		}
+		next += bits * word;
+	}
+	return count;
+}
+
+
+void relocation_table::reserve(std::size_t rows) {
+
+	relOffset.reserve(rows);
+	relType.reserve(rows);
+	relSymbol.reserve(rows);
+	relAddend.reserve(rows);
+}
+
+
+std::uint32_t relocation_table::relative_type(std::uint16_t machine) {
+
+	switch (machine) {
+		case 0x03: return 8;		// R_386_RELATIVE
+		case 0x3E: return 8;		// R_X86_64_RELATIVE
+		case 0x28: return 23;		// R_ARM_RELATIVE
+		case 0xB7: return 1027;		// R_AARCH64_RELATIVE
+		case 0x14: return 22;		// R_PPC_RELATIVE
+		case 0x15: return 22;		// R_PPC64_RELATIVE
+		case 0x16: return 12;		// R_390_RELATIVE
+		case 0xF3: return 3;		// R_RISCV_RELATIVE
+		case 0x102: return 3;		// R_LARCH_RELATIVE
+		default: return 0;
+	}
+}
+
+
+relocation_table::grouping relocation_table::by_type(void) const {
+
+	grouping groups;
+	std::uint32_t maxType = 0;
+	for (std::uint32_t type : relType) maxType = std::max(maxType, type);
+	groups.rows.resize(size());
+
+	if (maxType >= 1 << 16) {
+		// sparse types, sort the rows instead of counting
+		std::iota(groups.rows.begin(), groups.rows.end(), 0);
+		std::stable_sort(groups.rows.begin(), groups.rows.end(), [this](std::uint32_t a, std::uint32_t b) {
+			return relType[a] < relType[b];
+		});
+		for (std::size_t i=0; i<groups.rows.size(); i++) {
+			std::uint32_t type = relType[groups.rows[i]];
+			if (groups.keys.empty() || groups.keys.back() != type) {
+				groups.keys.push_back(type);
+				groups.starts.push_back(i);
+			}
+		}
+		groups.starts.push_back(size());
+		return groups;
+	}
+
+	// counting sort, one pass to count and one to place
+	std::vector<std::size_t> position(empty() ? 0 : maxType + 1);
+	for (std::uint32_t type : relType) position[type]++;
+	std::size_t start = 0;
+	for (std::uint32_t type=0; type<position.size(); type++) {
+		if (position[type] == 0) continue;
+		groups.keys.push_back(type);
+		groups.starts.push_back(start);
+		std::size_t count = position[type];
+		position[type] = start;
+		start += count;
+	}
+	groups.starts.push_back(start);
+	for (std::size_t row=0; row<size(); row++) groups.rows[position[relType[row]]++] = row;
+	return groups;
+}
+
+
+relocation_table::grouping relocation_table::by_target(void) const {
+
+	// rows of a run are contiguous, so only the runs need ordering
+	std::vector<std::size_t> order(relRuns.size());
+	std::iota(order.begin(), order.end(), 0);
+	std::stable_sort(order.begin(), order.end(), [this](std::size_t a, std::size_t b) {
+		return relRuns[a].target < relRuns[b].target;
+	});
+
+	grouping groups;
+	groups.rows.resize(size());
+	std::size_t filled = 0;
+	for (std::size_t i : order) {
+		const run_t &run = relRuns[i];
+		if (run.count == 0) continue;
+		if (groups.keys.empty() || groups.keys.back() != run.target) {
+			groups.keys.push_back(run.target);
+			groups.starts.push_back(filled);
+		}
+		std::iota(groups.rows.begin() + filled, groups.rows.begin() + filled + run.count, run.first);
+		filled += run.count;
+	}
+	groups.starts.push_back(filled);
+	return groups;
+}
+
+
+template void relocation_table::append<elf32_traits>(byte_view, run_t, std::size_t, bool, std::uint32_t);
+template void relocation_table::append<elf64_traits>(byte_view, run_t, std::size_t, bool, std::uint32_t);
+
+} // end of namespace elf
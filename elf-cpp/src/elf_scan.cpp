@@ -0,0 +1,184 @@
+#include "../inc/elf_scan.hpp"
+
+#include <system_error>
+
+
+namespace elf {
+
+
+scan_channel::scan_channel(std::vector<std::string> paths, scan_options options)
+		: paths(std::move(paths)), options(options) {
+
+	std::size_t threads = options.threads ? options.threads : std::thread::hardware_concurrency();
+	if (threads == 0) threads = 1;
+	if (threads > this->paths.size()) threads = this->paths.size();
+	if (this->options.max_pending == 0) this->options.max_pending = 4 * threads;
+	remaining = this->paths.size();
+
+	// neighbouring paths usually share a directory, keep them on one worker
+	for (std::size_t i=0; i<threads; i++) {
+		queues.push_back(std::make_unique<worker_queue>());
+		std::size_t first = this->paths.size() * i / threads;
+		std::size_t last = this->paths.size() * (i+1) / threads;
+		for (std::size_t j=first; j<last; j++) queues[i]->tasks.push_back(j);
+	}
+	for (std::size_t i=0; i<threads; i++) workers.emplace_back(&scan_channel::work, this, i);
+}
+
+
+scan_channel::~scan_channel() {
+
+	cancel();
+	for (std::thread& worker : workers) worker.join();
+}
+
+
+void scan_channel::cancel(void) {
+
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		stopped = true;
+	}
+	resultReady.notify_all();
+	slotFree.notify_all();
+}
+
+
+bool scan_channel::next(scan_result& result) {
+
+	std::unique_lock<std::mutex> guard(lock);
+	resultReady.wait(guard, [this] { return !results.empty() || remaining == 0 || stopped; });
+	if (results.empty() || stopped) return false;
+	result = std::move(results.front());
+	results.pop_front();
+	inFlight--;
+	guard.unlock();
+	slotFree.notify_one();
+	return true;
+}
+
+
+bool scan_channel::take_task(std::size_t self, std::size_t& index) {
+
+	{
+		worker_queue& own = *queues[self];
+		std::lock_guard<std::mutex> guard(own.lock);
+		if (!own.tasks.empty()) {
+			index = own.tasks.front();
+			own.tasks.pop_front();
+			return true;
+		}
+	}
+	// steal the back half of the first non-empty queue after ours, the
+	// owner keeps working from the front so the two rarely meet
+	for (std::size_t i=1; i<queues.size(); i++) {
+		worker_queue& victim = *queues[(self + i) % queues.size()];
+		std::vector<std::size_t> stolen;
+		{
+			std::lock_guard<std::mutex> guard(victim.lock);
+			std::size_t count = (victim.tasks.size() + 1) / 2;
+			if (count == 0) continue;
+			stolen.assign(victim.tasks.end() - count, victim.tasks.end());
+			victim.tasks.erase(victim.tasks.end() - count, victim.tasks.end());
+		}
+		index = stolen.front();
+		worker_queue& own = *queues[self];
+		std::lock_guard<std::mutex> guard(own.lock);
+		own.tasks.insert(own.tasks.end(), stolen.begin() + 1, stolen.end());
+		return true;
+	}
+	return false;
+}
+
+
+void scan_channel::work(std::size_t self) {
+
+	std::size_t index;
+	while (true) {
+		{
+			// backpressure, don't start a file until the consumer caught up
+			std::unique_lock<std::mutex> guard(lock);
+			slotFree.wait(guard, [this] { return inFlight < options.max_pending || stopped; });
+			if (stopped) return;
+			inFlight++;
+		}
+		if (!take_task(self, index)) {
+			std::lock_guard<std::mutex> guard(lock);
+			inFlight--;
+			return;
+		}
+
+		scan_result result;
+		result.index = index;
+		result.path = paths[index];
+		if (options.notes_only) {
+			read_notes(result.path, result.notes, result.error);
+		} else {
+			result.parser = elf_parser::open(result.path, result.error, options.read);
+		}
+		bool skip = options.skip_non_elf && result.error.code == parse_errc::bad_magic;
+
+		bool done;
+		{
+			std::lock_guard<std::mutex> guard(lock);
+			done = --remaining == 0;
+			if (skip) {
+				inFlight--;
+			} else {
+				results.push_back(std::move(result));
+			}
+		}
+		if (done) {
+			resultReady.notify_all();
+		} else if (skip) {
+			slotFree.notify_one();
+		} else {
+			resultReady.notify_one();
+		}
+	}
+}
+
+
+std::vector<std::string> list_files(const std::string& root) {
+
+	// recursive_directory_iterator gives up on the whole walk at its first
+	// error, here a directory that can't be read or went away mid-walk only
+	// loses its own entries
+	std::vector<std::string> files;
+	std::vector<std::filesystem::path> pending {root};
+	while (!pending.empty()) {
+		std::filesystem::path dir = std::move(pending.back());
+		pending.pop_back();
+		std::error_code error;
+		std::filesystem::directory_iterator it(dir, std::filesystem::directory_options::skip_permission_denied, error);
+		for (; !error && it != std::filesystem::directory_iterator(); it.increment(error)) {
+			// a link would list its target again, or something outside root
+			std::error_code status;
+			if (it->is_symlink(status)) continue;
+			if (it->is_directory(status)) {
+				pending.push_back(it->path());
+			} else if (it->is_regular_file(status)) {
+				files.push_back(it->path().string());
+			}
+		}
+	}
+	return files;
+}
+
+
+void scan_files(std::vector<std::string> paths, const std::function<void(scan_result&)>& callback,
+			scan_options options) {
+
+	scan_channel channel(std::move(paths), options);
+	scan_result result;
+	while (channel.next(result)) callback(result);
+}
+
+
+void scan_directory(const std::string& root, const std::function<void(scan_result&)>& callback,
+			scan_options options) {
+
+	scan_files(list_files(root), callback, options);
+}
+
+} // end of namespace elf
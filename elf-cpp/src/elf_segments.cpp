@@ -0,0 +1,93 @@
+#include "../inc/elf_segments.hpp"
+
+#include <algorithm>
+
+
+namespace elf {
+
+
+segment_index::segment_index(std::vector<load_segment> segments) {
+
+	segments.erase(std::remove_if(segments.begin(), segments.end(),
+			[](const load_segment& segment) { return segment.memsz == 0; }), segments.end());
+	std::stable_sort(segments.begin(), segments.end(),
+			[](const load_segment& a, const load_segment& b) { return a.vaddr < b.vaddr; });
+	// a segment reaching into the next one ends where the next one starts
+	for (std::size_t i=0; i+1<segments.size(); i++) {
+		load_segment &segment = segments[i];
+		std::uint64_t room = segments[i+1].vaddr - segment.vaddr;
+		segment.memsz = std::min(segment.memsz, room);
+		segment.filesz = std::min(segment.filesz, segment.memsz);
+	}
+	segments.erase(std::remove_if(segments.begin(), segments.end(),
+			[](const load_segment& segment) { return segment.memsz == 0; }), segments.end());
+	bySegment = std::move(segments);
+
+	for (std::uint32_t i=0; i<bySegment.size(); i++) {
+		if (bySegment[i].filesz) byOffset.push_back(i);
+	}
+	std::stable_sort(byOffset.begin(), byOffset.end(), [this](std::uint32_t a, std::uint32_t b) {
+		return bySegment[a].offset < bySegment[b].offset;
+	});
+}
+
+
+segment_index::segment_index(const segment_index& other)
+		: bySegment(other.bySegment), byOffset(other.byOffset) {}
+
+
+segment_index& segment_index::operator=(const segment_index& other) {
+
+	bySegment = other.bySegment;
+	byOffset = other.byOffset;
+	last.store(0, std::memory_order_relaxed);
+	return *this;
+}
+
+
+const load_segment* segment_index::find(std::uint64_t vaddr) const {
+
+	std::uint32_t hint = last.load(std::memory_order_relaxed);
+	if (hint < bySegment.size() && vaddr - bySegment[hint].vaddr < bySegment[hint].memsz) {
+		return &bySegment[hint];
+	}
+	auto it = std::upper_bound(bySegment.begin(), bySegment.end(), vaddr,
+			[](std::uint64_t value, const load_segment& segment) { return value < segment.vaddr; });
+	if (it == bySegment.begin()) return nullptr;
+	--it;
+	if (vaddr - it->vaddr >= it->memsz) return nullptr;
+	last.store(it - bySegment.begin(), std::memory_order_relaxed);
+	return &*it;
+}
+
+
+std::uint64_t segment_index::vaddr_to_offset(std::uint64_t vaddr) const {
+
+	const load_segment* segment = find(vaddr);
+	if (!segment || vaddr - segment->vaddr >= segment->filesz) return npos;
+	return segment->offset + (vaddr - segment->vaddr);
+}
+
+
+std::uint64_t segment_index::offset_to_vaddr(std::uint64_t offset) const {
+
+	auto it = std::upper_bound(byOffset.begin(), byOffset.end(), offset,
+			[this](std::uint64_t value, std::uint32_t i) { return value < bySegment[i].offset; });
+	if (it == byOffset.begin()) return npos;
+	const load_segment &segment = bySegment[*--it];
+	if (offset - segment.offset >= segment.filesz) return npos;
+	return segment.vaddr + (offset - segment.offset);
+}
+
+
+std::uint64_t segment_index::range_to_offset(std::uint64_t vaddr, std::uint64_t size) const {
+
+	const load_segment* segment = find(vaddr);
+	if (!segment) return npos;
+	std::uint64_t at = vaddr - segment->vaddr;
+	if (at >= segment->filesz || size > segment->filesz - at) return npos;
+	return segment->offset + at;
+}
+
+
+} // end of namespace elf
@@ -0,0 +1,167 @@
+#include "../inc/elf_stats.hpp"
+
+#include <chrono>
+#include <mutex>
+#include <vector>
+
+namespace elf {
+
+
+const char* stat_name(stat_phase phase) {
+
+	static const char* names[stat_phase_count] = {
+		"io", "header", "section_table", "section_names", "program_table", "segment_mapping",
+		"section_load", "decompress", "symbols", "relocations", "lines", "output"
+	};
+	return names[static_cast<unsigned>(phase)];
+}
+
+
+const char* stat_name(stat_counter counter) {
+
+	static const char* names[stat_counter_count] = {
+		"files_parsed", "bytes_read", "bytes_mapped", "allocations", "sections_decoded",
+		"segments_decoded", "sections_loaded", "section_bytes", "symbols_decoded",
+		"relocations_decoded", "cache_hits", "cache_misses"
+	};
+	return names[static_cast<unsigned>(counter)];
+}
+
+
+void parse_stats::write_json(output_buffer& out) const {
+
+	out.put("{\"enabled\":").put(stats_enabled ? "true" : "false").put(",\"phases\":{");
+	for (std::size_t i=0; i<stat_phase_count; i++) {
+		if (i) out.put(',');
+		out.json(stat_name(static_cast<stat_phase>(i))).put(":{\"ns\":").dec(nanoseconds[i])
+			.put(",\"calls\":").dec(calls[i]).put('}');
+	}
+	out.put("},\"counters\":{");
+	for (std::size_t i=0; i<stat_counter_count; i++) {
+		if (i) out.put(',');
+		out.json(stat_name(static_cast<stat_counter>(i))).put(':').dec(counters[i]);
+	}
+	out.put("}}");
+}
+
+
+#ifdef ELF_STATS
+
+// blocks of live threads, and what exited threads left behind
+typedef struct stat_registry {
+	std::mutex lock;
+	std::vector<stat_block*> blocks;
+	parse_stats retired;
+} stat_registry;
+
+// never destroyed, threads may exit after static destructors ran
+static stat_registry& registry(void) {
+
+	static stat_registry* instance = new stat_registry();
+	return *instance;
+}
+
+
+static void add_block(parse_stats& stats, const stat_block& block) {
+
+	for (std::size_t i=0; i<stat_phase_count; i++) {
+		stats.nanoseconds[i] += block.nanoseconds[i].load(std::memory_order_relaxed);
+		stats.calls[i] += block.calls[i].load(std::memory_order_relaxed);
+	}
+	for (std::size_t i=0; i<stat_counter_count; i++) {
+		stats.counters[i] += block.counters[i].load(std::memory_order_relaxed);
+	}
+}
+
+
+typedef struct stat_owner {
+	stat_block block;
+	stat_owner() {
+		std::lock_guard<std::mutex> guard(registry().lock);
+		registry().blocks.push_back(&block);
+	}
+	~stat_owner() {
+		stat_registry &shared = registry();
+		std::lock_guard<std::mutex> guard(shared.lock);
+		add_block(shared.retired, block);
+		for (std::size_t i=0; i<shared.blocks.size(); i++) {
+			if (shared.blocks[i] != &block) continue;
+			shared.blocks[i] = shared.blocks.back();
+			shared.blocks.pop_back();
+			break;
+		}
+	}
+} stat_owner;
+
+
+stat_block& thread_stats(void) {
+
+	thread_local stat_owner owner;
+	return owner.block;
+}
+
+
+static thread_local stat_timer* current = nullptr;
+
+static std::uint64_t now_ns(void) {
+
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(
+			std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+
+stat_timer::stat_timer(stat_phase phase) : phase(phase), start(now_ns()), parent(current) {
+
+	current = this;
+}
+
+
+stat_timer::~stat_timer() {
+
+	std::uint64_t elapsed = now_ns() - start;
+	current = parent;
+	if (parent) parent->nested += elapsed;
+	stat_block &block = thread_stats();
+	unsigned i = static_cast<unsigned>(phase);
+	block.nanoseconds[i].store(block.nanoseconds[i].load(std::memory_order_relaxed) + elapsed - nested,
+					std::memory_order_relaxed);
+	block.calls[i].store(block.calls[i].load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+}
+
+
+parse_stats collect_stats(void) {
+
+	stat_registry &shared = registry();
+	std::lock_guard<std::mutex> guard(shared.lock);
+	parse_stats stats = shared.retired;
+	for (const stat_block* block : shared.blocks) add_block(stats, *block);
+	return stats;
+}
+
+
+void reset_stats(void) {
+
+	stat_registry &shared = registry();
+	std::lock_guard<std::mutex> guard(shared.lock);
+	shared.retired = parse_stats();
+	for (stat_block* block : shared.blocks) {
+		for (auto &slot : block->nanoseconds) slot.store(0, std::memory_order_relaxed);
+		for (auto &slot : block->calls) slot.store(0, std::memory_order_relaxed);
+		for (auto &slot : block->counters) slot.store(0, std::memory_order_relaxed);
+	}
+}
+
+#else
+
+parse_stats collect_stats(void) {
+
+	return parse_stats();
+}
+
+
+void reset_stats(void) {}
+
+#endif
+
+
+} // end of namespace elf
@@ -0,0 +1,384 @@
+#include "../inc/elf_symbols.hpp"
+#include "../inc/elf_parser.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+
+namespace elf {
+
+
+template <typename elf_class>
+symbol_table symbol_table::decode(byte_view table, std::size_t entsize, byte_view strtab,
+					bool bigEndian, byte_view xindex) {
+
+	symbol_table symbols;
+	symbols.strtab = strtab;
+	if (entsize < (std::size_t) elf_class::sym_size) entsize = elf_class::sym_size;
+	std::size_t count = table.size() / entsize;
+	symbols.symValue.resize(count);
+	symbols.symSize.resize(count);
+	symbols.symInfo.resize(count);
+	symbols.symOther.resize(count);
+	symbols.symShndx.resize(count);
+	symbols.symName.resize(count);
+
+	if (bigEndian == host_big_endian) {
+		symbols.decode_rows<elf_class, false>(table.data(), count, entsize);
+	} else if (entsize == (std::size_t) elf_class::sym_size) {
+		// swap the whole table in one pass, then decode it as host order
+		std::vector<std::uint8_t> native(count * entsize);
+		swap_table(table.data(), native.data(), native.size(),
+				elf_class::sym_layout, sizeof(elf_class::sym_layout));
+		symbols.decode_rows<elf_class, false>(native.data(), count, entsize);
+	} else {
+		symbols.decode_rows<elf_class, true>(table.data(), count, entsize);
+	}
+
+	// section indexes that don't fit in st_shndx are in SHT_SYMTAB_SHNDX
+	if (!xindex.empty()) {
+		for (std::size_t i=0; i<count && (i+1)*4 <= xindex.size(); i++) {
+			if (symbols.symShndx[i] != SHN_XINDEX) continue;
+			symbols.symShndx[i] = bigEndian == host_big_endian ?
+					load<4, false>(xindex.data() + i*4)
+					: load<4, true>(xindex.data() + i*4);
+		}
+	}
+	return symbols;
+}
+
+
+template <typename elf_class, bool swap>
+void symbol_table::decode_rows(const std::uint8_t* table, std::size_t count, std::size_t entsize) {
+
+	for (std::size_t i=0; i<count; i++) {
+		const std::uint8_t* entry = table + entsize * i;
+		symName[i] =	load<st_name_size, swap>(entry+st_name_offset);
+		symValue[i] =	load<elf_class::st_value_size, swap>(entry+elf_class::st_value_offset);
+		symSize[i] =	load<elf_class::st_size_size, swap>(entry+elf_class::st_size_offset);
+		symInfo[i] =	entry[elf_class::st_info_offset];
+		symOther[i] =	entry[elf_class::st_other_offset];
+		symShndx[i] =	load<st_shndx_size, swap>(entry+elf_class::st_shndx_offset);
+	}
+}
+
+
+std::string_view symbol_table::name(std::size_t index) const {
+
+	std::uint32_t offset = symName[index];
+	if (offset >= strtab.size()) {
+		return std::string_view();
+	}
+	const char* str = reinterpret_cast<const char*>(strtab.data()) + offset;
+	return std::string_view(str, strnlen(str, strtab.size()-offset));
+}
+
+
+bool symbol_table::name_equals(std::size_t index, std::string_view name) const {
+
+	std::uint32_t offset = symName[index];
+	if (offset >= strtab.size()) {
+		return name.empty();
+	}
+	std::size_t left = strtab.size() - offset;
+	const std::uint8_t* str = strtab.data() + offset;
+	if (name.size() > left || std::memcmp(str, name.data(), name.size()) != 0) {
+		return false;
+	}
+	return name.size() == left || str[name.size()] == 0;
+}
+
+
+std::vector<std::uint32_t> symbol_table::filter(std::uint8_t type, std::uint8_t bind) const {
+
+	// branch free compaction over the info column so the loop vectorises
+	std::uint8_t typeMask = type == 0xFF ? 0x00 : 0x0F;
+	std::uint8_t bindMask = bind == 0xFF ? 0x00 : 0xF0;
+	std::uint8_t mask = typeMask | bindMask;
+	std::uint8_t want = ((bind << 4) & bindMask) | (type & typeMask);
+	std::vector<std::uint32_t> result(symInfo.size());
+	std::size_t found = 0;
+	for (std::size_t i=0; i<symInfo.size(); i++) {
+		result[found] = i;
+		found += (symInfo[i] & mask) == want;
+	}
+	result.resize(found);
+	return result;
+}
+
+
+address_index::address_index(const symbol_table& symbols) {
+
+	// defined functions, sorted by address with aliases folded together
+	std::vector<std::uint32_t> funcs;
+	for (std::uint32_t row : symbols.filter(STT_FUNC)) funcs.push_back(row);
+	for (std::uint32_t row : symbols.filter(STT_GNU_IFUNC)) funcs.push_back(row);
+	const std::vector<std::uint64_t> &values = symbols.values();
+	const std::vector<std::uint64_t> &sizes = symbols.sizes();
+	const std::vector<std::uint32_t> &shndx = symbols.section_indexes();
+	const std::vector<std::uint8_t> &infos = symbols.infos();
+	funcs.erase(std::remove_if(funcs.begin(), funcs.end(), [&](std::uint32_t row) {
+		return shndx[row] == SHN_UNDEF;
+	}), funcs.end());
+	// for aliases prefer the larger, then the global one
+	std::sort(funcs.begin(), funcs.end(), [&](std::uint32_t a, std::uint32_t b) {
+		if (values[a] != values[b]) return values[a] < values[b];
+		if (sizes[a] != sizes[b]) return sizes[a] > sizes[b];
+		return (infos[a] >> 4) == STB_GLOBAL && (infos[b] >> 4) != STB_GLOBAL;
+	});
+	for (std::uint32_t row : funcs) {
+		if (!starts.empty() && starts.back() == values[row]) continue;
+		starts.push_back(values[row]);
+		// zero sized symbols only cover their own address
+		sorted.push_back({values[row] + std::max<std::uint64_t>(sizes[row], 1), row});
+	}
+
+	// in-order walk of the implicit tree fills it from the sorted array
+	tree.resize(starts.size() + 1);
+	slots.resize(starts.size() + 1);
+	std::size_t next = 0;
+	std::vector<std::size_t> stack;
+	std::size_t k = 1;
+	while (k <= starts.size() || !stack.empty()) {
+		if (k <= starts.size()) {
+			stack.push_back(k);
+			k = 2*k;
+		} else {
+			k = stack.back();
+			stack.pop_back();
+			tree[k] = starts[next];
+			slots[k] = sorted[next++];
+			k = 2*k + 1;
+		}
+	}
+}
+
+
+std::uint32_t address_index::lookup(std::uint64_t address) const {
+
+	const std::size_t n = starts.size();
+	std::size_t k = 1;
+	while (k <= n) {
+		// the eight slots three levels down share a cache line
+		__builtin_prefetch(tree.data() + 8*k);
+		k = 2*k + (tree[k] <= address);
+	}
+	// undo the trailing left turns, k is then the last start <= address
+	k >>= __builtin_ffsll(k);
+	return k && address < slots[k].end ? slots[k].row : npos;
+}
+
+
+void address_index::lookup(const std::uint64_t* addresses, std::size_t count, std::uint32_t* result) const {
+
+	// a merge pays off once the queries are dense relative to the table
+	std::size_t depth = 64 - __builtin_clzll(starts.size() | 1);
+	if (count * depth < starts.size() || count < 64) {
+		for (std::size_t i=0; i<count; i++) result[i] = lookup(addresses[i]);
+		return;
+	}
+	std::vector<std::uint32_t> queries(count);
+	for (std::size_t i=0; i<count; i++) queries[i] = i;
+	std::sort(queries.begin(), queries.end(), [addresses](std::uint32_t a, std::uint32_t b) {
+		return addresses[a] < addresses[b];
+	});
+	std::size_t upper = 0;
+	for (std::uint32_t query : queries) {
+		std::uint64_t address = addresses[query];
+		while (upper < starts.size() && starts[upper] <= address) upper++;
+		result[query] = upper && address < sorted[upper-1].end ? sorted[upper-1].row : npos;
+	}
+}
+
+
+std::vector<std::uint32_t> address_index::lookup(const std::vector<std::uint64_t>& addresses) const {
+
+	std::vector<std::uint32_t> result(addresses.size());
+	lookup(addresses.data(), addresses.size(), result.data());
+	return result;
+}
+
+
+name_index::name_index(const symbol_table& symbols) : symbols(&symbols) {
+
+	if (!symbols.empty()) build();
+}
+
+
+name_index::name_index(const symbol_table& symbols, byte_view gnuHash, byte_view sysvHash,
+			bool bigEndian, std::size_t wordSize)
+		: symbols(&symbols), swap(bigEndian != host_big_endian) {
+
+	if (symbols.empty()) return;
+	if (use_gnu_hash(gnuHash, wordSize)) {
+		tableKind = source::gnu_hash;
+	} else if (use_sysv_hash(sysvHash)) {
+		tableKind = source::sysv_hash;
+	} else {
+		build();
+	}
+}
+
+
+std::uint32_t name_index::gnu_hash(std::string_view name) {
+
+	std::uint32_t h = 5381;
+	for (unsigned char c : name) h = h * 33 + c;
+	return h;
+}
+
+
+std::uint32_t name_index::sysv_hash(std::string_view name) {
+
+	std::uint32_t h = 0;
+	for (unsigned char c : name) {
+		h = (h << 4) + c;
+		std::uint32_t g = h & 0xF0000000;
+		h ^= g >> 24;
+		h &= ~g;
+	}
+	return h;
+}
+
+
+std::uint32_t name_index::word(const std::uint8_t* ptr) const {
+
+	return swap ? load<4, true>(ptr) : load<4, false>(ptr);
+}
+
+
+bool name_index::use_gnu_hash(byte_view table, std::size_t wordSize) {
+
+	// nbuckets, symoffset, bloom size and shift, then the bloom words,
+	// buckets and one hash value per symbol from symoffset on
+	if (table.size() < 16 || (wordSize != 4 && wordSize != 8)) return false;
+	std::uint32_t bloomSize = word(table.data() + 8);
+	bucketCount = word(table.data());
+	symbolOffset = word(table.data() + 4);
+	bloomShift = word(table.data() + 12);
+	std::uint64_t chainStart = 16 + (std::uint64_t) bloomSize * wordSize + (std::uint64_t) bucketCount * 4;
+	if (bucketCount == 0 || bloomSize == 0 || (bloomSize & (bloomSize-1)) || bloomShift >= 32
+			|| chainStart > table.size() || symbolOffset > symbols->size()) {
+		return false;
+	}
+	bloomMask = bloomSize - 1;
+	wordBits = 8 * wordSize;
+	bloom = table.data() + 16;
+	buckets = bloom + (std::size_t) bloomSize * wordSize;
+	chains = table.data() + chainStart;
+	chainCount = (table.size() - chainStart) / 4;
+	return true;
+}
+
+
+bool name_index::use_sysv_hash(byte_view table) {
+
+	// nbucket, nchain, buckets, then one chain link per symbol
+	if (table.size() < 8) return false;
+	bucketCount = word(table.data());
+	chainCount = word(table.data() + 4);
+	if (bucketCount == 0 || 8 + 4 * ((std::uint64_t) bucketCount + chainCount) > table.size()) {
+		return false;
+	}
+	buckets = table.data() + 8;
+	chains = buckets + 4 * (std::size_t) bucketCount;
+	return true;
+}
+
+
+void name_index::build(void) {
+
+	const std::vector<std::uint32_t> &shndx = symbols->section_indexes();
+	const std::vector<std::uint8_t> &infos = symbols->infos();
+	std::vector<std::uint32_t> defined;
+	for (std::uint32_t row=0; row<shndx.size(); row++) {
+		if (shndx[row] != SHN_UNDEF && (infos[row] >> 4) != STB_LOCAL) defined.push_back(row);
+	}
+	tableKind = source::built;
+	if (defined.empty()) return;
+	// at most half full keeps the probe runs short
+	std::size_t capacity = 16;
+	while (capacity < 2 * defined.size()) capacity *= 2;
+	built.assign(capacity, {0, npos});
+	std::size_t mask = capacity - 1;
+	for (std::uint32_t row : defined) {
+		std::string_view name = symbols->name(row);
+		std::uint32_t h = gnu_hash(name);
+		std::size_t i = h & mask;
+		// the first definition of a name wins
+		while (built[i].row != npos && !(built[i].hash == h && symbols->name_equals(built[i].row, name))) {
+			i = (i + 1) & mask;
+		}
+		if (built[i].row == npos) built[i] = {h, row};
+	}
+}
+
+
+bool name_index::defines(std::uint32_t row, std::string_view name) const {
+
+	return symbols->section_indexes()[row] != SHN_UNDEF && (symbols->infos()[row] >> 4) != STB_LOCAL
+			&& symbols->name_equals(row, name);
+}
+
+
+std::uint32_t name_index::lookup(std::string_view name) const {
+
+	switch (tableKind) {
+		case source::gnu_hash: return lookup_gnu(name);
+		case source::sysv_hash: return lookup_sysv(name);
+		case source::built: return lookup_built(name);
+		default: return npos;
+	}
+}
+
+
+std::uint32_t name_index::lookup_gnu(std::string_view name) const {
+
+	std::uint32_t h = gnu_hash(name);
+	// two bits of one bloom word reject most missing names without
+	// touching the buckets
+	const std::uint8_t* ptr = bloom + ((h / wordBits) & bloomMask) * (wordBits / 8);
+	std::uint64_t bits = wordBits == 64 ? (swap ? load<8, true>(ptr) : load<8, false>(ptr)) : word(ptr);
+	if (!((bits >> (h % wordBits)) & (bits >> ((h >> bloomShift) % wordBits)) & 1)) {
+		return npos;
+	}
+	std::uint32_t row = word(buckets + 4 * (h % bucketCount));
+	if (row < symbolOffset) return npos;
+	// a chain is a run of rows sharing the bucket, the low bit ends it
+	for (; row < symbols->size() && row - symbolOffset < chainCount; row++) {
+		std::uint32_t chain = word(chains + 4 * (row - symbolOffset));
+		if ((chain | 1) == (h | 1) && defines(row, name)) return row;
+		if (chain & 1) break;
+	}
+	return npos;
+}
+
+
+std::uint32_t name_index::lookup_sysv(std::string_view name) const {
+
+	std::uint32_t row = word(buckets + 4 * (sysv_hash(name) % bucketCount));
+	// bounded by the chain length in case the links form a loop
+	for (std::uint32_t steps=0; row != 0 && row < chainCount && steps < chainCount; steps++) {
+		if (row < symbols->size() && defines(row, name)) return row;
+		row = word(chains + 4 * row);
+	}
+	return npos;
+}
+
+
+std::uint32_t name_index::lookup_built(std::string_view name) const {
+
+	if (built.empty()) return npos;
+	std::uint32_t h = gnu_hash(name);
+	std::size_t mask = built.size() - 1;
+	for (std::size_t i = h & mask; built[i].row != npos; i = (i + 1) & mask) {
+		if (built[i].hash == h && symbols->name_equals(built[i].row, name)) return built[i].row;
+	}
+	return npos;
+}
+
+
+template symbol_table symbol_table::decode<elf32_traits>(byte_view, std::size_t, byte_view, bool, byte_view);
+template symbol_table symbol_table::decode<elf64_traits>(byte_view, std::size_t, byte_view, bool, byte_view);
+
+} // end of namespace elf
@@ -0,0 +1,295 @@
+#include "../inc/elf_watch.hpp"
+
+#include <cerrno>
+#include <poll.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+
+namespace elf {
+
+// the events that leave a file rewritten or gone
+constexpr std::uint32_t watch_mask = IN_CLOSE_WRITE | IN_MOVED_TO | IN_DELETE | IN_MOVED_FROM;
+
+
+static std::string absolute_path(const std::string& file) {
+
+	return std::filesystem::absolute(file).lexically_normal().string();
+}
+
+
+// header and program headers of parser in the class neutral form changes
+// are compared in
+template <typename elf_class>
+static void snapshot(elf_class_parser<elf_class>& parser, std::uint64_t header[6],
+			std::vector<std::vector<std::uint64_t>>& segments) {
+
+	const typename elf_class::header_t &h = parser.elf_header();
+	std::uint64_t fields[6] = {elf_class::elf_class, h.e_ident[EI_DATA_offset], h.e_type, h.e_machine,
+					h.e_entry, h.e_flags};
+	std::copy(fields, fields + 6, header);
+	segments.clear();
+	for (const auto &s : parser.segments()) {
+		segments.push_back({s.p_type, s.p_flags, s.p_offset, s.p_vaddr, s.p_filesz, s.p_memsz, s.p_align});
+	}
+}
+
+
+elf_watcher::elf_watcher(watch_options options) : options(options) {
+
+	this->options.read.cache.reset();
+	notifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+}
+
+
+elf_watcher::~elf_watcher() {
+
+	if (notifyFd >= 0) close(notifyFd);
+}
+
+
+bool elf_watcher::add(const std::string& file, parse_error& error) {
+
+	error = parse_error();
+	std::string path = absolute_path(file);
+	if (files.count(path)) return true;
+	watched_t watched;
+	watched.path = path;
+	elf_change change;
+	load(watched, change);
+	if (!watched.parser) {
+		error = change.error;
+		if (!error) error.code = parse_errc::file_not_found;
+		error.message = parse_error_message(error.code);
+		return false;
+	}
+
+	std::filesystem::path name(path);
+	std::string dir = name.parent_path().string();
+	auto it = watches.find(dir);
+	if (it == watches.end()) {
+		int wd = notifyFd < 0 ? -1 : inotify_add_watch(notifyFd, dir.c_str(), watch_mask | IN_ONLYDIR);
+		if (wd < 0) {
+			error.code = parse_errc::io_error;
+			error.message = parse_error_message(error.code);
+			return false;
+		}
+		directories[wd] = dir;
+		it = watches.emplace(dir, std::make_pair(wd, std::vector<std::string>())).first;
+	}
+	it->second.second.push_back(name.filename().string());
+	files.emplace(path, std::move(watched));
+	return true;
+}
+
+
+void elf_watcher::remove(const std::string& file) {
+
+	std::string path = absolute_path(file);
+	if (!files.erase(path)) return;
+	std::filesystem::path name(path);
+	auto it = watches.find(name.parent_path().string());
+	if (it == watches.end()) return;
+	std::vector<std::string> &names = it->second.second;
+	names.erase(std::find(names.begin(), names.end(), name.filename().string()));
+	if (names.empty()) {
+		inotify_rm_watch(notifyFd, it->second.first);
+		directories.erase(it->second.first);
+		watches.erase(it);
+	}
+}
+
+
+elf_parser* elf_watcher::parser(const std::string& file) {
+
+	auto it = files.find(absolute_path(file));
+	if (it == files.end() || it->second.gone) return nullptr;
+	return it->second.parser.get();
+}
+
+
+std::size_t elf_watcher::subscribe(subscriber callback) {
+
+	subscribers.emplace(nextId, std::move(callback));
+	return nextId++;
+}
+
+
+void elf_watcher::unsubscribe(std::size_t id) {
+
+	subscribers.erase(id);
+}
+
+
+void elf_watcher::notify(const elf_change& change) {
+
+	// a subscriber may unsubscribe itself
+	std::vector<subscriber> callbacks;
+	for (const auto &[id, callback] : subscribers) callbacks.push_back(callback);
+	for (const subscriber &callback : callbacks) callback(change);
+}
+
+
+// false if there is nothing to report
+bool elf_watcher::load(watched_t& file, elf_change& change) {
+
+	change.path = file.path;
+	struct stat st;
+	if (stat(file.path.c_str(), &st) != 0) {
+		if (file.gone || !file.parser) return false;
+		file.gone = true;
+		change.removed = true;
+		return true;
+	}
+	std::uint64_t mtime = (std::uint64_t) st.st_mtim.tv_sec * 1000000000 + st.st_mtim.tv_nsec;
+	if (!file.gone && file.parser && file.device == (std::uint64_t) st.st_dev
+			&& file.inode == (std::uint64_t) st.st_ino && file.size == (std::uint64_t) st.st_size
+			&& file.mtime == mtime) {
+		return false;
+	}
+
+	std::unique_ptr<elf_parser> parser;
+	std::uint64_t header[6];
+	std::vector<std::vector<std::uint64_t>> segments;
+	std::vector<section_state> sections;
+	try {
+		std::shared_ptr<file_buffer> buffer;
+		if (options.read.mode == load_mode::stream) {
+			buffer = file_buffer::stream_file(file.path);
+		} else if (options.read.mode == load_mode::map) {
+			buffer = file_buffer::map_file(file.path);
+		} else {
+			buffer = file_buffer::read_file(file.path);
+		}
+		byte_view ident = buffer->read(0, EI_PAD_offset);
+		if (ident.empty() || ident[0] != 0x7F || ident[1] != 0x45
+				|| ident[2] != 0x4c || ident[3] != 0x46) {
+			throw 1;
+		}
+		if (ident[EI_CLASS_offset] == 1) {
+			auto typed = std::make_unique<elf_32_parser>(buffer, options.read);
+			snapshot(*typed, header, segments);
+			parser = std::move(typed);
+		} else if (ident[EI_CLASS_offset] == 2) {
+			auto typed = std::make_unique<elf_64_parser>(buffer, options.read);
+			snapshot(*typed, header, segments);
+			parser = std::move(typed);
+		} else {
+			throw 2;
+		}
+		sections = fingerprint_sections(*parser, options.threads, &change.hashed);
+	}
+	catch (int e) {
+		change.error.code = static_cast<parse_errc>(e);
+	}
+	catch (const std::exception&) {
+		change.error.code = parse_errc::io_error;
+	}
+	if (change.error) {
+		// half written files show up here too, the next event brings the rest
+		change.error.message = parse_error_message(change.error.code);
+		return true;
+	}
+
+	if (file.parser) {
+		change.header = !std::equal(header, header + 6, file.header);
+		change.segments = segments != file.segments;
+
+		std::vector<bool> unchanged;
+		change.sections = diff_sections(file.sections, sections, &unchanged);
+		change.unchanged = sections.size();
+		for (const section_diff &section : change.sections) {
+			if (section.newIndex != section_diff::npos) change.unchanged--;
+		}
+
+		if (header[0] == file.header[0]) {
+			if (header[0] == 1) {
+				change.adopted = static_cast<elf_32_parser&>(*parser).adopt(
+							static_cast<elf_32_parser&>(*file.parser), unchanged);
+			} else {
+				change.adopted = static_cast<elf_64_parser&>(*parser).adopt(
+							static_cast<elf_64_parser&>(*file.parser), unchanged);
+			}
+		}
+	}
+
+	bool changed = file.gone || change.header || change.segments || !change.sections.empty();
+	file.parser = std::move(parser);
+	std::copy(header, header + 6, file.header);
+	file.segments = std::move(segments);
+	file.sections = std::move(sections);
+	file.device = st.st_dev;
+	file.inode = st.st_ino;
+	file.size = st.st_size;
+	file.mtime = mtime;
+	file.gone = false;
+	change.parser = file.parser.get();
+	return changed;
+}
+
+
+bool elf_watcher::refresh(const std::string& file) {
+
+	auto it = files.find(absolute_path(file));
+	if (it == files.end()) return false;
+	elf_change change;
+	if (!load(it->second, change)) return false;
+	notify(change);
+	return true;
+}
+
+
+std::size_t elf_watcher::poll(int timeoutMs) {
+
+	if (notifyFd < 0) return 0;
+	struct pollfd wait = {notifyFd, POLLIN, 0};
+	int ready;
+	do {
+		ready = ::poll(&wait, 1, timeoutMs);
+	} while (ready < 0 && errno == EINTR);
+	if (ready <= 0) return 0;
+
+	// a rewrite comes as several events, each file is read once per batch
+	std::vector<std::string> pending;
+	bool overflow = false;
+	alignas(struct inotify_event) char events[64 << 10];
+	for (;;) {
+		ssize_t got = read(notifyFd, events, sizeof(events));
+		if (got < 0 && errno == EINTR) continue;
+		if (got <= 0) break;
+		for (char* at = events; at < events + got; ) {
+			const struct inotify_event* event = reinterpret_cast<const struct inotify_event*>(at);
+			at += sizeof(struct inotify_event) + event->len;
+			if (event->mask & IN_Q_OVERFLOW) {
+				overflow = true;
+				continue;
+			}
+			auto dir = directories.find(event->wd);
+			if (dir == directories.end() || event->len == 0) continue;
+			std::string path = dir->second + "/" + event->name;
+			if (files.count(path) && std::find(pending.begin(), pending.end(), path) == pending.end()) {
+				pending.push_back(path);
+			}
+		}
+	}
+	// events were lost, every file is checked
+	if (overflow) {
+		pending.clear();
+		for (const auto &[path, file] : files) pending.push_back(path);
+	}
+
+	std::size_t delivered = 0;
+	for (const std::string &path : pending) {
+		auto it = files.find(path);
+		if (it == files.end()) continue;
+		elf_change change;
+		if (!load(it->second, change)) continue;
+		notify(change);
+		delivered++;
+	}
+	return delivered;
+}
+
+
+} // end of namespace elf
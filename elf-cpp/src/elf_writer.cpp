@@ -0,0 +1,562 @@
+#include "../inc/elf_writer.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <limits>
+#include <sys/sendfile.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+
+namespace elf {
+
+// section indexes from here up are reserved, see SHN_XINDEX
+constexpr std::uint64_t SHN_LORESERVE = 0xff00;
+
+
+elf_edit elf_edit::add(std::string section, std::vector<std::uint8_t> data, std::uint32_t type,
+			std::uint64_t flags, std::uint64_t align) {
+
+	elf_edit edit;
+	edit.kind = edit_kind::add_section;
+	edit.section = std::move(section);
+	edit.data = std::move(data);
+	edit.type = type;
+	edit.flags = flags;
+	edit.align = align;
+	return edit;
+}
+
+
+elf_edit elf_edit::remove(std::string section) {
+
+	elf_edit edit;
+	edit.kind = edit_kind::remove_section;
+	edit.section = std::move(section);
+	return edit;
+}
+
+
+elf_edit elf_edit::replace(std::string section, std::vector<std::uint8_t> data) {
+
+	elf_edit edit;
+	edit.kind = edit_kind::replace_section;
+	edit.section = std::move(section);
+	edit.data = std::move(data);
+	return edit;
+}
+
+
+elf_edit elf_edit::set_flags(std::string section, std::uint64_t flags) {
+
+	elf_edit edit;
+	edit.kind = edit_kind::set_flags;
+	edit.section = std::move(section);
+	edit.flags = flags;
+	return edit;
+}
+
+
+elf_edit elf_edit::update_note(std::string section, std::string owner, std::uint32_t type,
+				std::vector<std::uint8_t> desc) {
+
+	elf_edit edit;
+	edit.kind = edit_kind::update_note;
+	edit.section = std::move(section);
+	edit.owner = std::move(owner);
+	edit.noteType = type;
+	edit.data = std::move(desc);
+	return edit;
+}
+
+
+// a section of the new file
+typedef struct out_section_t {
+	std::string name;
+	std::size_t source;		// index in the parsed file, npos for added sections
+	std::uint64_t sourceOffset = 0;
+	std::uint64_t nameOffset = 0;
+	std::uint32_t type = 0;
+	std::uint64_t flags = 0;
+	std::uint64_t addr = 0;
+	std::uint64_t offset = 0;
+	std::uint64_t size = 0;
+	std::uint32_t link = 0;
+	std::uint32_t info = 0;
+	std::uint64_t align = 0;
+	std::uint64_t entsize = 0;
+	bool fixed = false;		// inside a segment, keeps its offset and size
+	bool removed = false;
+	bool inMemory = false;		// contents are in bytes rather than only in the source
+	std::vector<std::uint8_t> bytes;
+	static constexpr std::size_t npos = ~std::size_t(0);
+} out_section_t;
+
+
+static void read_fully(int fd, std::uint8_t* dst, std::uint64_t size, std::uint64_t offset) {
+
+	while (size) {
+		ssize_t got = pread(fd, dst, size, offset);
+		if (got < 0 && errno == EINTR) continue;
+		if (got < 0) throw 4;
+		if (got == 0) throw 3;
+		dst += got;
+		offset += got;
+		size -= got;
+	}
+}
+
+
+static void write_fully(int fd, const std::uint8_t* src, std::uint64_t size, std::uint64_t offset) {
+
+	while (size) {
+		ssize_t done = pwrite(fd, src, size, offset);
+		if (done < 0 && errno == EINTR) continue;
+		if (done <= 0) throw 4;
+		src += done;
+		offset += done;
+		size -= done;
+	}
+}
+
+
+// [from, from+size) of in to offset to of out without passing through user
+// space: copy_file_range (which may share extents on btrfs and xfs), then
+// sendfile for kernels and file system pairs without it, then pread/pwrite
+static void copy_range(int in, int out, std::uint64_t from, std::uint64_t to, std::uint64_t size) {
+
+	loff_t inOffset = from, outOffset = to;
+	while (size) {
+		ssize_t done = copy_file_range(in, &inOffset, out, &outOffset, size, 0);
+		if (done < 0 && errno == EINTR) continue;
+		if (done <= 0) break;
+		size -= done;
+	}
+	if (size && lseek(out, outOffset, SEEK_SET) == outOffset) {
+		while (size) {
+			off_t offset = inOffset;
+			ssize_t done = sendfile(out, in, &offset, size);
+			if (done < 0 && errno == EINTR) continue;
+			if (done <= 0) break;
+			inOffset += done;
+			outOffset += done;
+			size -= done;
+		}
+	}
+	// a source shorter than its headers say ends here too, with out_of_bounds
+	std::vector<std::uint8_t> chunk(std::min<std::uint64_t>(size, 1 << 20));
+	while (size) {
+		std::uint64_t count = std::min<std::uint64_t>(size, chunk.size());
+		read_fully(in, chunk.data(), count, inOffset);
+		write_fully(out, chunk.data(), count, outOffset);
+		inOffset += count;
+		outOffset += count;
+		size -= count;
+	}
+}
+
+
+static bool matches(const std::string& name, const std::string& pattern) {
+
+	if (!pattern.empty() && pattern.back() == '*') {
+		return name.compare(0, pattern.size() - 1, pattern, 0, pattern.size() - 1) == 0;
+	}
+	return name == pattern;
+}
+
+
+static std::vector<std::uint8_t>& contents(int in, out_section_t& section) {
+
+	if (!section.inMemory) {
+		section.bytes.resize(section.size);
+		read_fully(in, section.bytes.data(), section.size, section.sourceOffset);
+		section.inMemory = true;
+	}
+	return section.bytes;
+}
+
+
+// notes with the desc of the first note of edit.owner and edit.noteType
+// replaced, or with such a note appended. The others are kept byte for byte.
+template <bool swap>
+static std::vector<std::uint8_t> update_notes(const std::vector<std::uint8_t>& notes, std::uint64_t align,
+						const elf_edit& edit) {
+
+	align = align == 8 ? 8 : 4;
+	auto pad = [align](std::uint64_t value) { return (value + align - 1) & ~(align - 1); };
+	std::vector<std::uint8_t> result;
+	result.reserve(notes.size() + edit.data.size() + edit.owner.size() + 32);
+	auto put = [&](const std::uint8_t* name, std::uint64_t namesz) {
+		std::size_t at = result.size();
+		result.resize(at + 12);
+		store<4, swap>(result.data() + at, namesz);
+		store<4, swap>(result.data() + at + 4, edit.data.size());
+		store<4, swap>(result.data() + at + 8, edit.noteType);
+		result.insert(result.end(), name, name + namesz);
+		result.resize(pad(result.size()));
+		result.insert(result.end(), edit.data.begin(), edit.data.end());
+		result.resize(pad(result.size()));
+	};
+
+	bool done = false;
+	std::uint64_t pos = 0;
+	while (pos + 12 <= notes.size()) {
+		std::uint64_t namesz = load<4, swap>(notes.data() + pos);
+		std::uint64_t descsz = load<4, swap>(notes.data() + pos + 4);
+		std::uint32_t type = load<4, swap>(notes.data() + pos + 8);
+		std::uint64_t name = pos + 12;
+		std::uint64_t desc = pad(name + namesz);
+		if (desc > notes.size() || descsz > notes.size() - desc) break;
+		std::uint64_t end = std::min<std::uint64_t>(pad(desc + descsz), notes.size());
+		const char* text = reinterpret_cast<const char*>(notes.data() + name);
+		if (!done && type == edit.noteType && edit.owner == std::string_view(text, strnlen(text, namesz))) {
+			put(notes.data() + name, namesz);
+			done = true;
+		} else {
+			result.insert(result.end(), notes.begin() + pos, notes.begin() + end);
+		}
+		pos = end;
+	}
+	result.insert(result.end(), notes.begin() + pos, notes.end());
+	if (!done) {
+		result.resize(pad(result.size()));
+		put(reinterpret_cast<const std::uint8_t*>(edit.owner.c_str()), edit.owner.size() + 1);
+	}
+	return result;
+}
+
+
+template <typename elf_class, bool swap>
+static void write_sections(elf_class_parser<elf_class>& parser, int in, int out,
+				const std::vector<elf_edit>& edits, write_stats& stats) {
+
+	typedef typename elf_class::addr_t addr_t;
+	const typename elf_class::header_t &h = parser.elf_header();
+	const std::vector<typename elf_class::section_t> &sections = parser.sections();
+	const std::vector<typename elf_class::segment_t> &segments = parser.segments();
+	std::size_t shstrndx = h.e_shstrndx;
+	if (shstrndx == 0xffff && !sections.empty()) shstrndx = sections[0].sh_link;
+
+	// the file header, the program headers and the segments stay where they
+	// are, and so do the sections in them
+	const std::uint64_t headerSize = elf_class::e_shstrndx_offset + e_shstrndx_size;
+	std::uint64_t fixedEnd = std::max<std::uint64_t>(h.e_ehsize, headerSize);
+	if (!segments.empty()) {
+		fixedEnd = std::max<std::uint64_t>(fixedEnd, h.e_phoff + (std::uint64_t) h.e_phentsize * segments.size());
+	}
+	for (const auto &s : segments) fixedEnd = std::max<std::uint64_t>(fixedEnd, s.p_offset + s.p_filesz);
+
+	std::vector<out_section_t> list(sections.size());
+	for (std::size_t i=0; i<sections.size(); i++) {
+		const auto &s = sections[i];
+		out_section_t &o = list[i];
+		o.name = s.name;
+		o.source = i;
+		o.sourceOffset = s.sh_offset;
+		o.nameOffset = s.sh_name;
+		o.type = s.sh_type;
+		o.flags = s.sh_flags;
+		o.addr = s.sh_addr;
+		o.offset = s.sh_offset;
+		o.size = s.sh_size;
+		o.link = s.sh_link;
+		o.info = s.sh_info;
+		o.align = s.sh_addralign;
+		o.entsize = s.sh_entsize;
+		o.fixed = i == 0 || (!segments.empty() && (s.sh_flags & SHF_ALLOC));
+		for (const auto &segment : segments) {
+			if (o.fixed || s.sh_type == SHT_NOBITS || s.sh_size == 0) break;
+			o.fixed = s.sh_offset >= segment.p_offset
+					&& s.sh_offset + s.sh_size <= segment.p_offset + segment.p_filesz;
+		}
+		if (o.fixed && s.sh_type != SHT_NOBITS) fixedEnd = std::max<std::uint64_t>(fixedEnd, s.sh_offset + s.sh_size);
+	}
+
+	auto find = [&](const std::string& name) -> out_section_t* {
+		for (out_section_t &o : list) {
+			if (!o.removed && o.type != 0x00 && o.name == name) return &o;
+		}
+		return nullptr;
+	};
+	for (const elf_edit &edit : edits) {
+		if (edit.kind == edit_kind::add_section) {
+			// a new section has no address to be loaded at
+			if ((edit.flags & SHF_ALLOC) || edit.type == 0x00 || edit.section.empty()) throw 5;
+			out_section_t o;
+			o.name = edit.section;
+			o.source = out_section_t::npos;
+			o.type = edit.type;
+			o.flags = edit.flags;
+			o.size = edit.data.size();
+			o.align = std::max<std::uint64_t>(edit.align, 1);
+			o.bytes = edit.data;
+			o.inMemory = true;
+			list.push_back(std::move(o));
+
+		} else if (edit.kind == edit_kind::remove_section || edit.kind == edit_kind::set_flags) {
+			std::size_t hits = 0;
+			for (std::size_t i=0; i<list.size(); i++) {
+				out_section_t &o = list[i];
+				if (o.removed || o.type == 0x00 || !matches(o.name, edit.section)) continue;
+				if (edit.kind == edit_kind::remove_section) {
+					if (i == shstrndx) throw 5;
+					o.removed = true;
+				} else {
+					// SHF_ALLOC decides the layout
+					if ((o.flags ^ edit.flags) & SHF_ALLOC) throw 5;
+					o.flags = edit.flags;
+				}
+				hits++;
+			}
+			if (hits == 0) throw 5;
+
+		} else if (edit.kind == edit_kind::replace_section) {
+			out_section_t* o = find(edit.section);
+			if (!o || o->type == SHT_NOBITS || (o->fixed && edit.data.size() != o->size)) throw 5;
+			o->bytes = edit.data;
+			o->size = edit.data.size();
+			o->inMemory = true;
+
+		} else if (edit.kind == edit_kind::update_note) {
+			out_section_t* o = find(edit.section);
+			if (!o || o->type != SHT_NOTE) throw 5;
+			std::vector<std::uint8_t> notes = update_notes<swap>(contents(in, *o), o->align, edit);
+			if (o->fixed && notes.size() != o->size) throw 5;
+			o->size = notes.size();
+			o->bytes = std::move(notes);
+		}
+	}
+
+	// new indexes, a link to a removed section is an edit that can't be made
+	std::vector<std::uint64_t> remap(list.size());
+	std::uint64_t count = 0;
+	bool removed = false;
+	for (std::size_t i=0; i<list.size(); i++) {
+		if (list[i].removed) {
+			removed = true;
+			continue;
+		}
+		remap[i] = count++;
+	}
+	auto index = [&](std::uint64_t old) -> std::uint64_t {
+		// out of range on input, left as it was
+		if (old >= sections.size()) return old;
+		if (list[old].removed) throw 5;
+		return remap[old];
+	};
+	for (std::size_t i=1; i<sections.size(); i++) {
+		out_section_t &o = list[i];
+		if (o.removed) continue;
+		if (o.link) o.link = index(o.link);
+		if (o.info && ((o.flags & SHF_INFO_LINK) || o.type == SHT_REL || o.type == SHT_RELA)) o.info = index(o.info);
+	}
+
+	// symbols and groups refer to sections by index too, checked for
+	// removed ones even when no index moves
+	for (std::size_t i=1; removed && i<sections.size(); i++) {
+		out_section_t &o = list[i];
+		if (o.removed) continue;
+		std::size_t entry, field, width, first = 0;
+		if (o.type == 0x02 || o.type == 0x0B) {
+			entry = elf_class::sym_size;
+			field = elf_class::st_shndx_offset;
+			width = st_shndx_size;
+		} else if (o.type == SHT_SYMTAB_SHNDX) {
+			entry = width = 4;
+			field = 0;
+		} else if (o.type == SHT_GROUP) {
+			// the flag word comes first
+			entry = width = 4;
+			field = 0;
+			first = 4;
+		} else {
+			continue;
+		}
+		bool loaded = o.inMemory, changed = false;
+		std::vector<std::uint8_t> &bytes = contents(in, o);
+		for (std::uint64_t at=first; at+entry<=bytes.size(); at+=entry) {
+			std::uint8_t* ptr = bytes.data() + at + field;
+			std::uint64_t value = width == 2 ? load<2, swap>(ptr) : load<4, swap>(ptr);
+			if (value == 0 || (width == 2 && value >= SHN_LORESERVE)) continue;
+			std::uint64_t moved = index(value);
+			if (moved == value) continue;
+			width == 2 ? store<2, swap>(ptr, moved) : store<4, swap>(ptr, moved);
+			changed = true;
+		}
+		// nothing to patch, the kernel copies it
+		if (!changed && !loaded) {
+			o.inMemory = false;
+			std::vector<std::uint8_t>().swap(o.bytes);
+		}
+	}
+
+	// names of added sections go to the end of .shstrtab unless they are there
+	for (out_section_t &o : list) {
+		if (o.removed || o.source != out_section_t::npos) continue;
+		if (shstrndx == 0 || shstrndx >= sections.size() || list[shstrndx].fixed) throw 5;
+		out_section_t &strings = list[shstrndx];
+		std::vector<std::uint8_t> &table = contents(in, strings);
+		std::string name = o.name + '\0';
+		auto found = std::search(table.begin(), table.end(), name.begin(), name.end());
+		o.nameOffset = found - table.begin();
+		if (found == table.end()) table.insert(table.end(), name.begin(), name.end());
+		strings.size = table.size();
+	}
+
+	// sections outside of the segments follow them in their old order, the
+	// added ones last, then the section header table
+	std::vector<out_section_t*> moving;
+	for (out_section_t &o : list) {
+		if (!o.removed && !o.fixed) moving.push_back(&o);
+	}
+	std::stable_sort(moving.begin(), moving.end(), [](const out_section_t* a, const out_section_t* b) {
+		return std::make_pair(a->source == out_section_t::npos, a->sourceOffset)
+			< std::make_pair(b->source == out_section_t::npos, b->sourceOffset);
+	});
+	std::uint64_t at = fixedEnd;
+	for (out_section_t* o : moving) {
+		std::uint64_t align = std::max<std::uint64_t>(o->align, 1);
+		at = (at + align - 1) / align * align;
+		o->offset = at;
+		if (o->type != SHT_NOBITS) at += o->size;
+	}
+	std::uint64_t shoff = count ? (at + sizeof(addr_t) - 1) & ~(sizeof(addr_t) - 1) : 0;
+	std::uint64_t total = count ? shoff + count * elf_class::shdr_size : at;
+	if (total > (std::uint64_t) std::numeric_limits<addr_t>::max()) throw 5;
+
+	// unchanged ranges, joined where they follow each other on both sides
+	typedef struct piece_t {
+		std::uint64_t to;
+		std::uint64_t from;
+		std::uint64_t size;
+		const std::uint8_t* bytes;
+	} piece_t;
+	std::vector<piece_t> copies, writes;
+	auto copy = [&](std::uint64_t to, std::uint64_t from, std::uint64_t size) {
+		if (size == 0) return;
+		piece_t* last = copies.empty() ? nullptr : &copies.back();
+		if (last && last->from + last->size == from && last->to + last->size == to) last->size += size;
+		else copies.push_back({to, from, size, nullptr});
+	};
+	copy(0, 0, fixedEnd);
+	for (const out_section_t &o : list) {
+		if (!o.removed && o.fixed && o.inMemory) writes.push_back({o.offset, 0, o.size, o.bytes.data()});
+	}
+	for (const out_section_t* o : moving) {
+		if (o->type == SHT_NOBITS) continue;
+		if (o->inMemory) writes.push_back({o->offset, 0, o->size, o->bytes.data()});
+		else copy(o->offset, o->sourceOffset, o->size);
+	}
+
+	// section 0 holds the counts that don't fit the file header
+	std::uint64_t stringIndex = shstrndx < sections.size() && !list[shstrndx].removed ? remap[shstrndx] : 0;
+	if (!list.empty()) {
+		list[0].size = count >= SHN_LORESERVE ? count : 0;
+		list[0].link = stringIndex >= SHN_LORESERVE ? stringIndex : 0;
+	}
+	std::vector<std::uint8_t> table(count * elf_class::shdr_size);
+	for (std::size_t i=0; i<list.size(); i++) {
+		const out_section_t &o = list[i];
+		if (o.removed) continue;
+		std::uint8_t* ptr = table.data() + remap[i] * elf_class::shdr_size;
+		store<sh_name_size, swap>(ptr + sh_name_offset, o.nameOffset);
+		store<sh_type_size, swap>(ptr + sh_type_offset, o.type);
+		store<elf_class::sh_flags_size, swap>(ptr + sh_flags_offset, o.flags);
+		store<elf_class::sh_addr_size, swap>(ptr + elf_class::sh_addr_offset, o.addr);
+		store<elf_class::sh_offset_size, swap>(ptr + elf_class::sh_offset_offset, o.offset);
+		store<elf_class::sh_size_size, swap>(ptr + elf_class::sh_size_offset, o.size);
+		store<sh_link_size, swap>(ptr + elf_class::sh_link_offset, o.link);
+		store<sh_info_size, swap>(ptr + elf_class::sh_info_offset, o.info);
+		store<elf_class::sh_addralign_size, swap>(ptr + elf_class::sh_addralign_offset, o.align);
+		store<elf_class::sh_entsize_size, swap>(ptr + elf_class::sh_entsize_offset, o.entsize);
+	}
+	writes.push_back({shoff, 0, table.size(), table.data()});
+
+	std::vector<std::uint8_t> header(headerSize);
+	read_fully(in, header.data(), headerSize, 0);
+	std::uint8_t* ptr = header.data();
+	store<elf_class::e_shoff_size, swap>(ptr + elf_class::e_shoff_offset, shoff);
+	store<e_shentsize_size, swap>(ptr + elf_class::e_shentsize_offset, count ? elf_class::shdr_size : 0);
+	store<e_shnum_size, swap>(ptr + elf_class::e_shnum_offset, count >= SHN_LORESERVE ? 0 : count);
+	store<e_shstrndx_size, swap>(ptr + elf_class::e_shstrndx_offset,
+					stringIndex >= SHN_LORESERVE ? 0xffff : stringIndex);
+	writes.push_back({0, 0, headerSize, header.data()});
+
+	// gaps between sections read back as zeros
+	if (ftruncate(out, total) != 0) throw 4;
+	for (const piece_t &piece : copies) {
+		copy_range(in, out, piece.from, piece.to, piece.size);
+		stats.copied += piece.size;
+	}
+	stats.copies = copies.size();
+	// over the copied ranges, edits to sections in segments included
+	for (const piece_t &piece : writes) {
+		write_fully(out, piece.bytes, piece.size, piece.to);
+		stats.written += piece.size;
+	}
+	stats.size = total;
+	stats.sections = count;
+}
+
+
+template <typename elf_class>
+static void write_parsed(elf_class_parser<elf_class>& parser, int in, int out, const std::vector<elf_edit>& edits,
+				write_stats& stats) {
+
+	bool swap = (parser.elf_header().e_ident[EI_DATA_offset] == 2) != host_big_endian;
+	swap ? write_sections<elf_class, true>(parser, in, out, edits, stats)
+		: write_sections<elf_class, false>(parser, in, out, edits, stats);
+}
+
+
+bool write_elf(elf_parser& parser, const std::string& source, const std::vector<elf_edit>& edits,
+		const std::string& output, parse_error& error, write_stats* stats) {
+
+	error = parse_error();
+	write_stats counts;
+	int in = -1, out = -1;
+	// written next to output and renamed over it when complete
+	std::string temporary = output + ".XXXXXX";
+	try {
+		in = ::open(source.c_str(), O_RDONLY | O_CLOEXEC);
+		if (in < 0) throw errno == ENOENT ? 0 : 4;
+		struct stat st;
+		if (fstat(in, &st) != 0) throw 4;
+		out = mkostemp(temporary.data(), O_CLOEXEC);
+		if (out < 0) {
+			temporary.clear();
+			throw 4;
+		}
+		fchmod(out, st.st_mode & 07777);
+
+		if (elf_32_parser* typed = dynamic_cast<elf_32_parser*>(&parser)) {
+			write_parsed(*typed, in, out, edits, counts);
+		} else if (elf_64_parser* typed = dynamic_cast<elf_64_parser*>(&parser)) {
+			write_parsed(*typed, in, out, edits, counts);
+		} else {
+			throw 2;
+		}
+		int closed = close(out);
+		out = -1;
+		if (closed != 0 || rename(temporary.c_str(), output.c_str()) != 0) throw 4;
+		temporary.clear();
+	}
+	catch (int e) {
+		error.code = static_cast<parse_errc>(e);
+	}
+	catch (const std::exception&) {
+		error.code = parse_errc::io_error;
+	}
+	if (in >= 0) close(in);
+	if (out >= 0) close(out);
+	if (!temporary.empty()) unlink(temporary.c_str());
+	if (stats) *stats = counts;
+	if (!error) return true;
+	error.message = parse_error_message(error.code);
+	return false;
+}
+
+
+} // end of namespace elf
@@ -0,0 +1,192 @@
+#include "../../elf-cpp/inc/elf_archive.hpp"
+#include "synthetic_elf.hpp"
+
+#include <chrono>
+#include <cstring>
+#include <random>
+#include <thread>
+#include <unistd.h>
+
+// A synthetic archive of 2000 objects with 500 symbols each, long member
+// names and an armap (or the archive given): opening it, armap lookups and
+// parsing the defining member, against parsing members in order until one
+// defines the symbol. Then parsing every member from 1 up to every hardware
+// thread, and the same archive without an armap indexing its members.
+
+
+template <typename F>
+static double time_ms(F f) {
+
+	auto start = std::chrono::steady_clock::now();
+	f();
+	auto end = std::chrono::steady_clock::now();
+	return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+
+static void put_header(std::vector<std::uint8_t>& out, const std::string& name, std::size_t size) {
+
+	char header[elf::ar_header_size + 1];
+	std::snprintf(header, sizeof(header), "%-16s%-12d%-6d%-6d%-8o%-10zu`\n", name.c_str(), 0, 0, 0, 0644, size);
+	out.insert(out.end(), header, header + elf::ar_header_size);
+}
+
+
+// GNU layout: armap, long name table, then the members
+static std::vector<std::uint8_t> make_archive(std::size_t members, std::size_t symbols, bool armap) {
+
+	std::vector<std::vector<std::uint8_t>> objects;
+	std::string longNames;
+	std::vector<std::size_t> nameAt;
+	for (std::size_t i=0; i<members; i++) {
+		synthetic::options_t options;
+		options.sections = 8;
+		options.segments = 1;
+		options.payload = 64;
+		options.symbols = symbols;
+		options.prefix = "m" + std::to_string(i) + "_f";
+		objects.push_back(synthetic::make_elf(options));
+		nameAt.push_back(longNames.size());
+		longNames += "synthetic_member_" + std::to_string(i) + ".o/\n";
+	}
+
+	std::vector<std::uint8_t> table;
+	if (armap) {
+		std::string names;
+		for (std::size_t i=0; i<members; i++) {
+			for (std::size_t j=0; j<symbols; j++) names += "m" + std::to_string(i) + "_f" + std::to_string(j) + '\0';
+		}
+		table.resize(4 * (1 + members * symbols));
+		table.insert(table.end(), names.begin(), names.end());
+		if (table.size() & 1) table.push_back(0);
+	}
+	std::size_t pos = elf::ar_magic_size + (armap ? elf::ar_header_size + table.size() : 0)
+				+ elf::ar_header_size + longNames.size() + (longNames.size() & 1);
+	auto put32 = [&](std::size_t at, std::uint32_t value) {
+		for (int b=0; b<4; b++) table[at + b] = value >> (24 - 8 * b);
+	};
+	if (armap) put32(0, members * symbols);
+	for (std::size_t i=0; i<members; i++) {
+		for (std::size_t j=0; armap && j<symbols; j++) put32(4 * (1 + i * symbols + j), pos);
+		pos += elf::ar_header_size + objects[i].size() + (objects[i].size() & 1);
+	}
+
+	std::vector<std::uint8_t> out(elf::ar_magic_size);
+	std::memcpy(out.data(), "!<arch>\n", elf::ar_magic_size);
+	if (armap) {
+		put_header(out, "/", table.size());
+		out.insert(out.end(), table.begin(), table.end());
+	}
+	put_header(out, "//", longNames.size());
+	out.insert(out.end(), longNames.begin(), longNames.end());
+	if (longNames.size() & 1) out.push_back('\n');
+	for (std::size_t i=0; i<members; i++) {
+		put_header(out, "/" + std::to_string(nameAt[i]), objects[i].size());
+		out.insert(out.end(), objects[i].begin(), objects[i].end());
+		if (objects[i].size() & 1) out.push_back('\n');
+	}
+	return out;
+}
+
+
+int main(int argc, char** argv) {
+
+	elf::parse_error error;
+	std::filesystem::path dir = std::filesystem::temp_directory_path()
+					/ ("elf-archive-bench-" + std::to_string(getpid()));
+	std::filesystem::create_directories(dir);
+	std::string indexed = argc > 1 ? argv[1] : (dir / "indexed.a").string();
+	std::string plain = (dir / "plain.a").string();
+	if (argc <= 1) {
+		for (bool armap : {true, false}) {
+			std::vector<std::uint8_t> bytes = make_archive(2000, 500, armap);
+			std::ofstream(armap ? indexed : plain, std::ios::binary)
+					.write(reinterpret_cast<const char*>(bytes.data()), bytes.size());
+		}
+	}
+
+	std::unique_ptr<elf::archive_file> archive;
+	double openMs = time_ms([&]() { archive = elf::archive_file::open(indexed, error); });
+	if (!archive) {
+		std::cerr << indexed << ": " << error.message << std::endl;
+		return 1;
+	}
+	std::vector<std::string_view> names;
+	double indexMs = time_ms([&]() { archive->symbol_index(); });
+	for (const auto &[name, member] : archive->symbol_index()) names.push_back(name);
+	std::cout << indexed << ": " << std::filesystem::file_size(indexed) / 1e6 << " MB, " << archive->size()
+			<< " members, " << names.size() << " symbols, opened in " << std::fixed << std::setprecision(1)
+			<< openMs << " ms, " << (archive->has_symbol_index() ? "armap" : "members") << " indexed in "
+			<< indexMs << " ms" << std::endl;
+	if (names.empty()) {
+		std::filesystem::remove_all(dir);
+		return 0;
+	}
+
+	std::mt19937_64 random(42);
+	std::vector<std::string_view> wanted(100000);
+	for (std::string_view &name : wanted) name = names[random() % names.size()];
+	std::size_t found = 0;
+	double lookupMs = time_ms([&]() {
+		for (std::string_view name : wanted) found += archive->find_symbol(name) != elf::archive_file::npos;
+	});
+	std::cout << std::left << std::setw(24) << "Lookup" << std::setw(14) << "us/lookup" << "Found" << std::endl;
+	std::cout << std::setw(24) << "find_symbol" << std::setw(14) << std::setprecision(3) << lookupMs * 1e3 / wanted.size()
+			<< found << "/" << wanted.size() << std::endl;
+
+	// members of random symbols, none parsed so far
+	constexpr std::size_t parsed = 20;
+	found = 0;
+	double memberMs = time_ms([&]() {
+		for (std::size_t i=0; i<parsed; i++) {
+			elf::elf_parser* parser = archive->defining_member(wanted[i]);
+			found += parser && parser->symbols().size() > 0;
+		}
+	});
+	std::cout << std::setw(24) << "defining_member" << std::setw(14) << memberMs * 1e3 / parsed
+			<< found << "/" << parsed << std::endl;
+
+	// what finding the member costs without the armap
+	found = 0;
+	double scanMs = time_ms([&]() {
+		for (std::size_t i=0; i<parsed; i++) {
+			std::unique_ptr<elf::archive_file> fresh = elf::archive_file::open(indexed, error);
+			for (std::size_t m=0; m<fresh->size(); m++) {
+				elf::elf_parser* parser = fresh->member(m);
+				if (!parser) continue;
+				const elf::symbol_table &table = parser->symbols();
+				bool defines = false;
+				for (std::size_t row=1; row<table.size() && !defines; row++) {
+					defines = table.name(row) == wanted[i] && table[row].shndx() != elf::SHN_UNDEF;
+				}
+				if (defines) {
+					found++;
+					break;
+				}
+			}
+		}
+	});
+	std::cout << std::setw(24) << "parse in order" << std::setw(14) << scanMs * 1e3 / parsed
+			<< found << "/" << parsed << std::endl;
+
+	std::cout << std::setw(24) << "Parse all" << std::setw(10) << "Threads" << std::setw(12) << "Time (ms)"
+			<< "Parsed" << std::endl;
+	unsigned hardware = std::max(1u, std::thread::hardware_concurrency());
+	for (unsigned threads=1; ; threads=std::min(2*threads, hardware)) {
+		std::unique_ptr<elf::archive_file> fresh = elf::archive_file::open(indexed, error);
+		std::size_t count = 0;
+		double ms = time_ms([&]() { count = fresh->parse_members({}, threads); });
+		std::cout << std::setw(24) << "parse_members" << std::setw(10) << threads << std::setw(12)
+				<< std::setprecision(1) << ms << count << std::endl;
+		if (threads == hardware) break;
+	}
+	if (argc <= 1) {
+		std::unique_ptr<elf::archive_file> fresh = elf::archive_file::open(plain, error);
+		std::size_t count = 0;
+		double ms = time_ms([&]() { count = fresh->symbol_index().size(); });
+		std::cout << std::setw(24) << "no armap, index" << std::setw(10) << hardware << std::setw(12) << ms
+				<< count << " symbols" << std::endl;
+	}
+	std::filesystem::remove_all(dir);
+	return 0;
+}
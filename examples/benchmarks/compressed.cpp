@@ -0,0 +1,102 @@
+#include "../../elf-cpp/inc/elf_parser.hpp"
+#include "synthetic_elf.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <zlib.h>
+
+// Decompressing a zlib SHF_COMPRESSED .debug_line of 2000 units of 5000 rows
+// directly and through a section_cache, cold and warm. Given binaries with
+// compressed debug sections (e.g. built with -gz), opens each twice with a
+// shared section_cache and times lines() on both opens.
+
+
+template <typename F>
+static double time_ms(F f) {
+
+	auto start = std::chrono::steady_clock::now();
+	f();
+	auto end = std::chrono::steady_clock::now();
+	return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+
+// Elf64_Chdr followed by the zlib stream of contents
+static std::vector<std::uint8_t> compress_section(const std::vector<std::uint8_t>& contents) {
+
+	uLongf size = compressBound(contents.size());
+	std::vector<std::uint8_t> section(24 + size);
+	compress2(section.data() + 24, &size, contents.data(), contents.size(), 6);
+	section.resize(24 + size);
+	synthetic::writer out(section, false);
+	out.put(0, elf::ELFCOMPRESS_ZLIB, 4);
+	out.put(4, 0, 4);
+	out.put(8, contents.size(), 8);
+	out.put(16, 1, 8);
+	return section;
+}
+
+
+static bool lines_of(const std::string& file, std::shared_ptr<elf::section_cache> cache) {
+
+	elf::read_options options(elf::load_mode::map, true);
+	options.sections = cache;
+	elf::parse_error error;
+	std::unique_ptr<elf::elf_parser> parser;
+	std::size_t rows = 0;
+	double ms = time_ms([&]() {
+		parser = elf::elf_parser::open(file, error, options);
+		if (parser) rows = parser->lines().size();
+	});
+	if (!parser) {
+		std::cout << file << ": " << error.message << std::endl;
+		return false;
+	}
+	std::cout << std::setw(12) << ms << rows << " rows, cache " << cache->hits() << " hits "
+			<< cache->misses() << " misses, " << cache->size() / 1024 << " KiB" << std::endl;
+	return true;
+}
+
+
+int main(int argc, char** argv) {
+
+	std::cout << std::fixed << std::setprecision(2) << std::left;
+
+	std::vector<std::uint8_t> contents = synthetic::make_debug_line(2000, 5000);
+	std::vector<std::uint8_t> section = compress_section(contents);
+	elf::byte_view view(section.data(), section.size());
+	std::cout << contents.size() / 1024 << " KiB .debug_line, " << section.size() / 1024
+			<< " KiB compressed" << std::endl;
+	std::cout << std::setw(26) << "" << std::setw(12) << "ms" << "MB/s out" << std::endl;
+
+	elf::section_bytes bytes;
+	double ms = time_ms([&]() { bytes = elf::decompress_section(view, true, false); });
+	if (!bytes || *bytes != contents) {
+		std::cout << "decompressed contents differ" << std::endl;
+		return 1;
+	}
+	std::cout << std::setw(26) << "decompress_section" << std::setw(12) << ms
+			<< contents.size() / ms / 1000 << std::endl;
+
+	elf::section_cache cache(64 << 20);
+	ms = time_ms([&]() { bytes = cache.decompress(view, true, false); });
+	std::cout << std::setw(26) << "section_cache, miss" << std::setw(12) << ms
+			<< contents.size() / ms / 1000 << std::endl;
+	ms = time_ms([&]() { bytes = cache.decompress(view, true, false); });
+	std::cout << std::setw(26) << "section_cache, hit" << std::setw(12) << ms
+			<< contents.size() / ms / 1000 << std::endl;
+	ms = time_ms([&]() { elf::line_table table(elf::byte_view(bytes->data(), bytes->size()),
+							elf::byte_view(), elf::byte_view(), false); });
+	std::cout << std::setw(26) << "line_table build" << std::setw(12) << ms
+			<< contents.size() / ms / 1000 << std::endl;
+
+	for (int i=1; i<argc; i++) {
+		std::cout << std::endl << argv[i] << std::endl;
+		auto shared = std::make_shared<elf::section_cache>();
+		std::cout << std::setw(8) << "open 1";
+		if (!lines_of(argv[i], shared)) return 1;
+		std::cout << std::setw(8) << "open 2";
+		lines_of(argv[i], shared);
+	}
+	return 0;
+}
@@ -0,0 +1,168 @@
+#include "../../elf-cpp/inc/elf_core.hpp"
+
+#include <chrono>
+#include <cstring>
+#include <fcntl.h>
+#include <random>
+#include <unistd.h>
+
+// Opening a core dump and reading its memory. Without an argument a sparse
+// x86-64 core of 20000 segments of 64KiB (1.3GB) with 64 threads is written
+// to a temporary file. Times core_file::open against a full read_file parse,
+// 1M random read_memory and read_pointer lookups, and walks a pointer chain
+// through every segment. Given a core it also follows the frame pointers of
+// each thread.
+
+
+template <typename F>
+static double time_ms(F f) {
+
+	auto start = std::chrono::steady_clock::now();
+	f();
+	auto end = std::chrono::steady_clock::now();
+	return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+
+static void put(std::vector<std::uint8_t>& out, std::uint64_t value, int size) {
+
+	for (int i=0; i<size; i++) out.push_back(value >> (8*i));
+}
+
+static void put_note(std::vector<std::uint8_t>& out, std::uint32_t type, const std::vector<std::uint8_t>& desc) {
+
+	put(out, 5, 4);
+	put(out, desc.size(), 4);
+	put(out, type, 4);
+	out.insert(out.end(), {'C', 'O', 'R', 'E', 0, 0, 0, 0});
+	out.insert(out.end(), desc.begin(), desc.end());
+	out.resize((out.size() + 3) & ~std::size_t(3));
+}
+
+
+// segments at 0x10000000 spaced by twice their size, the first word of each
+// points to the next one
+static std::string make_core(std::size_t segments, std::size_t segmentSize, std::size_t threads) {
+
+	std::vector<std::uint8_t> notes;
+	for (std::size_t t=0; t<threads; t++) {
+		std::vector<std::uint8_t> prstatus(336);
+		prstatus[12] = t == 0 ? 6 : 0;
+		std::uint32_t pid = 1000 + t;
+		std::memcpy(&prstatus[32], &pid, 4);
+		std::uint64_t rsp = 0x10000000 + 2*segmentSize*t + 64;
+		std::memcpy(&prstatus[112 + 19*8], &rsp, 8);
+		put_note(notes, elf::NT_PRSTATUS, prstatus);
+	}
+	std::vector<std::uint8_t> psinfo(136);
+	std::memcpy(&psinfo[40], "bench", 5);
+	put_note(notes, elf::NT_PRPSINFO, psinfo);
+	std::vector<std::uint8_t> auxv;
+	for (std::uint64_t type : {6, 4096, 0, 0}) put(auxv, type, 8);
+	put_note(notes, elf::NT_AUXV, auxv);
+
+	std::uint64_t phoff = 64, noteOffset = phoff + 56 * (segments + 1);
+	std::uint64_t dataOffset = (noteOffset + notes.size() + 4095) & ~4095ull;
+	std::vector<std::uint8_t> head;
+	head.insert(head.end(), {0x7f, 'E', 'L', 'F', 2, 1, 1, 0});
+	head.resize(16);
+	put(head, elf::ET_CORE, 2); put(head, 62, 2); put(head, 1, 4);
+	put(head, 0, 8); put(head, phoff, 8); put(head, 0, 8); put(head, 0, 4);
+	put(head, 64, 2); put(head, 56, 2); put(head, segments + 1, 2); put(head, 64, 2); put(head, 0, 2); put(head, 0, 2);
+	put(head, 4, 4); put(head, 0, 4); put(head, noteOffset, 8); put(head, 0, 8); put(head, 0, 8);
+	put(head, notes.size(), 8); put(head, 0, 8); put(head, 4, 8);
+	for (std::size_t i=0; i<segments; i++) {
+		put(head, 1, 4); put(head, 6, 4); put(head, dataOffset + segmentSize*i, 8);
+		put(head, 0x10000000 + 2*segmentSize*i, 8); put(head, 0, 8);
+		put(head, segmentSize, 8); put(head, segmentSize, 8); put(head, 4096, 8);
+	}
+	head.insert(head.end(), notes.begin(), notes.end());
+
+	std::string path = (std::filesystem::temp_directory_path() / ("elf-core-bench-" + std::to_string(getpid()))).string();
+	int fd = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+	if (pwrite(fd, head.data(), head.size(), 0) != (ssize_t) head.size()
+			|| ftruncate(fd, dataOffset + segmentSize*segments) != 0) {
+		throw std::runtime_error("can't write " + path);
+	}
+	for (std::size_t i=0; i+1<segments; i++) {
+		std::uint64_t next = 0x10000000 + 2*segmentSize*(i+1);
+		if (pwrite(fd, &next, 8, dataOffset + segmentSize*i) != 8) throw std::runtime_error("can't write " + path);
+	}
+	close(fd);
+	return path;
+}
+
+
+int main(int argc, char** argv) {
+
+	bool synthetic = argc < 2;
+	std::string path = synthetic ? make_core(20000, 64 << 10, 64) : argv[1];
+	elf::parse_error error;
+	std::unique_ptr<elf::core_file> core;
+	double openMs = time_ms([&]() { core = elf::core_file::open(path, error); });
+	if (!core) {
+		std::cerr << path << ": " << error.message << std::endl;
+		return 1;
+	}
+	std::uint64_t size = std::filesystem::file_size(path);
+	std::cout << path << ": " << size / 1e6 << " MB, " << core->segments().size() << " segments, "
+			<< core->threads().size() << " threads, " << core->mappings().size() << " mapped files, "
+			<< core->notes().size() << " notes" << std::endl;
+	double fullMs = time_ms([&]() {
+		elf::elf_parser::open(path, error, elf::read_options(elf::load_mode::copy));
+	});
+	std::cout << std::left << std::fixed << std::setprecision(2) << std::setw(36) << "core_file::open" << openMs << " ms"
+			<< std::endl << std::setw(36) << "elf_parser::open read_file" << fullMs << " ms" << std::endl;
+
+	// addresses inside the dumped bytes of random segments
+	std::vector<std::uint64_t> addresses;
+	std::mt19937_64 random(7);
+	std::vector<elf::core_segment> dumped;
+	for (const elf::core_segment &segment : core->segments()) if (segment.filesz >= 8) dumped.push_back(segment);
+	if (dumped.empty()) {
+		std::cerr << "no dumped memory" << std::endl;
+		return 1;
+	}
+	for (int i=0; i<1000000; i++) {
+		const elf::core_segment &segment = dumped[random() % dumped.size()];
+		addresses.push_back(segment.vaddr + (random() % (segment.filesz - 7) & ~7ull));
+	}
+	std::uint64_t sum = 0;
+	double viewMs = time_ms([&]() {
+		for (std::uint64_t address : addresses) sum += core->read_memory(address, 8).size();
+	});
+	double pointerMs = time_ms([&]() {
+		std::uint64_t value;
+		for (std::uint64_t address : addresses) if (core->read_pointer(address, value)) sum += value;
+	});
+	std::cout << std::setw(36) << "read_memory 8 bytes" << viewMs * 1e6 / addresses.size() << " ns" << std::endl;
+	std::cout << std::setw(36) << "read_pointer" << pointerMs * 1e6 / addresses.size() << " ns" << std::endl;
+
+	if (synthetic) {
+		std::size_t hops = 0;
+		double chainMs = time_ms([&]() {
+			std::uint64_t address = core->segments().front().vaddr;
+			while (core->read_pointer(address, address) && address) hops++;
+		});
+		std::cout << std::setw(36) << "pointer chain" << hops << " hops in " << chainMs << " ms" << std::endl;
+		std::filesystem::remove(path);
+		return sum == 0;
+	}
+
+	// return addresses by frame pointer, as far as the chain is dumped
+	for (const elf::core_thread &thread : core->threads()) {
+		std::cout << "thread " << thread.pid << " signal " << thread.signal << " pc 0x" << std::hex << thread.pc
+				<< " sp 0x" << thread.sp;
+		std::uint64_t fp = thread.fp, ret;
+		for (int depth=0; depth<64 && fp; depth++) {
+			if (!core->read_pointer(fp + (core->is64() ? 8 : 4), ret)) break;
+			std::cout << " <- 0x" << ret;
+			// frames lie further up the stack, anything else isn't a frame chain
+			std::uint64_t next;
+			if (!core->read_pointer(fp, next) || next <= fp) break;
+			fp = next;
+		}
+		std::cout << std::dec << std::endl;
+	}
+	return sum == 0;
+}
@@ -0,0 +1,153 @@
+#include "../../elf-cpp/inc/elf_diff.hpp"
+#include "synthetic_elf.hpp"
+
+#include <chrono>
+#include <cstring>
+#include <thread>
+#include <unistd.h>
+
+// A synthetic 256MB file with 1M symbols against a copy with one section
+// byte and 10 symbol values changed, and against an identical copy:
+// diff_elf from 1 up to every hardware thread, against comparing every
+// section byte by byte. Before that checksum and fingerprint throughput on
+// the same bytes. Given two files, prints their differences.
+
+
+template <typename F>
+static double time_ms(F f) {
+
+	auto start = std::chrono::steady_clock::now();
+	f();
+	auto end = std::chrono::steady_clock::now();
+	return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+
+static void print_diff(const elf::binary_diff& diff) {
+
+	for (const elf::field_diff &field : diff.header) {
+		std::cout << "header " << field.field << ": " << field.before << " -> " << field.after << std::endl;
+	}
+	for (const elf::segment_diff &segment : diff.segments) {
+		std::cout << "segment " << std::hex << segment.type << std::dec;
+		if (segment.oldIndex == elf::segment_diff::npos) std::cout << " added";
+		if (segment.newIndex == elf::segment_diff::npos) std::cout << " removed";
+		for (const elf::field_diff &field : segment.fields) {
+			std::cout << " " << field.field << " " << std::hex << field.before << " -> " << field.after << std::dec;
+		}
+		std::cout << std::endl;
+	}
+	static const char* changes[] = {"added", "removed", "moved", "resized", "content", "header"};
+	for (const elf::section_diff &section : diff.sections) {
+		std::cout << "section " << section.name;
+		for (int bit=0; bit<6; bit++) {
+			if (section.changes & (1u << bit)) std::cout << " " << changes[bit];
+		}
+		for (const auto &[offset, size] : section.ranges) std::cout << " [" << offset << "+" << size << "]";
+		std::cout << std::endl;
+	}
+	std::size_t counts[2][6] = {};
+	for (const elf::symbol_diff &symbol : diff.symbols) {
+		for (int bit=0; bit<6; bit++) {
+			if (symbol.changes & (1u << bit)) counts[symbol.dynamic][bit]++;
+		}
+	}
+	static const char* symbolChanges[] = {"added", "removed", "value", "size", "kind", "section"};
+	for (int dynamic=0; dynamic<2; dynamic++) {
+		std::cout << (dynamic ? ".dynsym:" : ".symtab:");
+		for (int bit=0; bit<6; bit++) std::cout << " " << counts[dynamic][bit] << " " << symbolChanges[bit];
+		std::cout << std::endl;
+	}
+	std::cout << diff.unchanged << " sections unchanged, " << diff.skippedTables << " symbol tables skipped, "
+			<< diff.hashed / 1e6 << " MB hashed, " << diff.compared / 1e6 << " MB compared" << std::endl;
+}
+
+
+int main(int argc, char** argv) {
+
+	elf::parse_error error;
+	elf::binary_diff diff;
+	elf::diff_options options;
+	options.ranges = true;
+	if (argc > 2) {
+		double ms = time_ms([&]() { elf::diff_files(argv[1], argv[2], diff, error, options); });
+		if (error) {
+			std::cerr << error.message << std::endl;
+			return 1;
+		}
+		print_diff(diff);
+		std::cout << std::fixed << std::setprecision(1) << ms << " ms" << std::endl;
+		return 0;
+	}
+
+	synthetic::options_t synthetic;
+	synthetic.sections = 2000;
+	synthetic.segments = 16;
+	synthetic.payload = 128 << 10;
+	synthetic.symbols = 1000000;
+	std::vector<std::uint8_t> bytes = synthetic::make_elf(synthetic);
+
+	std::cout << std::left << std::setw(14) << "Hash" << "GB/s" << std::endl;
+	for (bool vectorized : {false, true}) {
+		std::uint64_t sum = 0;
+		double ms = time_ms([&]() {
+			for (int i=0; i<4; i++) {
+				sum += vectorized ? elf::fingerprint(bytes.data(), bytes.size())
+						: elf::checksum(bytes.data(), bytes.size());
+			}
+		});
+		std::cout << std::setw(14) << (vectorized ? "fingerprint" : "checksum") << std::fixed << std::setprecision(2)
+				<< 4 * bytes.size() / 1e6 / ms << (sum ? "" : " ") << std::endl;
+	}
+
+	std::filesystem::path dir = std::filesystem::temp_directory_path()
+					/ ("elf-diff-bench-" + std::to_string(getpid()));
+	std::filesystem::create_directories(dir);
+	auto write = [&](const std::string& name) {
+		std::string path = (dir / name).string();
+		std::ofstream(path, std::ios::binary).write(reinterpret_cast<const char*>(bytes.data()), bytes.size());
+		return path;
+	};
+	std::string before = write("before.elf");
+	std::string same = write("same.elf");
+	// one byte in the payload of a section, the low byte of 10 symbol values
+	bytes[bytes.size() / 3] ^= 0xFF;
+	elf::elf_64_parser layout(elf::file_buffer::from_vector(bytes), elf::read_options(elf::load_mode::map, true));
+	std::uint64_t symtab = layout.find_section(".symtab")->sh_offset;
+	for (int i=0; i<10; i++) bytes[symtab + 24 * (1000 + 997 * i) + 8] ^= 0x40;
+	std::string after = write("after.elf");
+	std::cout << bytes.size() / 1e6 << " MB, " << synthetic.sections << " sections, " << synthetic.symbols
+			<< " symbols" << std::endl;
+
+	std::cout << std::left << std::setw(14) << "Pair" << std::setw(10) << "Threads" << std::setw(12) << "Time (ms)"
+			<< std::setw(10) << "Sections" << std::setw(10) << "Symbols" << "Skipped" << std::endl;
+	unsigned hardware = std::max(1u, std::thread::hardware_concurrency());
+	for (const auto &[name, other] : {std::make_pair("changed", after), std::make_pair("identical", same)}) {
+		for (unsigned threads=1; ; threads=std::min(2*threads, hardware)) {
+			options.threads = threads;
+			double ms = time_ms([&, other = other]() { elf::diff_files(before, other, diff, error, options); });
+			std::cout << std::setw(14) << name << std::setw(10) << threads << std::setw(12) << std::setprecision(1)
+					<< ms << std::setw(10) << diff.sections.size() << std::setw(10) << diff.symbols.size()
+					<< diff.skippedTables << std::endl;
+			if (threads == hardware) break;
+		}
+		// what finding the changed sections costs without fingerprints
+		std::size_t differing = 0;
+		double ms = time_ms([&, other = other]() {
+			std::unique_ptr<elf::elf_parser> a = elf::elf_parser::open(before, error,
+								elf::read_options(elf::load_mode::map, true));
+			std::unique_ptr<elf::elf_parser> b = elf::elf_parser::open(other, error,
+								elf::read_options(elf::load_mode::map, true));
+			for (std::size_t i=0; i<layout.sections().size(); i++) {
+				elf::byte_view x = a->file_bytes(i), y = b->file_bytes(i);
+				if (x.size() != y.size() || std::memcmp(x.data(), y.data(), x.size()) != 0) differing++;
+			}
+		});
+		std::cout << std::setw(14) << name << std::setw(10) << "memcmp" << std::setw(12) << ms << differing << std::endl;
+	}
+	options.threads = 0;
+	elf::diff_files(before, after, diff, error, options);
+	print_diff(diff);
+	std::filesystem::remove_all(dir);
+	return 0;
+}
@@ -0,0 +1,117 @@
+#include "../../elf-cpp/inc/elf_parser.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <random>
+
+// Name lookups in the .dynsym of real shared objects, libc and libstdc++
+// unless paths are given: a linear scan of the table against name_index
+// through the object's .gnu.hash, its .hash, and an index built on the fly.
+// Half of the names looked up are missing.
+
+
+template <typename F>
+static double time_ms(F f) {
+
+	auto start = std::chrono::steady_clock::now();
+	f();
+	auto end = std::chrono::steady_clock::now();
+	return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+
+template <typename elf_class>
+static elf::byte_view hash_section(elf::elf_class_parser<elf_class>& parser, std::uint32_t type) {
+
+	auto tables = parser.sections_of_type(type);
+	return tables.empty() ? elf::byte_view() : tables[0]->data;
+}
+
+
+int main(int argc, char** argv) {
+
+	std::vector<std::string> files;
+	for (int i=1; i<argc; i++) files.push_back(argv[i]);
+	if (files.empty()) files = {"/lib/x86_64-linux-gnu/libc.so.6", "/lib/x86_64-linux-gnu/libstdc++.so.6"};
+
+	int status = 0;
+	for (const std::string& file : files) {
+		elf::parse_error error;
+		std::unique_ptr<elf::elf_parser> parser = elf::elf_parser::open(file, error);
+		auto elf64 = dynamic_cast<elf::elf_64_parser*>(parser.get());
+		if (!elf64) {
+			std::cout << file << ": " << (error ? error.message : "not a 64-bit object") << std::endl;
+			status = 1;
+			continue;
+		}
+		const elf::symbol_table &symbols = parser->dynamic_symbols();
+		bool bigEndian = elf64->elf_header().e_ident[elf::EI_DATA_offset] == 2;
+
+		std::vector<std::string> names;
+		for (elf::symbol_table::symbol symbol : symbols) {
+			if (symbol.shndx() == elf::SHN_UNDEF || symbol.bind() == elf::STB_LOCAL) continue;
+			names.push_back(std::string(symbol.name()));
+			names.push_back(std::string(symbol.name()) + "@missing");
+		}
+		std::shuffle(names.begin(), names.end(), std::mt19937_64(42));
+
+		std::vector<std::uint32_t> expected(names.size());
+		double linear = time_ms([&]() {
+			for (std::size_t i=0; i<names.size(); i++) {
+				expected[i] = elf::name_index::npos;
+				for (elf::symbol_table::symbol symbol : symbols) {
+					if (symbol.shndx() != elf::SHN_UNDEF && symbol.bind() != elf::STB_LOCAL
+							&& symbol.name() == names[i]) {
+						expected[i] = symbol.index();
+						break;
+					}
+				}
+			}
+		});
+
+		std::cout << file << ": " << symbols.size() << " symbols, " << names.size() << " lookups" << std::endl;
+		std::cout << std::left << std::setw(12) << "Lookup" << std::setw(12) << "Setup (us)"
+				<< std::setw(12) << "Time (ms)" << "ns/lookup" << std::endl;
+		std::cout << std::fixed << std::setprecision(1);
+		std::cout << std::setw(12) << "linear" << std::setw(12) << 0.0 << std::setw(12) << linear
+				<< linear * 1e6 / names.size() << std::endl;
+
+		elf::byte_view gnuHash = hash_section(*elf64, 0x6FFFFFF6);
+		elf::byte_view sysvHash = hash_section(*elf64, 0x05);
+		const std::pair<const char*, elf::name_index::source> kinds[] = {
+			{"gnu hash", elf::name_index::source::gnu_hash},
+			{"sysv hash", elf::name_index::source::sysv_hash},
+			{"built", elf::name_index::source::built}
+		};
+		for (auto [label, kind] : kinds) {
+			elf::name_index index;
+			double setup = time_ms([&]() {
+				if (kind == elf::name_index::source::built) {
+					index = elf::name_index(symbols);
+				} else {
+					index = elf::name_index(symbols, kind == elf::name_index::source::gnu_hash ? gnuHash : elf::byte_view(),
+								kind == elf::name_index::source::sysv_hash ? sysvHash : elf::byte_view(),
+								bigEndian, 8);
+				}
+			});
+			if (index.kind() != kind) {
+				std::cout << std::setw(12) << label << "no table" << std::endl;
+				continue;
+			}
+			std::vector<std::uint32_t> found(names.size());
+			double ms = time_ms([&]() {
+				for (std::size_t i=0; i<names.size(); i++) found[i] = index.lookup(names[i]);
+			});
+			// versioned names defined twice may resolve to either definition
+			std::size_t differ = 0;
+			for (std::size_t i=0; i<names.size(); i++) {
+				if ((found[i] == elf::name_index::npos) != (expected[i] == elf::name_index::npos)) differ++;
+			}
+			std::cout << std::setw(12) << label << std::setw(12) << setup * 1000 << std::setw(12) << ms
+					<< ms * 1e6 / names.size() << (differ ? "  RESULTS DIFFER" : "") << std::endl;
+			if (differ) status = 1;
+		}
+		std::cout << std::endl;
+	}
+	return status;
+}
@@ -0,0 +1,54 @@
+#include "synthetic_elf.hpp"
+
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+// Writes a synthetic ELF file, the same bytes for the same options:
+//   gen-elf out.elf [-32] [-be] [-sections N] [-segments M] [-symbols K] [-payload B]
+
+
+int main(int argc, char** argv) {
+
+	if (argc < 2) {
+		std::cerr << "usage: " << argv[0] << " out.elf [-32] [-be] [-sections N] [-segments M]"
+				<< " [-symbols K] [-payload B]" << std::endl;
+		return 2;
+	}
+	synthetic::options_t options;
+	for (int i=2; i<argc; i++) {
+		std::string flag = argv[i];
+		if (flag == "-32") {
+			options.is64 = false;
+		} else if (flag == "-be") {
+			options.bigEndian = true;
+		} else if (i+1 < argc && flag == "-sections") {
+			options.sections = std::stoul(argv[++i]);
+		} else if (i+1 < argc && flag == "-segments") {
+			options.segments = std::stoul(argv[++i]);
+		} else if (i+1 < argc && flag == "-symbols") {
+			options.symbols = std::stoul(argv[++i]);
+		} else if (i+1 < argc && flag == "-payload") {
+			options.payload = std::stoul(argv[++i]);
+		} else {
+			std::cerr << "unknown option " << flag << std::endl;
+			return 2;
+		}
+	}
+	if (options.segments == 0 || options.segments > 0xffff) {
+		std::cerr << "segments must be 1 to 65535" << std::endl;
+		return 2;
+	}
+
+	std::vector<std::uint8_t> bytes = synthetic::make_elf(options);
+	std::ofstream out(argv[1], std::ios::binary);
+	out.write(reinterpret_cast<const char*>(bytes.data()), bytes.size());
+	if (!out) {
+		std::cerr << argv[1] << ": " << std::strerror(errno) << std::endl;
+		return 1;
+	}
+	std::cout << argv[1] << ": " << bytes.size() << " bytes, " << (options.is64 ? "ELF64 " : "ELF32 ")
+			<< (options.bigEndian ? "big" : "little") << " endian, " << options.sections << " sections, "
+			<< options.segments << " segments, " << options.symbols << " symbols" << std::endl;
+	return 0;
+}
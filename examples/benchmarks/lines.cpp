@@ -0,0 +1,89 @@
+#include "../../elf-cpp/inc/elf_parser.hpp"
+#include "synthetic_elf.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <thread>
+
+// Building a line_table from 2000 units of 5000 rows with 1 up to every
+// hardware thread, then single and batched lookups. Given a binary with
+// .debug_line instead, indexes that and compares 1000 lookups with one
+// addr2line run over the same addresses.
+
+
+template <typename F>
+static double time_ms(F f) {
+
+	auto start = std::chrono::steady_clock::now();
+	f();
+	auto end = std::chrono::steady_clock::now();
+	return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+
+int main(int argc, char** argv) {
+
+	std::vector<std::uint8_t> synthetic;
+	std::unique_ptr<elf::elf_parser> parser;
+	elf::byte_view debugLine, debugLineStr, debugStr;
+	if (argc > 1) {
+		elf::parse_error error;
+		parser = elf::elf_parser::open(argv[1], error);
+		if (!parser) {
+			std::cout << argv[1] << ": " << error.message << std::endl;
+			return 1;
+		}
+		debugLine = parser->section_view(".debug_line");
+		debugLineStr = parser->section_view(".debug_line_str");
+		debugStr = parser->section_view(".debug_str");
+	} else {
+		synthetic = synthetic::make_debug_line(2000, 5000);
+		debugLine = elf::byte_view(synthetic.data(), synthetic.size());
+	}
+
+	elf::line_table table;
+	unsigned hardware = std::max(1u, std::thread::hardware_concurrency());
+	std::cout << std::fixed << std::setprecision(1) << std::left;
+	std::cout << std::setw(10) << "Threads" << std::setw(12) << "Build (ms)" << "MB/s" << std::endl;
+	for (unsigned threads=1; ; threads=std::min(2*threads, hardware)) {
+		elf::line_options options;
+		options.threads = threads;
+		double ms = time_ms([&]() { table = elf::line_table(debugLine, debugLineStr, debugStr, false, options); });
+		std::cout << std::setw(10) << threads << std::setw(12) << ms << debugLine.size() / ms / 1000 << std::endl;
+		if (threads == hardware) break;
+	}
+	std::cout << table.units() << " units, " << table.size() << " rows, " << table.file_count() << " files, "
+			<< table.memory_usage() / 1024 << " KiB (" << (double) table.memory_usage() / std::max<std::size_t>(table.size(), 1)
+			<< " bytes/row) for " << debugLine.size() / 1024 << " KiB of .debug_line" << std::endl;
+	if (table.empty()) return 1;
+
+	const std::size_t queries = argc > 1 ? 1000 : 4000000;
+	std::mt19937_64 rng(42);
+	std::uniform_int_distribution<std::uint64_t> pick(table.address(0), table.address(table.size()-1));
+	std::vector<std::uint64_t> addresses(queries);
+	for (std::uint64_t &address : addresses) address = pick(rng);
+	std::vector<std::uint32_t> single(queries), batch(queries);
+	double one = time_ms([&]() {
+		for (std::size_t i=0; i<queries; i++) single[i] = table.lookup(addresses[i]);
+	});
+	double many = time_ms([&]() { table.lookup(addresses.data(), queries, batch.data()); });
+	std::cout << std::setw(20) << "Lookup" << std::setw(12) << "Time (ms)" << "Mlookups/s" << std::endl;
+	std::cout << std::setw(20) << "single" << std::setw(12) << one << queries / one / 1000 << std::endl;
+	std::cout << std::setw(20) << "batch" << std::setw(12) << many << queries / many / 1000 << std::endl;
+
+	if (argc > 1) {
+		// one process for the whole batch, the cheapest way to use it
+		std::string command = "addr2line -e '" + std::string(argv[1]) + "' > /dev/null";
+		double external = time_ms([&]() {
+			FILE* pipe = popen(command.c_str(), "w");
+			if (!pipe) return;
+			for (std::uint64_t address : addresses) std::fprintf(pipe, "0x%llx\n", (unsigned long long) address);
+			pclose(pipe);
+		});
+		std::cout << std::setw(20) << "addr2line" << std::setw(12) << external << queries / external / 1000 << std::endl;
+	}
+	bool same = single == batch;
+	std::cout << (same ? "results match" : "RESULTS DIFFER") << std::endl;
+	return same ? 0 : 1;
+}
@@ -0,0 +1,70 @@
+#include "../../elf-cpp/inc/elf_scan.hpp"
+
+#include <chrono>
+#include <map>
+
+// Build-ids of every ELF file below /usr/bin (or the directory given) in
+// files per second, read_notes against a full read_file parse that takes
+// the id from .note.gnu.build-id, from 1 up to every hardware thread. Both
+// have to agree on every id.
+
+
+int main(int argc, char** argv) {
+
+	std::string root = argc > 1 ? argv[1] : "/usr/bin";
+	std::vector<std::string> paths = elf::list_files(root);
+	std::cout << paths.size() << " files below " << root << std::endl;
+
+	std::map<std::string, std::string> fastIds, fullIds;
+	std::uint64_t reads = 0;
+	unsigned hardware = std::max(1u, std::thread::hardware_concurrency());
+	std::cout << std::left << std::setw(12) << "Mode" << std::setw(10) << "Threads" << std::setw(8) << "ELF"
+			<< std::setw(10) << "With id" << std::setw(12) << "Time (ms)" << "files/s" << std::endl;
+	for (bool notesOnly : {true, false}) {
+		for (unsigned threads=1; ; threads=std::min(2*threads, hardware)) {
+			elf::scan_options scan;
+			scan.threads = threads;
+			scan.skip_non_elf = true;
+			scan.notes_only = notesOnly;
+			scan.read = elf::read_options(elf::load_mode::copy);
+			std::size_t elfs = 0, ids = 0;
+			reads = 0;
+			auto start = std::chrono::steady_clock::now();
+			elf::scan_files(paths, [&](elf::scan_result& result) {
+				if (result.error) return;
+				elfs++;
+				std::string id;
+				if (notesOnly) {
+					id = result.notes.build_id;
+					reads += result.notes.reads;
+				} else {
+					// what deduplicating by build-id costs without the fast path,
+					// files below the root are taken to be in host byte order
+					elf::note_info info;
+					elf::byte_view note = result.parser->section_view(".note.gnu.build-id");
+					elf::decode_notes(note, true, elf::host_big_endian, 4, info);
+					id = info.build_id;
+				}
+				if (!id.empty()) ids++;
+				(notesOnly ? fastIds : fullIds)[result.path] = id;
+			}, scan);
+			double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+			std::cout << std::setw(12) << (notesOnly ? "read_notes" : "read_file") << std::setw(10) << threads
+					<< std::setw(8) << elfs << std::setw(10) << ids << std::setw(12) << std::fixed
+					<< std::setprecision(1) << ms << std::setprecision(0) << paths.size() * 1000 / ms << std::endl;
+			if (threads == hardware) break;
+		}
+		if (notesOnly) {
+			std::cout << std::setprecision(2) << (double) reads / std::max<std::size_t>(fastIds.size(), 1)
+					<< " reads per ELF file" << std::endl;
+		}
+	}
+
+	std::size_t differ = 0;
+	for (const auto& [path, id] : fullIds) {
+		auto it = fastIds.find(path);
+		if (it == fastIds.end() || it->second != id) differ++;
+	}
+	std::cout << differ << " build-ids differ" << std::endl;
+	return differ ? 1 : 0;
+}
@@ -0,0 +1,90 @@
+#include "../../elf-cpp/inc/elf_scan.hpp"
+
+#include <chrono>
+#include <fcntl.h>
+#include <unistd.h>
+
+// Dumping header, sections, segments and symbols of every ELF file below
+// /usr/lib/x86_64-linux-gnu (or the directory given) to /dev/null as text,
+// JSON and NDJSON through one output_buffer, against the same symbol rows
+// formatted with iostream manipulators the way the printers used to.
+
+
+template <typename F>
+static double time_ms(F f) {
+
+	auto start = std::chrono::steady_clock::now();
+	f();
+	auto end = std::chrono::steady_clock::now();
+	return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+
+// counts what reaches the descriptor
+class counting_sink : public elf::fd_sink {
+
+	public:
+		counting_sink(int fd) : elf::fd_sink(fd) {}
+		void write(const char* data, std::size_t size) override { bytes += size; elf::fd_sink::write(data, size); }
+		std::uint64_t bytes = 0;
+};
+
+
+int main(int argc, char** argv) {
+
+	std::string root = argc > 1 ? argv[1] : "/usr/lib/x86_64-linux-gnu";
+	std::vector<std::unique_ptr<elf::elf_parser>> parsers;
+	std::vector<std::string> paths;
+	elf::scan_options scan;
+	scan.skip_non_elf = true;
+	elf::scan_directory(root, [&](elf::scan_result& result) {
+		if (result.error) return;
+		result.parser->symbols();
+		result.parser->dynamic_symbols();
+		paths.push_back(result.path);
+		parsers.push_back(std::move(result.parser));
+	}, scan);
+	std::cout << parsers.size() << " ELF files below " << root << ", tables decoded up front" << std::endl;
+
+	int null = open("/dev/null", O_WRONLY | O_CLOEXEC);
+	std::cout << std::left << std::setw(20) << "Format" << std::setw(12) << "Time (ms)" << std::setw(12)
+			<< "MB" << std::setw(10) << "MB/s" << "files/s" << std::endl;
+	for (auto [name, format] : {std::make_pair("text", elf::output_format::text),
+				std::make_pair("json", elf::output_format::json),
+				std::make_pair("ndjson", elf::output_format::ndjson)}) {
+		counting_sink sink(null);
+		double ms = time_ms([&, format = format]() {
+			elf::output_buffer out(sink);
+			for (std::size_t i=0; i<parsers.size(); i++) parsers[i]->write(out, format, elf::output_all, paths[i]);
+		});
+		std::cout << std::setw(20) << name << std::fixed << std::setprecision(1) << std::setw(12) << ms
+				<< std::setw(12) << sink.bytes / 1e6 << std::setw(10) << sink.bytes / ms / 1000
+				<< std::setprecision(0) << parsers.size() * 1000 / ms << std::endl;
+	}
+
+	// the symbol rows alone both ways, the bulk of the text output
+	counting_sink sink(null);
+	double buffered = time_ms([&]() {
+		elf::output_buffer out(sink);
+		for (auto &parser : parsers) parser->write(out, elf::output_format::text, elf::output_symbols);
+	});
+	std::ofstream stream("/dev/null");
+	double iostream = time_ms([&]() {
+		for (auto &parser : parsers) {
+			for (const elf::symbol_table* table : {&parser->dynamic_symbols(), &parser->symbols()}) {
+				for (elf::symbol_table::symbol symbol : *table) {
+					stream << std::right << std::dec << std::setw(6) << symbol.index() << ": ";
+					stream << std::hex << std::setfill('0') << std::setw(16) << symbol.value() << ' ';
+					stream << std::dec << std::setfill(' ') << std::setw(5) << symbol.size() << ' ';
+					stream << std::left << std::setw(7) << (int) symbol.type() << ' ';
+					stream << std::setw(6) << (int) symbol.bind() << ' ' << std::setw(8) << (int) symbol.visibility();
+					stream << std::right << std::setw(4) << symbol.shndx() << ' ' << symbol.name() << std::endl;
+				}
+			}
+		}
+	});
+	std::cout << std::setw(20) << "symbols buffered" << std::setprecision(1) << std::setw(12) << buffered << std::endl;
+	std::cout << std::setw(20) << "symbols iostream" << std::setw(12) << iostream << std::endl;
+	close(null);
+	return 0;
+}
@@ -0,0 +1,113 @@
+#include "../../elf-cpp/inc/elf_parser.hpp"
+
+#include <chrono>
+#include <random>
+
+// Decoding 4M RELA entries of each class and byte order into columns,
+// against a row at a time decode into structs reading byte by byte, then
+// grouping the decoded rows by type and by target section.
+
+
+template <typename F>
+static double time_ms(F f) {
+
+	auto start = std::chrono::steady_clock::now();
+	f();
+	auto end = std::chrono::steady_clock::now();
+	return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+
+typedef struct naive_rela_t {
+	std::uint64_t offset;
+	std::uint32_t type;
+	std::uint32_t symbol;
+	std::int64_t addend;
+} naive_rela_t;
+
+
+static std::uint64_t join(const std::uint8_t* ptr, int size, bool bigEndian) {
+
+	std::uint64_t value = 0;
+	for (int i=0; i<size; i++) {
+		value |= (std::uint64_t) ptr[i] << (bigEndian ? 8*(size-1-i) : 8*i);
+	}
+	return value;
+}
+
+
+template <typename elf_class>
+static void run(bool bigEndian, std::size_t count) {
+
+	const int word = elf_class::r_addr_size;
+	const int entsize = elf_class::rela_size;
+	std::vector<std::uint8_t> table(count * entsize);
+	std::mt19937_64 rng(42);
+	for (std::size_t i=0; i<count; i++) {
+		// mostly a handful of types, symbols in a 64k table
+		std::uint64_t type = rng() % 16 < 12 ? rng() % 4 + 1 : rng() % 40;
+		std::uint64_t info = ((rng() % 65536) << elf_class::r_sym_shift) | type;
+		std::uint64_t fields[3] = {8 * i, info, rng() % 4096};
+		for (int f=0; f<3; f++) {
+			for (int b=0; b<word; b++) {
+				int shift = bigEndian ? 8*(word-1-b) : 8*b;
+				table[i*entsize + f*word + b] = fields[f] >> shift;
+			}
+		}
+	}
+
+	std::vector<naive_rela_t> naive;
+	double rows = time_ms([&]() {
+		naive.reserve(count);
+		for (std::size_t i=0; i<count; i++) {
+			const std::uint8_t* entry = table.data() + i*entsize;
+			std::uint64_t info = join(entry + word, word, bigEndian);
+			naive.push_back({join(entry, word, bigEndian), (std::uint32_t) (info & elf_class::r_type_mask),
+					(std::uint32_t) (info >> elf_class::r_sym_shift), (std::int64_t) join(entry + 2*word, word, bigEndian)});
+		}
+	});
+
+	// four sections of a quarter each, two of them patching the same target
+	elf::relocation_table relocations;
+	double columns = time_ms([&]() {
+		relocations.reserve(count);
+		std::size_t quarter = count / 4 * entsize;
+		for (std::uint32_t s=0; s<4; s++) {
+			elf::relocation_table::run_t run;
+			run.section = s + 1;
+			run.target = s % 3 + 10;
+			run.type = elf::SHT_RELA;
+			elf::byte_view part(table.data() + s*quarter, s == 3 ? table.size() - 3*quarter : quarter);
+			relocations.append<elf_class>(part, run, entsize, bigEndian);
+		}
+	});
+	elf::relocation_table::grouping types, targets;
+	double byType = time_ms([&]() { types = relocations.by_type(); });
+	double byTarget = time_ms([&]() { targets = relocations.by_target(); });
+
+	bool same = relocations.size() == naive.size();
+	for (std::size_t i=0; same && i<count; i++) {
+		same = naive[i].offset == relocations.offsets()[i] && naive[i].type == relocations.types()[i]
+			&& naive[i].symbol == relocations.symbol_indexes()[i] && naive[i].addend == relocations.addends()[i];
+	}
+	std::cout << std::setw(8) << elf_class::name << std::setw(8) << (bigEndian ? "BE" : "LE")
+			<< std::setw(12) << rows << std::setw(12) << columns << std::setw(12) << byType
+			<< std::setw(12) << byTarget << types.size() << " types, " << targets.size() << " targets"
+			<< (same ? "" : "  RESULTS DIFFER") << std::endl;
+}
+
+
+int main(int argc, char** argv) {
+
+	std::size_t count = argc > 1 ? std::stoul(argv[1]) : 4000000;
+	std::cout << std::fixed << std::setprecision(1) << std::left;
+	std::cout << count << " relocations, times in ms" << std::endl;
+	std::cout << std::setw(8) << "Class" << std::setw(8) << "Order" << std::setw(12) << "Rows"
+			<< std::setw(12) << "Columns" << std::setw(12) << "By type" << std::setw(12) << "By target"
+			<< "Groups" << std::endl;
+	run<elf::elf32_traits>(false, count);
+	run<elf::elf32_traits>(true, count);
+	run<elf::elf64_traits>(false, count);
+	run<elf::elf64_traits>(true, count);
+	return 0;
+}
@@ -0,0 +1,105 @@
+#include "../../elf-cpp/inc/elf_writer.hpp"
+#include "synthetic_elf.hpp"
+
+#include <chrono>
+#include <fcntl.h>
+#include <unistd.h>
+
+// write_elf on a synthetic 256MB file (or the file given) that first gets 64
+// debug sections of 4MiB added: a rewrite without edits, stripping the debug
+// sections again, replacing a loaded section in place and updating a note.
+// Times each in MB/s of output against copying the same file through user
+// space with read and write, and shows how much went through memory.
+
+
+template <typename F>
+static double time_ms(F f) {
+
+	auto start = std::chrono::steady_clock::now();
+	f();
+	auto end = std::chrono::steady_clock::now();
+	return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+
+static void user_copy(const std::string& from, const std::string& to) {
+
+	int in = open(from.c_str(), O_RDONLY);
+	int out = open(to.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	std::vector<char> chunk(1 << 20);
+	ssize_t got;
+	while ((got = read(in, chunk.data(), chunk.size())) > 0) {
+		if (write(out, chunk.data(), got) != got) break;
+	}
+	close(in);
+	close(out);
+}
+
+
+int main(int argc, char** argv) {
+
+	std::filesystem::path dir = std::filesystem::temp_directory_path()
+					/ ("elf-rewrite-bench-" + std::to_string(getpid()));
+	std::filesystem::create_directories(dir);
+	std::string source = (dir / "in.elf").string();
+	std::string output = (dir / "out.elf").string();
+	elf::parse_error error;
+	elf::write_stats stats;
+	std::vector<elf::elf_edit> debug;
+
+	std::string base = argc > 1 ? argv[1] : (dir / "base.elf").string();
+	if (argc <= 1) {
+		synthetic::options_t options;
+		options.sections = 1000;
+		options.segments = 16;
+		options.payload = 256 << 10;
+		std::vector<std::uint8_t> bytes = synthetic::make_elf(options);
+		std::ofstream(base, std::ios::binary).write(reinterpret_cast<const char*>(bytes.data()), bytes.size());
+		for (int i=0; i<64; i++) {
+			debug.push_back(elf::elf_edit::add(".debug_" + std::to_string(i),
+								std::vector<std::uint8_t>(4 << 20, i), 0x01, 0, 8));
+		}
+	}
+	std::unique_ptr<elf::elf_parser> parser = elf::elf_parser::open(base, error,
+								elf::read_options(elf::load_mode::map, true));
+	if (!parser || !elf::write_elf(*parser, base, debug, source, error)) {
+		std::cerr << base << ": " << error.message << std::endl;
+		return 1;
+	}
+	parser = elf::elf_parser::open(source, error, elf::read_options(elf::load_mode::map, true));
+	std::uint64_t size = std::filesystem::file_size(source);
+	std::cout << source << ": " << size / 1e6 << " MB" << std::endl;
+
+	// a loaded section of the synthetic file, or the first one given
+	std::string loaded = argc > 1 ? ".text" : ".s500";
+	std::vector<std::uint8_t> replacement(parser->section_view(loaded).size(), 0xCC);
+	std::vector<std::pair<std::string, std::vector<elf::elf_edit>>> runs = {
+		{"no edits", {}},
+		{"strip debug", {elf::elf_edit::remove(".debug_*")}},
+		{"replace", {elf::elf_edit::replace(loaded, replacement)}},
+		{"note", {elf::elf_edit::add(".note.bench", {}, 0x07, 0, 4),
+				elf::elf_edit::update_note(".note.bench", "GNU", 3, std::vector<std::uint8_t>(20, 0xAB))}},
+	};
+
+	std::cout << std::left << std::setw(14) << "Edits" << std::setw(12) << "Time (ms)" << std::setw(10) << "MB/s"
+			<< std::setw(14) << "Output MB" << std::setw(14) << "Copied MB" << "Written KB" << std::endl;
+	double copyMs = time_ms([&]() { user_copy(source, output); });
+	std::cout << std::setw(14) << "read/write" << std::fixed << std::setprecision(1) << std::setw(12) << copyMs
+			<< std::setw(10) << size / 1e3 / copyMs << std::setw(14) << size / 1e6 << std::setw(14) << 0.0
+			<< size / 1e3 << std::endl;
+	for (const auto &[name, edits] : runs) {
+		bool done = false;
+		double ms = time_ms([&, &edits = edits]() {
+			done = elf::write_elf(*parser, source, edits, output, error, &stats);
+		});
+		if (!done) {
+			std::cerr << name << ": " << error.message << std::endl;
+			continue;
+		}
+		std::cout << std::setw(14) << name << std::setw(12) << ms << std::setw(10) << stats.size / 1e3 / ms
+				<< std::setw(14) << stats.size / 1e6 << std::setw(14) << stats.copied / 1e6
+				<< stats.written / 1e3 << std::endl;
+	}
+	std::filesystem::remove_all(dir);
+	return 0;
+}
@@ -0,0 +1,60 @@
+#include "../../elf-cpp/inc/elf_scan.hpp"
+#include "synthetic_elf.hpp"
+
+#include <chrono>
+#include <unistd.h>
+
+// Files per second scanning a directory of small synthetic files with 1 up to
+// every hardware thread. The files are written first so the page cache is warm.
+
+
+int main(int argc, char** argv) {
+
+	std::size_t count = argc > 1 ? std::stoul(argv[1]) : 20000;
+	std::filesystem::path root = std::filesystem::temp_directory_path()
+					/ ("elf-scan-bench-" + std::to_string(getpid()));
+	std::filesystem::create_directories(root);
+
+	synthetic::options_t options;
+	options.sections = 32;
+	options.segments = 2;
+	options.payload = 64;
+	std::vector<std::uint8_t> image = synthetic::make_elf(options);
+	std::vector<std::string> paths;
+	for (std::size_t i=0; i<count; i++) {
+		// 100 files per directory, a bad file every 1000 for the error path
+		std::filesystem::path dir = root / std::to_string(i / 100);
+		if (i % 100 == 0) std::filesystem::create_directory(dir);
+		std::ofstream out(dir / ("f" + std::to_string(i)), std::ios::binary);
+		if (i % 1000 == 999) {
+			out << "not an elf file";
+		} else {
+			out.write(reinterpret_cast<const char*>(image.data()), image.size());
+		}
+	}
+
+	unsigned hardware = std::max(1u, std::thread::hardware_concurrency());
+	std::cout << std::left << std::setw(10) << "Threads" << std::setw(10) << "Parsed"
+			<< std::setw(10) << "Errors" << std::setw(12) << "Time (ms)" << "files/s" << std::endl;
+	for (unsigned threads=1; ; threads=std::min(2*threads, hardware)) {
+		elf::scan_options scan;
+		scan.threads = threads;
+		std::size_t parsed = 0, errors = 0;
+		auto start = std::chrono::steady_clock::now();
+		elf::scan_directory(root.string(), [&](elf::scan_result& result) {
+			if (result.error) {
+				errors++;
+			} else if (!result.parser->symbols().empty() || result.parser->section_view(".s0").size()) {
+				parsed++;
+			}
+		}, scan);
+		double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		std::cout << std::setw(10) << threads << std::setw(10) << parsed << std::setw(10) << errors
+				<< std::setw(12) << std::fixed << std::setprecision(1) << ms
+				<< std::setprecision(0) << (parsed + errors) * 1000 / ms << std::endl;
+		if (threads == hardware) break;
+	}
+
+	std::filesystem::remove_all(root);
+	return 0;
+}
@@ -0,0 +1,37 @@
+#include "../../elf-cpp/inc/elf_parser.hpp"
+#include "synthetic_elf.hpp"
+
+#include <chrono>
+
+// Parse time of synthetic files with growing section counts, most of it is
+// map_sections_to_segments so the time per section should stay flat
+
+
+int main(void) {
+
+	std::cout << std::left << std::setw(10) << "Sections" << std::setw(10) << "Segments"
+			<< std::setw(10) << "Mapped" << std::setw(12) << "Parse (ms)"
+			<< "ns/section" << std::endl;
+	for (std::size_t sections : {1000, 10000, 100000}) {
+		synthetic::options_t options;
+		options.sections = sections;
+		options.segments = std::max<std::size_t>(1, sections / 256);
+		auto buffer = elf::file_buffer::from_vector(synthetic::make_elf(options));
+
+		const int runs = 5;
+		double best = 1e30;
+		std::size_t mapped = 0;
+		for (int run=0; run<runs; run++) {
+			auto start = std::chrono::steady_clock::now();
+			elf::elf_64_parser parser(buffer, elf::read_options(elf::load_mode::map, true));
+			auto end = std::chrono::steady_clock::now();
+			best = std::min(best, std::chrono::duration<double, std::milli>(end - start).count());
+			mapped = 0;
+			for (const auto &segment : parser.segments()) mapped += segment.sectionMapIndexes.size();
+		}
+		std::cout << std::setw(10) << sections << std::setw(10) << options.segments
+				<< std::setw(10) << mapped << std::setw(12) << std::fixed
+				<< std::setprecision(3) << best << best * 1e6 / sections << std::endl;
+	}
+	return 0;
+}
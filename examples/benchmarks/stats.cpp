@@ -0,0 +1,96 @@
+#include "../../elf-cpp/inc/elf_parser.hpp"
+#include "../../elf-cpp/inc/elf_stats.hpp"
+#include "synthetic_elf.hpp"
+
+#include <chrono>
+#include <unistd.h>
+
+// Parses a synthetic file of 5000 sections and 200k symbols (or the files
+// given) 20 times in each load mode, decoding the symbols and writing the
+// header and sections as NDJSON to nowhere, then shows where the time went by phase and the counters, and
+// dumps them as JSON. Built with make STATS=1 for the phases, the time per
+// parse of a plain build against it is the cost of the instrumentation.
+
+
+class discard_sink : public elf::output_sink {
+
+	public:
+		void write(const char* data, std::size_t size) override {}
+};
+
+
+int main(int argc, char** argv) {
+
+	std::vector<std::string> files;
+	std::filesystem::path dir = std::filesystem::temp_directory_path()
+					/ ("elf-stats-bench-" + std::to_string(getpid()));
+	if (argc > 1) {
+		files.assign(argv + 1, argv + argc);
+	} else {
+		synthetic::options_t options;
+		options.sections = 5000;
+		options.segments = 16;
+		options.payload = 256;
+		options.symbols = 200000;
+		std::vector<std::uint8_t> bytes = synthetic::make_elf(options);
+		std::filesystem::create_directories(dir);
+		files.push_back((dir / "in.elf").string());
+		std::ofstream(files[0], std::ios::binary).write(reinterpret_cast<const char*>(bytes.data()), bytes.size());
+	}
+
+	discard_sink sink;
+	elf::output_buffer out(sink);
+	elf::parse_error error;
+	constexpr int rounds = 20;
+	std::cout << "instrumentation " << (elf::stats_enabled ? "on" : "off") << std::endl;
+	std::cout << std::left << std::setw(14) << "Mode" << "ms/parse" << std::endl;
+	std::vector<std::pair<const char*, elf::read_options>> modes = {
+		{"map", elf::read_options(elf::load_mode::map)},
+		{"map lazy", elf::read_options(elf::load_mode::map, true)},
+		{"copy", elf::read_options(elf::load_mode::copy)},
+		{"stream", elf::read_options(elf::load_mode::stream)},
+	};
+	elf::reset_stats();
+	double totalMs = 0;
+	for (const auto &[name, options] : modes) {
+		auto start = std::chrono::steady_clock::now();
+		for (int round=0; round<rounds; round++) {
+			for (const std::string &file : files) {
+				std::unique_ptr<elf::elf_parser> parser = elf::elf_parser::open(file, error, options);
+				if (!parser) {
+					std::cerr << file << ": " << error.message << std::endl;
+					continue;
+				}
+				parser->symbols();
+				parser->write(out, elf::output_format::ndjson, elf::output_header | elf::output_sections, file);
+			}
+		}
+		double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		totalMs += ms;
+		std::cout << std::setw(14) << name << std::fixed << std::setprecision(3) << ms / rounds / files.size()
+				<< std::endl;
+	}
+	out.flush();
+
+	elf::parse_stats stats = elf::collect_stats();
+	if (elf::stats_enabled) {
+		std::cout << std::setw(21) << "Phase" << std::setw(12) << "ms" << std::setw(10) << "calls" << "%" << std::endl;
+		for (std::size_t i=0; i<elf::stat_phase_count; i++) {
+			elf::stat_phase phase = static_cast<elf::stat_phase>(i);
+			std::cout << std::setw(21) << elf::stat_name(phase) << std::setw(12) << std::setprecision(1)
+					<< stats.time(phase) / 1e6 << std::setw(10) << stats.calls[i]
+					<< stats.time(phase) / 1e4 / totalMs << std::endl;
+		}
+		for (std::size_t i=0; i<elf::stat_counter_count; i++) {
+			elf::stat_counter counter = static_cast<elf::stat_counter>(i);
+			std::cout << std::setw(21) << elf::stat_name(counter) << stats.count(counter) << std::endl;
+		}
+	}
+	elf::stream_sink console(std::cout);
+	elf::output_buffer json(console);
+	stats.write_json(json);
+	json.put('\n');
+	json.flush();
+	if (argc <= 1) std::filesystem::remove_all(dir);
+	return 0;
+}
@@ -0,0 +1,51 @@
+#include "../../elf-cpp/inc/elf_parser.hpp"
+#include "synthetic_elf.hpp"
+
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <unistd.h>
+
+// Header-only parse of a large sparse file, streamed against mapped. The
+// image sits at the start and the file is extended to the size given in GiB.
+
+
+int main(int argc, char** argv) {
+
+	std::uint64_t gib = argc > 1 ? std::stoull(argv[1]) : 20;
+	std::filesystem::path path = std::filesystem::temp_directory_path()
+					/ ("elf-stream-bench-" + std::to_string(getpid()));
+
+	synthetic::options_t options;
+	options.sections = 2000;
+	options.symbols = 10000;
+	std::vector<std::uint8_t> image = synthetic::make_elf(options);
+	{
+		std::ofstream out(path, std::ios::binary);
+		out.write(reinterpret_cast<const char*>(image.data()), image.size());
+	}
+	std::filesystem::resize_file(path, gib << 30);
+
+	std::cout << std::left << std::setw(10) << "Mode" << std::setw(12) << "Time (us)"
+			<< "Bytes read" << std::endl;
+	const int rounds = 20;
+	for (elf::load_mode mode : {elf::load_mode::map, elf::load_mode::stream}) {
+		std::uint64_t read = 0;
+		auto start = std::chrono::steady_clock::now();
+		for (int i=0; i<rounds; i++) {
+			std::shared_ptr<elf::file_buffer> buffer = mode == elf::load_mode::stream
+					? elf::file_buffer::stream_file(path.string())
+					: elf::file_buffer::map_file(path.string());
+			elf::elf_64_parser parser(buffer, elf::read_options(mode, true));
+			if (parser.sections().size() != options.sections + 4) std::cout << "bad parse" << std::endl;
+			if (mode == elf::load_mode::stream) read = static_cast<elf::stream_buffer&>(*buffer).bytes_read();
+		}
+		double us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+		std::cout << std::setw(10) << (mode == elf::load_mode::stream ? "stream" : "map")
+				<< std::setw(12) << std::fixed << std::setprecision(1) << us / rounds
+				<< (mode == elf::load_mode::stream ? std::to_string(read) : "-") << std::endl;
+	}
+
+	std::filesystem::remove(path);
+	return 0;
+}
@@ -0,0 +1,271 @@
+#include "../../elf-cpp/inc/elf_notes.hpp"
+#include "synthetic_elf.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <new>
+#include <sstream>
+#include <unistd.h>
+
+// Every public parse and output operation on synthetic files of both classes
+// and byte orders, small and large. Per operation: best and median latency,
+// bytes per second, allocations per run and peak RSS while it ran. With -json
+// the rows are also written to a file for tracking regressions between builds.
+//   bench-suite [-json results.json] [-quick]
+
+
+// every allocation of the process goes through here
+static std::atomic<std::uint64_t> allocations {0};
+static std::atomic<std::uint64_t> allocatedBytes {0};
+
+// inlined, gcc sees free() paired with new and warns
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+void* operator new(std::size_t size) {
+
+	allocations.fetch_add(1, std::memory_order_relaxed);
+	allocatedBytes.fetch_add(size, std::memory_order_relaxed);
+	if (void* ptr = std::malloc(size ? size : 1)) return ptr;
+	throw std::bad_alloc();
+}
+void* operator new[](std::size_t size) { return operator new(size); }
+void operator delete(void* ptr) noexcept { std::free(ptr); }
+void operator delete[](void* ptr) noexcept { std::free(ptr); }
+void operator delete(void* ptr, std::size_t) noexcept { std::free(ptr); }
+void operator delete[](void* ptr, std::size_t) noexcept { std::free(ptr); }
+#pragma GCC diagnostic pop
+
+
+// peak RSS since the last reset, writing 5 to clear_refs resets VmHWM to the
+// current RSS, without it the peak of the whole process is reported
+static void reset_peak_rss(void) {
+
+	std::ofstream("/proc/self/clear_refs") << "5";
+}
+
+static std::uint64_t peak_rss_kib(void) {
+
+	std::ifstream status("/proc/self/status");
+	std::string line;
+	while (std::getline(status, line)) {
+		if (line.rfind("VmHWM:", 0) == 0) return std::stoull(line.substr(6));
+	}
+	return 0;
+}
+
+
+typedef struct case_t {
+	std::string name;
+	synthetic::options_t options;
+	std::string path;
+	std::uint64_t size;
+} case_t;
+
+typedef struct row_t {
+	std::string file;
+	std::string op;
+	int runs;
+	double best;		// ms
+	double median;
+	std::uint64_t bytes;	// processed per run
+	std::uint64_t allocs;	// per run
+	std::uint64_t allocBytes;
+	std::uint64_t peakRss;	// KiB
+} row_t;
+
+
+// runs body on what setup returns until minRuns runs and minMs milliseconds
+// are done, only body is timed and counted
+template <typename Setup, typename Body>
+static row_t measure(const case_t& file, const std::string& op, std::uint64_t bytes,
+			int minRuns, double minMs, Setup setup, Body body) {
+
+	std::vector<double> times;
+	std::uint64_t allocs = 0, allocBytes = 0, peak = 0;
+	double total = 0;
+	while ((int) times.size() < minRuns || total < minMs) {
+		auto state = setup();
+		reset_peak_rss();
+		std::uint64_t allocs0 = allocations, bytes0 = allocatedBytes;
+		auto start = std::chrono::steady_clock::now();
+		body(state);
+		auto end = std::chrono::steady_clock::now();
+		allocs = allocations - allocs0;
+		allocBytes = allocatedBytes - bytes0;
+		peak = std::max(peak, peak_rss_kib());
+		times.push_back(std::chrono::duration<double, std::milli>(end - start).count());
+		total += times.back();
+		if (times.size() >= 1000) break;
+	}
+	std::sort(times.begin(), times.end());
+	return {file.name, op, (int) times.size(), times.front(), times[times.size() / 2],
+			bytes, allocs, allocBytes, peak};
+}
+
+
+static std::unique_ptr<elf::elf_parser> open_file(const case_t& file, elf::read_options options) {
+
+	elf::parse_error error;
+	std::unique_ptr<elf::elf_parser> parser = elf::elf_parser::open(file.path, error, options);
+	if (!parser) throw std::runtime_error(file.path + ": " + error.message);
+	return parser;
+}
+
+
+static std::vector<row_t> run_case(const case_t& file, int minRuns, double minMs) {
+
+	std::vector<row_t> rows;
+	const elf::read_options lazy(elf::load_mode::map, true);
+	std::vector<std::string> names;
+	for (std::size_t i=0; i<file.options.sections; i++) names.push_back(".s" + std::to_string(i));
+	std::uint64_t payload = file.options.sections * file.options.payload;
+	auto none = []() { return 0; };
+	auto lazyParser = [&]() { return open_file(file, lazy); };
+
+	for (auto [op, mode, isLazy] : {std::make_tuple("open map lazy", elf::load_mode::map, true),
+					std::make_tuple("open map", elf::load_mode::map, false),
+					std::make_tuple("open copy", elf::load_mode::copy, false),
+					std::make_tuple("open stream", elf::load_mode::stream, true)}) {
+		elf::read_options options(mode, isLazy);
+		rows.push_back(measure(file, op, file.size, minRuns, minMs, none, [&](int) {
+			open_file(file, options);
+		}));
+	}
+	rows.push_back(measure(file, "read_notes", file.size, minRuns, minMs, none, [&](int) {
+		elf::note_info info;
+		elf::parse_error error;
+		elf::read_notes(file.path, info, error);
+	}));
+	rows.push_back(measure(file, "section_view all", payload, minRuns, minMs, lazyParser,
+				[&](std::unique_ptr<elf::elf_parser>& parser) {
+		for (const std::string &name : names) parser->section_view(name);
+	}));
+	rows.push_back(measure(file, "read_section all", payload, minRuns, minMs, lazyParser,
+				[&](std::unique_ptr<elf::elf_parser>& parser) {
+		for (const std::string &name : names) parser->read_section(name);
+	}));
+	if (file.options.symbols) {
+		std::uint64_t symbolBytes = (file.options.symbols + 1) * (file.options.is64 ? 0x18 : 0x10);
+		rows.push_back(measure(file, "symbols", symbolBytes, minRuns, minMs, lazyParser,
+					[&](std::unique_ptr<elf::elf_parser>& parser) {
+			parser->symbols();
+		}));
+		rows.push_back(measure(file, "address_index", symbolBytes, minRuns, minMs, [&]() {
+			std::unique_ptr<elf::elf_parser> parser = lazyParser();
+			parser->symbols();
+			return parser;
+		}, [&](std::unique_ptr<elf::elf_parser>& parser) {
+			elf::address_index index(parser->symbols());
+		}));
+	}
+	for (auto [op, method] : {std::make_pair("print_sections", &elf::elf_parser::print_sections),
+				std::make_pair("print_segments", &elf::elf_parser::print_segments)}) {
+		void (elf::elf_parser::*print)(void) = method;
+		rows.push_back(measure(file, op, file.size, minRuns, minMs, lazyParser,
+					[&](std::unique_ptr<elf::elf_parser>& parser) {
+			std::ostringstream sink;
+			std::streambuf* saved = std::cout.rdbuf(sink.rdbuf());
+			((*parser).*print)();
+			std::cout.rdbuf(saved);
+		}));
+	}
+	for (auto [op, kind] : {std::make_pair("write text", elf::output_format::text),
+				std::make_pair("write ndjson", elf::output_format::ndjson)}) {
+		elf::output_format format = kind;
+		rows.push_back(measure(file, op, file.size, minRuns, minMs, lazyParser,
+					[&](std::unique_ptr<elf::elf_parser>& parser) {
+			std::ostringstream sink;
+			elf::stream_sink to(sink);
+			elf::output_buffer out(to);
+			parser->write(out, format);
+		}));
+	}
+	return rows;
+}
+
+
+static void write_json(const std::string& path, const std::vector<case_t>& cases, const std::vector<row_t>& rows) {
+
+	std::ofstream out(path);
+	out << "{\n  \"files\": [\n";
+	for (std::size_t i=0; i<cases.size(); i++) {
+		const synthetic::options_t &o = cases[i].options;
+		out << "    {\"name\": \"" << cases[i].name << "\", \"class\": " << (o.is64 ? 64 : 32)
+			<< ", \"big_endian\": " << (o.bigEndian ? "true" : "false") << ", \"sections\": " << o.sections
+			<< ", \"segments\": " << o.segments << ", \"symbols\": " << o.symbols
+			<< ", \"payload\": " << o.payload << ", \"bytes\": " << cases[i].size << "}"
+			<< (i+1 < cases.size() ? "," : "") << "\n";
+	}
+	out << "  ],\n  \"results\": [\n";
+	for (std::size_t i=0; i<rows.size(); i++) {
+		const row_t &r = rows[i];
+		out << "    {\"file\": \"" << r.file << "\", \"op\": \"" << r.op << "\", \"runs\": " << r.runs
+			<< ", \"best_ms\": " << r.best << ", \"median_ms\": " << r.median << ", \"bytes\": " << r.bytes
+			<< ", \"mb_per_s\": " << r.bytes / r.best / 1000 << ", \"allocations\": " << r.allocs
+			<< ", \"allocated_bytes\": " << r.allocBytes << ", \"peak_rss_kib\": " << r.peakRss << "}"
+			<< (i+1 < rows.size() ? "," : "") << "\n";
+	}
+	out << "  ]\n}\n";
+}
+
+
+int main(int argc, char** argv) {
+
+	std::string json;
+	bool quick = false;
+	for (int i=1; i<argc; i++) {
+		std::string flag = argv[i];
+		if (flag == "-json" && i+1 < argc) json = argv[++i];
+		else if (flag == "-quick") quick = true;
+		else {
+			std::cerr << "usage: " << argv[0] << " [-json results.json] [-quick]" << std::endl;
+			return 2;
+		}
+	}
+
+	std::filesystem::path dir = std::filesystem::temp_directory_path()
+					/ ("elf-suite-bench-" + std::to_string(getpid()));
+	std::filesystem::create_directories(dir);
+	std::vector<case_t> cases;
+	for (bool large : {false, true}) {
+		for (bool is64 : {true, false}) {
+			for (bool bigEndian : {false, true}) {
+				case_t file;
+				file.options.is64 = is64;
+				file.options.bigEndian = bigEndian;
+				file.options.sections = large ? 50000 : 1000;
+				file.options.segments = large ? 200 : 4;
+				file.options.symbols = large ? 500000 : 10000;
+				file.options.payload = large ? 256 : 64;
+				file.name = std::string(large ? "large-" : "small-") + (is64 ? "64" : "32")
+						+ (bigEndian ? "be" : "le");
+				file.path = (dir / (file.name + ".elf")).string();
+				std::vector<std::uint8_t> bytes = synthetic::make_elf(file.options);
+				std::ofstream(file.path, std::ios::binary).write(
+						reinterpret_cast<const char*>(bytes.data()), bytes.size());
+				file.size = bytes.size();
+				cases.push_back(file);
+			}
+		}
+	}
+
+	std::vector<row_t> rows;
+	std::cout << std::left << std::setw(14) << "File" << std::setw(18) << "Operation" << std::setw(12)
+			<< "Best (ms)" << std::setw(12) << "Median (ms)" << std::setw(10) << "MB/s" << std::setw(10)
+			<< "Allocs" << std::setw(12) << "Alloc KiB" << "Peak RSS KiB" << std::endl;
+	for (const case_t &file : cases) {
+		for (const row_t &r : run_case(file, quick ? 1 : 5, quick ? 0 : 200)) {
+			std::cout << std::setw(14) << r.file << std::setw(18) << r.op << std::fixed << std::setprecision(3)
+					<< std::setw(12) << r.best << std::setw(12) << r.median << std::setprecision(0)
+					<< std::setw(10) << r.bytes / r.best / 1000 << std::setw(10) << r.allocs
+					<< std::setw(12) << r.allocBytes / 1024 << r.peakRss << std::endl;
+			rows.push_back(r);
+		}
+	}
+	if (!json.empty()) write_json(json, cases, rows);
+	std::filesystem::remove_all(dir);
+	return 0;
+}
@@ -0,0 +1,77 @@
+#include "../../elf-cpp/inc/elf_parser.hpp"
+#include "synthetic_elf.hpp"
+
+#include <chrono>
+#include <random>
+
+// Address to function lookups against a large synthetic .symtab: plain
+// binary search over sorted addresses, address_index one at a time, and
+// address_index batched
+
+
+template <typename F>
+static double time_ms(F f) {
+
+	auto start = std::chrono::steady_clock::now();
+	f();
+	auto end = std::chrono::steady_clock::now();
+	return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+
+int main(void) {
+
+	synthetic::options_t options;
+	options.sections = 16;
+	options.segments = 1;
+	options.symbols = 2000000;
+	auto buffer = elf::file_buffer::from_vector(synthetic::make_elf(options));
+	elf::elf_64_parser parser(buffer, elf::read_options(elf::load_mode::map, true));
+	const elf::symbol_table &symbols = parser.symbols();
+
+	elf::address_index index;
+	double build = time_ms([&]() { index = elf::address_index(symbols); });
+
+	// the baseline, sorted (start, end, row) searched with upper_bound
+	std::vector<std::uint64_t> starts, ends;
+	std::vector<std::uint32_t> rows;
+	for (std::uint32_t row : symbols.filter(elf::STT_FUNC)) {
+		starts.push_back(symbols[row].value());
+		ends.push_back(symbols[row].value() + std::max<std::uint64_t>(symbols[row].size(), 1));
+		rows.push_back(row);
+	}
+
+	const std::size_t queries = 4000000;
+	std::mt19937_64 rng(42);
+	std::uniform_int_distribution<std::uint64_t> pick(starts.front(), ends.back());
+	std::vector<std::uint64_t> addresses(queries);
+	for (std::uint64_t &address : addresses) address = pick(rng);
+
+	std::vector<std::uint32_t> expected(queries), single(queries), batch(queries);
+	double binary = time_ms([&]() {
+		for (std::size_t i=0; i<queries; i++) {
+			auto it = std::upper_bound(starts.begin(), starts.end(), addresses[i]);
+			std::size_t k = it - starts.begin();
+			expected[i] = k && addresses[i] < ends[k-1] ? rows[k-1] : elf::address_index::npos;
+		}
+	});
+	double eytzinger = time_ms([&]() {
+		for (std::size_t i=0; i<queries; i++) single[i] = index.lookup(addresses[i]);
+	});
+	double batched = time_ms([&]() {
+		index.lookup(addresses.data(), queries, batch.data());
+	});
+
+	std::cout << std::fixed << std::setprecision(1);
+	std::cout << symbols.size() << " symbols, index built in " << build << " ms" << std::endl;
+	std::cout << std::left << std::setw(20) << "Lookup" << std::setw(12) << "Time (ms)"
+			<< "Mlookups/s" << std::endl;
+	for (auto [name, ms] : {std::make_pair("binary search", binary),
+				std::make_pair("eytzinger", eytzinger),
+				std::make_pair("eytzinger batch", batched)}) {
+		std::cout << std::setw(20) << name << std::setw(12) << ms << queries / ms / 1000 << std::endl;
+	}
+	bool same = expected == single && expected == batch;
+	std::cout << (same ? "results match" : "RESULTS DIFFER") << std::endl;
+	return same ? 0 : 1;
+}
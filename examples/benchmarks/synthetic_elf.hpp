@@ -0,0 +1,247 @@
+#ifndef SYNTHETIC_ELF_H
+#define SYNTHETIC_ELF_H
+
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Deterministic in-memory ELF images for benchmarking the parser
+
+namespace synthetic {
+
+typedef struct options_t {
+	bool is64 = true;
+	bool bigEndian = false;
+	std::size_t sections = 1000;	// PROGBITS sections, besides null, symbol and string tables
+	std::size_t segments = 4;	// PT_LOAD segments, each covers a run of sections
+	std::size_t payload = 16;	// bytes per section
+	std::size_t symbols = 0;	// STT_FUNC symbols in .symtab, none means no .symtab
+	std::string prefix = "f";	// symbol names are prefix followed by their number
+} options_t;
+
+
+class writer {
+
+	public:
+		writer(std::vector<std::uint8_t>& bytes, bool bigEndian) : bytes(bytes), bigEndian(bigEndian) {}
+		void put(std::size_t offset, std::uint64_t value, int size) {
+			for (int i=0; i<size; i++) {
+				int shift = bigEndian ? 8*(size-1-i) : 8*i;
+				bytes[offset+i] = (value >> shift) & 0xFF;
+			}
+		}
+
+	private:
+		std::vector<std::uint8_t>& bytes;
+		bool bigEndian;
+};
+
+
+inline std::vector<std::uint8_t> make_elf(const options_t& options) {
+
+	const bool is64 = options.is64;
+	const std::size_t ehsize = is64 ? 0x40 : 0x34;
+	const std::size_t phentsize = is64 ? 0x38 : 0x20;
+	const std::size_t shentsize = is64 ? 0x40 : 0x28;
+	const int word = is64 ? 8 : 4;
+	const std::uint64_t base = 0x400000;
+	const std::size_t symentsize = is64 ? 0x18 : 0x10;
+	const bool hasSymbols = options.symbols > 0;
+	const std::size_t shnum = options.sections + (hasSymbols ? 4 : 2);
+
+	// section names, ".s<n>" then ".symtab", ".strtab" and ".shstrtab"
+	std::string strtab(1, '\0');
+	std::vector<std::size_t> nameOffsets;
+	for (std::size_t i=0; i<options.sections; i++) {
+		nameOffsets.push_back(strtab.size());
+		strtab += ".s" + std::to_string(i) + '\0';
+	}
+	std::size_t symtabName = strtab.size();
+	strtab += std::string(".symtab") + '\0';
+	std::size_t strtabName = strtab.size();
+	strtab += std::string(".strtab") + '\0';
+	std::size_t shstrtabName = strtab.size();
+	strtab += std::string(".shstrtab") + '\0';
+
+	// symbol names, "f<n>" by default
+	std::string symstr(1, '\0');
+	std::vector<std::size_t> symNames;
+	for (std::size_t i=0; i<options.symbols; i++) {
+		symNames.push_back(symstr.size());
+		symstr += options.prefix + std::to_string(i) + '\0';
+	}
+
+	std::size_t phoff = ehsize;
+	std::size_t dataOff = phoff + phentsize * options.segments;
+	std::size_t strOff = dataOff + options.sections * options.payload;
+	std::size_t symstrOff = strOff + strtab.size();
+	std::size_t symOff = (symstrOff + (hasSymbols ? symstr.size() : 0) + 7) & ~(std::size_t) 7;
+	std::size_t symSize = hasSymbols ? symentsize * (options.symbols + 1) : 0;
+	std::size_t shoff = (symOff + symSize + 7) & ~(std::size_t) 7;
+	std::vector<std::uint8_t> bytes(shoff + shentsize * shnum);
+	writer out(bytes, options.bigEndian);
+
+	// file header
+	bytes[0] = 0x7F; bytes[1] = 'E'; bytes[2] = 'L'; bytes[3] = 'F';
+	bytes[4] = is64 ? 2 : 1;
+	bytes[5] = options.bigEndian ? 2 : 1;
+	bytes[6] = 1;
+	out.put(0x10, 2, 2);					// e_type EXEC
+	out.put(0x12, is64 ? 0x3E : 0x03, 2);			// e_machine
+	out.put(0x14, 1, 4);					// e_version
+	out.put(0x18, base + dataOff, word);			// e_entry
+	out.put(is64 ? 0x20 : 0x1C, phoff, word);		// e_phoff
+	out.put(is64 ? 0x28 : 0x20, shoff, word);		// e_shoff
+	std::size_t half = is64 ? 0x34 : 0x28;
+	out.put(half, ehsize, 2);				// e_ehsize
+	out.put(half+2, phentsize, 2);				// e_phentsize
+	out.put(half+4, options.segments, 2);			// e_phnum
+	out.put(half+6, shentsize, 2);				// e_shentsize
+	// beyond 0xff00 sections the counts move into section 0
+	bool extended = shnum >= 0xff00;
+	out.put(half+8, extended ? 0 : shnum, 2);		// e_shnum
+	out.put(half+10, extended ? 0xffff : shnum-1, 2);	// e_shstrndx
+
+	// sections
+	for (std::size_t i=0; i<options.sections; i++) {
+		std::size_t offset = dataOff + i * options.payload;
+		for (std::size_t j=0; j<options.payload; j++) bytes[offset+j] = (i + j) & 0xFF;
+	}
+	std::copy(strtab.begin(), strtab.end(), bytes.begin() + strOff);
+	if (hasSymbols) std::copy(symstr.begin(), symstr.end(), bytes.begin() + symstrOff);
+
+	// functions 16 bytes apart with sizes from 4 to 16, so some addresses
+	// fall in the gaps between them
+	for (std::size_t i=0; i<options.symbols; i++) {
+		std::size_t entry = symOff + symentsize * (i+1);
+		std::uint64_t value = base + dataOff + 16 * i;
+		std::uint64_t size = 4 + (i * 2654435761u >> 7) % 13;
+		out.put(entry, symNames[i], 4);
+		if (is64) {
+			bytes[entry+4] = 0x12;				// GLOBAL FUNC
+			out.put(entry+6, 1, 2);
+			out.put(entry+8, value, 8);
+			out.put(entry+16, size, 8);
+		} else {
+			out.put(entry+4, value, 4);
+			out.put(entry+8, size, 4);
+			bytes[entry+12] = 0x12;
+			out.put(entry+14, 1, 2);
+		}
+	}
+	auto section = [&](std::size_t index, std::uint64_t name, std::uint32_t type,
+				std::uint64_t flags, std::uint64_t addr, std::uint64_t offset,
+				std::uint64_t size, std::uint32_t link, std::uint32_t info,
+				std::uint64_t entsize) {
+		std::size_t entry = shoff + shentsize * index;
+		out.put(entry, name, 4);
+		out.put(entry+4, type, 4);
+		out.put(entry+8, flags, word);
+		out.put(entry+8+word, addr, word);
+		out.put(entry+8+2*word, offset, word);
+		out.put(entry+8+3*word, size, word);
+		out.put(entry+8+4*word, link, 4);
+		out.put(entry+12+4*word, info, 4);
+		out.put(entry+16+4*word, 1, word);
+		out.put(entry+16+5*word, entsize, word);
+	};
+	section(0, 0, 0, 0, 0, 0, extended ? shnum : 0, extended ? shnum-1 : 0, 0, 0);
+	for (std::size_t i=0; i<options.sections; i++) {
+		std::uint64_t offset = dataOff + i * options.payload;
+		section(i+1, nameOffsets[i], 0x01, 0x02, base + offset, offset, options.payload, 0, 0, 0);
+	}
+	if (hasSymbols) {
+		std::size_t symtab = options.sections + 1;
+		section(symtab, symtabName, 0x02, 0, 0, symOff, symSize, symtab+1, 1, symentsize);
+		section(symtab+1, strtabName, 0x03, 0, 0, symstrOff, symstr.size(), 0, 0, 0);
+	}
+	section(shnum-1, shstrtabName, 0x03, 0, 0, strOff, strtab.size(), 0, 0, 0);
+
+	// segments split the sections evenly
+	for (std::size_t i=0; i<options.segments; i++) {
+		std::size_t first = options.sections * i / options.segments;
+		std::size_t last = options.sections * (i+1) / options.segments;
+		std::uint64_t offset = dataOff + first * options.payload;
+		std::uint64_t size = (last - first) * options.payload;
+		std::size_t entry = phoff + phentsize * i;
+		out.put(entry, 0x01, 4);				// PT_LOAD
+		if (is64) {
+			out.put(entry+0x04, 0x4, 4);
+			out.put(entry+0x08, offset, 8);
+			out.put(entry+0x10, base + offset, 8);
+			out.put(entry+0x18, base + offset, 8);
+			out.put(entry+0x20, size, 8);
+			out.put(entry+0x28, size, 8);
+			out.put(entry+0x30, 1, 8);
+		} else {
+			out.put(entry+0x04, offset, 4);
+			out.put(entry+0x08, base + offset, 4);
+			out.put(entry+0x0C, base + offset, 4);
+			out.put(entry+0x10, size, 4);
+			out.put(entry+0x14, size, 4);
+			out.put(entry+0x18, 0x4, 4);
+			out.put(entry+0x1C, 1, 4);
+		}
+	}
+	return bytes;
+}
+
+
+// Contents of a little endian DWARF 4 .debug_line with units compilation
+// units of rows rows each, in one sequence per unit. Units cover adjacent
+// address ranges from 0x400000, rows are 1 to 16 bytes apart.
+inline std::vector<std::uint8_t> make_debug_line(std::size_t units, std::size_t rows) {
+
+	const int lineBase = -5, lineRange = 14, opcodeBase = 13;
+	std::vector<std::uint8_t> bytes;
+	std::uint64_t address = 0x400000;
+	std::uint32_t seed = 1;
+	auto next = [&seed]() { seed = seed * 1103515245 + 12345; return seed >> 8; };
+	auto put = [&bytes](std::uint64_t value, int size) {
+		for (int i=0; i<size; i++) bytes.push_back(value >> 8*i);
+	};
+	for (std::size_t unit=0; unit<units; unit++) {
+		std::size_t start = bytes.size();
+		put(0, 4);					// unit_length, patched below
+		put(4, 2);					// version
+		std::size_t headerLength = bytes.size();
+		put(0, 4);
+		std::size_t header = bytes.size();
+		const std::uint8_t fields[] = {1, 1, 1, (std::uint8_t) lineBase, lineRange, opcodeBase,
+						0, 1, 1, 1, 1, 0, 0, 0, 1, 0, 0, 1};
+		bytes.insert(bytes.end(), fields, fields + sizeof(fields));
+		std::string dirs = "src/u" + std::to_string(unit) + '\0' + '\0';
+		bytes.insert(bytes.end(), dirs.begin(), dirs.end());
+		for (int file=0; file<4; file++) {
+			std::string name = "f" + std::to_string(file) + ".cpp";
+			bytes.insert(bytes.end(), name.begin(), name.end());
+			bytes.insert(bytes.end(), {0, 1, 0, 0});	// dir 1, no time or size
+		}
+		bytes.push_back(0);
+		std::uint32_t length = bytes.size() - header;
+		for (int i=0; i<4; i++) bytes[headerLength+i] = length >> 8*i;
+
+		bytes.insert(bytes.end(), {0, 9, 2});		// DW_LNE_set_address
+		put(address, 8);
+		for (std::size_t row=0; row<rows; row++) {
+			if (row % 64 == 0) {
+				bytes.push_back(4);			// DW_LNS_set_file
+				bytes.push_back(1 + next() % 4);
+				bytes.push_back(5);			// DW_LNS_set_column
+				bytes.push_back(1 + next() % 80);
+			}
+			int advance = 1 + next() % 16, line = (int) (next() % 12) + lineBase;
+			bytes.push_back((line - lineBase) + lineRange * advance + opcodeBase);
+			address += advance;
+		}
+		bytes.insert(bytes.end(), {0, 1, 1});		// DW_LNE_end_sequence
+		std::uint32_t unitLength = bytes.size() - start - 4;
+		for (int i=0; i<4; i++) bytes[start+i] = unitLength >> 8*i;
+	}
+	return bytes;
+}
+
+} // end of namespace synthetic
+
+#endif
@@ -0,0 +1,101 @@
+#include "../../elf-cpp/inc/elf_parser.hpp"
+#include "synthetic_elf.hpp"
+
+#include <chrono>
+#include <random>
+
+// Virtual address to file offset over the PT_LOAD segments of a synthetic
+// file with 1000 segments, 1M random and 1M ascending addresses, a linear
+// walk of the program headers against segment_index. Then every defined
+// dynamic symbol of libc and libstdc++ (or the objects given) is translated
+// to an offset and back, which has to give the same address, and counted
+// as file bytes or bss.
+
+
+template <typename F>
+static double time_ms(F f) {
+
+	auto start = std::chrono::steady_clock::now();
+	f();
+	auto end = std::chrono::steady_clock::now();
+	return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+
+int main(int argc, char** argv) {
+
+	synthetic::options_t options;
+	options.sections = 100000;
+	options.segments = 1000;
+	auto buffer = elf::file_buffer::from_vector(synthetic::make_elf(options));
+	elf::elf_64_parser parser(buffer, elf::read_options(elf::load_mode::map, true));
+	const elf::segment_index& index = parser.vaddr_index();
+	std::uint64_t first = index.segments().front().vaddr;
+	std::uint64_t span = index.segments().back().vaddr + index.segments().back().memsz - first;
+
+	std::mt19937_64 random(11);
+	std::vector<std::uint64_t> randomAddresses, ascending;
+	for (int i=0; i<1000000; i++) randomAddresses.push_back(first + random() % span);
+	for (int i=0; i<1000000; i++) ascending.push_back(first + span * (std::uint64_t) i / 1000000);
+
+	std::cout << index.size() << " segments" << std::endl;
+	std::cout << std::left << std::setw(14) << "Addresses" << std::setw(16) << "Linear (ns)"
+			<< std::setw(16) << "Index (ns)" << "Speedup" << std::endl;
+	for (auto [name, addresses] : {std::make_pair("random", &randomAddresses),
+					std::make_pair("ascending", &ascending)}) {
+		std::uint64_t linearSum = 0, indexSum = 0;
+		double linear = time_ms([&, addresses = addresses]() {
+			for (std::uint64_t address : *addresses) {
+				for (const auto &segment : parser.segments()) {
+					if (segment.p_type == 0x01 && address - segment.p_vaddr < segment.p_filesz) {
+						linearSum += segment.p_offset + (address - segment.p_vaddr);
+						break;
+					}
+				}
+			}
+		});
+		double indexed = time_ms([&, addresses = addresses]() {
+			for (std::uint64_t address : *addresses) indexSum += index.vaddr_to_offset(address);
+		});
+		if (linearSum != indexSum) {
+			std::cerr << "offsets differ" << std::endl;
+			return 1;
+		}
+		std::cout << std::setw(14) << name << std::fixed << std::setprecision(1)
+				<< std::setw(16) << linear * 1e6 / addresses->size()
+				<< std::setw(16) << indexed * 1e6 / addresses->size() << linear / indexed << "x" << std::endl;
+	}
+
+	std::vector<std::string> files;
+	for (int i=1; i<argc; i++) files.push_back(argv[i]);
+	if (files.empty()) files = {"/usr/lib/x86_64-linux-gnu/libc.so.6", "/usr/lib/x86_64-linux-gnu/libstdc++.so.6"};
+	for (const std::string &file : files) {
+		elf::parse_error error;
+		std::unique_ptr<elf::elf_parser> object = elf::elf_parser::open(file, error);
+		if (!object) {
+			std::cerr << file << ": " << error.message << std::endl;
+			continue;
+		}
+		const elf::segment_index& segments = object->vaddr_index();
+		std::size_t inFile = 0, inBss = 0, unmapped = 0;
+		for (elf::symbol_table::symbol symbol : object->dynamic_symbols()) {
+			// TLS values are offsets into the TLS block
+			if (symbol.shndx() == 0 || symbol.value() == 0 || symbol.type() == 6) continue;
+			std::uint64_t offset = segments.vaddr_to_offset(symbol.value());
+			if (offset != elf::segment_index::npos) {
+				if (segments.offset_to_vaddr(offset) != symbol.value()) {
+					std::cerr << file << ": " << symbol.name() << " doesn't translate back" << std::endl;
+					return 1;
+				}
+				inFile++;
+			} else if (segments.find(symbol.value())) {
+				inBss++;
+			} else {
+				unmapped++;
+			}
+		}
+		std::cout << file << ": " << segments.size() << " PT_LOAD, " << inFile << " symbols in file bytes, "
+				<< inBss << " in bss, " << unmapped << " unmapped" << std::endl;
+	}
+	return 0;
+}
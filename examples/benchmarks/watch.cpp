@@ -0,0 +1,83 @@
+#include "../../elf-cpp/inc/elf_watch.hpp"
+#include "synthetic_elf.hpp"
+
+#include <chrono>
+#include <unistd.h>
+
+// A relink loop on a synthetic file of 5000 sections of 16KiB and 1M
+// symbols (or the section count given): each round one section's bytes
+// change and the file is replaced by rename, as linkers do. Times the
+// watcher from the rename to the delivered change, symbols included, against
+// a fresh read_file parse that decodes the symbols again.
+
+
+template <typename F>
+static double time_ms(F f) {
+
+	auto start = std::chrono::steady_clock::now();
+	f();
+	auto end = std::chrono::steady_clock::now();
+	return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+
+int main(int argc, char** argv) {
+
+	synthetic::options_t options;
+	options.sections = argc > 1 ? std::stoul(argv[1]) : 5000;
+	options.segments = 16;
+	options.symbols = 1000000;
+	options.payload = 16 << 10;
+	std::vector<std::uint8_t> bytes = synthetic::make_elf(options);
+
+	std::filesystem::path dir = std::filesystem::temp_directory_path()
+					/ ("elf-watch-bench-" + std::to_string(getpid()));
+	std::filesystem::create_directories(dir);
+	std::string path = (dir / "out.elf").string();
+	auto write = [&](const std::string& to) {
+		std::ofstream(to, std::ios::binary).write(reinterpret_cast<const char*>(bytes.data()), bytes.size());
+	};
+	write(path);
+	std::cout << path << ": " << bytes.size() / 1e6 << " MB, " << options.sections << " sections, "
+			<< options.symbols << " symbols" << std::endl;
+
+	elf::elf_watcher watcher;
+	elf::parse_error error;
+	if (!watcher.add(path, error)) {
+		std::cerr << path << ": " << error.message << std::endl;
+		return 1;
+	}
+	watcher.parser(path)->symbols();
+	std::size_t changed = 0, adopted = 0;
+	std::uint64_t hashed = 0;
+	watcher.subscribe([&](const elf::elf_change& change) {
+		changed = change.sections.size();
+		adopted = change.adopted;
+		hashed = change.hashed;
+		change.parser->symbols();
+	});
+
+	std::cout << std::left << std::setw(8) << "Round" << std::setw(16) << "Watcher (ms)" << std::setw(16)
+			<< "read_file (ms)" << std::setw(10) << "Changed" << std::setw(12) << "Hashed MB" << "Symbols kept"
+			<< std::endl;
+	for (int round=0; round<5; round++) {
+		// somewhere in the payload of one section
+		std::size_t at = bytes.size() / 2 + round * 4096;
+		bytes[at] ^= 0xFF;
+		write(path + ".tmp");
+		double watched = time_ms([&]() {
+			std::filesystem::rename(path + ".tmp", path);
+			while (watcher.poll(1000) == 0) {}
+		});
+		double full = time_ms([&]() {
+			std::unique_ptr<elf::elf_parser> parser = elf::elf_parser::open(path, error,
+										elf::read_options(elf::load_mode::copy));
+			parser->symbols();
+		});
+		std::cout << std::setw(8) << round << std::fixed << std::setprecision(1) << std::setw(16) << watched
+				<< std::setw(16) << full << std::setw(10) << changed << std::setw(12) << hashed / 1e6
+				<< ((adopted & elf::adopted_symbols) ? "yes" : "no") << std::endl;
+	}
+	std::filesystem::remove_all(dir);
+	return 0;
+}